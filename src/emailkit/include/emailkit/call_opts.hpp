@@ -0,0 +1 @@
+#include "../../src/call_opts.hpp"
\ No newline at end of file
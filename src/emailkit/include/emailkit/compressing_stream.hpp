@@ -0,0 +1 @@
+#include "../../src/compressing_stream.hpp"
\ No newline at end of file
@@ -0,0 +1 @@
+#include "../../src/connection_health.hpp"
\ No newline at end of file
@@ -0,0 +1 @@
+#include "../../src/deflate_codec.hpp"
\ No newline at end of file
@@ -0,0 +1 @@
+#include "../../src/fetch_batch_sizer.hpp"
\ No newline at end of file
@@ -0,0 +1 @@
+#include "../../src/imap_capabilities.hpp"
\ No newline at end of file
@@ -0,0 +1 @@
+#include "../../src/imap_client_coro.hpp"
\ No newline at end of file
@@ -0,0 +1 @@
+#include "../../src/imap_connection_pool.hpp"
\ No newline at end of file
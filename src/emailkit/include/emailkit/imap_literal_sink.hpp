@@ -0,0 +1 @@
+#include "../../src/imap_literal_sink.hpp"
\ No newline at end of file
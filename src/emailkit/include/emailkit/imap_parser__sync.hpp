@@ -0,0 +1 @@
+#include "../../src/imap_parser__sync.hpp"
\ No newline at end of file
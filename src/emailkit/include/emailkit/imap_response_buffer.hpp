@@ -0,0 +1 @@
+#include "../../src/imap_response_buffer.hpp"
\ No newline at end of file
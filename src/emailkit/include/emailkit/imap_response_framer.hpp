@@ -0,0 +1 @@
+#include "../../src/imap_response_framer.hpp"
\ No newline at end of file
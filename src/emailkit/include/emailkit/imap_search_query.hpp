@@ -0,0 +1 @@
+#include "../../src/imap_search_query.hpp"
\ No newline at end of file
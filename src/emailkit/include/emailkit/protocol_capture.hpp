@@ -0,0 +1 @@
+#include "../../src/protocol_capture.hpp"
\ No newline at end of file
@@ -0,0 +1 @@
+#include "../../src/tcp_connector.hpp"
\ No newline at end of file
@@ -0,0 +1 @@
+#include "../../src/timer_wheel.hpp"
\ No newline at end of file
@@ -0,0 +1 @@
+#include "../../src/tls_session_cache.hpp"
\ No newline at end of file
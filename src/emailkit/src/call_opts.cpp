@@ -0,0 +1,68 @@
+#include "call_opts.hpp"
+#include <utility>
+
+namespace emailkit {
+
+cancellation_registration_t::cancellation_registration_t(
+    cancellation_registration_t&& other) noexcept
+    : m_state(std::move(other.m_state)), m_id(std::exchange(other.m_id, 0)) {}
+
+cancellation_registration_t& cancellation_registration_t::operator=(
+    cancellation_registration_t&& other) noexcept {
+    if (this != &other) {
+        reset();
+        m_state = std::move(other.m_state);
+        m_id = std::exchange(other.m_id, 0);
+    }
+    return *this;
+}
+
+void cancellation_registration_t::reset() {
+    if (auto state = m_state.lock()) {
+        std::lock_guard lock{state->mutex};
+        state->callbacks.erase(m_id);
+    }
+    m_state.reset();
+    m_id = 0;
+}
+
+bool cancellation_token_t::is_cancelled() const {
+    if (!m_state) {
+        return false;
+    }
+    std::lock_guard lock{m_state->mutex};
+    return m_state->cancelled;
+}
+
+cancellation_registration_t cancellation_token_t::on_cancel(
+    fu2::unique_function<void()> cb) const {
+    if (!m_state) {
+        return {};
+    }
+    {
+        std::lock_guard lock{m_state->mutex};
+        if (!m_state->cancelled) {
+            const auto id = ++m_state->last_id;
+            m_state->callbacks.emplace(id, std::move(cb));
+            return cancellation_registration_t{m_state, id};
+        }
+    }
+    cb();
+    return {};
+}
+
+void cancellation_source_t::cancel() {
+    std::map<uint64_t, fu2::unique_function<void()>> callbacks;
+    {
+        std::lock_guard lock{m_state->mutex};
+        if (std::exchange(m_state->cancelled, true)) {
+            return;
+        }
+        callbacks.swap(m_state->callbacks);
+    }
+    for (auto& [id, cb] : callbacks) {
+        cb();
+    }
+}
+
+}  // namespace emailkit
@@ -0,0 +1,84 @@
+#pragma once
+#include <emailkit/global.hpp>
+#include <mutex>
+
+namespace emailkit {
+
+namespace detail {
+struct cancellation_state_t {
+    std::mutex mutex;
+    bool cancelled = false;
+    uint64_t last_id = 0;
+    std::map<uint64_t, fu2::unique_function<void()>> callbacks;
+};
+}  // namespace detail
+
+// Unregisters cancellation callback when destroyed.
+class cancellation_registration_t {
+   public:
+    cancellation_registration_t() = default;
+    cancellation_registration_t(std::weak_ptr<detail::cancellation_state_t> state, uint64_t id)
+        : m_state(std::move(state)), m_id(id) {}
+    cancellation_registration_t(cancellation_registration_t&& other) noexcept;
+    cancellation_registration_t& operator=(cancellation_registration_t&& other) noexcept;
+    ~cancellation_registration_t() { reset(); }
+
+    void reset();
+
+   private:
+    std::weak_ptr<detail::cancellation_state_t> m_state;
+    uint64_t m_id = 0;
+};
+
+// Observing side of cancellation_source_t. Default constructed token is never cancelled. Tokens
+// are cheap to copy and can be shared by any number of calls.
+class cancellation_token_t {
+   public:
+    cancellation_token_t() = default;
+    explicit cancellation_token_t(std::shared_ptr<detail::cancellation_state_t> state)
+        : m_state(std::move(state)) {}
+
+    bool can_be_cancelled() const { return m_state != nullptr; }
+    bool is_cancelled() const;
+
+    // Callback is called once, from the thread which calls cancel(), or right away if the token
+    // is cancelled already. Callback is not called if registration is destroyed before cancel(),
+    // so callbacks which need a particular thread should post to it.
+    [[nodiscard]] cancellation_registration_t on_cancel(fu2::unique_function<void()> cb) const;
+
+   private:
+    std::shared_ptr<detail::cancellation_state_t> m_state;
+};
+
+// Requests cancellation of all calls which have been given its token. Thread safe.
+class cancellation_source_t {
+   public:
+    cancellation_source_t() : m_state(std::make_shared<detail::cancellation_state_t>()) {}
+
+    cancellation_token_t token() const { return cancellation_token_t{m_state}; }
+    void cancel();
+
+   private:
+    std::shared_ptr<detail::cancellation_state_t> m_state;
+};
+
+// Constraints of an asynchronous call. Deadline is absolute so that the same opts can be passed
+// down to every step of a multi-step operation (e.g. send command and receive its response) and
+// the operation as a whole is constrained by it.
+//
+// When deadline expires, call fails with std::errc::timed_out, when cancelled, with
+// std::errc::operation_canceled.
+struct call_opts_t {
+    std::optional<std::chrono::steady_clock::time_point> deadline;
+    cancellation_token_t cancellation;
+
+    static call_opts_t timeout(std::chrono::steady_clock::duration d,
+                               cancellation_token_t cancellation = {}) {
+        return call_opts_t{.deadline = std::chrono::steady_clock::now() + d,
+                           .cancellation = std::move(cancellation)};
+    }
+
+    bool unconstrained() const { return !deadline && !cancellation.can_be_cancelled(); }
+};
+
+}  // namespace emailkit
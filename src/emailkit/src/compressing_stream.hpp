@@ -0,0 +1,204 @@
+#pragma once
+#include <emailkit/global.hpp>
+#include <asio/buffer.hpp>
+#include <asio/compose.hpp>
+#include <asio/post.hpp>
+#include <asio/write.hpp>
+#include <emailkit/deflate_codec.hpp>
+
+namespace emailkit {
+
+// Stream adapter which sits between TLS stream and IMAP reading/writing code. Until compression is
+// started all operations are forwarded to next layer as they are, after that data is inflated on
+// the way in and deflated on the way out (IMAP COMPRESS=DEFLATE). Satisfies asio AsyncReadStream
+// and AsyncWriteStream requirements so it can be used with async_read_until and async_write.
+template <class NextLayer>
+class compressing_stream_t {
+   public:
+    using executor_type = typename NextLayer::executor_type;
+
+    explicit compressing_stream_t(NextLayer& next_layer) : m_next_layer(next_layer) {}
+
+    executor_type get_executor() { return m_next_layer.get_executor(); }
+
+    bool compression_started() const { return m_codec != nullptr; }
+
+    // Observer is told how many bytes went through next layer (compressed ones if compression
+    // is on), e.g. for estimating connection health.
+    using transfer_observer_t = fu2::function<void(size_t bytes_received, size_t bytes_sent)>;
+    void set_transfer_observer(transfer_observer_t observer) {
+        m_transfer_observer = std::move(observer);
+    }
+    const deflate_codec_t* codec() const { return m_codec.get(); }
+
+    // Starts compression in both directions. already_received contains bytes which were received
+    // from the peer after it agreed to compress, they are compressed already.
+    std::error_code start_compression(std::string_view already_received) {
+        if (m_codec) {
+            return make_error_code(std::errc::already_connected);
+        }
+        auto codec = std::make_unique<deflate_codec_t>();
+        if (auto ec = codec->init_error()) {
+            return ec;
+        }
+        if (auto ec = codec->inflate(already_received, m_plain_in)) {
+            return ec;
+        }
+        m_codec = std::move(codec);
+        return {};
+    }
+
+    // Forgets compression and buffered data, for a new connection of next layer. No operations
+    // may be in progress.
+    void reset() {
+        m_codec.reset();
+        m_compressed_in.clear();
+        m_plain_in.clear();
+        m_compressed_out.clear();
+    }
+
+    template <class MutableBufferSequence, class ReadToken>
+    auto async_read_some(const MutableBufferSequence& buffers, ReadToken&& token) {
+        return asio::async_compose<ReadToken, void(std::error_code, size_t)>(
+            read_some_op<MutableBufferSequence>{*this, buffers}, token, m_next_layer);
+    }
+
+    template <class ConstBufferSequence, class WriteToken>
+    auto async_write_some(const ConstBufferSequence& buffers, WriteToken&& token) {
+        return asio::async_compose<WriteToken, void(std::error_code, size_t)>(
+            write_some_op<ConstBufferSequence>{*this, buffers}, token, m_next_layer);
+    }
+
+   private:
+    static constexpr size_t COMPRESSED_CHUNK_SIZE = 16 * 1024;
+
+    void notify_transfer(size_t bytes_received, size_t bytes_sent) {
+        if (m_transfer_observer) {
+            m_transfer_observer(bytes_received, bytes_sent);
+        }
+    }
+
+    template <class MutableBufferSequence>
+    size_t take_plain_in(const MutableBufferSequence& buffers) {
+        const size_t n = asio::buffer_copy(buffers, asio::buffer(m_plain_in));
+        m_plain_in.erase(0, n);
+        return n;
+    }
+
+    template <class MutableBufferSequence>
+    struct read_some_op {
+        compressing_stream_t& stream;
+        MutableBufferSequence buffers;
+        enum class state_t { starting, reading_raw, reading_compressed, has_plain } state{};
+
+        template <class Self>
+        void operator()(Self& self, std::error_code ec = {}, size_t bytes_transferred = 0) {
+            switch (state) {
+                case state_t::starting:
+                    if (!stream.m_codec) {
+                        state = state_t::reading_raw;
+                        stream.m_next_layer.async_read_some(buffers, std::move(self));
+                    } else if (!stream.m_plain_in.empty()) {
+                        // Not completing inline, caller does not expect handler to be called
+                        // from within initiating function.
+                        state = state_t::has_plain;
+                        asio::post(stream.get_executor(), std::move(self));
+                    } else {
+                        state = state_t::reading_compressed;
+                        stream.m_compressed_in.resize(COMPRESSED_CHUNK_SIZE);
+                        stream.m_next_layer.async_read_some(asio::buffer(stream.m_compressed_in),
+                                                            std::move(self));
+                    }
+                    return;
+
+                case state_t::reading_raw:
+                    stream.notify_transfer(bytes_transferred, 0);
+                    self.complete(ec, bytes_transferred);
+                    return;
+
+                case state_t::reading_compressed:
+                    stream.notify_transfer(bytes_transferred, 0);
+                    if (ec) {
+                        self.complete(ec, 0);
+                        return;
+                    }
+                    if (auto inflate_ec = stream.m_codec->inflate(
+                            {stream.m_compressed_in.data(), bytes_transferred}, stream.m_plain_in)) {
+                        self.complete(inflate_ec, 0);
+                        return;
+                    }
+                    if (stream.m_plain_in.empty()) {
+                        // Compressed chunk may produce no output (e.g. only a flush marker).
+                        stream.m_next_layer.async_read_some(asio::buffer(stream.m_compressed_in),
+                                                            std::move(self));
+                        return;
+                    }
+                    self.complete({}, stream.take_plain_in(buffers));
+                    return;
+
+                case state_t::has_plain:
+                    self.complete({}, stream.take_plain_in(buffers));
+                    return;
+            }
+        }
+    };
+
+    template <class ConstBufferSequence>
+    struct write_some_op {
+        compressing_stream_t& stream;
+        ConstBufferSequence buffers;
+        enum class state_t { starting, writing_raw, writing_compressed } state{};
+        size_t plain_size = 0;
+
+        template <class Self>
+        void operator()(Self& self, std::error_code ec = {}, size_t bytes_transferred = 0) {
+            switch (state) {
+                case state_t::starting: {
+                    if (!stream.m_codec) {
+                        state = state_t::writing_raw;
+                        stream.m_next_layer.async_write_some(buffers, std::move(self));
+                        return;
+                    }
+
+                    std::string plain(asio::buffer_size(buffers), '\0');
+                    asio::buffer_copy(asio::buffer(plain), buffers);
+                    plain_size = plain.size();
+
+                    stream.m_compressed_out.clear();
+                    if (auto deflate_ec = stream.m_codec->deflate(plain, stream.m_compressed_out)) {
+                        asio::post(stream.get_executor(),
+                                   [self = std::move(self), deflate_ec]() mutable {
+                                       self.complete(deflate_ec, 0);
+                                   });
+                        return;
+                    }
+
+                    state = state_t::writing_compressed;
+                    asio::async_write(stream.m_next_layer, asio::buffer(stream.m_compressed_out),
+                                      std::move(self));
+                    return;
+                }
+
+                case state_t::writing_raw:
+                    stream.notify_transfer(0, bytes_transferred);
+                    self.complete(ec, bytes_transferred);
+                    return;
+
+                case state_t::writing_compressed:
+                    stream.notify_transfer(0, bytes_transferred);
+                    // Caller is interested in how much of its data went out, not compressed size.
+                    self.complete(ec, ec ? 0 : plain_size);
+                    return;
+            }
+        }
+    };
+
+    NextLayer& m_next_layer;
+    std::unique_ptr<deflate_codec_t> m_codec;
+    std::string m_compressed_in;
+    std::string m_plain_in;  // inflated but not yet consumed by reader
+    std::string m_compressed_out;
+    transfer_observer_t m_transfer_observer;
+};
+
+}  // namespace emailkit
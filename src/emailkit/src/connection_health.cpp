@@ -0,0 +1,132 @@
+#include "connection_health.hpp"
+
+namespace emailkit {
+
+std::string_view to_string(link_grade_t grade) {
+    switch (grade) {
+        case link_grade_t::green:
+            return "green";
+        case link_grade_t::yellow:
+            return "yellow";
+        case link_grade_t::red:
+            return "red";
+    }
+    return "unknown";
+}
+
+void connection_health_estimator_t::on_bytes_received(size_t n, steady_clock::time_point now) {
+    m_bytes_received_total += n;
+    m_last_byte_at = now;
+
+    if (m_in_flight.empty()) {
+        return;  // unsolicited data (e.g. IDLE updates), not useful for estimates
+    }
+
+    auto& front = m_in_flight.front();
+    if (!front.rtt_sampled) {
+        front.rtt_sampled = true;
+        const auto sample =
+            std::chrono::duration_cast<std::chrono::microseconds>(now - front.sent_at);
+        // Waits which went over stall timeout are reported as stalls, folding them into RTT would
+        // only keep connection graded as bad long after it has recovered.
+        if (sample < m_opts.stall_timeout) {
+            m_last_rtt = sample;
+            m_rtt = m_rtt.count() == 0
+                        ? sample
+                        : std::chrono::microseconds{static_cast<int64_t>(
+                              m_opts.rtt_alpha * sample.count() +
+                              (1.0 - m_opts.rtt_alpha) * m_rtt.count())};
+        }
+    }
+
+    if (!m_window_start) {
+        // Bytes of the chunk which opened the window have been travelling for unknown time, so
+        // they are not counted.
+        m_window_start = now;
+        m_window_bytes = 0;
+        return;
+    }
+    m_window_bytes += n;
+    if (now - *m_window_start >= m_opts.bandwidth_sample_interval) {
+        close_bandwidth_window(now);
+        m_window_start = now;
+    }
+}
+
+void connection_health_estimator_t::on_bytes_sent(size_t n, steady_clock::time_point now) {
+    m_bytes_sent_total += n;
+}
+
+void connection_health_estimator_t::on_command_sent(std::string_view tag,
+                                                    steady_clock::time_point now) {
+    m_server_waits_for_us = false;
+    m_waiting_since = now;
+    if (tag.empty()) {
+        return;  // continuation data of a command which is already in flight
+    }
+    const bool rtt_eligible = m_in_flight.empty();
+    m_in_flight.push_back(in_flight_command_t{std::string{tag}, now, !rtt_eligible});
+}
+
+void connection_health_estimator_t::on_continuation_request(steady_clock::time_point now) {
+    m_server_waits_for_us = true;
+}
+
+void connection_health_estimator_t::on_tagged_response(std::string_view tag,
+                                                       steady_clock::time_point now) {
+    auto it = std::find_if(m_in_flight.begin(), m_in_flight.end(),
+                           [tag](const in_flight_command_t& c) { return c.tag == tag; });
+    if (it == m_in_flight.end()) {
+        return;
+    }
+    m_in_flight.erase(m_in_flight.begin(), std::next(it));
+
+    if (m_in_flight.empty() && m_window_start) {
+        close_bandwidth_window(now);
+        m_window_start.reset();
+    }
+}
+
+void connection_health_estimator_t::close_bandwidth_window(steady_clock::time_point now) {
+    const auto elapsed = std::chrono::duration<double>(now - *m_window_start).count();
+    if (m_window_bytes >= m_opts.bandwidth_min_sample_bytes && elapsed > 0) {
+        const double sample = m_window_bytes / elapsed;
+        m_bandwidth = m_bandwidth == 0
+                          ? sample
+                          : m_opts.bandwidth_alpha * sample +
+                                (1.0 - m_opts.bandwidth_alpha) * m_bandwidth;
+    }
+    m_window_bytes = 0;
+}
+
+connection_health_t connection_health_estimator_t::snapshot(steady_clock::time_point now) const {
+    using std::chrono::duration_cast;
+    using std::chrono::milliseconds;
+
+    connection_health_t h;
+    h.bandwidth = m_bandwidth;
+    h.rtt = m_rtt;
+    h.last_rtt = m_last_rtt;
+    if (m_last_byte_at != steady_clock::time_point{}) {
+        h.since_last_byte = duration_cast<milliseconds>(now - m_last_byte_at);
+    }
+    if (!m_in_flight.empty() && !m_server_waits_for_us) {
+        h.pending_silence =
+            duration_cast<milliseconds>(now - std::max(m_last_byte_at, m_waiting_since));
+    }
+    h.bytes_received_total = m_bytes_received_total;
+    h.bytes_sent_total = m_bytes_sent_total;
+    h.commands_in_flight = m_in_flight.size();
+
+    if (h.pending_silence >= m_opts.stall_timeout || h.rtt >= m_opts.red_rtt) {
+        h.grade = link_grade_t::red;
+    } else if (h.pending_silence >= m_opts.yellow_silence || h.rtt >= m_opts.yellow_rtt ||
+               (h.bandwidth > 0 && h.bandwidth < m_opts.yellow_bandwidth)) {
+        h.grade = link_grade_t::yellow;
+    } else {
+        h.grade = link_grade_t::green;
+    }
+    return h;
+}
+
+}  // namespace emailkit
@@ -0,0 +1,101 @@
+#pragma once
+#include <emailkit/global.hpp>
+#include <deque>
+#include <string_view>
+
+namespace emailkit {
+
+// Coarse connection quality for UI and for sync logic deciding how much to ask for at once.
+enum class link_grade_t {
+    green,   // data flows, latency is fine
+    yellow,  // slow: high latency, low bandwidth or server has been silent for a while
+    red,     // stalled: command is pending and nothing has been received for stall_timeout
+};
+
+std::string_view to_string(link_grade_t grade);
+
+struct connection_health_opts_t {
+    // Received bytes are turned into bandwidth samples over windows of at least this duration
+    // with at least bandwidth_min_sample_bytes in them, otherwise latency dominates the sample.
+    std::chrono::milliseconds bandwidth_sample_interval = 500ms;
+    size_t bandwidth_min_sample_bytes = 16 * 1024;
+    double bandwidth_alpha = 0.3;
+    double rtt_alpha = 0.125;  // same as TCP SRTT (RFC6298)
+
+    std::chrono::milliseconds yellow_silence = 3s;
+    std::chrono::milliseconds stall_timeout = 10s;
+    std::chrono::milliseconds yellow_rtt = 1s;
+    std::chrono::milliseconds red_rtt = 5s;
+    double yellow_bandwidth = 20 * 1024;  // bytes per second
+};
+
+// Snapshot of connection health.
+struct connection_health_t {
+    double bandwidth = 0;  // EWMA of receive rate when data flows, bytes per second, 0 if unknown
+    std::chrono::microseconds rtt{};       // EWMA, 0 if unknown
+    std::chrono::microseconds last_rtt{};  // most recent sample
+    std::chrono::milliseconds since_last_byte{};
+    // How long server has been silent while we wait for it, 0 when nothing is pending.
+    std::chrono::milliseconds pending_silence{};
+    size_t bytes_received_total = 0;
+    size_t bytes_sent_total = 0;
+    size_t commands_in_flight = 0;
+    link_grade_t grade = link_grade_t::green;
+};
+
+// Estimates connection throughput and latency from traffic events reported by socket.
+//
+// RTT is time from sending a command to the first byte received after it, sampled only for
+// commands sent while no other command was pending (otherwise the first byte may belong to a
+// response to the earlier command). Bytes are counted as they go over the wire (compressed if
+// COMPRESS is active).
+class connection_health_estimator_t {
+   public:
+    using steady_clock = std::chrono::steady_clock;
+
+    explicit connection_health_estimator_t(connection_health_opts_t opts = {}) : m_opts(opts) {}
+
+    void on_bytes_received(size_t n, steady_clock::time_point now);
+    void on_bytes_sent(size_t n, steady_clock::time_point now);
+
+    // Command with given tag has been written to the socket.
+    void on_command_sent(std::string_view tag, steady_clock::time_point now);
+    // Server sent continuation request ("+ ..."), it is our turn now so silence is not a stall.
+    void on_continuation_request(steady_clock::time_point now);
+    // Tagged (completion) response received. Commands sent before it are considered completed
+    // as well since IMAP server completes them in order.
+    void on_tagged_response(std::string_view tag, steady_clock::time_point now);
+
+    connection_health_t snapshot(steady_clock::time_point now) const;
+    link_grade_t grade(steady_clock::time_point now) const { return snapshot(now).grade; }
+
+    bool has_commands_in_flight() const { return !m_in_flight.empty(); }
+
+   private:
+    struct in_flight_command_t {
+        std::string tag;
+        steady_clock::time_point sent_at;
+        bool rtt_sampled;  // or not eligible for sampling
+    };
+
+    void close_bandwidth_window(steady_clock::time_point now);
+
+    const connection_health_opts_t m_opts;
+
+    std::deque<in_flight_command_t> m_in_flight;
+    bool m_server_waits_for_us = false;
+    steady_clock::time_point m_last_byte_at{};
+    steady_clock::time_point m_waiting_since{};  // last time we sent something to the server
+
+    std::optional<steady_clock::time_point> m_window_start;
+    size_t m_window_bytes = 0;
+    double m_bandwidth = 0;
+
+    std::chrono::microseconds m_rtt{};
+    std::chrono::microseconds m_last_rtt{};
+
+    size_t m_bytes_received_total = 0;
+    size_t m_bytes_sent_total = 0;
+};
+
+}  // namespace emailkit
@@ -0,0 +1,102 @@
+#include "deflate_codec.hpp"
+
+namespace emailkit {
+
+namespace {
+// Negative window bits select raw deflate without zlib header and trailer.
+constexpr int RAW_DEFLATE_WINDOW_BITS = -15;
+constexpr size_t OUTPUT_CHUNK_SIZE = 16 * 1024;
+}  // namespace
+
+deflate_codec_t::deflate_codec_t() {
+    if (inflateInit2(&m_inflate_stream, RAW_DEFLATE_WINDOW_BITS) != Z_OK) {
+        log_error("inflateInit2 failed: {}", m_inflate_stream.msg ? m_inflate_stream.msg : "");
+        m_init_error = make_error_code(std::errc::not_enough_memory);
+        return;
+    }
+    m_inflate_initialized = true;
+
+    if (deflateInit2(&m_deflate_stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED, RAW_DEFLATE_WINDOW_BITS,
+                     8, Z_DEFAULT_STRATEGY) != Z_OK) {
+        log_error("deflateInit2 failed: {}", m_deflate_stream.msg ? m_deflate_stream.msg : "");
+        m_init_error = make_error_code(std::errc::not_enough_memory);
+        return;
+    }
+    m_deflate_initialized = true;
+}
+
+deflate_codec_t::~deflate_codec_t() {
+    if (m_inflate_initialized) {
+        inflateEnd(&m_inflate_stream);
+    }
+    if (m_deflate_initialized) {
+        deflateEnd(&m_deflate_stream);
+    }
+}
+
+std::error_code deflate_codec_t::inflate(std::string_view compressed, std::string& out) {
+    if (!m_inflate_initialized) {
+        return make_error_code(std::errc::not_connected);
+    }
+
+    m_inflate_stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(compressed.data()));
+    m_inflate_stream.avail_in = static_cast<uInt>(compressed.size());
+
+    const size_t out_size_before = out.size();
+    do {
+        const size_t offset = out.size();
+        out.resize(offset + OUTPUT_CHUNK_SIZE);
+        m_inflate_stream.next_out = reinterpret_cast<Bytef*>(out.data() + offset);
+        m_inflate_stream.avail_out = static_cast<uInt>(OUTPUT_CHUNK_SIZE);
+
+        const int ret = ::inflate(&m_inflate_stream, Z_SYNC_FLUSH);
+        out.resize(offset + OUTPUT_CHUNK_SIZE - m_inflate_stream.avail_out);
+        if (ret == Z_BUF_ERROR) {
+            break;  // no progress possible, all input consumed
+        }
+        if (ret == Z_STREAM_END) {
+            log_warning("peer finished compressed stream");
+            break;
+        }
+        if (ret != Z_OK) {
+            log_error("inflate failed: {} ({})", ret,
+                      m_inflate_stream.msg ? m_inflate_stream.msg : "");
+            return make_error_code(std::errc::bad_message);
+        }
+    } while (m_inflate_stream.avail_in > 0 || m_inflate_stream.avail_out == 0);
+
+    m_inflated_bytes_in += compressed.size();
+    m_inflated_bytes_out += out.size() - out_size_before;
+    return {};
+}
+
+std::error_code deflate_codec_t::deflate(std::string_view plain, std::string& out) {
+    if (!m_deflate_initialized) {
+        return make_error_code(std::errc::not_connected);
+    }
+
+    m_deflate_stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(plain.data()));
+    m_deflate_stream.avail_in = static_cast<uInt>(plain.size());
+
+    const size_t out_size_before = out.size();
+    do {
+        const size_t offset = out.size();
+        out.resize(offset + OUTPUT_CHUNK_SIZE);
+        m_deflate_stream.next_out = reinterpret_cast<Bytef*>(out.data() + offset);
+        m_deflate_stream.avail_out = static_cast<uInt>(OUTPUT_CHUNK_SIZE);
+
+        const int ret = ::deflate(&m_deflate_stream, Z_SYNC_FLUSH);
+        out.resize(offset + OUTPUT_CHUNK_SIZE - m_deflate_stream.avail_out);
+        if (ret != Z_OK && ret != Z_BUF_ERROR) {
+            log_error("deflate failed: {} ({})", ret,
+                      m_deflate_stream.msg ? m_deflate_stream.msg : "");
+            return make_error_code(std::errc::io_error);
+        }
+    } while (m_deflate_stream.avail_out == 0);
+
+    m_deflated_bytes_in += plain.size();
+    m_deflated_bytes_out += out.size() - out_size_before;
+    return {};
+}
+
+}  // namespace emailkit
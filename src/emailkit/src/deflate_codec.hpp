@@ -0,0 +1,49 @@
+#pragma once
+#include <emailkit/global.hpp>
+#include <string>
+#include <string_view>
+
+#include <zlib.h>
+
+namespace emailkit {
+
+// Streaming raw DEFLATE (RFC1951) compression in both directions as required by IMAP COMPRESS
+// extension (https://datatracker.ietf.org/doc/html/rfc4978). Streams live as long as connection
+// does, every chunk is flushed with Z_SYNC_FLUSH so that peer can decompress whatever has been sent
+// without waiting for more data.
+class deflate_codec_t {
+   public:
+    deflate_codec_t();
+    ~deflate_codec_t();
+
+    deflate_codec_t(const deflate_codec_t&) = delete;
+    deflate_codec_t& operator=(const deflate_codec_t&) = delete;
+
+    // Must be checked before use, zlib may fail to allocate its state.
+    std::error_code init_error() const { return m_init_error; }
+
+    // Decompresses a chunk of data received from peer and appends it to out.
+    std::error_code inflate(std::string_view compressed, std::string& out);
+
+    // Compresses a chunk of data which is going to be sent to peer and appends it to out.
+    std::error_code deflate(std::string_view plain, std::string& out);
+
+    size_t inflated_bytes_in() const { return m_inflated_bytes_in; }
+    size_t inflated_bytes_out() const { return m_inflated_bytes_out; }
+    size_t deflated_bytes_in() const { return m_deflated_bytes_in; }
+    size_t deflated_bytes_out() const { return m_deflated_bytes_out; }
+
+   private:
+    z_stream m_inflate_stream{};
+    z_stream m_deflate_stream{};
+    bool m_inflate_initialized = false;
+    bool m_deflate_initialized = false;
+    std::error_code m_init_error;
+
+    size_t m_inflated_bytes_in = 0;
+    size_t m_inflated_bytes_out = 0;
+    size_t m_deflated_bytes_in = 0;
+    size_t m_deflated_bytes_out = 0;
+};
+
+}  // namespace emailkit
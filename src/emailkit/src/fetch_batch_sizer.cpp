@@ -0,0 +1,100 @@
+#include "fetch_batch_sizer.hpp"
+#include <algorithm>
+
+namespace emailkit {
+
+fetch_batch_sizer_t::fetch_batch_sizer_t(fetch_batch_sizer_opts_t opts)
+    : m_opts(opts), m_batch_size(std::clamp(opts.initial_batch, opts.min_batch, opts.max_batch)) {}
+
+int fetch_batch_sizer_t::begin_batch() {
+    int n = m_batch_size;
+    if (m_bytes_per_message > 0) {
+        const size_t room = m_opts.max_bytes_in_flight > m_bytes_in_flight
+                                ? m_opts.max_bytes_in_flight - m_bytes_in_flight
+                                : 0;
+        n = std::min(n, static_cast<int>(room / m_bytes_per_message));
+    }
+    // Progress is made even when ceiling is reached, by smallest batches.
+    n = std::max(n, m_opts.min_batch);
+
+    m_bytes_in_flight += estimated_bytes(n);
+    ++m_batches_in_flight;
+    m_smallest_batch = m_batches == 0 ? n : std::min(m_smallest_batch, n);
+    m_largest_batch = std::max(m_largest_batch, n);
+    ++m_batches;
+    return n;
+}
+
+void fetch_batch_sizer_t::on_batch_completed(int batch_size,
+                                             size_t messages,
+                                             const fetch_stats_t& work,
+                                             std::chrono::microseconds latency,
+                                             const connection_health_t& health) {
+    release(batch_size);
+    m_messages += messages;
+    m_last_latency = latency;
+
+    if (work.messages > 0) {
+        const double bytes = static_cast<double>(work.response_bytes) / work.messages;
+        const double parse_us = static_cast<double>(work.parse_time.count()) / work.messages;
+        if (m_bytes_per_message == 0) {
+            m_bytes_per_message = bytes;
+            m_parse_us_per_message = parse_us;
+        } else {
+            m_bytes_per_message = m_opts.alpha * bytes + (1 - m_opts.alpha) * m_bytes_per_message;
+            m_parse_us_per_message =
+                m_opts.alpha * parse_us + (1 - m_opts.alpha) * m_parse_us_per_message;
+        }
+    }
+    if (m_bytes_per_message == 0) {
+        return;  // nothing learned yet
+    }
+
+    const double bdp = health.bandwidth * std::chrono::duration<double>(health.rtt).count();
+    const double target_bytes = std::max<double>(m_opts.target_response_bytes, bdp);
+    double n = target_bytes / m_bytes_per_message;
+    if (m_parse_us_per_message > 0) {
+        const double target_parse_us =
+            std::chrono::duration<double, std::micro>(m_opts.target_parse_time).count();
+        n = std::min(n, target_parse_us / m_parse_us_per_message);
+    }
+    if (latency > m_opts.target_latency && batch_size > 0) {
+        n = std::min(n, batch_size * std::chrono::duration<double>(m_opts.target_latency) /
+                            std::chrono::duration<double>(latency));
+    }
+
+    const int max_growth = m_batch_size * 2;
+    m_batch_size =
+        std::clamp(std::min(static_cast<int>(n), max_growth), m_opts.min_batch, m_opts.max_batch);
+}
+
+void fetch_batch_sizer_t::on_batch_failed(int batch_size) {
+    release(batch_size);
+}
+
+fetch_batch_metrics_t fetch_batch_sizer_t::metrics() const {
+    return {.batch_size = m_batch_size,
+            .smallest_batch = m_smallest_batch,
+            .largest_batch = m_largest_batch,
+            .batches = m_batches,
+            .messages = m_messages,
+            .bytes_per_message = m_bytes_per_message,
+            .parse_time_per_message =
+                std::chrono::microseconds{static_cast<int64_t>(m_parse_us_per_message)},
+            .last_latency = m_last_latency,
+            .bytes_in_flight = m_bytes_in_flight};
+}
+
+size_t fetch_batch_sizer_t::estimated_bytes(int batch_size) const {
+    return static_cast<size_t>(batch_size * m_bytes_per_message);
+}
+
+void fetch_batch_sizer_t::release(int batch_size) {
+    // Estimate may have changed since the batch began, it is corrected once nothing is in flight.
+    m_bytes_in_flight -= std::min(m_bytes_in_flight, estimated_bytes(batch_size));
+    if (m_batches_in_flight > 0 && --m_batches_in_flight == 0) {
+        m_bytes_in_flight = 0;
+    }
+}
+
+}  // namespace emailkit
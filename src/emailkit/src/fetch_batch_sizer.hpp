@@ -0,0 +1,100 @@
+#pragma once
+#include <emailkit/global.hpp>
+#include <emailkit/connection_health.hpp>
+
+namespace emailkit {
+
+// Totals of FETCH responses received over a connection (see imap_client_t::fetch_stats()). Work
+// done while a batch was in flight is the difference of totals taken before and after it.
+struct fetch_stats_t {
+    size_t responses = 0;
+    size_t messages = 0;        // message data items
+    size_t response_bytes = 0;  // as parsed, i.e. after decompression
+    std::chrono::microseconds parse_time{};
+
+    fetch_stats_t operator-(const fetch_stats_t& earlier) const {
+        return {.responses = responses - earlier.responses,
+                .messages = messages - earlier.messages,
+                .response_bytes = response_bytes - earlier.response_bytes,
+                .parse_time = parse_time - earlier.parse_time};
+    }
+};
+
+struct fetch_batch_sizer_opts_t {
+    int initial_batch = 50;
+    int min_batch = 5;
+    int max_batch = 1000;
+    // Messages of a response are parsed one by one as they arrive (fetch_t::on_message_data), so
+    // raw response is not held and parsing overlaps download. Emails made of them are held until
+    // the batch completes, so response size bounds memory of a batch and parse time bounds work
+    // handed over at once. Targets are lifted to bandwidth-delay product on slow links so that
+    // batches do not become round trip bound.
+    size_t target_response_bytes = 512 * 1024;
+    std::chrono::milliseconds target_parse_time = 100ms;
+    std::chrono::milliseconds target_latency = 2s;
+    // Ceiling for estimated size of responses of all batches in flight, shared by all connections
+    // of an account that use the same sizer. Emails of a batch are held until it completes, so
+    // this bounds memory of downloaded but not yet processed emails.
+    size_t max_bytes_in_flight = 16 * 1024 * 1024;
+    double alpha = 0.3;  // EWMA weight of new per-message samples
+};
+
+// Observed values and chosen batch sizes, for metrics.
+struct fetch_batch_metrics_t {
+    int batch_size = 0;  // for the next batch
+    int smallest_batch = 0;
+    int largest_batch = 0;
+    size_t batches = 0;
+    size_t messages = 0;  // delivered by completed batches
+    double bytes_per_message = 0;  // EWMA, 0 if unknown
+    std::chrono::microseconds parse_time_per_message{};
+    std::chrono::microseconds last_latency{};
+    size_t bytes_in_flight = 0;  // estimate
+};
+
+// Chooses number of messages per FETCH from what previous batches cost: response bytes and
+// parse time per message and time to complete a batch. Mailboxes of newsletters get big batches
+// (small messages, round trips dominate), mailboxes with big headers or body structures get
+// small ones. Grows at most twice per batch, shrinks at once.
+//
+// Not thread safe, to be used from the thread running io_context.
+class fetch_batch_sizer_t {
+   public:
+    explicit fetch_batch_sizer_t(fetch_batch_sizer_opts_t opts = {});
+
+    // Number of messages for the next batch, counted as in flight until on_batch_completed or
+    // on_batch_failed. Smaller than batch_size() when memory ceiling does not allow more.
+    int begin_batch();
+
+    // batch_size: as returned by begin_batch, messages: delivered by the batch (fewer at the end
+    // of mailbox), work: fetch_stats_t delta of the connection over the batch (may include other
+    // batches pipelined on the connection), latency: from sending the batch to its completion.
+    void on_batch_completed(int batch_size,
+                            size_t messages,
+                            const fetch_stats_t& work,
+                            std::chrono::microseconds latency,
+                            const connection_health_t& health);
+    void on_batch_failed(int batch_size);
+
+    int batch_size() const { return m_batch_size; }
+    fetch_batch_metrics_t metrics() const;
+
+   private:
+    size_t estimated_bytes(int batch_size) const;
+    void release(int batch_size);
+
+    const fetch_batch_sizer_opts_t m_opts;
+    int m_batch_size;
+    double m_bytes_per_message = 0;
+    double m_parse_us_per_message = 0;
+    size_t m_bytes_in_flight = 0;
+    size_t m_batches_in_flight = 0;
+
+    int m_smallest_batch = 0;
+    int m_largest_batch = 0;
+    size_t m_batches = 0;
+    size_t m_messages = 0;
+    std::chrono::microseconds m_last_latency{};
+};
+
+}  // namespace emailkit
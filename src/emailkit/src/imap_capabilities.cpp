@@ -0,0 +1,95 @@
+#include "imap_capabilities.hpp"
+#include <algorithm>
+#include <array>
+#include <cctype>
+#include "utils.hpp"
+
+namespace emailkit::imap_client {
+
+namespace {
+
+constexpr std::array<std::pair<imap_capability_t, std::string_view>,
+                     static_cast<size_t>(imap_capability_t::count_)>
+    CAPABILITY_NAMES = {{
+        {imap_capability_t::literal_plus, "LITERAL+"},
+        {imap_capability_t::literal_minus, "LITERAL-"},
+        {imap_capability_t::enable, "ENABLE"},
+        {imap_capability_t::condstore, "CONDSTORE"},
+        {imap_capability_t::qresync, "QRESYNC"},
+        {imap_capability_t::compress_deflate, "COMPRESS=DEFLATE"},
+        {imap_capability_t::esearch, "ESEARCH"},
+        {imap_capability_t::idle, "IDLE"},
+        {imap_capability_t::binary, "BINARY"},
+        {imap_capability_t::list_status, "LIST-STATUS"},
+        {imap_capability_t::special_use, "SPECIAL-USE"},
+        {imap_capability_t::gmail_ext, "X-GM-EXT-1"},
+    }};
+
+std::string to_upper(std::string_view s) {
+    std::string result{s};
+    std::transform(result.begin(), result.end(), result.begin(),
+                   [](unsigned char c) { return std::toupper(c); });
+    return result;
+}
+
+}  // namespace
+
+std::string_view to_string(imap_capability_t c) {
+    for (auto& [capability, name] : CAPABILITY_NAMES) {
+        if (capability == c) {
+            return name;
+        }
+    }
+    return "<unknown>";
+}
+
+imap_capabilities_t::imap_capabilities_t(std::vector<std::string> names) {
+    for (auto& name : names) {
+        name = to_upper(name);
+        for (auto& [capability, capability_name] : CAPABILITY_NAMES) {
+            if (name == capability_name) {
+                m_flags.set(static_cast<size_t>(capability));
+            }
+        }
+    }
+    m_names = std::move(names);
+}
+
+std::optional<imap_capabilities_t> imap_capabilities_t::from_response_line(
+    std::string_view line) {
+    while (line.ends_with('\r') || line.ends_with('\n')) {
+        line.remove_suffix(1);
+    }
+
+    std::string_view list;
+    if (line.starts_with("* CAPABILITY ")) {
+        list = line.substr(line.find(' ', 2) + 1);
+    } else if (auto code_pos = line.find(" [CAPABILITY "); code_pos != std::string_view::npos) {
+        // Response code of status response, "* OK", "* PREAUTH" or tagged "OK".
+        list = line.substr(code_pos + std::string_view{" [CAPABILITY "}.size());
+        const auto code_end = list.find(']');
+        if (code_end == std::string_view::npos) {
+            return std::nullopt;
+        }
+        list = list.substr(0, code_end);
+    } else {
+        return std::nullopt;
+    }
+
+    std::vector<std::string> names;
+    for (auto name : utils::split_views(list, ' ')) {
+        if (!name.empty()) {
+            names.emplace_back(name);
+        }
+    }
+    if (names.empty()) {
+        return std::nullopt;
+    }
+    return imap_capabilities_t{std::move(names)};
+}
+
+bool imap_capabilities_t::has(std::string_view name) const {
+    return std::find(m_names.begin(), m_names.end(), to_upper(name)) != m_names.end();
+}
+
+}  // namespace emailkit::imap_client
@@ -0,0 +1,56 @@
+#pragma once
+#include <emailkit/global.hpp>
+#include <bitset>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace emailkit::imap_client {
+
+// Capabilities the client takes faster protocol paths for.
+enum class imap_capability_t {
+    literal_plus,      // LITERAL+ (https://datatracker.ietf.org/doc/html/rfc7888)
+    literal_minus,     // LITERAL-, non-synchronizing literals up to 4096 bytes only
+    enable,            // https://datatracker.ietf.org/doc/html/rfc5161
+    condstore,         // https://datatracker.ietf.org/doc/html/rfc7162
+    qresync,           // https://datatracker.ietf.org/doc/html/rfc7162
+    compress_deflate,  // COMPRESS=DEFLATE (https://datatracker.ietf.org/doc/html/rfc4978)
+    esearch,           // https://datatracker.ietf.org/doc/html/rfc4731
+    idle,              // https://datatracker.ietf.org/doc/html/rfc2177
+    binary,            // https://datatracker.ietf.org/doc/html/rfc3516
+    list_status,       // https://datatracker.ietf.org/doc/html/rfc5819
+    special_use,       // https://datatracker.ietf.org/doc/html/rfc6154
+    gmail_ext,         // X-GM-EXT-1 (https://developers.google.com/gmail/imap/imap-extensions)
+    count_
+};
+
+std::string_view to_string(imap_capability_t c);
+
+// Capabilities announced by server (https://datatracker.ietf.org/doc/html/rfc3501#section-7.2.1).
+// They come in CAPABILITY response or response code, e.g. in greeting, and change after
+// authentication. Default constructed object means server has not told its capabilities yet, in
+// which case callers should assume nothing beyond IMAP4rev1 is supported.
+class imap_capabilities_t {
+   public:
+    imap_capabilities_t() = default;
+    explicit imap_capabilities_t(std::vector<std::string> names);
+
+    // "* CAPABILITY IMAP4rev1 IDLE" or a line with CAPABILITY response code, e.g. greeting
+    // "* OK [CAPABILITY IMAP4rev1 IDLE] ready" or "A1 OK [CAPABILITY IMAP4rev1 IDLE] done".
+    // Returns nullopt for other lines.
+    static std::optional<imap_capabilities_t> from_response_line(std::string_view line);
+
+    bool known() const { return !m_names.empty(); }
+    bool has(imap_capability_t c) const { return m_flags.test(static_cast<size_t>(c)); }
+    // Case insensitive, e.g. has("AUTH=XOAUTH2").
+    bool has(std::string_view name) const;
+
+    const std::vector<std::string>& names() const { return m_names; }
+
+   private:
+    std::vector<std::string> m_names;  // upper case, in order of announcement
+    std::bitset<static_cast<size_t>(imap_capability_t::count_)> m_flags;
+};
+
+}  // namespace emailkit::imap_client
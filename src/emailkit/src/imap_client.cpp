@@ -6,11 +6,16 @@
 
 #include "imap_parser.hpp"
 #include "imap_parser__rfc822.hpp"
+#include "imap_parser__sync.hpp"
 #include "imap_parser_utils.hpp"
+#include "imap_response_framer.hpp"
+#include "timer_wheel.hpp"
 
 #include <rapidjson/document.h>
 #include <rapidjson/stringbuffer.h>
 
+#include <charconv>
+#include <deque>
 #include <map>
 
 namespace emailkit::imap_client {
@@ -171,13 +176,20 @@ expected<void> capture_attachments_metadata(const imap_parser::wip::Body& body,
             mail.attachments.emplace_back(emailkit::types::Attachment{
                 basic_part->media_type, basic_part->media_subtype, {}, {}});
             capture_attachment_name(basic_part->body_fields.params, mail.attachments.back().name);
+            // Body of non-multipart message is part 1 (RFC 3501, 6.4.5).
+            mail.attachments.back().part_id = "1";
+            mail.attachments.back().encoding = basic_part->body_fields.encoding;
         }
     } else {
         assert(std::holds_alternative<std::unique_ptr<BodyTypeMPart>>(body));
         auto& multi_part = *std::get<std::unique_ptr<BodyTypeMPart>>(body);
         if (multi_part.media_subtype == "MIXED") {
             log_debug("skipping non-mixed multipart");
-            for (auto& subpart : multi_part.body_ptrs) {
+            for (size_t subpart_index = 0; subpart_index < multi_part.body_ptrs.size();
+                 ++subpart_index) {
+                auto& subpart = multi_part.body_ptrs[subpart_index];
+                // Parts of multipart are numbered from 1 in order they appear in BODYSTRUCTURE.
+                const auto part_id = std::to_string(subpart_index + 1);
                 // Take only first-level BASIC and TEXT parts
                 if (std::holds_alternative<std::unique_ptr<BodyType1Part>>(subpart)) {
                     auto& one_part = *std::get<std::unique_ptr<BodyType1Part>>(subpart);
@@ -185,12 +197,16 @@ expected<void> capture_attachments_metadata(const imap_parser::wip::Body& body,
                         // TODO: use a constant.
                         mail.attachments.emplace_back(
                             emailkit::types::Attachment{"TEXT", text_part->media_subtype, "", {}});
+                        mail.attachments.back().part_id = part_id;
+                        mail.attachments.back().encoding = text_part->body_fields.encoding;
                     } else if (auto* basic_part = std::get_if<BodyTypeBasic>(&one_part.part_body)) {
                         mail.attachments.emplace_back(emailkit::types::Attachment{
                             basic_part->media_type, basic_part->media_subtype, {}, {}});
                         capture_attachment_name(basic_part->body_fields.params,
                                                 mail.attachments.back().name);
                         mail.attachments.back().octets = basic_part->body_fields.octets;
+                        mail.attachments.back().part_id = part_id;
+                        mail.attachments.back().encoding = basic_part->body_fields.encoding;
                     } else if (auto* msg_part = std::get_if<BodyTypeMsg>(&one_part.part_body)) {
                         log_warning("skipping MESSAGE part type on first second level");
                     }
@@ -205,10 +221,93 @@ expected<void> capture_attachments_metadata(const imap_parser::wip::Body& body,
     return {};
 }
 
+// Converts response to FETCH (UID BODYSTRUCTURE RFC822.HEADER).
+std::vector<emailkit::types::MailboxEmail> emails_from_fetch_response(
+    types::fetch_response_t& response) {
+    std::vector<emailkit::types::MailboxEmail> result;
+
+    for (auto& [message_number, static_attributes] : response.message_data_items) {
+        emailkit::types::MailboxEmail current_email;
+
+        if (static_attributes.size() > 3) {
+            log_warning(
+                "unexpected static attributes alongside of bodystructure, will be ignored ({})",
+                static_attributes.size());
+        }
+
+        for (auto& sattr : static_attributes) {
+            if (std::holds_alternative<imap_parser::wip::Body>(sattr)) {
+                auto& as_body = std::get<imap_parser::wip::Body>(sattr);
+                if (!capture_attachments_metadata(as_body, current_email)) {
+                    log_error("failed capturing attachements");
+                    // TODO: use some blank/dumyy emails instead or leave partially
+                    // parsed emails so user can see details.
+                    continue;
+                }
+            } else if (std::holds_alternative<imap_parser::msg_attr_uid_t>(sattr)) {
+                auto& as_uid = std::get<imap_parser::msg_attr_uid_t>(sattr);
+                current_email.message_uid = as_uid.value;
+            } else if (std::holds_alternative<imap_parser::MsgAttrRFC822>(sattr)) {
+                auto& as_rfc822 = std::get<imap_parser::MsgAttrRFC822>(sattr);
+                auto parser = imap_parser::rfc822::parse_rfc882_message(as_rfc822.msg_data);
+                if (!capture_headers(parser, current_email)) {
+                    log_error("invalid email, skipping");
+                    // TODO: use some blank/dummy emails instead
+                    continue;
+                }
+
+            } else {
+                log_warning("ignoring unexpected non-bodystructure static attribute");
+                continue;
+            }
+        }
+
+        result.emplace_back(std::move(current_email));
+    }
+    return result;
+}
+
 }  // namespace
 
 namespace imap_commands {
+namespace {
+// Section spec goes into the command as is, it must not terminate the section or the command.
+bool is_valid_section_spec(std::string_view section_spec) {
+    return section_spec.find_first_of("[]\r\n") == std::string_view::npos;
+}
+
+// section-part of BINARY items: MIME part numbers, e.g. "1.2", or empty.
+bool is_valid_section_part(std::string_view section_part) {
+    return section_part.find_first_not_of("0123456789.") == std::string_view::npos;
+}
+
+std::string encode_body_section(std::string_view name,
+                                std::string_view section_spec,
+                                const std::optional<fetch_items::body_partial_t>& partial) {
+    if (partial) {
+        return fmt::format("{}[{}]<{}.{}>", name, section_spec, partial->offset, partial->length);
+    }
+    return fmt::format("{}[{}]", name, section_spec);
+}
+}  // namespace
+
 expected<std::string> encode_cmd(const fetch_t& cmd) {
+    if (auto* items = std::get_if<fetch_items_vec_t>(&cmd.items)) {
+        for (auto& i : *items) {
+            const auto* part = std::get_if<fetch_items::body_part_t>(&i);
+            const auto* peek = std::get_if<fetch_items::body_peek_t>(&i);
+            const auto* binary = std::get_if<fetch_items::binary_peek_t>(&i);
+            const auto* binary_size = std::get_if<fetch_items::binary_size_t>(&i);
+            if ((part && !is_valid_section_spec(part->section_spec)) ||
+                (peek && !is_valid_section_spec(peek->section_spec)) ||
+                (binary && !is_valid_section_part(binary->section_part)) ||
+                (binary_size && !is_valid_section_part(binary_size->section_part))) {
+                log_error("invalid section spec in fetch item");
+                return unexpected(make_error_code(std::errc::invalid_argument));
+            }
+        }
+    }
+
     const auto encoded_items = std::visit(
         overload{
             [&](all_t x) -> std::string { return "all"; },
@@ -220,13 +319,20 @@ expected<std::string> encode_cmd(const fetch_t& cmd) {
                     auto item_encoded = std::visit(
                         overload{
                             [&](fetch_items::body_t x) -> std::string { return "body"; },
-                            // TODO: not supported yet, encoding is complicated here.
-                            // [&](fetch_items::body_part_t x) -> std::string {
-                            //     return fmt::format("body[{}]", x.section_spec);
-                            // },
-                            // [&](fetch_items::body_peek_t x) -> std::string {
-                            //     return fmt::format("[{}]", x.section_spec);
-                            // },
+                            [&](const fetch_items::body_part_t& x) -> std::string {
+                                return encode_body_section("body", x.section_spec, x.partial);
+                            },
+                            [&](const fetch_items::body_peek_t& x) -> std::string {
+                                return encode_body_section("body.peek", x.section_spec,
+                                                           x.partial);
+                            },
+                            [&](const fetch_items::binary_peek_t& x) -> std::string {
+                                return encode_body_section("binary.peek", x.section_part,
+                                                           x.partial);
+                            },
+                            [&](const fetch_items::binary_size_t& x) -> std::string {
+                                return fmt::format("binary.size[{}]", x.section_part);
+                            },
                             [&](fetch_items::body_structure_t x) -> std::string {
                                 return "bodystructure";
                             },
@@ -264,7 +370,73 @@ expected<std::string> encode_cmd(const fetch_t& cmd) {
                             }},
                    cmd.sequence_set);
 
-    return fmt::format("fetch {} {}", encoded_sequence_set, encoded_items);
+    return fmt::format("{}fetch {} {}", cmd.by_uid ? "uid " : "", encoded_sequence_set,
+                       encoded_items);
+}
+
+std::string encode_cmd(const uid_search_t& cmd) {
+    if (cmd.return_options.empty()) {
+        return fmt::format("uid search {}", cmd.criteria);
+    }
+    std::vector<std::string_view> options;
+    for (auto o : cmd.return_options) {
+        switch (o) {
+            case search_return_t::min:
+                options.emplace_back("MIN");
+                break;
+            case search_return_t::max:
+                options.emplace_back("MAX");
+                break;
+            case search_return_t::count:
+                options.emplace_back("COUNT");
+                break;
+            case search_return_t::all:
+                options.emplace_back("ALL");
+                break;
+        }
+    }
+    return fmt::format("uid search return ({}) {}", fmt::join(options, " "), cmd.criteria);
+}
+
+namespace {
+std::string encode_status_items(const std::vector<status_item_t>& items) {
+    std::vector<std::string_view> names;
+    for (auto item : items) {
+        switch (item) {
+            case status_item_t::messages:
+                names.emplace_back("MESSAGES");
+                break;
+            case status_item_t::recent:
+                names.emplace_back("RECENT");
+                break;
+            case status_item_t::unseen:
+                names.emplace_back("UNSEEN");
+                break;
+            case status_item_t::uid_next:
+                names.emplace_back("UIDNEXT");
+                break;
+            case status_item_t::uid_validity:
+                names.emplace_back("UIDVALIDITY");
+                break;
+            case status_item_t::highest_modseq:
+                names.emplace_back("HIGHESTMODSEQ");
+                break;
+        }
+    }
+    return fmt::format("({})", fmt::join(names, " "));
+}
+}  // namespace
+
+std::string encode_cmd(const list_t& cmd) {
+    auto encoded = fmt::format("list \"{}\" \"{}\"", cmd.reference_name, cmd.mailbox_name);
+    if (!cmd.return_status.empty()) {
+        encoded += fmt::format(" return (status {})", encode_status_items(cmd.return_status));
+    }
+    return encoded;
+}
+
+std::string encode_cmd(const status_t& cmd) {
+    return fmt::format("status \"{}\" {}", cmd.mailbox_name, encode_status_items(cmd.items));
 }
 
 }  // namespace imap_commands
@@ -280,7 +452,9 @@ class imap_client_impl_t : public imap_client_t, public EnableUseThis<imap_clien
             log_info("make_imap_socket failed");
             return false;
         }
-        m_imap_socket->set_option(imap_socket_opts::dump_stream_to_file{});
+#ifndef NDEBUG
+        m_imap_socket->set_option(imap_socket_opts::capture_protocol{.enabled = true});
+#endif
         m_tag_pattern = tag_pattern;
         return true;
     }
@@ -300,11 +474,32 @@ class imap_client_impl_t : public imap_client_t, public EnableUseThis<imap_clien
         m_state_change_cb = std::move(cb);
     }
 
+    virtual void set_protocol_capture(bool enabled) override {
+        m_imap_socket->set_option(imap_socket_opts::capture_protocol{.enabled = enabled});
+    }
+
+    virtual connection_health_t connection_health() const override {
+        return m_imap_socket->connection_health();
+    }
+
+    virtual fetch_stats_t fetch_stats() const override { return m_fetch_stats; }
+
+    virtual void on_link_grade_change(fu2::function<void(link_grade_t)> cb) override {
+        m_imap_socket->on_link_grade_change(std::move(cb));
+    }
+
+    virtual void set_max_commands_in_flight(size_t n) override {
+        m_max_commands_in_flight = std::max<size_t>(n, 1);
+        send_queued_commands();
+    }
+
     virtual void async_connect(std::string host,
                                std::string port,
+                               call_opts_t opts,
                                async_callback<void> cb) override {
         assert(m_imap_socket);
-        m_imap_socket->async_connect(host, port,
+        reset_session_state();
+        m_imap_socket->async_connect(host, port, std::move(opts),
                                      [this, cb = std::move(cb)](std::error_code ec) mutable {
                                          if (!ec) {
                                              // just after connect we should start receiving data
@@ -320,6 +515,14 @@ class imap_client_impl_t : public imap_client_t, public EnableUseThis<imap_clien
                                      });
     }
 
+    // Capabilities, enabled extensions and selected mailbox belong to one session, client may be
+    // connected again after connection has been lost.
+    void reset_session_state() {
+        m_mailbox_selected = false;
+        m_qresync_enabled.reset();
+        m_capabilities = {};
+    }
+
     void recive_next_line() {
         log_debug("waiting next line ...");
         m_imap_socket->async_receive_line([this](std::error_code ec, imap_response_line_t line) {
@@ -341,78 +544,63 @@ class imap_client_impl_t : public imap_client_t, public EnableUseThis<imap_clien
 
     // void async_execute_imap_command(std::string command, strong_callback<std::vector<std::)
 
-    virtual void async_obtain_capabilities(async_callback<std::vector<std::string>> cb) override {
-        // IDEA: before sending command we register handler, or we can attach handler to
-        // send_command itself. through some helper. execute_command(new_command_id(), "CAPABILITY",
-        // [](std::string ) { response; }) we can add additional timeout (e.g. 5s). If command comes
-        // without ID then we have unregistered response/upstream command.
-        //
-        const auto id = new_command_id();
-
-        m_imap_socket->async_send_command(
-            fmt::format("{} CAPABILITY\r\n", id),
-            [this, cb = std::move(cb)](std::error_code ec) mutable {
-                if (ec) {
-                    // TODO: better message
-                    log_error("send caps command failed: {}", ec);
-                    cb(ec, {});
+    virtual void async_obtain_capabilities(call_opts_t opts,
+                                           async_callback<std::vector<std::string>> cb) override {
+        async_execute_simple_command(
+            "CAPABILITY", std::move(opts),
+            use_this(std::move(cb), [](auto& this_, std::error_code ec, imap_response_t response,
+                                       auto cb) {
+                ASYNC_RETURN_ON_ERROR(ec, cb, "CAPABILITY command failed");
+                const auto& tagged_line = response.lines.back();
+                if (tagged_line.is_bad_response() || tagged_line.is_no_response()) {
+                    cb(make_error_code(tagged_line.is_bad_response()
+                                           ? types::imap_errors::imap_bad
+                                           : types::imap_errors::imap_no),
+                       {});
                     return;
                 }
 
-                m_imap_socket->async_receive_line(
-                    [this, cb = std::move(cb)](std::error_code ec,
-                                               imap_response_line_t line) mutable {
-                        if (ec) {
-                            log_error("failed receiving line: {}", ec);
-                            cb(ec, {});
-                            return;
-                        }
-
-                        log_debug("got response: {}", line);
-
-                        // TODO: keep receiving lines until we have OK or NO (check RFC for more).
-                        m_imap_socket->async_receive_line(
-                            [this, cb = std::move(cb)](std::error_code ec,
-                                                       imap_response_line_t line) mutable {
-                                if (ec) {
-                                    log_error("failed receiving line2: {}", ec);
-                                    cb(ec, {});
-                                    return;
-                                }
-
-                                log_debug("got response2: {}", line);
-
-                                m_imap_socket->async_receive_line(
-                                    [this, cb = std::move(cb)](std::error_code ec,
-                                                               imap_response_line_t line) mutable {
-                                        if (ec) {
-                                            log_error("failed receiving line3: {}", ec);
-                                            cb(ec, {});
-                                            return;
-                                        }
+                // Greeting may come along with response to the first command, the last
+                // capabilities announced are the current ones.
+                std::optional<imap_capabilities_t> capabilities;
+                for (auto& l : response.lines) {
+                    if (auto c = imap_capabilities_t::from_response_line(l.line)) {
+                        capabilities = std::move(*c);
+                    }
+                }
+                if (!capabilities) {
+                    log_error("no CAPABILITY in response");
+                    cb(make_error_code(std::errc::protocol_error), {});
+                    return;
+                }
+                this_.set_capabilities(std::move(*capabilities));
+                cb({}, this_.m_capabilities.names());
+            }));
+    }
 
-                                        log_debug("got response3: {}", line);
+    virtual const imap_capabilities_t& capabilities() const override { return m_capabilities; }
 
-                                        cb(ec, {});
-                                    });
-                            });
-                    });
-            });
+    void set_capabilities(imap_capabilities_t capabilities) {
+        m_capabilities = std::move(capabilities);
+        log_info("server capabilities: {}", fmt::join(m_capabilities.names(), " "));
     }
 
     struct xoauth2_auth_result_state {
         bool auth_success = false;
         std::string error_details;
+        // Announced with authentication result, capabilities change after authentication.
+        std::optional<imap_capabilities_t> capabilities;
 
         // TODO: collect received untagged lines
         // std::vector<std::string> untagged_lines;
     };
 
     void receive_xoauth2_result(xoauth2_auth_result_state state,
+                                call_opts_t opts,
                                 async_callback<xoauth2_auth_result_state> cb) {
-        m_imap_socket->async_receive_line([this, state, cb = std::move(cb)](
-                                              std::error_code ec,
-                                              imap_response_line_t line) mutable {
+        m_imap_socket->async_receive_line(opts, [this, state, opts, cb = std::move(cb)](
+                                                    std::error_code ec,
+                                                    imap_response_line_t line) mutable {
             if (ec) {
                 // TODO: check for eof?
                 log_error("async_receive_line failed: {}", ec);
@@ -421,8 +609,17 @@ class imap_client_impl_t : public imap_client_t, public EnableUseThis<imap_clien
             }
 
             if (line.is_untagged_reply()) {
-                // so far just ignore this and keep reading..
-                receive_xoauth2_result(state, std::move(cb));
+                // Greeting (* OK) is received here as nobody reads it before the first command,
+                // its capabilities are ones before authentication. Other untagged lines are
+                // ignored.
+                if (auto capabilities = imap_capabilities_t::from_response_line(line.line)) {
+                    if (line.tokens[1] == "CAPABILITY") {
+                        state.capabilities = std::move(*capabilities);
+                    } else {
+                        set_capabilities(std::move(*capabilities));
+                    }
+                }
+                receive_xoauth2_result(state, std::move(opts), std::move(cb));
             } else if (line.is_command_continiation_request()) {
                 // this must be error happened and server challanged us to accept result
                 // and confirm by sending \r\n before it will send its final result (<TAG>
@@ -434,7 +631,8 @@ class imap_client_impl_t : public imap_client_t, public EnableUseThis<imap_clien
                 }
 
                 m_imap_socket->async_send_command(
-                    "\r\n", [this, cb = std::move(cb), state](std::error_code ec) mutable {
+                    "\r\n", opts,
+                    [this, opts, cb = std::move(cb), state](std::error_code ec) mutable {
                         if (ec) {
                             log_error("failed sending \r\n in response to auth challange: {}", ec);
                             cb(ec, state);
@@ -442,13 +640,16 @@ class imap_client_impl_t : public imap_client_t, public EnableUseThis<imap_clien
                         }
                         // sent, we can continue reading and don't expect continuations any more
                         // TODO: put flag in a state that continuations are not expected anymore.
-                        receive_xoauth2_result(state, std::move(cb));
+                        receive_xoauth2_result(state, std::move(opts), std::move(cb));
                     });
             } else if (line.maybe_tagged_reply()) {
                 log_debug("got tagged reply, finishing: line: '{}', line tokens: {}", line,
                           line.tokens);
                 if (line.tokens[1] == "OK") {
                     state.auth_success = true;
+                    if (auto capabilities = imap_capabilities_t::from_response_line(line.line)) {
+                        state.capabilities = std::move(*capabilities);
+                    }
                 } else if (line.tokens[1] == "NO" || line.tokens[1] == "BAD") {
                     log_debug("NO/BAD received during attempt to authinicate");
                     state.auth_success = false;
@@ -459,6 +660,7 @@ class imap_client_impl_t : public imap_client_t, public EnableUseThis<imap_clien
     }
 
     virtual void async_authenticate(xoauth2_creds_t creds,
+                                    call_opts_t opts,
                                     async_callback<auth_error_details_t> cb) override {
         // https://developers.google.com/gmail/imap/xoauth2-protocol
         // https://learn.microsoft.com/en-us/exchange/client-developer/legacy-protocols/how-to-authenticate-an-imap-pop-smtp-application-by-using-oauth
@@ -477,8 +679,8 @@ class imap_client_impl_t : public imap_client_t, public EnableUseThis<imap_clien
         const auto id = new_command_id();
 
         m_imap_socket->async_send_command(
-            fmt::format("{} AUTHENTICATE XOAUTH2 {}\r\n", id, xoauth2_req_encoded),
-            [this, id, cb = std::move(cb)](std::error_code ec) mutable {
+            fmt::format("{} AUTHENTICATE XOAUTH2 {}\r\n", id, xoauth2_req_encoded), opts,
+            [this, id, opts, cb = std::move(cb)](std::error_code ec) mutable {
                 if (ec) {
                     log_error("send AUTHENTICATE XOAUTH2 failed: {}", ec);
                     cb(ec, {});
@@ -486,8 +688,9 @@ class imap_client_impl_t : public imap_client_t, public EnableUseThis<imap_clien
                 }
 
                 receive_xoauth2_result(
-                    {}, [this, cb = std::move(cb)](std::error_code ec,
-                                                   xoauth2_auth_result_state state) mutable {
+                    {}, opts,
+                    [this, opts, cb = std::move(cb)](std::error_code ec,
+                                                     xoauth2_auth_result_state state) mutable {
                         if (ec) {
                             log_error("receive_xoauth2_result failed: {}", ec);
                             cb(ec, {});
@@ -495,7 +698,22 @@ class imap_client_impl_t : public imap_client_t, public EnableUseThis<imap_clien
                         }
 
                         if (state.auth_success) {
-                            cb({}, {});
+                            if (state.capabilities) {
+                                set_capabilities(std::move(*state.capabilities));
+                                cb({}, {});
+                                return;
+                            }
+                            // Capabilities known so far are ones before authentication.
+                            m_capabilities = {};
+                            async_obtain_capabilities(
+                                std::move(opts),
+                                [cb = std::move(cb)](std::error_code ec,
+                                                     std::vector<std::string>) mutable {
+                                    if (ec) {
+                                        log_warning("failed obtaining capabilities: {}", ec);
+                                    }
+                                    cb({}, {});
+                                });
                         } else {
                             cb(make_error_code(std::errc::protocol_error),
                                auth_error_details_t{.summary = state.error_details});
@@ -505,83 +723,126 @@ class imap_client_impl_t : public imap_client_t, public EnableUseThis<imap_clien
     }
 
     struct imap_response_t {
-        std::string raw_response_bytes;
+        imap_response_buffer_t raw_response_bytes;
         std::vector<imap_response_line_t> lines;
         std::string tag;
     };
 
+    enum class command_pipelining_t {
+        pipelined,
+        exclusive,  // executed alone, when no other command is in flight
+    };
+
+    struct pending_command_ctx {
+        std::string tag;
+        std::string command;
+        imap_literal_sink_opts_t literal_sink_opts;
+        untagged_response_handler_t on_untagged_response;  // see imap_socket_t
+        call_opts_t opts;
+        bool exclusive = false;
+        async_callback<imap_response_buffer_t> cb;
+    };
+
     virtual void async_execute_simple_command(std::string command,
+                                              call_opts_t opts,
+                                              async_callback<imap_response_t> cb) {
+        async_execute_simple_command(std::move(command), command_pipelining_t::pipelined,
+                                     std::move(opts), std::move(cb));
+    }
+
+    virtual void async_execute_simple_command(std::string command,
+                                              command_pipelining_t pipelining,
+                                              call_opts_t opts,
                                               async_callback<imap_response_t> cb) {
         const auto tag = next_tag();
-        m_imap_socket->async_send_command(
-            fmt::format("{} {}\r\n", tag, command),
-            [this, tag, cb = std::move(cb)](std::error_code ec) mutable {
+        submit_command(
+            tag, std::move(command), {}, {}, pipelining, std::move(opts),
+            [tag, cb = std::move(cb)](std::error_code ec,
+                                      imap_response_buffer_t response_bytes) mutable {
                 imap_response_t response{.tag = tag};
                 if (ec) {
-                    log_error("failed sending namespace command: {}", ec);
+                    log_error("failed executing command {}: {}", response.tag, ec);
                     cb(ec, std::move(response));
                     return;
                 }
 
-                async_receive_response(*m_imap_socket, std::move(response),
-                                       [this, cb = std::move(cb)](
-                                           std::error_code ec, imap_response_t response) mutable {
-                                           if (ec) {
-                                               cb(ec, std::move(response));
-                                               return;
-                                           }
+                response.raw_response_bytes = std::move(response_bytes);
+                if (auto ec = split_response_lines(response)) {
+                    cb(ec, std::move(response));
+                    return;
+                }
 
-                                           log_debug("{} command finished, lines are:",
-                                                     response.tag);
-                                           for (auto& line : response.lines) {
-                                               log_debug("{}", line);
-                                           }
+                log_debug("{} command finished, lines are:", response.tag);
+                for (auto& line : response.lines) {
+                    log_debug("{}", line);
+                }
 
-                                           cb({}, std::move(response));
-                                       });
+                cb({}, std::move(response));
             });
     }
 
-    virtual void async_execute_raw_command(std::string command, async_callback<std::string> cb) {
-        const auto tag = next_tag();
-        m_imap_socket->async_send_command(
-            fmt::format("{} {}\r\n", tag, command),
-            [this, command, tag, cb = std::move(cb)](std::error_code ec) mutable {
-                if (ec) {
-                    log_error("failed sending namespace command: {}", ec);
-                    cb(ec, {});
-                    return;
-                }
-
-                log_info("sent command {}, receiving response ...", command);
-
-                m_imap_socket->async_receive_response(
-                    tag, [this, tag, cb = std::move(cb)](std::error_code ec,
-                                                         std::string response) mutable {
-                        if (ec) {
-                            cb(ec, std::move(response));
-                            return;
-                        }
+    virtual void async_execute_raw_command(std::string command,
+                                           call_opts_t opts,
+                                           async_callback<imap_response_buffer_t> cb) {
+        async_execute_raw_command(std::move(command), imap_literal_sink_opts_t{}, std::move(opts),
+                                  std::move(cb));
+    }
 
-                        // log_debug("{} command finished, text is: '{}'", tag,
-                        //           utils::escape_ctrl(response));
-                        cb({}, std::move(response));
-                    });
-            });
+    virtual void async_execute_raw_command(std::string command,
+                                           imap_literal_sink_opts_t literal_sink_opts,
+                                           call_opts_t opts,
+                                           async_callback<imap_response_buffer_t> cb) {
+        const auto tag = next_tag();
+        log_info("executing command {} {} ...", tag, command);
+        submit_command(tag, std::move(command), std::move(literal_sink_opts), {},
+                       command_pipelining_t::pipelined, std::move(opts),
+                       [tag, cb = std::move(cb)](std::error_code ec,
+                                                 imap_response_buffer_t response) mutable {
+                           if (ec) {
+                               log_error("failed executing command {}: {}", tag, ec);
+                           }
+                           cb(ec, std::move(response));
+                       });
     }
 
     virtual void async_execute_command(imap_commands::namespace_t,
+                                       call_opts_t opts,
                                        async_callback<void> cb) override {
         // TODO: ensure connected and authenticated?
         async_execute_simple_command(
-            "namespace",
+            "namespace", std::move(opts),
             [cb = std::move(cb)](std::error_code ec, imap_response_t response) mutable {
                 // TODO: parse response
                 cb(ec);
             });
     }
 
+    virtual void async_execute_command(imap_commands::compress_deflate_t,
+                                       call_opts_t opts,
+                                       async_callback<void> cb) override {
+        // Everything after the response is compressed, so nothing may be pipelined after it.
+        async_execute_simple_command(
+            "COMPRESS DEFLATE", command_pipelining_t::exclusive, std::move(opts),
+            [this, cb = std::move(cb)](std::error_code ec, imap_response_t response) mutable {
+                if (ec) {
+                    log_error("COMPRESS command failed: {}", ec);
+                    cb(ec);
+                    return;
+                }
+
+                const auto& tagged_line = response.lines.back();
+                if (tagged_line.tokens.size() < 2 || tagged_line.tokens[1] != "OK") {
+                    log_warning("server declined compression: {}", tagged_line);
+                    cb(make_error_code(std::errc::operation_not_supported));
+                    return;
+                }
+
+                cb(m_imap_socket->start_compression());
+            });
+    }
+
     virtual void async_execute_command(imap_commands::list_t cmd,
+                                       call_opts_t opts,
                                        async_callback<types::list_response_t> cb) override {
         // https://datatracker.ietf.org/doc/html/rfc3501#section-6.3.8
         // TODO: laternatively we can use parser all the way down instead of this.
@@ -593,7 +854,7 @@ class imap_client_impl_t : public imap_client_t, public EnableUseThis<imap_clien
         //     cmd.mailbox_name = "\"\"";
         // }
         async_execute_simple_command(
-            fmt::format("list \"{}\" \"{}\"", cmd.reference_name, cmd.mailbox_name),
+            imap_commands::encode_cmd(cmd), std::move(opts),
             [cb = std::move(cb)](std::error_code ec, imap_response_t response) mutable {
                 if (ec) {
                     log_error("async_execute_simple_command failed: {}", ec);
@@ -604,8 +865,18 @@ class imap_client_impl_t : public imap_client_t, public EnableUseThis<imap_clien
                 // and write unit tests.
 
                 types::list_response_t command_result;
+                // LIST-STATUS: "* STATUS" follows "* LIST" of the mailbox.
+                std::map<std::string, types::mailbox_status_t> statuses;
                 for (auto& l : response.lines) {
-                    if (l.is_untagged_reply()) {
+                    if (l.is_untagged_reply() && l.line.starts_with("* STATUS ")) {
+                        auto status_or_err =
+                            imap_parser::sync::parse_status_response_line(l.line);
+                        if (!status_or_err) {
+                            continue;  // same as for LIST lines below
+                        }
+                        auto mailbox = status_or_err->mailbox;
+                        statuses.insert_or_assign(std::move(mailbox), std::move(*status_or_err));
+                    } else if (l.is_untagged_reply()) {
                         log_debug("untagged reply, stripping *");
 
                         auto unwrapped_line = l.unwrap_untagged_reply();
@@ -637,6 +908,11 @@ class imap_client_impl_t : public imap_client_t, public EnableUseThis<imap_clien
                         // this must be reply to our command, this should be guaranteed by
                         // execute_simple_command
                         if (l.is_ok_response()) {
+                            for (auto& e : command_result.inbox_list) {
+                                if (auto it = statuses.find(e.mailbox_raw); it != statuses.end()) {
+                                    e.status = std::move(it->second);
+                                }
+                            }
                             cb(ec, std::move(command_result));
                             return;
                         } else if (l.is_bad_response()) {
@@ -656,11 +932,48 @@ class imap_client_impl_t : public imap_client_t, public EnableUseThis<imap_clien
             });
     }
 
+    virtual void async_execute_command(imap_commands::status_t cmd,
+                                       call_opts_t opts,
+                                       async_callback<types::mailbox_status_t> cb) override {
+        async_execute_raw_command(
+            imap_commands::encode_cmd(cmd), std::move(opts),
+            [cb = std::move(cb)](std::error_code ec, imap_response_buffer_t imap_resp) mutable {
+                if (ec) {
+                    log_error("STATUS command failed: {}", ec);
+                    cb(ec, {});
+                    return;
+                }
+                if (auto ec = tagged_status_error(imap_resp.view())) {
+                    cb(ec, {});
+                    return;
+                }
+
+                for (auto line : utils::split_views(imap_resp.view(), '\n')) {
+                    if (line.starts_with("* STATUS ")) {
+                        auto status_or_err = imap_parser::sync::parse_status_response_line(line);
+                        if (!status_or_err) {
+                            log_error("failed parsing STATUS response: {}", status_or_err.error());
+                            cb(status_or_err.error(), {});
+                            return;
+                        }
+                        cb({}, std::move(*status_or_err));
+                        return;
+                    }
+                }
+                log_error("no STATUS in response");
+                cb(make_error_code(std::errc::protocol_error), {});
+            });
+    }
+
     virtual void async_execute_command(imap_commands::select_t cmd,
+                                       call_opts_t opts,
                                        async_callback<types::select_response_t> cb) override {
+        // Commands pipelined after SELECT would silently run against previously selected mailbox
+        // if SELECT fails.
         async_execute_simple_command(
-            fmt::format("select \"{}\"", cmd.mailbox_name),
-            [cb = std::move(cb)](std::error_code ec, imap_response_t imap_resp) mutable {
+            fmt::format("select \"{}\"", cmd.mailbox_name), command_pipelining_t::exclusive,
+            std::move(opts),
+            [this, cb = std::move(cb)](std::error_code ec, imap_response_t imap_resp) mutable {
                 if (ec) {
                     log_error("async_execute_simple_command failed: {}", ec);
                     cb(ec, {});
@@ -684,7 +997,7 @@ class imap_client_impl_t : public imap_client_t, public EnableUseThis<imap_clien
                 // (Failure)\r\n'
                 types::select_response_t select_resp;
                 auto records_or_err =
-                    imap_parser::parse_mailbox_data_records(imap_resp.raw_response_bytes);
+                    imap_parser::parse_mailbox_data_records(imap_resp.raw_response_bytes.view());
                 if (!records_or_err) {
                     // TODO: this needs to be somehow delivered to develoers alongside with logs for
                     // anallysis.
@@ -726,17 +1039,25 @@ class imap_client_impl_t : public imap_client_t, public EnableUseThis<imap_clien
                                         [&](const imap_parser::try_create_resp_text_code_t& v) {
                                             select_resp.read_write_mode =
                                                 types::read_write_mode_t::try_create;
+                                        },
+                                        [&](const imap_parser::highest_modseq_resp_text_code_t& v) {
+                                            select_resp.highest_modseq = v.value;
+                                        },
+                                        [&](const imap_parser::no_modseq_resp_text_code_t& v) {
+                                            select_resp.highest_modseq.reset();
                                         }},
                                rec);
                 }
 
                 // TODO: validate?
 
+                m_mailbox_selected = true;
                 cb({}, std::move(select_resp));
             });
     }
 
     virtual void async_execute_command(imap_commands::fetch_t cmd,
+                                       call_opts_t opts,
                                        async_callback<types::fetch_response_t> cb) override {
         auto encoded_cmd_or_err = encode_cmd(cmd);
         if (!encoded_cmd_or_err) {
@@ -746,8 +1067,16 @@ class imap_client_impl_t : public imap_client_t, public EnableUseThis<imap_clien
         }
         auto& encoded_cmd = *encoded_cmd_or_err;
 
-        async_execute_raw_command(encoded_cmd, [cb = std::move(cb)](std::error_code ec,
-                                                                    std::string imap_resp) mutable {
+        if (cmd.on_message_data) {
+            async_execute_streaming_fetch(std::move(encoded_cmd), std::move(cmd), std::move(opts),
+                                          std::move(cb));
+            return;
+        }
+
+        async_execute_raw_command(encoded_cmd, std::move(cmd.literal_sink), std::move(opts),
+                                  use_this(std::move(cb), [](auto& this_, std::error_code ec,
+                                                             imap_response_buffer_t imap_resp,
+                                                             auto cb) mutable {
             if (ec) {
                 log_error("async_execute_simple_command failed: {}", ec);
                 cb(ec, {});
@@ -759,28 +1088,271 @@ class imap_client_impl_t : public imap_client_t, public EnableUseThis<imap_clien
             log_info("parsing fetch response of size {}Kb", imap_resp.size() / 1024);
 
             auto parse_start = std::chrono::steady_clock::now();
-            auto message_data_records_or_err = imap_parser::parse_message_data_records(imap_resp);
+            // Parser runs directly on received bytes.
+            auto message_data_records_or_err =
+                imap_parser::parse_message_data_records(imap_resp.view());
             if (!message_data_records_or_err) {
                 log_error("failed parsing message data: {}", message_data_records_or_err.error());
                 cb(message_data_records_or_err.error(),
                    types::fetch_response_t{.message_data_items = {},
-                                           .failed_raw_imap_opt = imap_resp});
+                                           .failed_raw_imap_opt = imap_resp.to_string()});
                 return;
             }
             auto parse_took = std::chrono::steady_clock::now() - parse_start;
 
             log_info("parsing successful, time taken: {}ms", parse_took / 1.0ms);
 
+            auto& stats = this_.m_fetch_stats;
+            ++stats.responses;
+            stats.messages += message_data_records_or_err->size();
+            stats.response_bytes += imap_resp.size();
+            stats.parse_time += std::chrono::duration_cast<std::chrono::microseconds>(parse_took);
+
             cb({}, types::fetch_response_t{.message_data_items =
                                                std::move(*message_data_records_or_err)});
-        });
+        }));
+    }
+
+    // Each "* n FETCH" is parsed as soon as it has been received (see imap_socket_t), so parsing
+    // overlaps with downloading of the rest and only one message of raw response is kept.
+    void async_execute_streaming_fetch(std::string encoded_cmd,
+                                       imap_commands::fetch_t cmd,
+                                       call_opts_t opts,
+                                       async_callback<types::fetch_response_t> cb) {
+        struct streaming_fetch_state_t {
+            std::error_code parse_error;
+            std::optional<std::string> failed_raw_imap_opt;
+        };
+        auto state = std::make_shared<streaming_fetch_state_t>();
+
+        auto on_untagged_response = [this, state, on_message_data = std::move(
+                                                      cmd.on_message_data)](
+                                        imap_response_buffer_t response) {
+            auto parse_start = std::chrono::steady_clock::now();
+            auto message_data_or_err = imap_parser::parse_untagged_message_data(response.view());
+            if (!message_data_or_err) {
+                log_error("failed parsing message data: {}", message_data_or_err.error());
+                if (!state->failed_raw_imap_opt) {
+                    state->parse_error = message_data_or_err.error();
+                    state->failed_raw_imap_opt = response.to_string();
+                }
+                return std::error_code{};
+            }
+
+            auto& stats = m_fetch_stats;
+            stats.messages += message_data_or_err->size();
+            stats.response_bytes += response.size();
+            stats.parse_time += std::chrono::duration_cast<std::chrono::microseconds>(
+                std::chrono::steady_clock::now() - parse_start);
+
+            for (auto& message_data : *message_data_or_err) {
+                on_message_data(std::move(message_data));
+            }
+            return std::error_code{};
+        };
+
+        const auto tag = next_tag();
+        log_info("executing command {} {} ...", tag, encoded_cmd);
+        submit_command(
+            tag, std::move(encoded_cmd), std::move(cmd.literal_sink),
+            std::move(on_untagged_response), command_pipelining_t::pipelined, std::move(opts),
+            use_this(std::move(cb), [tag, state](auto& this_, std::error_code ec,
+                                                 imap_response_buffer_t imap_resp, auto cb) {
+                if (ec) {
+                    log_error("failed executing command {}: {}", tag, ec);
+                    cb(ec, {});
+                    return;
+                }
+                ++this_.m_fetch_stats.responses;
+                if (state->failed_raw_imap_opt) {
+                    cb(state->parse_error,
+                       types::fetch_response_t{.message_data_items = {},
+                                               .failed_raw_imap_opt =
+                                                   std::move(state->failed_raw_imap_opt)});
+                    return;
+                }
+                cb({}, {});
+            }));
+    }
+
+    virtual void async_execute_command(imap_commands::uid_search_t cmd,
+                                       call_opts_t opts,
+                                       async_callback<types::search_response_t> cb) override {
+        async_execute_raw_command(
+            imap_commands::encode_cmd(cmd), std::move(opts),
+            [cb = std::move(cb)](std::error_code ec, imap_response_buffer_t imap_resp) mutable {
+                if (ec) {
+                    log_error("UID SEARCH command failed: {}", ec);
+                    cb(ec, {});
+                    return;
+                }
+                if (auto ec = tagged_status_error(imap_resp.view())) {
+                    cb(ec, {});
+                    return;
+                }
+
+                auto parsed_or_err = imap_parser::sync::parse_sync_response(imap_resp.view());
+                if (!parsed_or_err) {
+                    log_error("failed parsing SEARCH response: {}", parsed_or_err.error());
+                    cb(parsed_or_err.error(), {});
+                    return;
+                }
+                auto& parsed = *parsed_or_err;
+                types::search_response_t response{.ids = std::move(parsed.search_results),
+                                                  .highest_modseq = parsed.search_modseq};
+                if (parsed.esearch) {
+                    auto& e = *parsed.esearch;
+                    response.highest_modseq = e.modseq;
+                    response.min = e.min;
+                    response.max = e.max;
+                    response.count = e.count;
+                    response.all = std::move(e.all);
+                }
+                cb({}, std::move(response));
+            });
+    }
+
+    void async_search(search_query_t query,
+                      call_opts_t opts,
+                      async_callback<types::search_response_t> cb) override {
+        auto criteria_or_err = query.encode(m_capabilities);
+        if (!criteria_or_err) {
+            log_error("invalid search query");
+            cb(criteria_or_err.error(), {});
+            return;
+        }
+        if (query.uses_gmail_extensions() && !m_capabilities.has(imap_capability_t::gmail_ext)) {
+            cb(make_error_code(std::errc::operation_not_supported), {});
+            return;
+        }
+
+        using imap_commands::search_return_t;
+        if (m_capabilities.has(imap_capability_t::esearch)) {
+            // Result stays small regardless of number of found messages.
+            async_execute_command(
+                imap_commands::uid_search_t{
+                    .criteria = std::move(*criteria_or_err),
+                    .return_options = {search_return_t::min, search_return_t::max,
+                                       search_return_t::count, search_return_t::all}},
+                std::move(opts), std::move(cb));
+            return;
+        }
+
+        async_execute_command(
+            imap_commands::uid_search_t{.criteria = std::move(*criteria_or_err)}, std::move(opts),
+            [cb = std::move(cb)](std::error_code ec, types::search_response_t response) mutable {
+                if (ec) {
+                    log_error("UID SEARCH failed: {}", ec);
+                    cb(ec, {});
+                    return;
+                }
+                std::sort(response.ids.begin(), response.ids.end());
+                response.count = static_cast<uint32_t>(response.ids.size());
+                if (!response.ids.empty()) {
+                    response.min = response.ids.front();
+                    response.max = response.ids.back();
+                }
+                response.all = imap_parser::sync::encode_uid_set(response.ids);
+                cb({}, std::move(response));
+            });
+    }
+
+    virtual void async_execute_command(
+        imap_commands::uid_fetch_flags_changes_t cmd,
+        call_opts_t opts,
+        async_callback<types::flags_changes_response_t> cb) override {
+        async_execute_raw_command(
+            fmt::format("uid fetch {} (UID FLAGS) (CHANGEDSINCE {}{})", cmd.uid_set,
+                        cmd.changed_since, cmd.vanished ? " VANISHED" : ""),
+            std::move(opts),
+            [cb = std::move(cb)](std::error_code ec, imap_response_buffer_t imap_resp) mutable {
+                if (ec) {
+                    log_error("UID FETCH CHANGEDSINCE command failed: {}", ec);
+                    cb(ec, {});
+                    return;
+                }
+                if (auto ec = tagged_status_error(imap_resp.view())) {
+                    cb(ec, {});
+                    return;
+                }
+
+                auto parsed_or_err = imap_parser::sync::parse_sync_response(imap_resp.view());
+                if (!parsed_or_err) {
+                    log_error("failed parsing FETCH response: {}", parsed_or_err.error());
+                    cb(parsed_or_err.error(), {});
+                    return;
+                }
+                cb({}, types::flags_changes_response_t{
+                           .changes = std::move(parsed_or_err->flags_changes),
+                           .vanished = std::move(parsed_or_err->vanished)});
+            });
+    }
+
+    virtual void async_execute_command(imap_commands::uid_fetch_gmail_ids_t cmd,
+                                       call_opts_t opts,
+                                       async_callback<types::gmail_ids_response_t> cb) override {
+        async_execute_raw_command(
+            fmt::format("uid fetch {} (UID X-GM-MSGID X-GM-THRID{})", cmd.uid_set,
+                        cmd.labels ? " X-GM-LABELS" : ""),
+            std::move(opts),
+            [cb = std::move(cb)](std::error_code ec, imap_response_buffer_t imap_resp) mutable {
+                if (ec) {
+                    log_error("UID FETCH of Gmail ids failed: {}", ec);
+                    cb(ec, {});
+                    return;
+                }
+                if (auto ec = tagged_status_error(imap_resp.view())) {
+                    cb(ec, {});
+                    return;
+                }
+
+                auto parsed_or_err = imap_parser::sync::parse_sync_response(imap_resp.view());
+                if (!parsed_or_err) {
+                    log_error("failed parsing FETCH response: {}", parsed_or_err.error());
+                    cb(parsed_or_err.error(), {});
+                    return;
+                }
+                cb({}, types::gmail_ids_response_t{.ids = std::move(parsed_or_err->gmail_ids)});
+            });
+    }
+
+    virtual void async_execute_command(imap_commands::enable_t cmd,
+                                       call_opts_t opts,
+                                       async_callback<std::vector<std::string>> cb) override {
+        async_execute_simple_command(
+            fmt::format("ENABLE {}", fmt::join(cmd.extensions, " ")),
+            command_pipelining_t::exclusive, std::move(opts),
+            [cb = std::move(cb)](std::error_code ec, imap_response_t response) mutable {
+                if (ec) {
+                    log_error("ENABLE command failed: {}", ec);
+                    cb(ec, {});
+                    return;
+                }
+                const auto& tagged_line = response.lines.back();
+                if (tagged_line.is_bad_response() || tagged_line.is_no_response()) {
+                    cb(make_error_code(tagged_line.is_bad_response()
+                                           ? types::imap_errors::imap_bad
+                                           : types::imap_errors::imap_no),
+                       {});
+                    return;
+                }
+
+                // * ENABLED CONDSTORE QRESYNC
+                std::vector<std::string> enabled;
+                for (auto& l : response.lines) {
+                    if (l.is_untagged_reply() && l.tokens.size() > 1 && l.tokens[1] == "ENABLED") {
+                        enabled.insert(enabled.end(), l.tokens.begin() + 2, l.tokens.end());
+                    }
+                }
+                cb({}, std::move(enabled));
+            });
     }
 
     ////////////////////////////////////////////////////////////////////////////////////////
 
-    void async_list_mailboxes(async_callback<ListMailboxesResult> cb) override {
+    void async_list_mailboxes(call_opts_t opts, async_callback<ListMailboxesResult> cb) override {
         async_execute_command(
-            imap_commands::list_t{.reference_name = "", .mailbox_name = "*"},
+            imap_commands::list_t{.reference_name = "", .mailbox_name = "*"}, std::move(opts),
             use_this(std::move(cb), [](auto& this_, std::error_code ec,
                                        types::list_response_t response, auto cb) mutable {
                 ASYNC_RETURN_ON_ERROR(ec, cb, "async list command failed");
@@ -796,10 +1368,91 @@ class imap_client_impl_t : public imap_client_t, public EnableUseThis<imap_clien
             }));
     }
 
+    void async_list_mailboxes_with_status(call_opts_t opts,
+                                          async_callback<ListMailboxesResult> cb) override {
+        std::vector<imap_commands::status_item_t> items = {
+            imap_commands::status_item_t::messages, imap_commands::status_item_t::unseen,
+            imap_commands::status_item_t::uid_next, imap_commands::status_item_t::uid_validity};
+        if (m_capabilities.has(imap_capability_t::condstore)) {
+            items.push_back(imap_commands::status_item_t::highest_modseq);
+        }
+
+        if (m_capabilities.has(imap_capability_t::list_status)) {
+            async_execute_command(
+                imap_commands::list_t{
+                    .reference_name = "", .mailbox_name = "*", .return_status = std::move(items)},
+                std::move(opts),
+                [cb = std::move(cb)](std::error_code ec, types::list_response_t response) mutable {
+                    if (ec) {
+                        log_error("LIST RETURN (STATUS) command failed: {}", ec);
+                        cb(ec, {});
+                        return;
+                    }
+                    cb({}, ListMailboxesResult{.raw_response = std::move(response)});
+                });
+            return;
+        }
+
+        // No LIST-STATUS: STATUS of all mailboxes are pipelined after LIST, one round trip more.
+        async_list_mailboxes(
+            opts, use_this(std::move(cb), [items = std::move(items), opts](
+                                              auto& this_, std::error_code ec,
+                                              ListMailboxesResult list, auto cb) mutable {
+                ASYNC_RETURN_ON_ERROR(ec, cb, "LIST command failed");
+
+                struct state_t {
+                    ListMailboxesResult list;
+                    size_t pending = 0;
+                    async_callback<ListMailboxesResult> cb;
+                };
+                auto state = std::make_shared<state_t>(
+                    state_t{.list = std::move(list), .pending = 0, .cb = std::move(cb)});
+
+                std::vector<size_t> selectable;
+                for (size_t i = 0; i < state->list.raw_response.inbox_list.size(); ++i) {
+                    const auto& flags = state->list.raw_response.inbox_list[i].flags;
+                    const auto has_flag = [&](std::string_view f) {
+                        return std::find(flags.begin(), flags.end(), f) != flags.end();
+                    };
+                    if (!has_flag("\\Noselect") && !has_flag("\\NonExistent")) {
+                        selectable.push_back(i);
+                    }
+                }
+                if (selectable.empty()) {
+                    state->cb({}, std::move(state->list));
+                    return;
+                }
+
+                state->pending = selectable.size();
+                for (size_t i : selectable) {
+                    this_.async_execute_command(
+                        imap_commands::status_t{
+                            .mailbox_name = state->list.raw_response.inbox_list[i].mailbox_raw,
+                            .items = items},
+                        opts,
+                        [state, i](std::error_code ec, types::mailbox_status_t status) {
+                            // Mailbox may be deleted between LIST and STATUS, it stays
+                            // without status.
+                            if (ec) {
+                                log_warning("STATUS of '{}' failed: {}",
+                                            state->list.raw_response.inbox_list[i].mailbox_raw,
+                                            ec);
+                            } else {
+                                state->list.raw_response.inbox_list[i].status = std::move(status);
+                            }
+                            if (--state->pending == 0) {
+                                state->cb({}, std::move(state->list));
+                            }
+                        });
+                }
+            }));
+    }
+
     void async_select_mailbox(std::string inbox_name,
+                              call_opts_t opts,
                               async_callback<SelectMailboxResult> cb) override {
         async_execute_command(
-            imap_commands::select_t{.mailbox_name = inbox_name},
+            imap_commands::select_t{.mailbox_name = inbox_name}, std::move(opts),
             use_this(std::move(cb),
                      [inbox_name](auto& this_, std::error_code ec,
                                   types::select_response_t response, auto cb) mutable {
@@ -812,11 +1465,13 @@ class imap_client_impl_t : public imap_client_t, public EnableUseThis<imap_clien
                      }));
     }
 
-    void async_list_items(
-        int from,
-        std::optional<int> to,
-        async_callback<std::variant<std::string, std::vector<emailkit::types::MailboxEmail>>> cb)
-        override {
+    void async_list_items(int from,
+                          std::optional<int> to,
+                          call_opts_t opts,
+                          async_callback<list_items_result_t> cb) override {
+        // Emails are made while the response is still downloading, Gmail ids are added to the
+        // whole batch at once.
+        auto emails = std::make_shared<std::vector<emailkit::types::MailboxEmail>>();
         async_execute_command(
             imap_commands::fetch_t{
                 .sequence_set = imap_commands::raw_fetch_sequence_spec{fmt::format(
@@ -825,61 +1480,529 @@ class imap_client_impl_t : public imap_client_t, public EnableUseThis<imap_clien
                     imap_commands::fetch_items_vec_t{
                         imap_commands::fetch_items::uid_t{},
                         imap_commands::fetch_items::body_structure_t{},
-                        imap_commands::fetch_items::rfc822_header_t{}}},
-            use_this(std::move(cb), [](auto& this_, std::error_code ec,
-                                       types::fetch_response_t response, auto cb) {
+                        imap_commands::fetch_items::rfc822_header_t{}},
+                .on_message_data =
+                    [emails](imap_parser::MessageData message_data) {
+                        types::fetch_response_t response;
+                        response.message_data_items.emplace_back(std::move(message_data));
+                        auto made = emails_from_fetch_response(response);
+                        emails->insert(emails->end(), std::make_move_iterator(made.begin()),
+                                       std::make_move_iterator(made.end()));
+                    }},
+            opts,
+            use_this(std::move(cb), [opts, emails](auto& this_, std::error_code ec,
+                                                   types::fetch_response_t response, auto cb) {
                 if (ec) {
                     log_error("async fetch command failed: {}", ec);
                     cb(ec, response.failed_raw_imap_opt.value_or(""));
                     return;
                 }
 
-                std::vector<emailkit::types::MailboxEmail> result;
+                this_.async_add_gmail_ids(
+                    std::move(*emails), std::move(opts),
+                    [cb = std::move(cb)](
+                        std::error_code ec,
+                        std::vector<emailkit::types::MailboxEmail> emails) mutable {
+                        cb({}, std::move(emails));
+                    });
+            }));
+    }
 
-                for (auto& [message_number, static_attributes] : response.message_data_items) {
-                    emailkit::types::MailboxEmail current_email;
+    void async_fetch_message_part(uint32_t uid,
+                                  std::string part_id,
+                                  std::optional<imap_commands::fetch_items::body_partial_t> partial,
+                                  call_opts_t opts,
+                                  async_callback<types::body_section_t> cb) override {
+        async_execute_command(
+            imap_commands::fetch_t{
+                .sequence_set = imap_commands::raw_fetch_sequence_spec{std::to_string(uid)},
+                .by_uid = true,
+                .items =
+                    imap_commands::fetch_items_vec_t{imap_commands::fetch_items::body_peek_t{
+                        .section_spec = part_id, .partial = partial}}},
+            std::move(opts),
+            use_this(std::move(cb), [uid, part_id](auto& this_, std::error_code ec,
+                                                   types::fetch_response_t response, auto cb) {
+                ASYNC_RETURN_ON_ERROR(ec, cb, "async fetch of message part failed");
 
-                    if (static_attributes.size() > 3) {
-                        log_warning(
-                            "unexpected static attributes alongside of bodystructure, will be "
-                            "ignored ({})",
-                            static_attributes.size());
+                for (auto& [message_number, static_attributes] : response.message_data_items) {
+                    for (auto& sattr : static_attributes) {
+                        if (auto* section = std::get_if<types::body_section_t>(&sattr);
+                            section && section->section == part_id) {
+                            cb({}, std::move(*section));
+                            return;
+                        }
                     }
+                }
+                log_error("no part {} of message {} in fetch response", part_id, uid);
+                cb(make_error_code(std::errc::no_message), {});
+            }));
+    }
 
-                    for (auto& sattr : static_attributes) {
-                        if (std::holds_alternative<imap_parser::wip::Body>(sattr)) {
-                            auto& as_body = std::get<imap_parser::wip::Body>(sattr);
-                            if (!capture_attachments_metadata(as_body, current_email)) {
-                                log_error("failed capturing attachements");
-                                // TODO: use some blank/dumyy emails instead or leave partially
-                                // parsed emails so user can see details.
-                                continue;
-                            }
-                        } else if (std::holds_alternative<imap_parser::msg_attr_uid_t>(sattr)) {
-                            auto& as_uid = std::get<imap_parser::msg_attr_uid_t>(sattr);
-                            current_email.message_uid = as_uid.value;
-                        } else if (std::holds_alternative<imap_parser::MsgAttrRFC822>(sattr)) {
-                            auto& as_rfc822 = std::get<imap_parser::MsgAttrRFC822>(sattr);
-                            auto parser =
-                                imap_parser::rfc822::parse_rfc882_message(as_rfc822.msg_data);
-                            if (!capture_headers(parser, current_email)) {
-                                log_error("invalid email, skipping");
-                                // TODO: use some blank/dummy emails instead
-                                continue;
-                            }
+    void async_fetch_message_part_binary(
+        uint32_t uid,
+        std::string part_id,
+        std::optional<imap_commands::fetch_items::body_partial_t> partial,
+        imap_literal_sink_opts_t literal_sink,
+        call_opts_t opts,
+        async_callback<types::binary_section_t> cb) override {
+        if (!m_capabilities.has(imap_capability_t::binary)) {
+            cb(make_error_code(std::errc::operation_not_supported), {});
+            return;
+        }
 
-                        } else {
-                            log_warning("ignoring unexpected non-bodystructure static attribute");
-                            continue;
-                        }
+        imap_commands::fetch_items_vec_t items{
+            imap_commands::fetch_items::binary_peek_t{.section_part = part_id, .partial = partial}};
+        if (partial) {
+            items.emplace_back(imap_commands::fetch_items::binary_size_t{.section_part = part_id});
+        }
+        auto command_or_err = imap_commands::encode_cmd(imap_commands::fetch_t{
+            .sequence_set = imap_commands::raw_fetch_sequence_spec{std::to_string(uid)},
+            .by_uid = true,
+            .items = std::move(items)});
+        if (!command_or_err) {
+            log_error("invalid part id {}", part_id);
+            cb(command_or_err.error(), {});
+            return;
+        }
+
+        // Generic FETCH response parser does not know BINARY items.
+        async_execute_raw_command(
+            std::move(*command_or_err), std::move(literal_sink), std::move(opts),
+            [uid, part_id, cb = std::move(cb)](std::error_code ec,
+                                               imap_response_buffer_t imap_resp) mutable {
+                if (ec) {
+                    log_error("async fetch of binary message part failed: {}", ec);
+                    cb(ec, {});
+                    return;
+                }
+                if (auto ec = tagged_status_error(imap_resp.view())) {
+                    cb(ec, {});
+                    return;
+                }
+
+                auto sections_or_err =
+                    imap_parser::sync::parse_binary_fetch_response(imap_resp.view());
+                if (!sections_or_err) {
+                    log_error("failed parsing FETCH response with BINARY items: {}",
+                              sections_or_err.error());
+                    cb(sections_or_err.error(), {});
+                    return;
+                }
+                for (auto& section : *sections_or_err) {
+                    if (section.uid == uid && section.section == part_id) {
+                        cb({}, std::move(section));
+                        return;
                     }
+                }
+                log_error("no binary part {} of message {} in fetch response", part_id, uid);
+                cb(make_error_code(std::errc::no_message), {});
+            });
+    }
+
+    void async_sync_mailbox(std::string mailbox_name,
+                            MailboxSyncState known,
+                            call_opts_t opts,
+                            async_callback<MailboxSyncResult> cb) override {
+        // ENABLE is only valid before a mailbox is selected, servers without ENABLE respond with
+        // BAD and are synchronized without QRESYNC. No need to ask when capabilities tell so.
+        if (!m_qresync_enabled.has_value() && m_capabilities.known() &&
+            !(m_capabilities.has(imap_capability_t::enable) &&
+              m_capabilities.has(imap_capability_t::condstore) &&
+              m_capabilities.has(imap_capability_t::qresync))) {
+            m_qresync_enabled = false;
+        }
+        if (!m_qresync_enabled.has_value() && !m_mailbox_selected) {
+            async_execute_command(
+                imap_commands::enable_t{.extensions = {"CONDSTORE", "QRESYNC"}}, opts,
+                use_this(std::move(cb),
+                         [mailbox_name = std::move(mailbox_name), known = std::move(known), opts](
+                             auto& this_, std::error_code ec, std::vector<std::string> enabled,
+                             auto cb) mutable {
+                             if (ec) {
+                                 log_info("ENABLE failed, synchronizing without QRESYNC: {}", ec);
+                             }
+                             this_.m_qresync_enabled = std::find(enabled.begin(), enabled.end(),
+                                                                 "QRESYNC") != enabled.end();
+                             this_.async_sync_mailbox(std::move(mailbox_name), std::move(known),
+                                                      std::move(opts), std::move(cb));
+                         }));
+            return;
+        }
+
+        async_select_mailbox(
+            std::move(mailbox_name), opts,
+            use_this(std::move(cb), [known = std::move(known), opts](
+                                        auto& this_, std::error_code ec,
+                                        SelectMailboxResult selected, auto cb) mutable {
+                ASYNC_RETURN_ON_ERROR(ec, cb, "select failed");
+                const auto& s = selected.raw_response;
+
+                auto result = std::make_shared<MailboxSyncResult>();
+                result->state = MailboxSyncState{.uid_validity = s.uid_validity,
+                                                 .uid_next = s.uid_next,
+                                                 .highest_modseq = s.highest_modseq};
+                if (known.uid_validity != s.uid_validity) {
+                    // UIDs known from previous synchronization do not refer to the same messages
+                    // anymore.
+                    result->uid_validity_changed = known.uid_validity != 0;
+                    known = MailboxSyncState{};
+                }
+
+                this_.async_sync_flags_changes(
+                    known, s, result, opts,
+                    this_.use_this(std::move(cb), [known, result, opts](auto& this_,
+                                                                        std::error_code ec,
+                                                                        auto cb) mutable {
+                        ASYNC_RETURN_ON_ERROR(ec, cb, "synchronizing flags failed");
+                        this_.async_sync_new_emails(
+                            known, result, opts,
+                            [result, cb = std::move(cb)](std::error_code ec) mutable {
+                                ASYNC_RETURN_ON_ERROR(ec, cb, "downloading new emails failed");
+                                cb({}, std::move(*result));
+                            });
+                    }));
+            }));
+    }
+
+    void async_sync_flags_changes(const MailboxSyncState& known,
+                                  const types::select_response_t& selected,
+                                  std::shared_ptr<MailboxSyncResult> result,
+                                  call_opts_t opts,
+                                  async_callback<void> cb) {
+        if (known.uid_next <= 1) {
+            cb({});  // nothing has been downloaded
+            return;
+        }
+        if (!known.highest_modseq || !selected.highest_modseq) {
+            log_info("no mod-sequences, flags changes are not synchronized");
+            cb({});
+            return;
+        }
+        if (*selected.highest_modseq == *known.highest_modseq) {
+            log_debug("mailbox has not changed since mod-sequence {}", *known.highest_modseq);
+            cb({});
+            return;
+        }
 
-                    result.emplace_back(std::move(current_email));
+        async_execute_command(
+            imap_commands::uid_fetch_flags_changes_t{
+                .uid_set = fmt::format("1:{}", known.uid_next - 1),
+                .changed_since = *known.highest_modseq,
+                .vanished = m_qresync_enabled.value_or(false)},
+            std::move(opts),
+            [result, cb = std::move(cb)](std::error_code ec,
+                                         types::flags_changes_response_t response) mutable {
+                if (ec) {
+                    log_error("UID FETCH CHANGEDSINCE failed: {}", ec);
+                    cb(ec);
+                    return;
                 }
-                cb({}, std::move(result));
+                log_info("{} messages changed, {} ranges vanished", response.changes.size(),
+                         response.vanished.size());
+                result->flags_changes = std::move(response.changes);
+                result->vanished = std::move(response.vanished);
+                cb({});
+            });
+    }
+
+    void async_sync_new_emails(const MailboxSyncState& known,
+                               std::shared_ptr<MailboxSyncResult> result,
+                               call_opts_t opts,
+                               async_callback<void> cb) {
+        if (result->state.uid_next != 0 && result->state.uid_next <= known.uid_next) {
+            cb({});  // no new messages
+            return;
+        }
+
+        // UIDs are sparse, so they are looked up first and only existing ones are fetched.
+        async_execute_command(
+            imap_commands::uid_search_t{.criteria = fmt::format("UID {}:*", known.uid_next)}, opts,
+            use_this(std::move(cb), [known, result, opts](auto& this_, std::error_code ec,
+                                                          types::search_response_t response,
+                                                          auto cb) mutable {
+                ASYNC_RETURN_ON_ERROR(ec, cb, "UID SEARCH failed");
+
+                // "n:*" includes the last message even if its UID is below n.
+                auto& uids = response.ids;
+                std::erase_if(uids, [&](uint32_t uid) { return uid < known.uid_next; });
+                std::sort(uids.begin(), uids.end());
+                if (uids.empty()) {
+                    cb({});
+                    return;
+                }
+                result->state.uid_next = std::max(result->state.uid_next, uids.back() + 1);
+
+                log_info("downloading {} new emails", uids.size());
+                this_.async_fetch_emails_by_uid(std::move(uids), result, std::move(opts),
+                                                std::move(cb));
             }));
     }
 
+    // Batches are submitted at once and pipelined.
+    void async_fetch_emails_by_uid(std::vector<uint32_t> sorted_uids,
+                                   std::shared_ptr<MailboxSyncResult> result,
+                                   call_opts_t opts,
+                                   async_callback<void> cb) {
+        struct fetch_state_t {
+            std::vector<std::vector<emailkit::types::MailboxEmail>> batches;
+            size_t batches_left = 0;
+            std::error_code first_error;
+            async_callback<void> cb;
+        };
+        const size_t batches_count =
+            (sorted_uids.size() + SYNC_FETCH_BATCH_SIZE - 1) / SYNC_FETCH_BATCH_SIZE;
+        auto state = std::make_shared<fetch_state_t>();
+        state->batches.resize(batches_count);
+        state->batches_left = batches_count;
+        state->cb = std::move(cb);
+
+        for (size_t i = 0; i < batches_count; ++i) {
+            const auto batch_begin = sorted_uids.begin() + i * SYNC_FETCH_BATCH_SIZE;
+            const auto batch_end = sorted_uids.begin() +
+                                   std::min(sorted_uids.size(), (i + 1) * SYNC_FETCH_BATCH_SIZE);
+            async_callback<std::vector<emailkit::types::MailboxEmail>> on_batch_fetched =
+                [i, state, result](std::error_code ec,
+                                   std::vector<emailkit::types::MailboxEmail> emails) mutable {
+                    if (ec) {
+                        log_error("UID FETCH of batch {} failed: {}", i, ec);
+                        state->first_error = state->first_error ? state->first_error : ec;
+                    } else {
+                        state->batches[i] = std::move(emails);
+                    }
+                    if (--state->batches_left > 0) {
+                        return;
+                    }
+                    if (state->first_error) {
+                        state->cb(state->first_error);
+                        return;
+                    }
+                    for (auto& batch : state->batches) {
+                        std::move(batch.begin(), batch.end(),
+                                  std::back_inserter(result->new_emails));
+                    }
+                    state->cb({});
+                };
+            async_execute_command(
+                imap_commands::fetch_t{
+                    .sequence_set = imap_commands::raw_fetch_sequence_spec{
+                        imap_parser::sync::encode_uid_set({batch_begin, batch_end})},
+                    .by_uid = true,
+                    .items =
+                        imap_commands::fetch_items_vec_t{
+                            imap_commands::fetch_items::uid_t{},
+                            imap_commands::fetch_items::body_structure_t{},
+                            imap_commands::fetch_items::rfc822_header_t{}}},
+                opts,
+                use_this(std::move(on_batch_fetched),
+                         [opts](auto& this_, std::error_code ec, types::fetch_response_t response,
+                                auto cb) mutable {
+                             ASYNC_RETURN_ON_ERROR(ec, cb, "UID FETCH failed");
+                             this_.async_add_gmail_ids(emails_from_fetch_response(response),
+                                                       std::move(opts), std::move(cb));
+                         }));
+        }
+    }
+
+    // With X-GM-EXT-1, fills Gmail message and thread ids and labels of emails (fetched by UID in
+    // selected mailbox) with one more pipelined UID FETCH. These are an optimization (threading
+    // without References, folders from All Mail only), so emails are passed on without them if
+    // the fetch fails.
+    void async_add_gmail_ids(std::vector<emailkit::types::MailboxEmail> emails,
+                             call_opts_t opts,
+                             async_callback<std::vector<emailkit::types::MailboxEmail>> cb) {
+        if (!m_capabilities.has(imap_capability_t::gmail_ext) || emails.empty()) {
+            cb({}, std::move(emails));
+            return;
+        }
+
+        std::vector<uint32_t> uids;
+        for (auto& e : emails) {
+            uids.push_back(static_cast<uint32_t>(e.message_uid));
+        }
+        std::sort(uids.begin(), uids.end());
+
+        async_execute_command(
+            imap_commands::uid_fetch_gmail_ids_t{
+                .uid_set = imap_parser::sync::encode_uid_set(uids), .labels = true},
+            std::move(opts),
+            [emails = std::move(emails), cb = std::move(cb)](
+                std::error_code ec, types::gmail_ids_response_t response) mutable {
+                if (ec) {
+                    log_warning("failed fetching Gmail ids, continuing without them: {}", ec);
+                    cb({}, std::move(emails));
+                    return;
+                }
+                std::map<uint32_t, types::gmail_ids_t*> ids_by_uid;
+                for (auto& ids : response.ids) {
+                    ids_by_uid.emplace(ids.uid, &ids);
+                }
+                for (auto& e : emails) {
+                    if (auto it = ids_by_uid.find(static_cast<uint32_t>(e.message_uid));
+                        it != ids_by_uid.end()) {
+                        e.gmail_message_id = it->second->msgid;
+                        e.gmail_thread_id = it->second->thrid;
+                        e.gmail_labels = std::move(it->second->labels);
+                    }
+                }
+                cb({}, std::move(emails));
+            });
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////
+    // IDLE (https://datatracker.ietf.org/doc/html/rfc2177).
+    //
+    // IDLE is an exclusive command whose response is read line by line (receive_idle_line) so
+    // that untagged updates reach the subscriber as they arrive. It is completed by sending DONE,
+    // after which it is either re-issued (renewal) or async_idle finishes.
+
+    void async_idle(call_opts_t opts,
+                    fu2::function<void(const types::idle_event_t&)> on_event,
+                    async_callback<void> cb) override {
+        if (m_idle) {
+            cb(make_error_code(std::errc::operation_in_progress));
+            return;
+        }
+        if (m_capabilities.known() && !m_capabilities.has(imap_capability_t::idle)) {
+            cb(make_error_code(std::errc::operation_not_supported));
+            return;
+        }
+        m_idle = std::make_unique<idle_state_t>(idle_state_t{
+            .opts = std::move(opts), .on_event = std::move(on_event), .cb = std::move(cb)});
+        issue_idle();
+    }
+
+    void stop_idle() override {
+        if (!m_idle) {
+            return;
+        }
+        m_idle->stop_requested = true;
+        if (m_idle->idling) {
+            send_idle_done();
+        }
+    }
+
+    void issue_idle() {
+        m_idle->tag = next_tag();
+        m_idle->idling = false;
+        m_idle->done_sent = false;
+        submit_command(m_idle->tag, "IDLE", {}, {}, command_pipelining_t::exclusive, m_idle->opts,
+                       [this](std::error_code ec, imap_response_buffer_t response) {
+                           if (!ec) {
+                               ec = tagged_status_error(response.view());
+                           }
+                           on_idle_finished(ec);
+                       });
+    }
+
+    void on_idle_finished(std::error_code ec) {
+        timer_wheel_t::of(m_ctx).cancel(m_idle->renew_timer);
+        if (!ec && !m_idle->stop_requested && m_queued_commands.empty()) {
+            log_debug("renewing IDLE");
+            issue_idle();
+            return;
+        }
+        if (ec) {
+            log_error("IDLE failed: {}", ec);
+        }
+        auto idle = std::exchange(m_idle, nullptr);
+        idle->cb(ec);
+    }
+
+    void send_idle_done() {
+        if (std::exchange(m_idle->done_sent, true)) {
+            return;
+        }
+        timer_wheel_t::of(m_ctx).cancel(m_idle->renew_timer);
+        m_imap_socket->async_send_command("DONE\r\n", m_idle->opts, [this](std::error_code ec) {
+            if (ec) {
+                log_error("failed sending DONE: {}", ec);
+                fail_all_commands(ec);
+            }
+        });
+    }
+
+    void receive_idle_line() {
+        m_receiving = true;
+        m_imap_socket->async_receive_line(
+            m_idle->opts, [this](std::error_code ec, imap_response_line_t line) {
+                m_receiving = false;
+                if (ec) {
+                    log_error("failed receiving IDLE updates: {}", ec);
+                    fail_all_commands(ec);
+                    return;
+                }
+
+                if (line.is_command_continiation_request()) {
+                    m_idle->idling = true;
+                    if (m_idle->stop_requested || !m_queued_commands.empty()) {
+                        send_idle_done();
+                    } else {
+                        m_idle->renew_timer = timer_wheel_t::of(m_ctx).schedule(
+                            std::chrono::steady_clock::now() + IDLE_RENEW_INTERVAL,
+                            [this] { send_idle_done(); });
+                    }
+                } else if (line.is_untagged_reply()) {
+                    if (auto event = parse_idle_event(line)) {
+                        m_idle->on_event(*event);
+                    } else {
+                        log_debug("ignoring untagged line while idling: {}", line);
+                    }
+                } else if (line.first_token_is(m_idle->tag)) {
+                    auto c = std::move(m_active_commands.at(m_idle->tag));
+                    m_active_commands.erase(m_idle->tag);
+                    std::erase(m_active_tags, c.tag);
+                    m_exclusive_command_active = false;
+                    c.cb({}, imap_response_buffer_t::from_string(line.line));
+                    send_queued_commands();
+                } else {
+                    log_error("unexpected line while idling: {}", line);
+                    fail_all_commands(make_error_code(std::errc::bad_message));
+                    return;
+                }
+
+                receive_next_response();
+            });
+    }
+
+    // "* 23 EXISTS", "* 5 EXPUNGE", "* 3 FETCH (FLAGS (\Seen))"
+    static std::optional<types::idle_event_t> parse_idle_event(const imap_response_line_t& line) {
+        static const std::map<std::string_view, types::idle_event_kind_t> kinds = {
+            {"EXISTS", types::idle_event_kind_t::exists},
+            {"RECENT", types::idle_event_kind_t::recent},
+            {"EXPUNGE", types::idle_event_kind_t::expunge},
+            {"FETCH", types::idle_event_kind_t::fetch},
+        };
+        if (line.tokens.size() < 3) {
+            return std::nullopt;
+        }
+        auto kind_it = kinds.find(line.tokens[2]);
+        if (kind_it == kinds.end()) {
+            return std::nullopt;
+        }
+        const auto n = line.tokens[1];
+        uint32_t number{};
+        if (std::from_chars(n.data(), n.data() + n.size(), number).ec != std::errc{}) {
+            return std::nullopt;
+        }
+        return types::idle_event_t{.kind = kind_it->second,
+                                   .number = number,
+                                   .line = std::string{details::remove_crln(line.line)}};
+    }
+
+    // Error for NO/BAD tagged line of raw response.
+    static std::error_code tagged_status_error(std::string_view response) {
+        const auto tag = imap_response_tag(response);
+        auto status = response.substr(response.rfind(tag) + tag.size());
+        if (status.starts_with(" NO")) {
+            return make_error_code(types::imap_errors::imap_no);
+        }
+        if (status.starts_with(" BAD")) {
+            return make_error_code(types::imap_errors::imap_bad);
+        }
+        return {};
+    }
+
     ////////////////////////////////////////////////////////////////////////////////////////
 
     // read input line by line until tagged line received. Returns raw, unparsed bytes.
@@ -917,39 +2040,182 @@ class imap_client_impl_t : public imap_client_t, public EnableUseThis<imap_clien
         });
     }
 
-    void async_receive_response(imap_socket_t& socket,
-                                imap_response_t r,
-                                async_callback<imap_response_t> cb) {
-        // receiving response means we read until we get tag or +. If we encounter plus.
-        socket.async_receive_line([this, &socket, cb = std::move(cb), r = std::move(r)](
-                                      std::error_code ec, imap_response_line_t line) mutable {
-            if (ec) {
-                log_error("failed receiving line {}: {}", r.lines.size() + 1, ec);
-                cb(ec, std::move(r));
-                return;
-            }
+    // Splits response into lines for commands that interpret response line by line. Raw bytes are
+    // kept as they are (not copied) for parsers.
+    static std::error_code split_response_lines(imap_response_t& r) {
+        std::string_view rest = r.raw_response_bytes.view();
+        while (!rest.empty()) {
+            auto crlf_pos = rest.find("\r\n");
+            const size_t line_size =
+                crlf_pos == std::string_view::npos ? rest.size() : crlf_pos + 2;
+            r.lines.emplace_back(std::string{rest.substr(0, line_size)});
+            rest.remove_prefix(line_size);
 
-            r.raw_response_bytes += line.line;
-            r.lines.emplace_back(std::move(line));
             const auto& l = r.lines.back();
-
             if (l.first_token_is(r.tag)) {
                 log_debug("got tag, stopping..");
-                cb({}, std::move(r));
-                return;
+                return {};
             } else if (l.is_command_continiation_request()) {
-                cb(make_error_code(std::errc::interrupted), std::move(r));
-                return;
-            } else if (l.is_untagged_reply()) {
-                // continue receiving lines
-                async_receive_response(socket, std::move(r), std::move(cb));
-                return;
-            } else {
+                return make_error_code(std::errc::interrupted);
+            } else if (!l.is_untagged_reply()) {
                 log_error("unexpected line from server: {}", l);
-                cb(make_error_code(std::errc::bad_message), std::move(r));
-                return;
+                return make_error_code(std::errc::bad_message);
             }
-        });
+        }
+
+        log_error("no tagged line in response for {}", r.tag);
+        return make_error_code(std::errc::bad_message);
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////
+    // Pipelining (https://datatracker.ietf.org/doc/html/rfc3501#section-5.5).
+    //
+    // Commands are sent as soon as there is room in the pipeline, without waiting for responses
+    // of the previous ones. Responses are read by a single reader (receive_next_response) which
+    // reads up to the next tagged line of any command and hands everything read so far over to
+    // the command with that tag: servers send untagged data of a command before its completion.
+
+    void submit_command(std::string tag,
+                        std::string command,
+                        imap_literal_sink_opts_t literal_sink_opts,
+                        untagged_response_handler_t on_untagged_response,
+                        command_pipelining_t pipelining,
+                        call_opts_t opts,
+                        async_callback<imap_response_buffer_t> cb) {
+        m_queued_commands.emplace_back(
+            pending_command_ctx{.tag = std::move(tag),
+                                .command = std::move(command),
+                                .literal_sink_opts = std::move(literal_sink_opts),
+                                .on_untagged_response = std::move(on_untagged_response),
+                                .opts = std::move(opts),
+                                .exclusive = pipelining == command_pipelining_t::exclusive,
+                                .cb = std::move(cb)});
+        send_queued_commands();
+
+        // Nothing else can be sent until IDLE is done.
+        if (m_idle && m_idle->idling && !m_queued_commands.empty()) {
+            send_idle_done();
+        }
+    }
+
+    bool pipeline_has_room_for(const pending_command_ctx& c) const {
+        if (m_active_commands.empty()) {
+            return true;
+        }
+        return !c.exclusive && !m_exclusive_command_active &&
+               m_active_commands.size() < m_max_commands_in_flight;
+    }
+
+    void send_queued_commands() {
+        while (!m_sending && !m_queued_commands.empty() &&
+               pipeline_has_room_for(m_queued_commands.front())) {
+            auto c = std::move(m_queued_commands.front());
+            m_queued_commands.pop_front();
+
+            // Commands which have not been sent yet can be dropped without harming connection.
+            if (c.opts.cancellation.is_cancelled()) {
+                c.cb(make_error_code(std::errc::operation_canceled), {});
+                continue;
+            }
+            if (c.opts.deadline && *c.opts.deadline <= std::chrono::steady_clock::now()) {
+                c.cb(make_error_code(std::errc::timed_out), {});
+                continue;
+            }
+
+            auto command = fmt::format("{} {}\r\n", c.tag, c.command);
+            auto opts = c.opts;
+            const auto tag = c.tag;
+            m_exclusive_command_active = c.exclusive;
+            m_active_tags.push_back(tag);
+            m_active_commands.emplace(tag, std::move(c));
+
+            m_sending = true;
+            m_imap_socket->async_send_command(
+                std::move(command), std::move(opts), [this, tag](std::error_code ec) mutable {
+                    m_sending = false;
+                    if (ec) {
+                        log_error("failed sending command {}: {}", tag, ec);
+                        fail_all_commands(ec);
+                        return;
+                    }
+                    receive_next_response();
+                    send_queued_commands();
+                });
+        }
+    }
+
+    void receive_next_response() {
+        if (m_receiving || m_active_commands.empty()) {
+            return;
+        }
+        if (m_idle && m_active_tags.front() == m_idle->tag) {
+            receive_idle_line();
+            return;
+        }
+        m_receiving = true;
+
+        // Responses come in order commands have been sent unless server decides otherwise, so
+        // literals and untagged responses go to the oldest command and the read is constrained by
+        // its opts. Deadline of a command behind it is checked once the command becomes the oldest
+        // one.
+        const auto& oldest = m_active_commands.at(m_active_tags.front());
+        untagged_response_handler_t on_untagged_response;
+        if (oldest.on_untagged_response) {
+            on_untagged_response = [this, tag = oldest.tag](imap_response_buffer_t response) {
+                auto it = m_active_commands.find(tag);
+                if (it == m_active_commands.end()) {
+                    return std::error_code{};  // failed already
+                }
+                return it->second.on_untagged_response(std::move(response));
+            };
+        }
+        m_imap_socket->async_receive_response(
+            "", oldest.literal_sink_opts, std::move(on_untagged_response), oldest.opts,
+            [this](std::error_code ec, imap_response_buffer_t response) mutable {
+                m_receiving = false;
+                if (ec) {
+                    log_error("failed receiving response: {}", ec);
+                    fail_all_commands(ec);
+                    return;
+                }
+
+                const std::string tag{imap_response_tag(response.view())};
+                auto it = m_active_commands.find(tag);
+                if (it == m_active_commands.end()) {
+                    log_error("received response with unexpected tag '{}'", tag);
+                    fail_all_commands(make_error_code(std::errc::bad_message));
+                    return;
+                }
+                auto c = std::move(it->second);
+                m_active_commands.erase(it);
+                std::erase(m_active_tags, tag);
+                if (c.exclusive) {
+                    m_exclusive_command_active = false;
+                }
+
+                // Callback goes first, e.g. compression must be started before anything else is
+                // read.
+                c.cb({}, std::move(response));
+
+                send_queued_commands();
+                receive_next_response();
+            });
+    }
+
+    // After a failure it is not known where the next response starts, so the connection is not
+    // usable and every command fails.
+    void fail_all_commands(std::error_code ec) {
+        auto active_commands = std::exchange(m_active_commands, {});
+        auto active_tags = std::exchange(m_active_tags, {});
+        auto queued_commands = std::exchange(m_queued_commands, {});
+        m_exclusive_command_active = false;
+
+        for (auto& tag : active_tags) {
+            active_commands.at(tag).cb(ec, {});
+        }
+        for (auto& c : queued_commands) {
+            c.cb(ec, {});
+        }
     }
 
     std::string new_command_id() {
@@ -963,12 +2229,35 @@ class imap_client_impl_t : public imap_client_t, public EnableUseThis<imap_clien
     std::function<void(imap_client_state)> m_state_change_cb = [](auto s) {};
     int m_command_counter = 0;
 
-    // a registry of pending commands for which we are waiting response.
-    struct pending_command_ctx {
-        async_callback<std::string> cb;
-    };
-    std::map<std::string, pending_command_ctx> m_active_commands;
     std::string m_tag_pattern;
+
+    // Commands waiting for room in the pipeline.
+    std::deque<pending_command_ctx> m_queued_commands;
+    // A registry of sent commands for which we are waiting response.
+    std::map<std::string, pending_command_ctx> m_active_commands;
+    std::deque<std::string> m_active_tags;  // tags of m_active_commands in order of sending
+    bool m_exclusive_command_active = false;
+    bool m_sending = false;
+    bool m_receiving = false;
+    size_t m_max_commands_in_flight = DEFAULT_MAX_COMMANDS_IN_FLIGHT;
+
+    static constexpr size_t SYNC_FETCH_BATCH_SIZE = 200;
+    bool m_mailbox_selected = false;
+    std::optional<bool> m_qresync_enabled;  // nullopt until ENABLE has been tried
+    imap_capabilities_t m_capabilities;
+    fetch_stats_t m_fetch_stats;
+
+    struct idle_state_t {
+        call_opts_t opts;
+        fu2::function<void(const types::idle_event_t&)> on_event;
+        async_callback<void> cb;
+        std::string tag;          // of IDLE command currently in progress
+        bool idling = false;      // server has confirmed IDLE with continuation request
+        bool done_sent = false;
+        bool stop_requested = false;
+        timer_wheel_t::timer_id_t renew_timer = 0;
+    };
+    std::unique_ptr<idle_state_t> m_idle;  // while async_idle is in progress
 };  // namespace
 
 }  // namespace
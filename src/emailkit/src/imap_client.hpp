@@ -1,6 +1,12 @@
 #pragma once
 #include <emailkit/global.hpp>
 #include <asio/io_context.hpp>
+#include <emailkit/call_opts.hpp>
+#include <emailkit/connection_health.hpp>
+#include <emailkit/fetch_batch_sizer.hpp>
+#include <emailkit/imap_capabilities.hpp>
+#include <emailkit/imap_search_query.hpp>
+#include <emailkit/imap_literal_sink.hpp>
 
 #include <functional>
 #include <memory>
@@ -36,15 +42,31 @@ struct auth_error_details_t {
 namespace imap_commands {
 struct namespace_t {};
 
+enum class status_item_t { messages, recent, unseen, uid_next, uid_validity, highest_modseq };
+
 struct list_t {
     std::string reference_name;
     std::string mailbox_name;  // with possible wildcards.
+    // LIST ... RETURN (STATUS (<items>)) (https://datatracker.ietf.org/doc/html/rfc5819): status
+    // of every listed mailbox comes in the same response, only for servers with LIST-STATUS.
+    std::vector<status_item_t> return_status;
+};
+
+// STATUS <mailbox> (<items>): status of a mailbox without selecting it. Unlike SELECT it does not
+// change state of connection, so STATUS of many mailboxes is pipelined. highest_modseq is only for
+// servers with CONDSTORE.
+struct status_t {
+    std::string mailbox_name;
+    std::vector<status_item_t> items;
 };
 
 struct select_t {
     std::string mailbox_name;
 };
 
+// https://datatracker.ietf.org/doc/html/rfc4978, DEFLATE is the only mechanism defined.
+struct compress_deflate_t {};
+
 //
 // Defines of one arguments that can be passed to FETCH command.
 // See FETCH Command in RFC for details:
@@ -53,15 +75,40 @@ struct select_t {
 namespace fetch_items {
 struct body_t {};
 
-// TODO: not supported yet, encoding is complicated here.
-// struct body_part_t {
-//     std::string section_spec;
-//     std::string partial;
-// };
-// struct body_peek_t {
-//     std::string section_spec;
-//     std::string partial;
-// };
+// <offset.length> suffix of BODY[...], requests length octets of the section starting at offset.
+struct body_partial_t {
+    uint32_t offset{};
+    uint32_t length{};
+};
+
+// BODY[<section_spec>]<<offset.length>>, e.g. section_spec "2" or "1.2.MIME" (MIME part numbers
+// as in BODYSTRUCTURE), "HEADER", "TEXT", or empty for the whole message. Sets \Seen flag.
+struct body_part_t {
+    std::string section_spec;
+    std::optional<body_partial_t> partial;
+};
+
+// BODY.PEEK[<section_spec>]<<offset.length>>, same as body_part_t but does not set \Seen flag.
+struct body_peek_t {
+    std::string section_spec;
+    std::optional<body_partial_t> partial;
+};
+
+// BINARY.PEEK[<section_part>]<<offset.length>> (https://datatracker.ietf.org/doc/html/rfc3516),
+// same as body_peek_t but content of the part comes decoded by server from its
+// Content-Transfer-Encoding, in literal8 if it has NULs. Offset and length are of decoded data.
+// Section part is MIME part number only (e.g. "2" or "1.2"), or empty for the whole message. Only
+// for servers with BINARY capability. Responses are not understood by the parser of FETCH
+// responses (the grammar is of RFC 3501), see imap_client_t::async_fetch_message_part_binary.
+struct binary_peek_t {
+    std::string section_part;
+    std::optional<body_partial_t> partial;
+};
+
+// BINARY.SIZE[<section_part>], size of the part after decoding, see binary_peek_t.
+struct binary_size_t {
+    std::string section_part;
+};
 
 struct body_structure_t {};
 struct envelope_t {};
@@ -86,8 +133,10 @@ struct full_t {};
 
 using fetch_items_raw_string_t = std::string;
 using fetch_item_t = std::variant<fetch_items::body_t,
-                                  //   fetch_items::body_part_t,
-                                  //   fetch_items::body_peek_t,
+                                  fetch_items::body_part_t,
+                                  fetch_items::body_peek_t,
+                                  fetch_items::binary_peek_t,
+                                  fetch_items::binary_size_t,
                                   fetch_items::body_structure_t,
                                   fetch_items::envelope_t,
                                   fetch_items::flags_t,
@@ -108,11 +157,55 @@ using raw_fetch_sequence_spec = std::string;
 
 struct fetch_t {
     // 2,4:7,9,12:* -> 2,4,5,6,7,9,12,13,14,15 -- for mailbox of size 15.
+    // With by_uid it is a set of UIDs (UID FETCH).
     std::variant<fetch_sequence_spec, raw_fetch_sequence_spec> sequence_set;
+    bool by_uid = false;
     std::variant<all_t, fast_t, full_t, fetch_items_vec_t> items;
+    // Optional, large literals (message bodies) go to the sink instead of fetch response.
+    imap_literal_sink_opts_t literal_sink = {};
+    // Optional, message data items are passed here one by one as soon as each has been received
+    // and parsed, while the rest of the response is still downloading, instead of being collected
+    // into fetch response. A message which fails to parse does not stop the others, the command
+    // then fails with the first such message in failed_raw_imap_opt.
+    std::function<void(imap_parser::MessageData)> on_message_data;
+};
+
+enum class search_return_t { min, max, count, all };
+
+// UID SEARCH [RETURN (<return_options>)] <criteria>, e.g. "UID 1000:*" or "MODSEQ 620162338"
+// (RFC 7162), see also search_query_t. With return options the server responds with ESEARCH
+// (https://datatracker.ietf.org/doc/html/rfc4731), only for servers with ESEARCH capability.
+struct uid_search_t {
+    std::string criteria;
+    std::vector<search_return_t> return_options;
+};
+
+// UID FETCH <uid_set> (UID FLAGS) (CHANGEDSINCE <changed_since> [VANISHED]): flags of messages
+// changed after given mod-sequence and, with QRESYNC enabled, UIDs of expunged messages.
+// https://datatracker.ietf.org/doc/html/rfc7162#section-3.1.4.1
+struct uid_fetch_flags_changes_t {
+    std::string uid_set;
+    uint64_t changed_since{};
+    bool vanished = false;
+};
+
+// UID FETCH <uid_set> (UID X-GM-MSGID X-GM-THRID [X-GM-LABELS]), only for servers with X-GM-EXT-1
+// capability (https://developers.google.com/gmail/imap/imap-extensions).
+struct uid_fetch_gmail_ids_t {
+    std::string uid_set;
+    bool labels = false;
+};
+
+// ENABLE <extensions> (https://datatracker.ietf.org/doc/html/rfc5161), valid only before a
+// mailbox is selected. Responds with extensions which have been enabled.
+struct enable_t {
+    std::vector<std::string> extensions;
 };
 
 expected<std::string> encode_cmd(const fetch_t& cmd);
+std::string encode_cmd(const uid_search_t& cmd);
+std::string encode_cmd(const list_t& cmd);
+std::string encode_cmd(const status_t& cmd);
 
 }  // namespace imap_commands
 
@@ -128,29 +221,109 @@ class imap_client_t {
     virtual ~imap_client_t() = default;
     virtual void start() = 0;
     virtual void on_state_change(std::function<void(imap_client_state)>) = 0;
+    // Turns capturing of the connection traffic into protocol dump on or off, see
+    // protocol_capture_t. On by default in debug builds.
+    virtual void set_protocol_capture(bool enabled) = 0;
+    // Throughput and latency estimate of the connection, e.g. for picking batch sizes.
+    virtual connection_health_t connection_health() const = 0;
+    // Totals of FETCH responses of the connection, see fetch_batch_sizer_t.
+    virtual fetch_stats_t fetch_stats() const = 0;
+    // Called when connection becomes slow/stalled or recovers, see imap_socket_t.
+    virtual void on_link_grade_change(fu2::function<void(link_grade_t)> cb) = 0;
+    // Up to n commands are sent without waiting for responses of the previous ones (pipelining),
+    // so e.g. several FETCH batches share one round trip. Commands changing state of connection
+    // (SELECT, COMPRESS) are always executed alone. Connect, capabilities and authentication are
+    // not pipelined and must not overlap with other commands.
+    virtual void set_max_commands_in_flight(size_t n) = 0;
+    // Capabilities of the server as last announced: in greeting, with authentication result or
+    // in response to async_obtain_capabilities. Unknown until then, the client does not use
+    // extensions while they are unknown. The client uses them to choose protocol paths, e.g. with
+    // X-GM-EXT-1 emails it fetches carry Gmail ids and labels (see types::MailboxEmail).
+    virtual const imap_capabilities_t& capabilities() const = 0;
 
    public:  // IMAP protocol commands
-    virtual void async_connect(std::string host, std::string port, async_callback<void> cb) = 0;
-    virtual void async_obtain_capabilities(async_callback<std::vector<std::string>> cb) = 0;
+    // Every command takes call_opts_t with deadline and/or cancellation token which constrains
+    // the whole command: sending it and receiving the response. Expired or cancelled command fails
+    // with timed_out/operation_canceled and connection is closed (see imap_socket_t). Overloads
+    // without opts are not constrained.
+    // Client can be connected again after connection has been lost, what it learned about the
+    // previous session (capabilities, enabled extensions, selected mailbox) is forgotten.
+    virtual void async_connect(std::string host,
+                               std::string port,
+                               call_opts_t opts,
+                               async_callback<void> cb) = 0;
+    // CAPABILITY command, the result is cached (see capabilities()). Names are in upper case.
+    virtual void async_obtain_capabilities(call_opts_t opts,
+                                           async_callback<std::vector<std::string>> cb) = 0;
+    // Capabilities change after authentication, if server does not announce them with the
+    // result they are queried with CAPABILITY before cb is called (failing that is not an error,
+    // capabilities stay unknown).
     virtual void async_authenticate(xoauth2_creds_t creds,
+                                    call_opts_t opts,
                                     async_callback<auth_error_details_t> cb) = 0;
-    virtual void async_execute_command(imap_commands::namespace_t, async_callback<void> cb) = 0;
+    virtual void async_execute_command(imap_commands::namespace_t,
+                                       call_opts_t opts,
+                                       async_callback<void> cb) = 0;
     virtual void async_execute_command(imap_commands::list_t,
+                                       call_opts_t opts,
                                        async_callback<types::list_response_t> cb) = 0;
     virtual void async_execute_command(imap_commands::select_t,
+                                       call_opts_t opts,
                                        async_callback<types::select_response_t> cb) = 0;
+    virtual void async_execute_command(imap_commands::status_t,
+                                       call_opts_t opts,
+                                       async_callback<types::mailbox_status_t> cb) = 0;
     virtual void async_execute_command(imap_commands::fetch_t,
+                                       call_opts_t opts,
                                        async_callback<types::fetch_response_t> cb) = 0;
+    // Once server accepts, connection is compressed in both directions until it is closed.
+    virtual void async_execute_command(imap_commands::compress_deflate_t,
+                                       call_opts_t opts,
+                                       async_callback<void> cb) = 0;
+    virtual void async_execute_command(imap_commands::uid_search_t,
+                                       call_opts_t opts,
+                                       async_callback<types::search_response_t> cb) = 0;
+    virtual void async_execute_command(imap_commands::uid_fetch_flags_changes_t,
+                                       call_opts_t opts,
+                                       async_callback<types::flags_changes_response_t> cb) = 0;
+    virtual void async_execute_command(imap_commands::uid_fetch_gmail_ids_t,
+                                       call_opts_t opts,
+                                       async_callback<types::gmail_ids_response_t> cb) = 0;
+    virtual void async_execute_command(imap_commands::enable_t,
+                                       call_opts_t opts,
+                                       async_callback<std::vector<std::string>> cb) = 0;
     // TODO: https://www.rfc-editor.org/rfc/rfc7628.html
     // virtual void async_authenticate(oauthbearer_creds_t creds,
     //                                 async_callback<auth_error_details_t> cb) {}
 
+    void async_connect(std::string host, std::string port, async_callback<void> cb) {
+        async_connect(std::move(host), std::move(port), {}, std::move(cb));
+    }
+    void async_obtain_capabilities(async_callback<std::vector<std::string>> cb) {
+        async_obtain_capabilities({}, std::move(cb));
+    }
+    void async_authenticate(xoauth2_creds_t creds, async_callback<auth_error_details_t> cb) {
+        async_authenticate(std::move(creds), {}, std::move(cb));
+    }
+    template <class Command, class Callback>
+    void async_execute_command(Command cmd, Callback cb) {
+        async_execute_command(std::move(cmd), call_opts_t{}, std::move(cb));
+    }
+
    public:  // Higher level functions that execute standard IMAP commands and do additional parsing
             // where needed.
     struct ListMailboxesResult {
         types::list_response_t raw_response;  // unprocessed response
     };
-    virtual void async_list_mailboxes(async_callback<ListMailboxesResult> cb) = 0;
+    virtual void async_list_mailboxes(call_opts_t opts,
+                                      async_callback<ListMailboxesResult> cb) = 0;
+    // Same as async_list_mailboxes but every selectable mailbox comes with its status (counts of
+    // messages and unseen ones, UIDNEXT, UIDVALIDITY and with CONDSTORE HIGHESTMODSEQ), e.g. for
+    // folder tree with unread counts or for skipping mailboxes which have not changed since the
+    // last synchronization without selecting them. With LIST-STATUS it takes one command, otherwise
+    // STATUS of each mailbox is pipelined after LIST. Mailboxes whose STATUS fails have no status.
+    virtual void async_list_mailboxes_with_status(call_opts_t opts,
+                                                  async_callback<ListMailboxesResult> cb) = 0;
 
     struct SelectMailboxResult {
         // Parsed server response without any interpretation
@@ -163,17 +336,133 @@ class imap_client_t {
         // unsigned highestmodseq{};
     };
     virtual void async_select_mailbox(std::string inbox_name,
+                                      call_opts_t opts,
                                       async_callback<SelectMailboxResult> cb) = 0;
 
-    virtual void async_list_items(
-        int from,
-        std::optional<int> to,
-        async_callback<std::variant<string, std::vector<emailkit::types::MailboxEmail>>> cb) = 0;
+    using list_items_result_t = std::variant<string, std::vector<emailkit::types::MailboxEmail>>;
+    virtual void async_list_items(int from,
+                                  std::optional<int> to,
+                                  call_opts_t opts,
+                                  async_callback<list_items_result_t> cb) = 0;
+
+    // Where previous synchronization of a mailbox stopped, to be kept by caller between runs.
+    // Default constructed state means nothing has been synchronized yet.
+    struct MailboxSyncState {
+        uint32_t uid_validity{};
+        uint32_t uid_next = 1;  // messages with UIDs below this have been downloaded
+        std::optional<uint64_t> highest_modseq;  // absent if server has no CONDSTORE
+    };
+    struct MailboxSyncResult {
+        MailboxSyncState state;  // for the next synchronization
+        // UIDVALIDITY has changed, everything known about mailbox is stale and new_emails has
+        // the whole mailbox.
+        bool uid_validity_changed = false;
+        std::vector<emailkit::types::MailboxEmail> new_emails;
+        std::vector<types::flags_change_t> flags_changes;
+        std::vector<types::uid_range_t> vanished;  // UIDs of expunged messages, only with QRESYNC
+    };
+    // Selects the mailbox and transfers only what has changed since known state: messages with
+    // UIDs at or above known.uid_next, and with CONDSTORE, flags changed since
+    // known.highest_modseq (CHANGEDSINCE), and with QRESYNC, expunged UIDs (VANISHED). Without
+    // CONDSTORE only new messages are detected.
+    virtual void async_sync_mailbox(std::string mailbox_name,
+                                    MailboxSyncState known,
+                                    call_opts_t opts,
+                                    async_callback<MailboxSyncResult> cb) = 0;
+
+    // Loads one MIME part of a message in selected mailbox by its section in BODYSTRUCTURE (see
+    // Attachment::part_id), so attachments are transferred only when they are opened. With
+    // partial only given range of the part is loaded (e.g. for a preview or resuming download).
+    // Data is returned as is, in transfer encoding of the part. Does not set \Seen flag.
+    virtual void async_fetch_message_part(uint32_t uid,
+                                          std::string part_id,
+                                          std::optional<imap_commands::fetch_items::body_partial_t>
+                                              partial,
+                                          call_opts_t opts,
+                                          async_callback<types::body_section_t> cb) = 0;
+
+    // Same as async_fetch_message_part but the part comes decoded by server (BINARY.PEEK), so
+    // base64 encoded attachments take a quarter fewer bytes to transfer and need no decoding.
+    // With partial the range is of decoded data and decoded size of the whole part comes too
+    // (BINARY.SIZE), e.g. for progress of resumed download. Large parts can be written to
+    // literal_sink as they arrive instead of data of the result. Only for servers with BINARY
+    // capability, fails with operation_not_supported otherwise. Server rejects the command for
+    // parts in encoding it does not know ([UNKNOWN-CTE]), those are loaded as is.
+    virtual void async_fetch_message_part_binary(
+        uint32_t uid,
+        std::string part_id,
+        std::optional<imap_commands::fetch_items::body_partial_t> partial,
+        imap_literal_sink_opts_t literal_sink,
+        call_opts_t opts,
+        async_callback<types::binary_section_t> cb) = 0;
+
+    // Searches selected mailbox on server, so that filtered views and counts do not need emails
+    // to be downloaded. With ESEARCH capability found UIDs come as compact set (count, min, max
+    // and all are set, ids are empty), otherwise they are computed from plain SEARCH response.
+    // Fails with operation_not_supported if query uses Gmail extensions server does not have or
+    // has literals server cannot take (see search_query_t).
+    virtual void async_search(search_query_t query,
+                              call_opts_t opts,
+                              async_callback<types::search_response_t> cb) = 0;
+
+    // Watches selected mailbox with IDLE: updates pushed by server (new messages, expunges, flag
+    // changes) are passed to on_event as they arrive. Idling ends when stop_idle() is called or
+    // any other command is submitted (it is executed after IDLE is done), then cb is called with
+    // success. IDLE is re-issued every IDLE_RENEW_INTERVAL because servers drop connections idling
+    // longer than 30 minutes, this is transparent to caller. Unlike commands, opts constrain the
+    // whole time of idling. Fails with operation_not_supported if server has no IDLE capability.
+    virtual void async_idle(call_opts_t opts,
+                            fu2::function<void(const types::idle_event_t&)> on_event,
+                            async_callback<void> cb) = 0;
+    // Does nothing if not idling.
+    virtual void stop_idle() = 0;
+
+    void async_list_mailboxes(async_callback<ListMailboxesResult> cb) {
+        async_list_mailboxes({}, std::move(cb));
+    }
+    void async_list_mailboxes_with_status(async_callback<ListMailboxesResult> cb) {
+        async_list_mailboxes_with_status({}, std::move(cb));
+    }
+    void async_select_mailbox(std::string inbox_name, async_callback<SelectMailboxResult> cb) {
+        async_select_mailbox(std::move(inbox_name), {}, std::move(cb));
+    }
+    void async_list_items(int from, std::optional<int> to, async_callback<list_items_result_t> cb) {
+        async_list_items(from, to, {}, std::move(cb));
+    }
+    void async_sync_mailbox(std::string mailbox_name,
+                            MailboxSyncState known,
+                            async_callback<MailboxSyncResult> cb) {
+        async_sync_mailbox(std::move(mailbox_name), std::move(known), {}, std::move(cb));
+    }
+    void async_fetch_message_part(uint32_t uid,
+                                  std::string part_id,
+                                  std::optional<imap_commands::fetch_items::body_partial_t> partial,
+                                  async_callback<types::body_section_t> cb) {
+        async_fetch_message_part(uid, std::move(part_id), partial, {}, std::move(cb));
+    }
+    void async_fetch_message_part_binary(
+        uint32_t uid,
+        std::string part_id,
+        std::optional<imap_commands::fetch_items::body_partial_t> partial,
+        async_callback<types::binary_section_t> cb) {
+        async_fetch_message_part_binary(uid, std::move(part_id), partial, {}, {}, std::move(cb));
+    }
+    void async_search(search_query_t query, async_callback<types::search_response_t> cb) {
+        async_search(std::move(query), {}, std::move(cb));
+    }
+    void async_idle(fu2::function<void(const types::idle_event_t&)> on_event,
+                    async_callback<void> cb) {
+        async_idle({}, std::move(on_event), std::move(cb));
+    }
 
    public:
     // TODO: state change API (logical states + disconnected/failed)
 };
 
+constexpr size_t DEFAULT_MAX_COMMANDS_IN_FLIGHT = 4;
+// Servers may log out clients idling for 30 minutes (https://datatracker.ietf.org/doc/html/rfc2177)
+constexpr auto IDLE_RENEW_INTERVAL = std::chrono::minutes{28};
+
 std::shared_ptr<imap_client_t> make_imap_client(asio::io_context& ctx);
 
 // test client has predictive tags: a1, a2, a_n..
@@ -0,0 +1,198 @@
+#pragma once
+#include <emailkit/global.hpp>
+#include <emailkit/imap_client.hpp>
+
+#include <asio/associated_executor.hpp>
+#include <asio/async_result.hpp>
+#include <asio/awaitable.hpp>
+#include <asio/post.hpp>
+#include <asio/use_awaitable.hpp>
+
+#include <tuple>
+
+// Awaitable counterparts of imap_client_t operations for code written as C++20 coroutines
+// (started with asio::co_spawn) instead of callback chains:
+//
+//     auto [ec, emails] = co_await coro::list_items(client, from, to);
+//
+// Operation results in a tuple of error code and the value its callback would get (only error code
+// for operations without value), so errors are handled the same way as with callbacks and nothing
+// is thrown. Coroutine frames are allocated by asio from recycling allocator of the thread running
+// io_context, which is where every operation of a connection runs, so once warmed up awaiting
+// does not allocate for frames. Operations are not wrapped into coroutines of their own, awaiting
+// one costs a single callback.
+//
+// Client (and everything passed by reference) must outlive awaiting, as with callbacks.
+namespace emailkit::imap_client::coro {
+
+template <class T>
+using result_t = std::conditional_t<std::is_void_v<T>,
+                                    std::tuple<std::error_code>,
+                                    std::tuple<std::error_code, T>>;
+
+// Awaits operation started by initiate(async_callback<T>). Callback may be called before initiate
+// returns (e.g. on validation errors), so completion is always posted to coroutine's executor
+// instead of resuming it from within initiation.
+template <class T, class Initiate>
+asio::awaitable<result_t<T>> async_await(Initiate initiate) {
+    return asio::async_initiate<const asio::use_awaitable_t<>&, void(result_t<T>)>(
+        [initiate = std::move(initiate)](auto handler) mutable {
+            auto ex = asio::get_associated_executor(handler);
+            auto complete = [handler = std::move(handler), ex](result_t<T> result) mutable {
+                asio::post(ex, [handler = std::move(handler),
+                                result = std::move(result)]() mutable {
+                    std::move(handler)(std::move(result));
+                });
+            };
+            if constexpr (std::is_void_v<T>) {
+                initiate(async_callback<void>{
+                    [complete = std::move(complete)](std::error_code ec) mutable {
+                        complete(result_t<T>{ec});
+                    }});
+            } else {
+                initiate(async_callback<T>{
+                    [complete = std::move(complete)](std::error_code ec, T value) mutable {
+                        complete(result_t<T>{ec, std::move(value)});
+                    }});
+            }
+        },
+        asio::use_awaitable);
+}
+
+inline asio::awaitable<result_t<void>> connect(imap_client_t& client,
+                                               std::string host,
+                                               std::string port,
+                                               call_opts_t opts = {}) {
+    return async_await<void>([&client, host = std::move(host), port = std::move(port),
+                              opts = std::move(opts)](async_callback<void> cb) mutable {
+        client.async_connect(std::move(host), std::move(port), std::move(opts), std::move(cb));
+    });
+}
+
+inline asio::awaitable<result_t<std::vector<std::string>>> obtain_capabilities(
+    imap_client_t& client,
+    call_opts_t opts = {}) {
+    return async_await<std::vector<std::string>>(
+        [&client, opts = std::move(opts)](async_callback<std::vector<std::string>> cb) mutable {
+            client.async_obtain_capabilities(std::move(opts), std::move(cb));
+        });
+}
+
+inline asio::awaitable<result_t<auth_error_details_t>> authenticate(imap_client_t& client,
+                                                                    xoauth2_creds_t creds,
+                                                                    call_opts_t opts = {}) {
+    return async_await<auth_error_details_t>(
+        [&client, creds = std::move(creds),
+         opts = std::move(opts)](async_callback<auth_error_details_t> cb) mutable {
+            client.async_authenticate(std::move(creds), std::move(opts), std::move(cb));
+        });
+}
+
+inline asio::awaitable<result_t<imap_client_t::ListMailboxesResult>> list_mailboxes(
+    imap_client_t& client,
+    call_opts_t opts = {}) {
+    return async_await<imap_client_t::ListMailboxesResult>(
+        [&client,
+         opts = std::move(opts)](async_callback<imap_client_t::ListMailboxesResult> cb) mutable {
+            client.async_list_mailboxes(std::move(opts), std::move(cb));
+        });
+}
+
+inline asio::awaitable<result_t<imap_client_t::ListMailboxesResult>> list_mailboxes_with_status(
+    imap_client_t& client,
+    call_opts_t opts = {}) {
+    return async_await<imap_client_t::ListMailboxesResult>(
+        [&client,
+         opts = std::move(opts)](async_callback<imap_client_t::ListMailboxesResult> cb) mutable {
+            client.async_list_mailboxes_with_status(std::move(opts), std::move(cb));
+        });
+}
+
+inline asio::awaitable<result_t<imap_client_t::SelectMailboxResult>> select_mailbox(
+    imap_client_t& client,
+    std::string mailbox_name,
+    call_opts_t opts = {}) {
+    return async_await<imap_client_t::SelectMailboxResult>(
+        [&client, mailbox_name = std::move(mailbox_name),
+         opts = std::move(opts)](async_callback<imap_client_t::SelectMailboxResult> cb) mutable {
+            client.async_select_mailbox(std::move(mailbox_name), std::move(opts), std::move(cb));
+        });
+}
+
+inline asio::awaitable<result_t<imap_client_t::list_items_result_t>> list_items(
+    imap_client_t& client,
+    int from,
+    std::optional<int> to,
+    call_opts_t opts = {}) {
+    return async_await<imap_client_t::list_items_result_t>(
+        [&client, from, to,
+         opts = std::move(opts)](async_callback<imap_client_t::list_items_result_t> cb) mutable {
+            client.async_list_items(from, to, std::move(opts), std::move(cb));
+        });
+}
+
+inline asio::awaitable<result_t<types::fetch_response_t>> fetch(imap_client_t& client,
+                                                                imap_commands::fetch_t cmd,
+                                                                call_opts_t opts = {}) {
+    return async_await<types::fetch_response_t>(
+        [&client, cmd = std::move(cmd),
+         opts = std::move(opts)](async_callback<types::fetch_response_t> cb) mutable {
+            client.async_execute_command(std::move(cmd), std::move(opts), std::move(cb));
+        });
+}
+
+inline asio::awaitable<result_t<types::search_response_t>> search(imap_client_t& client,
+                                                                  search_query_t query,
+                                                                  call_opts_t opts = {}) {
+    return async_await<types::search_response_t>(
+        [&client, query = std::move(query),
+         opts = std::move(opts)](async_callback<types::search_response_t> cb) mutable {
+            client.async_search(std::move(query), std::move(opts), std::move(cb));
+        });
+}
+
+inline asio::awaitable<result_t<imap_client_t::MailboxSyncResult>> sync_mailbox(
+    imap_client_t& client,
+    std::string mailbox_name,
+    imap_client_t::MailboxSyncState known,
+    call_opts_t opts = {}) {
+    return async_await<imap_client_t::MailboxSyncResult>(
+        [&client, mailbox_name = std::move(mailbox_name), known = std::move(known),
+         opts = std::move(opts)](async_callback<imap_client_t::MailboxSyncResult> cb) mutable {
+            client.async_sync_mailbox(std::move(mailbox_name), std::move(known), std::move(opts),
+                                      std::move(cb));
+        });
+}
+
+inline asio::awaitable<result_t<types::body_section_t>> fetch_message_part(
+    imap_client_t& client,
+    uint32_t uid,
+    std::string part_id,
+    std::optional<imap_commands::fetch_items::body_partial_t> partial = std::nullopt,
+    call_opts_t opts = {}) {
+    return async_await<types::body_section_t>(
+        [&client, uid, part_id = std::move(part_id), partial,
+         opts = std::move(opts)](async_callback<types::body_section_t> cb) mutable {
+            client.async_fetch_message_part(uid, std::move(part_id), partial, std::move(opts),
+                                            std::move(cb));
+        });
+}
+
+inline asio::awaitable<result_t<types::binary_section_t>> fetch_message_part_binary(
+    imap_client_t& client,
+    uint32_t uid,
+    std::string part_id,
+    std::optional<imap_commands::fetch_items::body_partial_t> partial = std::nullopt,
+    imap_literal_sink_opts_t literal_sink = {},
+    call_opts_t opts = {}) {
+    return async_await<types::binary_section_t>(
+        [&client, uid, part_id = std::move(part_id), partial,
+         literal_sink = std::move(literal_sink),
+         opts = std::move(opts)](async_callback<types::binary_section_t> cb) mutable {
+            client.async_fetch_message_part_binary(uid, std::move(part_id), partial,
+                                                   std::move(literal_sink), std::move(opts),
+                                                   std::move(cb));
+        });
+}
+
+}  // namespace emailkit::imap_client::coro
@@ -7,10 +7,15 @@
 
 #include <emailkit/global.hpp>
 
+#include "imap_parser__sync.hpp"
 #include "imap_parser_types.hpp"
 
 namespace emailkit::imap_client::types {
 
+////////////////////////////////////////////////////////////////////////////////////////////////
+// mailbox_status_t
+using mailbox_status_t = imap_parser::sync::mailbox_status_t;
+
 ////////////////////////////////////////////////////////////////////////////////////////////////
 // list_response_t
 struct list_response_entry_t {
@@ -19,6 +24,8 @@ struct list_response_entry_t {
                                           // we should have called it mailbox_path_parts
     std::vector<std::string> flags;
     std::string hierarchy_delimiter;
+    // With LIST-STATUS or STATUS fallback (see imap_client_t::async_list_mailboxes_with_status).
+    std::optional<mailbox_status_t> status;
 };
 
 struct list_response_t {
@@ -40,6 +47,8 @@ struct select_response_t {
     uint32_t uid_validity{};
     std::optional<uint32_t> opt_unseen;
     uint32_t uid_next{};
+    // Absent if server does not support CONDSTORE or mailbox has no mod-sequences (NOMODSEQ).
+    std::optional<uint64_t> highest_modseq;
     std::vector<std::string> flags;
     std::vector<std::string> permanent_flags;
     read_write_mode_t read_write_mode = read_write_mode_t::na;
@@ -52,6 +61,65 @@ struct fetch_response_t {
     std::optional<std::string> failed_raw_imap_opt;
 };
 
+////////////////////////////////////////////////////////////////////////////////////////////////
+// search_response_t
+struct search_response_t {
+    std::vector<uint32_t> ids;  // UIDs for UID SEARCH, sequence numbers otherwise
+    // Highest mod-sequence of found messages, when search criteria has MODSEQ.
+    std::optional<uint64_t> highest_modseq;
+
+    // Results of ESEARCH, ids are empty then. Only the ones requested with return options are set,
+    // min and max are absent when nothing has been found.
+    std::optional<uint32_t> min;
+    std::optional<uint32_t> max;
+    std::optional<uint32_t> count;
+    std::string all;  // e.g. "2,10:11", see imap_parser::sync::parse_uid_set
+};
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+// flags_changes_response_t
+using flags_change_t = imap_parser::sync::flags_change_t;
+using uid_range_t = imap_parser::sync::uid_range_t;
+
+struct flags_changes_response_t {
+    std::vector<flags_change_t> changes;
+    std::vector<uid_range_t> vanished;  // with QRESYNC only
+};
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+// gmail_ids_response_t
+using gmail_ids_t = imap_parser::sync::gmail_ids_t;
+
+struct gmail_ids_response_t {
+    std::vector<gmail_ids_t> ids;
+};
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+// body_section_t
+// Content of BODY[<section>] fetch item, for partial fetch origin is offset of data in the section.
+using body_section_t = imap_parser::MsgAttrBodySection;
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+// binary_section_t
+// Content of BINARY[<section>] fetch item (RFC 3516), decoded by server.
+using binary_section_t = imap_parser::sync::binary_section_t;
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+// idle_event_t
+// Mailbox update pushed by server while idling (https://datatracker.ietf.org/doc/html/rfc2177).
+enum class idle_event_kind_t {
+    exists,   // number of messages in mailbox, grows when new messages arrive
+    recent,   // number of messages with \Recent flag
+    expunge,  // message with given sequence number has been removed
+    fetch,    // flags of message with given sequence number have changed
+};
+
+struct idle_event_t {
+    idle_event_kind_t kind;
+    uint32_t number{};  // message count for exists/recent, message sequence number otherwise
+    std::string line;   // raw untagged line without CRLF, e.g. "* 3 FETCH (FLAGS (\Seen))"
+};
+
 ////////////////////////////////////////////////////////////////////////////////////////////////
 // imap_errors
 enum class imap_errors {
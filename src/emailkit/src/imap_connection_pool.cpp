@@ -0,0 +1,209 @@
+#include "imap_connection_pool.hpp"
+#include <asio/post.hpp>
+#include <deque>
+#include "timer_wheel.hpp"
+
+namespace emailkit::imap_client {
+
+imap_connection_lease_t::imap_connection_lease_t(imap_connection_lease_t&& other) noexcept
+    : m_pool(std::move(other.m_pool)),
+      m_client(std::move(other.m_client)),
+      m_discard(std::exchange(other.m_discard, false)) {}
+
+imap_connection_lease_t& imap_connection_lease_t::operator=(
+    imap_connection_lease_t&& other) noexcept {
+    if (this != &other) {
+        release();
+        m_pool = std::move(other.m_pool);
+        m_client = std::move(other.m_client);
+        m_discard = std::exchange(other.m_discard, false);
+    }
+    return *this;
+}
+
+void imap_connection_lease_t::release() {
+    if (!m_client) {
+        return;
+    }
+    if (auto pool = m_pool.lock()) {
+        pool->on_connection_released(std::move(m_client), m_discard);
+    }
+    m_client.reset();
+    m_pool.reset();
+    m_discard = false;
+}
+
+namespace {
+
+class imap_connection_pool_impl_t
+    : public imap_connection_pool_t,
+      public detail::imap_connection_owner_t,
+      public std::enable_shared_from_this<imap_connection_pool_impl_t> {
+   public:
+    imap_connection_pool_impl_t(asio::io_context& ctx,
+                                imap_connection_pool_opts_t opts,
+                                imap_connection_setup_t setup)
+        : m_ctx(ctx),
+          m_opts(opts),
+          m_setup(std::move(setup)),
+          m_max_connections(std::max<size_t>(opts.max_connections, 1)) {}
+
+    ~imap_connection_pool_impl_t() {
+        for (auto& w : m_waiters) {
+            if (w.deadline_timer) {
+                timer_wheel_t::of(m_ctx).cancel(w.deadline_timer);
+            }
+        }
+    }
+
+    void async_acquire(call_opts_t opts, async_callback<imap_connection_lease_t> cb) override {
+        const auto id = ++m_last_waiter_id;
+        waiter_t w{.id = id, .cb = std::move(cb)};
+        if (opts.deadline) {
+            w.deadline_timer = timer_wheel_t::of(m_ctx).schedule(
+                *opts.deadline, [this, id] { fail_waiter(id, std::errc::timed_out); });
+        }
+        // Cancellation may come from any thread.
+        w.cancellation = opts.cancellation.on_cancel(
+            [this_weak = weak_from_this(), id, &ctx = m_ctx] {
+                asio::post(ctx, [this_weak, id] {
+                    if (auto this_ = this_weak.lock()) {
+                        this_->fail_waiter(id, std::errc::operation_canceled);
+                    }
+                });
+            });
+        m_waiters.emplace_back(std::move(w));
+        serve_waiters();
+    }
+
+    size_t size() const override { return m_open_connections; }
+
+    size_t max_size() const override { return m_max_connections; }
+
+    void on_connection_released(std::shared_ptr<imap_client_t> client, bool discard) override {
+        if (discard) {
+            log_debug("connection discarded");
+            --m_open_connections;
+        } else {
+            m_idle_connections.emplace_back(std::move(client));
+        }
+        serve_waiters();
+    }
+
+   private:
+    struct waiter_t {
+        uint64_t id = 0;
+        async_callback<imap_connection_lease_t> cb;
+        timer_wheel_t::timer_id_t deadline_timer = 0;
+        cancellation_registration_t cancellation;
+    };
+
+    void serve_waiters() {
+        while (!m_waiters.empty() && !m_idle_connections.empty()) {
+            auto client = std::move(m_idle_connections.front());
+            m_idle_connections.pop_front();
+            auto w = take_waiter(m_waiters.begin());
+            w.cb({}, imap_connection_lease_t{weak_from_this(), std::move(client)});
+        }
+
+        while (m_connections_being_set_up < m_waiters.size() &&
+               m_open_connections + m_connections_being_set_up < m_max_connections) {
+            open_connection();
+        }
+    }
+
+    void open_connection() {
+        ++m_connections_being_set_up;
+        auto client = make_imap_client(m_ctx);
+        if (!client) {
+            on_connection_setup_failed(make_error_code(std::errc::not_enough_memory));
+            return;
+        }
+        log_info("opening connection {} of the pool",
+                 m_open_connections + m_connections_being_set_up);
+
+        auto& client_ref = *client;
+        m_setup(client_ref, call_opts_t::timeout(m_opts.setup_timeout),
+                [this_weak = weak_from_this(), client = std::move(client)](
+                    std::error_code ec) mutable {
+                    auto this_ = this_weak.lock();
+                    if (!this_) {
+                        return;
+                    }
+                    if (ec) {
+                        this_->on_connection_setup_failed(ec);
+                        return;
+                    }
+                    --this_->m_connections_being_set_up;
+                    ++this_->m_open_connections;
+                    this_->m_idle_connections.emplace_back(std::move(client));
+                    this_->serve_waiters();
+                });
+    }
+
+    void on_connection_setup_failed(std::error_code ec) {
+        --m_connections_being_set_up;
+        if (m_open_connections > 0) {
+            // Most likely server limit, waiters are served by connections which are open.
+            log_warning("failed opening connection {} of the pool, limiting pool to {}: {}",
+                        m_open_connections + 1, m_open_connections, ec);
+            m_max_connections = m_open_connections;
+            return;
+        }
+        if (m_connections_being_set_up > 0) {
+            return;  // waiters may still be served by connections being set up
+        }
+
+        log_error("failed opening connection of the pool: {}", ec);
+        auto waiters = std::exchange(m_waiters, {});
+        for (auto& w : waiters) {
+            cancel_deadline(w);
+            w.cb(ec, {});
+        }
+    }
+
+    void fail_waiter(uint64_t id, std::errc errc) {
+        auto it = std::find_if(m_waiters.begin(), m_waiters.end(),
+                               [id](const waiter_t& w) { return w.id == id; });
+        if (it == m_waiters.end()) {
+            return;
+        }
+        auto w = take_waiter(it);
+        w.cb(make_error_code(errc), {});
+    }
+
+    waiter_t take_waiter(std::deque<waiter_t>::iterator it) {
+        auto w = std::move(*it);
+        m_waiters.erase(it);
+        cancel_deadline(w);
+        w.cancellation.reset();
+        return w;
+    }
+
+    void cancel_deadline(waiter_t& w) {
+        if (w.deadline_timer) {
+            timer_wheel_t::of(m_ctx).cancel(std::exchange(w.deadline_timer, 0));
+        }
+    }
+
+    asio::io_context& m_ctx;
+    imap_connection_pool_opts_t m_opts;
+    imap_connection_setup_t m_setup;
+    size_t m_max_connections;
+    size_t m_open_connections = 0;
+    size_t m_connections_being_set_up = 0;
+    std::deque<std::shared_ptr<imap_client_t>> m_idle_connections;
+    std::deque<waiter_t> m_waiters;
+    uint64_t m_last_waiter_id = 0;
+};
+
+}  // namespace
+
+std::shared_ptr<imap_connection_pool_t> make_imap_connection_pool(
+    asio::io_context& ctx,
+    imap_connection_pool_opts_t opts,
+    imap_connection_setup_t setup) {
+    return std::make_shared<imap_connection_pool_impl_t>(ctx, opts, std::move(setup));
+}
+
+}  // namespace emailkit::imap_client
@@ -0,0 +1,83 @@
+#pragma once
+#include <emailkit/global.hpp>
+#include <asio/io_context.hpp>
+#include <emailkit/call_opts.hpp>
+#include "imap_client.hpp"
+
+namespace emailkit::imap_client {
+
+namespace detail {
+struct imap_connection_owner_t {
+    virtual ~imap_connection_owner_t() = default;
+    virtual void on_connection_released(std::shared_ptr<imap_client_t> client, bool discard) = 0;
+};
+}  // namespace detail
+
+// Exclusive use of one connection of imap_connection_pool_t, the connection goes back to the pool
+// when lease is destroyed. IMAP connection is stateful (e.g. selected mailbox) and holder of the
+// lease is free to change that state, the next holder should not rely on it.
+class imap_connection_lease_t {
+   public:
+    imap_connection_lease_t() = default;
+    imap_connection_lease_t(std::weak_ptr<detail::imap_connection_owner_t> pool,
+                            std::shared_ptr<imap_client_t> client)
+        : m_pool(std::move(pool)), m_client(std::move(client)) {}
+    imap_connection_lease_t(imap_connection_lease_t&& other) noexcept;
+    imap_connection_lease_t& operator=(imap_connection_lease_t&& other) noexcept;
+    ~imap_connection_lease_t() { release(); }
+
+    imap_client_t& operator*() const { return *m_client; }
+    imap_client_t* operator->() const { return m_client.get(); }
+    explicit operator bool() const { return m_client != nullptr; }
+
+    // Connection is closed instead of being returned to the pool, to be called when connection is
+    // not usable anymore (e.g. a command failed, see imap_client_t).
+    void discard() { m_discard = true; }
+    void release();
+
+   private:
+    std::weak_ptr<detail::imap_connection_owner_t> m_pool;
+    std::shared_ptr<imap_client_t> m_client;
+    bool m_discard = false;
+};
+
+// Brings new connection of the pool to the state in which it can be leased, typically connects and
+// authenticates.
+using imap_connection_setup_t =
+    fu2::function<void(imap_client_t& client, call_opts_t opts, async_callback<void> cb)>;
+
+struct imap_connection_pool_opts_t {
+    size_t max_connections = 4;
+    std::chrono::steady_clock::duration setup_timeout = std::chrono::seconds{30};
+};
+
+// Connections of one account used in parallel, e.g. for downloading several mailboxes at once.
+// Connections are opened on demand up to max_connections. Servers limit number of simultaneous
+// connections per account (e.g. Gmail to 15, counting other clients of the user), so when a new
+// connection cannot be set up while others are open, the limit is lowered to the number of open
+// connections and requests wait for them to be released. Not thread safe, to be used from the
+// thread running io_context.
+class imap_connection_pool_t {
+   public:
+    virtual ~imap_connection_pool_t() = default;
+
+    // Leases an idle connection or opens a new one if pool is below its limit, otherwise waits for
+    // a connection to be released. Waiting requests are served in order. Fails if connection
+    // cannot be set up and there are no other connections to wait for.
+    virtual void async_acquire(call_opts_t opts, async_callback<imap_connection_lease_t> cb) = 0;
+    void async_acquire(async_callback<imap_connection_lease_t> cb) {
+        async_acquire({}, std::move(cb));
+    }
+
+    // Open connections, leased or idle.
+    virtual size_t size() const = 0;
+    // Current limit, can be lower than configured one after server refused connection.
+    virtual size_t max_size() const = 0;
+};
+
+std::shared_ptr<imap_connection_pool_t> make_imap_connection_pool(
+    asio::io_context& ctx,
+    imap_connection_pool_opts_t opts,
+    imap_connection_setup_t setup);
+
+}  // namespace emailkit::imap_client
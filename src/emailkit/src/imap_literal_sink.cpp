@@ -0,0 +1,37 @@
+#include "imap_literal_sink.hpp"
+
+namespace emailkit {
+
+std::error_code file_literal_sink_t::on_literal_begin(size_t literal_size) {
+    auto path = m_dir / fmt::format("literal-{}.bin", m_files.size());
+    m_current_file = std::ofstream{path, std::ios_base::out | std::ios_base::binary};
+    if (!m_current_file) {
+        auto err = errno;
+        log_error("failed opening {} for literal of size {}: {}", path.string(), literal_size,
+                  strerror(err));
+        return std::error_code{err, std::generic_category()};
+    }
+    m_files.emplace_back(std::move(path));
+    return {};
+}
+
+std::error_code file_literal_sink_t::on_literal_data(std::string_view chunk) {
+    m_current_file.write(chunk.data(), chunk.size());
+    if (!m_current_file.good()) {
+        auto err = errno;
+        log_error("write to {} failed: {}", m_files.back().string(), strerror(err));
+        return std::error_code{err, std::generic_category()};
+    }
+    return {};
+}
+
+std::error_code file_literal_sink_t::on_literal_end() {
+    m_current_file.close();
+    if (m_current_file.fail()) {
+        log_error("closing {} failed", m_files.back().string());
+        return make_error_code(std::errc::io_error);
+    }
+    return {};
+}
+
+}  // namespace emailkit
@@ -0,0 +1,71 @@
+#pragma once
+#include <emailkit/global.hpp>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+
+namespace emailkit {
+
+// Receives payload of large literals (e.g. RFC822 of a message with attachments) while response is
+// being received, so that socket does not need to keep them in memory. Literal is replaced in the
+// response with empty one ({0}), literals are delivered to the sink in order they appear in the
+// response.
+class imap_literal_sink_t {
+   public:
+    virtual ~imap_literal_sink_t() = default;
+
+    virtual std::error_code on_literal_begin(size_t literal_size) = 0;
+    virtual std::error_code on_literal_data(std::string_view chunk) = 0;
+    virtual std::error_code on_literal_end() = 0;
+};
+
+struct imap_literal_sink_opts_t {
+    std::shared_ptr<imap_literal_sink_t> sink;
+    // Literals smaller than this are kept in the response as usual.
+    size_t threshold = 1024 * 1024;
+};
+
+// Writes every literal into its own file in the directory, files are named literal-<n>.bin where
+// n is a number of diverted literal within the response.
+class file_literal_sink_t : public imap_literal_sink_t {
+   public:
+    explicit file_literal_sink_t(std::filesystem::path dir) : m_dir(std::move(dir)) {}
+
+    std::error_code on_literal_begin(size_t literal_size) override;
+    std::error_code on_literal_data(std::string_view chunk) override;
+    std::error_code on_literal_end() override;
+
+    const std::vector<std::filesystem::path>& files() const { return m_files; }
+
+   private:
+    std::filesystem::path m_dir;
+    std::ofstream m_current_file;
+    std::vector<std::filesystem::path> m_files;
+};
+
+// Hands literal data over to user provided callbacks.
+class callback_literal_sink_t : public imap_literal_sink_t {
+   public:
+    struct callbacks_t {
+        std::function<std::error_code(size_t literal_size)> on_begin = [](size_t) {
+            return std::error_code{};
+        };
+        std::function<std::error_code(std::string_view chunk)> on_data;
+        std::function<std::error_code()> on_end = [] { return std::error_code{}; };
+    };
+
+    explicit callback_literal_sink_t(callbacks_t callbacks) : m_callbacks(std::move(callbacks)) {}
+
+    std::error_code on_literal_begin(size_t literal_size) override {
+        return m_callbacks.on_begin(literal_size);
+    }
+    std::error_code on_literal_data(std::string_view chunk) override {
+        return m_callbacks.on_data(chunk);
+    }
+    std::error_code on_literal_end() override { return m_callbacks.on_end(); }
+
+   private:
+    callbacks_t m_callbacks;
+};
+
+}  // namespace emailkit
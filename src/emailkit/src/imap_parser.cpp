@@ -16,6 +16,7 @@
 #include <function2/function2.hpp>
 
 #include <any>
+#include <charconv>
 #include <cstdlib>
 #include <set>
 #include <vector>
@@ -627,6 +628,27 @@ expected<std::vector<mailbox_data_t>> parse_mailbox_data_records(std::string_vie
                                                 IMAP_PARSER_APG_IMPL_RESP_TEXT_CODE_TRY_CREATE})) {
                         parsed_records.emplace_back(try_create_resp_text_code_t{});
 
+                    } else if (current_path_is({IMAP_PARSER_APG_IMPL_RESP_COND_STATE,
+                                                IMAP_PARSER_APG_IMPL_RESP_TEXT,
+                                                IMAP_PARSER_APG_IMPL_RESP_TEXT_CODE})) {
+                        // Grammar knows nothing about CONDSTORE, its codes are parsed as
+                        // generic "atom [SP text]" codes.
+                        constexpr std::string_view highest_modseq_prefix = "HIGHESTMODSEQ ";
+                        if (match_text.starts_with(highest_modseq_prefix)) {
+                            const auto digits = match_text.substr(highest_modseq_prefix.size());
+                            uint64_t value{};
+                            auto [ptr, ec] = std::from_chars(digits.data(),
+                                                             digits.data() + digits.size(), value);
+                            if (ec == std::errc{} && ptr == digits.data() + digits.size()) {
+                                parsed_records.emplace_back(
+                                    highest_modseq_resp_text_code_t{.value = value});
+                            } else {
+                                log_warning("invalid HIGHESTMODSEQ: '{}'", match_text);
+                            }
+                        } else if (match_text == "NOMODSEQ") {
+                            parsed_records.emplace_back(no_modseq_resp_text_code_t{});
+                        }
+
                     } else if (current_path_is({IMAP_PARSER_APG_IMPL_MAILBOX_DATA,
                                                 IMAP_PARSER_APG_IMPL_MAILBOX_DATA_RECENT,
                                                 IMAP_PARSER_APG_IMPL_NUMBER})) {
@@ -1665,11 +1687,39 @@ const ast_record* parse_msg_att_static_body_structure(std::string_view input,
 
 const ast_record* parse_msg_att_static_body_section(std::string_view input,
                                                     const ast_record* begin,
-                                                    const ast_record* end) {
+                                                    const ast_record* end,
+                                                    MsgAttrBodySection& out_result) {
+    // msg-att-static-body-section = "BODY" section ["<" number ">"] SP nstring
     assert(begin->uiIndex == IMAP_PARSER_APG_IMPL_MSG_ATT_STATIC_BODY_SECTION);
 
     auto it = begin + 1;
 
+    it = skip_until(it, end, IMAP_PARSER_APG_IMPL_SECTION, ID_AST_PRE);
+    RETURN_IF_END(it);
+    // section = "[" [section-spec] "]"
+    const std::string_view section_text{input.data() + it->uiPhraseOffset, it->uiPhraseLength};
+    out_result.section = std::string{section_text.substr(1, section_text.size() - 2)};
+
+    it = skip_until(it, end, IMAP_PARSER_APG_IMPL_SECTION, ID_AST_POST);
+    RETURN_IF_END(it);
+    it++;
+    RETURN_IF_END(it);
+
+    if (it->uiIndex == IMAP_PARSER_APG_IMPL_NUMBER && it->uiState == ID_AST_PRE) {
+        uint32_t origin = 0;
+        it = parse_number(input, it, end, origin);
+        RETURN_IF_END(it);
+        out_result.origin = origin;
+    }
+
+    it = skip_until(it, end, IMAP_PARSER_APG_IMPL_NSTRING, ID_AST_PRE);
+    RETURN_IF_END(it);
+    it = parse_nstring(input, it, end, out_result.data);
+
+    it = skip_until(it, end, IMAP_PARSER_APG_IMPL_MSG_ATT_STATIC_BODY_SECTION, ID_AST_POST);
+    RETURN_IF_END(it);
+    it++;
+
     assert((it - 1)->uiIndex == IMAP_PARSER_APG_IMPL_MSG_ATT_STATIC_BODY_SECTION &&
            (it - 1)->uiState == ID_AST_POST);
     return it;
@@ -1761,7 +1811,9 @@ const ast_record* parse_msg_att_static(std::string_view input,
             break;
         }
         case IMAP_PARSER_APG_IMPL_MSG_ATT_STATIC_BODY_SECTION: {
-            it = parse_msg_att_static_body_section(input, it, end);
+            MsgAttrBodySection parsed_body_section;
+            it = parse_msg_att_static_body_section(input, it, end, parsed_body_section);
+            out_result = std::move(parsed_body_section);
             break;
         }
         case IMAP_PARSER_APG_IMPL_MSG_ATT_STATIC_RFC822: {
@@ -1879,7 +1931,9 @@ const ast_record* parse_message_data(std::string_view input,
     return it;
 }
 
-expected<std::vector<MessageData>> parse_message_data_records(std::string_view input_text) {
+static expected<std::vector<MessageData>> parse_message_data_records_impl(
+    uint32_t starting_rule,
+    std::string_view input_text) {
     std::vector<MessageData> result;
 
     auto parsing_start_time = std::chrono::steady_clock::now();
@@ -1888,7 +1942,7 @@ expected<std::vector<MessageData>> parse_message_data_records(std::string_view i
     // parsing will be fine and we don't report this as error.
 
     auto ec = apg_invoke_parser__ast(
-        IMAP_PARSER_APG_IMPL_RESPONSE, input_text,
+        starting_rule, input_text,
         {
             IMAP_PARSER_APG_IMPL_MESSAGE_DATA,
             IMAP_PARSER_APG_IMPL_NZ_NUMBER,
@@ -1903,6 +1957,8 @@ expected<std::vector<MessageData>> parse_message_data_records(std::string_view i
             IMAP_PARSER_APG_IMPL_DATE_TIME,
             IMAP_PARSER_APG_IMPL_MSG_ATT_STATIC_RFC822,
             IMAP_PARSER_APG_IMPL_MSG_ATT_STATIC_RFC822_SIZE,
+            IMAP_PARSER_APG_IMPL_MSG_ATT_STATIC_BODY_SECTION,
+            IMAP_PARSER_APG_IMPL_SECTION,
             IMAP_PARSER_APG_IMPL_NUMBER,
             IMAP_PARSER_APG_IMPL_NSTRING,
             IMAP_PARSER_APG_IMPL_STRING,
@@ -1948,7 +2004,7 @@ expected<std::vector<MessageData>> parse_message_data_records(std::string_view i
         },
 
         [&](const ast_record* begin, const ast_record* end) {
-            log_info("l2 parsing almost done , now process AST, time taken so far: {}ms",
+            log_debug("l2 parsing almost done , now process AST, time taken so far: {}ms",
                      (std::chrono::steady_clock::now() - parsing_start_time) / 1ms);
 
             auto it = begin;
@@ -1971,6 +2027,14 @@ expected<std::vector<MessageData>> parse_message_data_records(std::string_view i
     return result;
 }
 
+expected<std::vector<MessageData>> parse_message_data_records(std::string_view input_text) {
+    return parse_message_data_records_impl(IMAP_PARSER_APG_IMPL_RESPONSE, input_text);
+}
+
+expected<std::vector<MessageData>> parse_untagged_message_data(std::string_view response_line) {
+    return parse_message_data_records_impl(IMAP_PARSER_APG_IMPL_RESPONSE_DATA, response_line);
+}
+
 static void write_message_to_screen(GMimeMessage* message) {
     GMimeStream* stream;
 
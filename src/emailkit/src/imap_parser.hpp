@@ -16,6 +16,10 @@ expected<std::vector<mailbox_data_t>> parse_mailbox_data_records(std::string_vie
 
 expected<std::vector<MessageData>> parse_message_data_records(std::string_view input_text);
 
+// Same as parse_message_data_records but for a single untagged response ("* 12 FETCH (...)\r\n"
+// with its literals), as delivered while the rest of the response is still being received.
+expected<std::vector<MessageData>> parse_untagged_message_data(std::string_view response_line);
+
 expected<void> parse_rfc822_message(std::string_view input_text);
 
 ///////////////////////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,610 @@
+#include "imap_parser__sync.hpp"
+#include "imap_parser.hpp"
+#include "utils.hpp"
+
+#include <algorithm>
+#include <charconv>
+#include <utility>
+
+namespace emailkit::imap_parser::sync {
+
+namespace {
+
+std::error_code syntax_error() {
+    return make_error_code(parser_errc::parser_fail_l0);
+}
+
+template <class T>
+std::optional<T> to_number(std::string_view s) {
+    T value{};
+    auto [ptr, ec] = std::from_chars(s.data(), s.data() + s.size(), value);
+    if (ec != std::errc{} || ptr != s.data() + s.size() || s.empty()) {
+        return std::nullopt;
+    }
+    return value;
+}
+
+// Minimal tokenizer for a response: atoms, quoted strings, literals and parenthesized lists.
+class line_reader_t {
+   public:
+    explicit line_reader_t(std::string_view line) : m_rest(line) {}
+
+    bool at_end() const { return m_rest.empty(); }
+
+    bool starts_with(std::string_view prefix) const { return m_rest.starts_with(prefix); }
+
+    bool consume(std::string_view prefix) {
+        if (m_rest.starts_with(prefix)) {
+            m_rest.remove_prefix(prefix.size());
+            return true;
+        }
+        return false;
+    }
+
+    bool consume_space() { return consume(" "); }
+
+    std::string_view atom() {
+        const auto n = std::min(m_rest.find_first_of(" ()"), m_rest.size());
+        auto result = m_rest.substr(0, n);
+        m_rest.remove_prefix(n);
+        return result;
+    }
+
+    // Atom or quoted string with escapes removed.
+    std::optional<std::string> astring() {
+        if (!m_rest.starts_with('"')) {
+            auto a = atom();
+            return a.empty() ? std::nullopt : std::optional<std::string>{a};
+        }
+        std::string value;
+        for (size_t i = 1; i < m_rest.size(); ++i) {
+            if (m_rest[i] == '"') {
+                m_rest.remove_prefix(i + 1);
+                return value;
+            }
+            if (m_rest[i] == '\\' && i + 1 < m_rest.size()) {
+                ++i;
+            }
+            value += m_rest[i];
+        }
+        return std::nullopt;
+    }
+
+    // Contents of parenthesized list, nested lists are included as they are.
+    std::optional<std::string_view> list() {
+        if (!m_rest.starts_with('(')) {
+            return std::nullopt;
+        }
+        int depth = 0;
+        bool in_quotes = false;
+        for (size_t i = 0; i < m_rest.size(); ++i) {
+            if (in_quotes) {
+                if (m_rest[i] == '\\') {
+                    ++i;
+                } else if (m_rest[i] == '"') {
+                    in_quotes = false;
+                }
+            } else if (m_rest[i] == '"') {
+                in_quotes = true;
+            } else if (m_rest[i] == '{') {
+                // Literal data may contain anything, e.g. parentheses of a Gmail label.
+                line_reader_t l{m_rest.substr(i)};
+                if (!l.literal()) {
+                    return std::nullopt;
+                }
+                i = m_rest.size() - l.m_rest.size() - 1;
+            } else if (m_rest[i] == '(') {
+                ++depth;
+            } else if (m_rest[i] == ')' && --depth == 0) {
+                auto result = m_rest.substr(1, i - 1);
+                m_rest.remove_prefix(i + 1);
+                return result;
+            }
+        }
+        return std::nullopt;
+    }
+
+    // "{N}\r\n" or literal8 "~{N}\r\n" followed by N bytes which are returned.
+    std::optional<std::string_view> literal() {
+        auto rest = m_rest;
+        if (rest.starts_with('~')) {
+            rest.remove_prefix(1);
+        }
+        const auto close_pos = rest.find("}\r\n");
+        if (!rest.starts_with('{') || close_pos == std::string_view::npos) {
+            return std::nullopt;
+        }
+        const auto size = to_number<size_t>(rest.substr(1, close_pos - 1));
+        rest.remove_prefix(close_pos + 3);
+        if (!size || rest.size() < *size) {
+            return std::nullopt;
+        }
+        m_rest = rest.substr(*size);
+        return rest.substr(0, *size);
+    }
+
+    // Rest of current line including LF.
+    void skip_line() {
+        const auto lf_pos = m_rest.find('\n');
+        m_rest.remove_prefix(lf_pos == std::string_view::npos ? m_rest.size() : lf_pos + 1);
+    }
+
+    // Value of unknown item: an atom, a quoted string, a literal or a list.
+    bool skip_value() {
+        if (m_rest.starts_with('(')) {
+            return list().has_value();
+        }
+        if (m_rest.starts_with('"')) {
+            return astring().has_value();
+        }
+        if (m_rest.starts_with('{') || m_rest.starts_with("~{")) {
+            return literal().has_value();
+        }
+        return !atom().empty();
+    }
+
+   private:
+    std::string_view m_rest;
+};
+
+// Space separated atoms, quoted strings and literals, e.g. X-GM-LABELS list:
+// \Inbox "My Label" {8}\r\nWork (1). Gmail sends labels with special characters as literals.
+expected<std::vector<std::string>> parse_astring_list(std::string_view s) {
+    std::vector<std::string> result;
+    line_reader_t r{s};
+    while (!r.at_end()) {
+        if (r.consume_space()) {
+            continue;
+        }
+        if (r.starts_with("{")) {
+            auto literal = r.literal();
+            if (!literal) {
+                return unexpected(syntax_error());
+            }
+            result.emplace_back(*literal);
+            continue;
+        }
+        auto value = r.astring();
+        if (!value) {
+            return unexpected(syntax_error());
+        }
+        result.emplace_back(std::move(*value));
+    }
+    return result;
+}
+
+// Size of literal the line (CRLF excluded) ends with, e.g. 9 for "* 1 FETCH (X-GM-LABELS ({9}".
+std::optional<size_t> literal_size_at_end(std::string_view line) {
+    if (!line.ends_with('}')) {
+        return std::nullopt;
+    }
+    const auto open_pos = line.rfind('{');
+    if (open_pos == std::string_view::npos) {
+        return std::nullopt;
+    }
+    return to_number<size_t>(line.substr(open_pos + 1, line.size() - open_pos - 2));
+}
+
+// Takes next response off the buffer, without its CRLF. Response continues on the next line
+// after a literal.
+std::string_view take_response(std::string_view& rest) {
+    size_t line_start = 0;
+    while (true) {
+        const auto lf_pos = rest.find('\n', line_start);
+        if (lf_pos == std::string_view::npos) {
+            return std::exchange(rest, {});
+        }
+        auto line = rest.substr(line_start, lf_pos - line_start);
+        if (line.ends_with('\r')) {
+            line.remove_suffix(1);
+        }
+        const auto literal_size = literal_size_at_end(line);
+        if (!literal_size || *literal_size > rest.size() - lf_pos - 1) {
+            auto response = rest.substr(0, lf_pos);
+            if (response.ends_with('\r')) {
+                response.remove_suffix(1);
+            }
+            rest.remove_prefix(lf_pos + 1);
+            return response;
+        }
+        line_start = lf_pos + 1 + *literal_size;
+    }
+}
+
+struct fetch_attributes_t {
+    flags_change_t change;
+    std::optional<uint64_t> gm_msgid;
+    std::optional<uint64_t> gm_thrid;
+    std::optional<std::vector<std::string>> gm_labels;
+};
+
+// msg-att of FETCH response, e.g. "UID 345 FLAGS (\Seen) MODSEQ (6789)".
+expected<fetch_attributes_t> parse_fetch_attributes(std::string_view attributes) {
+    fetch_attributes_t result;
+    auto& change = result.change;
+    line_reader_t r{attributes};
+    while (!r.at_end()) {
+        const auto name = r.atom();
+        if (name.empty() || !r.consume_space()) {
+            return unexpected(syntax_error());
+        }
+        if (name == "UID") {
+            auto uid = to_number<uint32_t>(r.atom());
+            if (!uid) {
+                return unexpected(syntax_error());
+            }
+            change.uid = *uid;
+        } else if (name == "FLAGS") {
+            auto flags = r.list();
+            if (!flags) {
+                return unexpected(syntax_error());
+            }
+            for (auto flag : emailkit::utils::split_views(*flags, ' ')) {
+                if (!flag.empty()) {
+                    change.flags.emplace_back(flag);
+                }
+            }
+        } else if (name == "MODSEQ") {
+            auto modseq_list = r.list();
+            auto modseq = modseq_list ? to_number<uint64_t>(*modseq_list) : std::nullopt;
+            if (!modseq) {
+                return unexpected(syntax_error());
+            }
+            change.modseq = *modseq;
+        } else if (name == "X-GM-MSGID" || name == "X-GM-THRID") {
+            auto id = to_number<uint64_t>(r.atom());
+            if (!id) {
+                return unexpected(syntax_error());
+            }
+            (name == "X-GM-MSGID" ? result.gm_msgid : result.gm_thrid) = *id;
+        } else if (name == "X-GM-LABELS") {
+            auto labels_list = r.list();
+            if (!labels_list) {
+                return unexpected(syntax_error());
+            }
+            auto labels_or_err = parse_astring_list(*labels_list);
+            if (!labels_or_err) {
+                return unexpected(labels_or_err.error());
+            }
+            result.gm_labels = std::move(*labels_or_err);
+        } else if (!r.skip_value()) {
+            return unexpected(syntax_error());
+        }
+        r.consume_space();
+    }
+    if (change.uid == 0) {
+        log_error("no UID in FETCH response: '{}'", attributes);
+        return unexpected(make_error_code(parser_errc::parser_fail_l1));
+    }
+    return result;
+}
+
+// Rest of "* ESEARCH [(TAG "A1")] [UID] *(SP <return data name> SP <value>)".
+expected<esearch_result_t> parse_esearch(line_reader_t& r) {
+    esearch_result_t result;
+    if (r.starts_with(" (")) {
+        // Search correlator is not needed, responses are matched to commands by tagged line.
+        r.consume_space();
+        if (!r.list()) {
+            return unexpected(syntax_error());
+        }
+    }
+    result.uid = r.consume(" UID");
+    while (r.consume_space()) {
+        const auto name = r.atom();
+        if (name.empty() || !r.consume_space()) {
+            return unexpected(syntax_error());
+        }
+        if (name == "MIN" || name == "MAX" || name == "COUNT") {
+            auto number = to_number<uint32_t>(r.atom());
+            if (!number) {
+                return unexpected(syntax_error());
+            }
+            (name == "MIN" ? result.min : name == "MAX" ? result.max : result.count) = *number;
+        } else if (name == "ALL") {
+            result.all = r.atom();
+            if (result.all.empty()) {
+                return unexpected(syntax_error());
+            }
+        } else if (name == "MODSEQ") {
+            result.modseq = to_number<uint64_t>(r.atom());
+            if (!result.modseq) {
+                return unexpected(syntax_error());
+            }
+        } else if (!r.skip_value()) {
+            return unexpected(syntax_error());
+        }
+    }
+    if (!r.at_end()) {
+        return unexpected(syntax_error());
+    }
+    return result;
+}
+
+}  // namespace
+
+expected<mailbox_status_t> parse_status_response_line(std::string_view line) {
+    if (line.ends_with('\n')) {
+        line.remove_suffix(1);
+    }
+    if (line.ends_with('\r')) {
+        line.remove_suffix(1);
+    }
+    line_reader_t r{line};
+    if (!r.consume("* STATUS ")) {
+        return unexpected(syntax_error());
+    }
+
+    mailbox_status_t result;
+    auto mailbox = r.astring();
+    auto attributes = r.consume_space() ? r.list() : std::nullopt;
+    if (!mailbox || !attributes || !r.at_end()) {
+        log_error("failed parsing STATUS response: '{}'", line);
+        return unexpected(syntax_error());
+    }
+    result.mailbox = std::move(*mailbox);
+
+    line_reader_t a{*attributes};
+    while (!a.at_end()) {
+        const auto name = a.atom();
+        if (name.empty() || !a.consume_space()) {
+            return unexpected(syntax_error());
+        }
+        const auto value = a.atom();
+        std::optional<uint32_t>* item = name == "MESSAGES"      ? &result.messages
+                                        : name == "RECENT"      ? &result.recent
+                                        : name == "UNSEEN"      ? &result.unseen
+                                        : name == "UIDNEXT"     ? &result.uid_next
+                                        : name == "UIDVALIDITY" ? &result.uid_validity
+                                                                : nullptr;
+        if (item) {
+            *item = to_number<uint32_t>(value);
+            if (!*item) {
+                return unexpected(syntax_error());
+            }
+        } else if (name == "HIGHESTMODSEQ") {
+            result.highest_modseq = to_number<uint64_t>(value);
+            if (!result.highest_modseq) {
+                return unexpected(syntax_error());
+            }
+        } else if (value.empty()) {
+            return unexpected(syntax_error());  // unknown items (e.g. SIZE) are skipped
+        }
+        if (!a.at_end() && !a.consume_space()) {
+            return unexpected(syntax_error());
+        }
+    }
+    return result;
+}
+
+expected<std::vector<binary_section_t>> parse_binary_fetch_response(std::string_view response) {
+    std::vector<binary_section_t> result;
+    line_reader_t r{response};
+    while (!r.at_end()) {
+        if (!r.consume("* ")) {
+            r.skip_line();  // tagged line
+            continue;
+        }
+        if (auto number = to_number<uint32_t>(r.atom()); !number || !r.consume(" FETCH (")) {
+            r.skip_line();
+            continue;
+        }
+
+        // BINARY and BINARY.SIZE of the same section come as separate items.
+        uint32_t uid = 0;
+        std::vector<binary_section_t> sections;
+        auto section = [&](std::string_view name) -> binary_section_t& {
+            auto it = std::find_if(sections.begin(), sections.end(),
+                                   [&](const binary_section_t& s) { return s.section == name; });
+            return it != sections.end() ? *it
+                                        : sections.emplace_back(
+                                              binary_section_t{.section = std::string{name}});
+        };
+        while (!r.consume(")")) {
+            const auto name = r.atom();
+            if (name.empty() || !r.consume_space()) {
+                log_error("failed parsing FETCH response with BINARY items");
+                return unexpected(syntax_error());
+            }
+            if (name == "UID") {
+                auto value = to_number<uint32_t>(r.atom());
+                if (!value) {
+                    return unexpected(syntax_error());
+                }
+                uid = *value;
+            } else if (name.starts_with("BINARY.SIZE[") && name.ends_with(']')) {
+                auto& s = section(name.substr(12, name.size() - 13));
+                s.size = to_number<uint32_t>(r.atom());
+                if (!s.size) {
+                    return unexpected(syntax_error());
+                }
+            } else if (name.starts_with("BINARY[")) {
+                // BINARY[1.2] or, for partial fetch, BINARY[1.2]<origin>.
+                const auto close_pos = name.find(']');
+                if (close_pos == std::string_view::npos) {
+                    return unexpected(syntax_error());
+                }
+                auto& s = section(name.substr(7, close_pos - 7));
+                if (auto origin = name.substr(close_pos + 1); !origin.empty()) {
+                    if (origin.size() < 3 || !origin.starts_with('<') || !origin.ends_with('>')) {
+                        return unexpected(syntax_error());
+                    }
+                    s.origin = to_number<uint32_t>(origin.substr(1, origin.size() - 2));
+                    if (!s.origin) {
+                        return unexpected(syntax_error());
+                    }
+                }
+                if (r.starts_with("\"")) {
+                    auto data = r.astring();
+                    if (!data) {
+                        return unexpected(syntax_error());
+                    }
+                    s.data = std::move(*data);
+                } else if (auto data = r.literal()) {
+                    s.data = *data;
+                } else if (!r.consume("NIL")) {
+                    log_error("failed parsing data of {}", name);
+                    return unexpected(syntax_error());
+                }
+            } else if (!r.skip_value()) {
+                log_error("failed parsing {} of FETCH response with BINARY items", name);
+                return unexpected(syntax_error());
+            }
+            r.consume_space();
+        }
+        r.skip_line();
+
+        if (!sections.empty() && uid == 0) {
+            log_error("no UID in FETCH response with BINARY items");
+            return unexpected(make_error_code(parser_errc::parser_fail_l1));
+        }
+        for (auto& s : sections) {
+            s.uid = uid;
+            result.emplace_back(std::move(s));
+        }
+    }
+    return result;
+}
+
+expected<std::vector<uid_range_t>> parse_uid_ranges(std::string_view s) {
+    std::vector<uid_range_t> ranges;
+    for (auto item : emailkit::utils::split_views(s, ',')) {
+        const auto colon_pos = item.find(':');
+        if (colon_pos == std::string_view::npos) {
+            auto uid = to_number<uint32_t>(item);
+            if (!uid) {
+                return unexpected(syntax_error());
+            }
+            ranges.push_back({*uid, *uid});
+            continue;
+        }
+        auto first = to_number<uint32_t>(item.substr(0, colon_pos));
+        auto last = to_number<uint32_t>(item.substr(colon_pos + 1));
+        if (!first || !last) {
+            return unexpected(syntax_error());
+        }
+        ranges.push_back({std::min(*first, *last), std::max(*first, *last)});
+    }
+    return ranges;
+}
+
+expected<std::vector<uint32_t>> parse_uid_set(std::string_view s, size_t max_uids) {
+    auto ranges_or_err = parse_uid_ranges(s);
+    if (!ranges_or_err) {
+        return unexpected(ranges_or_err.error());
+    }
+    uint64_t total = 0;
+    for (auto& r : *ranges_or_err) {
+        total += uint64_t{r.last} - r.first + 1;
+    }
+    if (total > max_uids) {
+        log_error("set of {} UIDs is too big to be expanded", total);
+        return unexpected(syntax_error());
+    }
+
+    std::vector<uint32_t> uids;
+    uids.reserve(total);
+    for (auto& r : *ranges_or_err) {
+        for (uint64_t uid = r.first; uid <= r.last; ++uid) {
+            uids.push_back(static_cast<uint32_t>(uid));
+        }
+    }
+    return uids;
+}
+
+std::string encode_uid_set(const std::vector<uint32_t>& sorted_uids) {
+    std::string result;
+    for (size_t i = 0; i < sorted_uids.size();) {
+        size_t j = i;
+        while (j + 1 < sorted_uids.size() && sorted_uids[j + 1] == sorted_uids[j] + 1) {
+            ++j;
+        }
+        if (!result.empty()) {
+            result += ',';
+        }
+        result += i == j ? fmt::format("{}", sorted_uids[i])
+                         : fmt::format("{}:{}", sorted_uids[i], sorted_uids[j]);
+        i = j + 1;
+    }
+    return result;
+}
+
+expected<sync_response_t> parse_sync_response(std::string_view response) {
+    sync_response_t result;
+
+    for (auto rest = response; !rest.empty();) {
+        const auto line = take_response(rest);
+        line_reader_t r{line};
+        if (!r.consume("* ")) {
+            continue;  // tagged line
+        }
+
+        if (r.consume("VANISHED ")) {
+            r.consume("(EARLIER) ");
+            auto ranges_or_err = parse_uid_ranges(r.atom());
+            if (!ranges_or_err) {
+                log_error("failed parsing VANISHED response: '{}'", line);
+                return unexpected(ranges_or_err.error());
+            }
+            result.vanished.insert(result.vanished.end(), ranges_or_err->begin(),
+                                   ranges_or_err->end());
+        } else if (r.consume("ESEARCH")) {
+            auto esearch_or_err = parse_esearch(r);
+            if (!esearch_or_err) {
+                log_error("failed parsing ESEARCH response: '{}'", line);
+                return unexpected(esearch_or_err.error());
+            }
+            result.esearch = std::move(*esearch_or_err);
+        } else if (r.consume("SEARCH")) {
+            while (r.consume_space()) {
+                if (auto modseq_list = r.list()) {
+                    // (MODSEQ <highest mod-sequence of found messages>)
+                    line_reader_t m{*modseq_list};
+                    if (!m.consume("MODSEQ ")) {
+                        return unexpected(syntax_error());
+                    }
+                    result.search_modseq = to_number<uint64_t>(m.atom());
+                    if (!result.search_modseq) {
+                        return unexpected(syntax_error());
+                    }
+                    continue;
+                }
+                auto id = to_number<uint32_t>(r.atom());
+                if (!id) {
+                    log_error("failed parsing SEARCH response: '{}'", line);
+                    return unexpected(syntax_error());
+                }
+                result.search_results.push_back(*id);
+            }
+        } else if (auto number = to_number<uint32_t>(r.atom()); number && r.consume(" FETCH ")) {
+            auto attributes = r.list();
+            if (!attributes) {
+                log_error("failed parsing FETCH response: '{}'", line);
+                return unexpected(syntax_error());
+            }
+            auto attributes_or_err = parse_fetch_attributes(*attributes);
+            if (!attributes_or_err) {
+                log_error("failed parsing FETCH response: '{}'", line);
+                return unexpected(attributes_or_err.error());
+            }
+            auto& a = *attributes_or_err;
+            if (a.gm_msgid || a.gm_thrid || a.gm_labels) {
+                if (!a.gm_msgid || !a.gm_thrid) {
+                    log_error("incomplete Gmail ids in FETCH response: '{}'", line);
+                    return unexpected(syntax_error());
+                }
+                result.gmail_ids.emplace_back(gmail_ids_t{.uid = a.change.uid,
+                                                          .msgid = *a.gm_msgid,
+                                                          .thrid = *a.gm_thrid,
+                                                          .labels = a.gm_labels.value_or(
+                                                              std::vector<std::string>{})});
+            } else {
+                result.flags_changes.emplace_back(std::move(a.change));
+            }
+        }
+    }
+
+    return result;
+}
+
+}  // namespace emailkit::imap_parser::sync
@@ -0,0 +1,114 @@
+#pragma once
+#include <emailkit/global.hpp>
+
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace emailkit::imap_parser::sync {
+
+// Parsers for responses of mailbox synchronization commands that use CONDSTORE/QRESYNC extensions
+// (https://datatracker.ietf.org/doc/html/rfc7162) and Gmail extensions, and of BINARY fetches. The
+// grammar main parser is generated from does not know about these extensions, and the responses
+// are simple enough (no nested structures except flag lists, literals only in BINARY items) to be
+// parsed by hand.
+
+// Closed range of UIDs, first <= last.
+struct uid_range_t {
+    uint32_t first{};
+    uint32_t last{};
+
+    bool operator==(const uid_range_t&) const = default;
+};
+
+struct flags_change_t {
+    uint32_t uid{};
+    std::vector<std::string> flags;
+    uint64_t modseq{};
+};
+
+// Gmail message and thread ids (https://developers.google.com/gmail/imap/imap-extensions), stable
+// across folders and sessions, and labels of the message if requested.
+struct gmail_ids_t {
+    uint32_t uid{};
+    uint64_t msgid{};                 // X-GM-MSGID
+    uint64_t thrid{};                 // X-GM-THRID
+    std::vector<std::string> labels;  // X-GM-LABELS, e.g. "\\Inbox", "Work/Projects"
+};
+
+// Result of SEARCH with RETURN options (https://datatracker.ietf.org/doc/html/rfc4731), only the
+// requested ones are set. MIN, MAX and ALL are absent when nothing has been found.
+struct esearch_result_t {
+    bool uid = false;  // numbers are UIDs
+    std::optional<uint32_t> min;
+    std::optional<uint32_t> max;
+    std::optional<uint32_t> count;
+    std::string all;  // set of found messages, e.g. "2,10:11" (see parse_uid_set)
+    std::optional<uint64_t> modseq;
+};
+
+// STATUS response (https://datatracker.ietf.org/doc/html/rfc3501#section-7.2.4), also sent for
+// every listed mailbox by LIST with RETURN (STATUS ...)
+// (https://datatracker.ietf.org/doc/html/rfc5819). Only requested items are set.
+struct mailbox_status_t {
+    std::string mailbox;  // as sent by server, e.g. "[Gmail]/All Mail"
+    std::optional<uint32_t> messages;
+    std::optional<uint32_t> recent;
+    std::optional<uint32_t> unseen;
+    std::optional<uint32_t> uid_next;
+    std::optional<uint32_t> uid_validity;
+    std::optional<uint64_t> highest_modseq;  // with CONDSTORE
+
+    bool operator==(const mailbox_status_t&) const = default;
+};
+
+// BINARY[<section>]<<origin>> and BINARY.SIZE[<section>] items of FETCH response
+// (https://datatracker.ietf.org/doc/html/rfc3516) which come for the same section of a message.
+struct binary_section_t {
+    uint32_t uid{};
+    std::string section;             // e.g. "1.2", "" for the whole message
+    std::optional<uint32_t> origin;  // offset of data in decoded section if partial was requested
+    std::string data;                // decoded, empty if literal went to a literal sink
+    std::optional<uint32_t> size;    // BINARY.SIZE, decoded size of the whole section
+};
+
+struct sync_response_t {
+    // "* 12 FETCH (UID 345 FLAGS (\Seen) MODSEQ (6789))"
+    std::vector<flags_change_t> flags_changes;
+    // "* 12 FETCH (UID 345 X-GM-MSGID 1278455344230334865 X-GM-THRID 1266894439832287888
+    //   X-GM-LABELS (\Inbox "My Label"))"
+    std::vector<gmail_ids_t> gmail_ids;
+    // "* VANISHED (EARLIER) 300:310,405", kept as ranges since the server decides how many UIDs
+    // they cover (up to 1:4294967295).
+    std::vector<uid_range_t> vanished;
+    // "* SEARCH 2 84 882 (MODSEQ 917162500)"
+    std::vector<uint32_t> search_results;
+    std::optional<uint64_t> search_modseq;
+    // "* ESEARCH (TAG "A282") UID MIN 2 MAX 20 COUNT 3 ALL 2,10:11"
+    std::optional<esearch_result_t> esearch;
+};
+
+// Parses whole response, responses other than the above are ignored.
+expected<sync_response_t> parse_sync_response(std::string_view response);
+
+// "* STATUS "INBOX" (MESSAGES 17 UNSEEN 3)" with or without CRLF, other lines are rejected.
+// Mailbox name sent as literal is not supported.
+expected<mailbox_status_t> parse_status_response_line(std::string_view line);
+
+// FETCH responses with BINARY items, unlike others here they have data in literals (literal8
+// "~{N}" included). Items other than UID, BINARY and BINARY.SIZE are skipped, so are other
+// responses.
+expected<std::vector<binary_section_t>> parse_binary_fetch_response(std::string_view response);
+
+// "1:3,7,12:10" -> [1, 3], [7, 7], [10, 12] (in order of appearance).
+expected<std::vector<uid_range_t>> parse_uid_ranges(std::string_view s);
+
+// "1:3,7,12:10" -> 1, 2, 3, 7, 10, 11, 12 (in order of appearance). Sets of more than max_uids
+// UIDs are rejected as syntax error rather than expanded.
+expected<std::vector<uint32_t>> parse_uid_set(std::string_view s, size_t max_uids = 1 << 20);
+
+// Sorted UIDs are encoded as ranges: 1, 2, 3, 7 -> "1:3,7".
+std::string encode_uid_set(const std::vector<uint32_t>& sorted_uids);
+
+}  // namespace emailkit::imap_parser::sync
@@ -41,6 +41,11 @@ struct recent_mailbox_data_t {
 struct read_write_resp_text_code_t {};
 struct read_only_resp_text_code_t {};
 struct try_create_resp_text_code_t {};
+// CONDSTORE, https://datatracker.ietf.org/doc/html/rfc7162#section-3.1.2.1
+struct highest_modseq_resp_text_code_t {
+    uint64_t value{};
+};
+struct no_modseq_resp_text_code_t {};
 
 using mailbox_data_t = std::variant<flags_mailbox_data_t,
                                     permanent_flags_mailbox_data_t,
@@ -51,7 +56,9 @@ using mailbox_data_t = std::variant<flags_mailbox_data_t,
                                     uidnext_resp_text_code_t,
                                     read_write_resp_text_code_t,
                                     read_only_resp_text_code_t,
-                                    try_create_resp_text_code_t>;
+                                    try_create_resp_text_code_t,
+                                    highest_modseq_resp_text_code_t,
+                                    no_modseq_resp_text_code_t>;
 
 ///////////////////////////////////////////////////////////////////////////////////////////////
 // message-data
@@ -187,7 +194,12 @@ struct BodyTypeMPart {
 
 }  // namespace wip
 
-struct MsgAttrBodySection {};
+// BODY[<section>]<<origin>> (https://datatracker.ietf.org/doc/html/rfc3501#section-7.4.2)
+struct MsgAttrBodySection {
+    std::string section;           // e.g. "1.2", "HEADER", "" for the whole message
+    std::optional<uint32_t> origin;  // offset of data in the section if partial was requested
+    std::string data;
+};
 struct MsgAttrRFC822 {
     std::string msg_data;
 };
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <emailkit/global.hpp>
+#include <memory>
+#include <string>
+#include <string_view>
+
+namespace emailkit {
+
+// Handle to bytes of a server response exactly as they were received from the socket. Handle
+// shares ownership of the receive buffer the bytes were read into so that neither socket nor
+// client need to copy the response (which can be multi-megabyte for FETCH with RFC822 literals) to
+// pass it around. Copying the handle is cheap, parsers are supposed to work on view().
+class imap_response_buffer_t {
+   public:
+    imap_response_buffer_t() = default;
+
+    imap_response_buffer_t(std::shared_ptr<const std::string> storage, std::string_view view)
+        : m_storage(std::move(storage)), m_view(view) {}
+
+    // Takes ownership of the string without copying it.
+    static imap_response_buffer_t from_string(std::string s) {
+        auto storage = std::make_shared<const std::string>(std::move(s));
+        std::string_view view = *storage;
+        return imap_response_buffer_t{std::move(storage), view};
+    }
+
+    std::string_view view() const { return m_view; }
+    const char* data() const { return m_view.data(); }
+    size_t size() const { return m_view.size(); }
+    bool empty() const { return m_view.empty(); }
+
+    // Returns a handle to part of the response, sharing the same storage.
+    imap_response_buffer_t subbuffer(size_t offset, size_t count = std::string_view::npos) const {
+        return imap_response_buffer_t{m_storage, m_view.substr(offset, count)};
+    }
+
+    // Explicit copy, for cases where caller needs to own the text (e.g. writing failed responses
+    // for further analysis).
+    std::string to_string() const { return std::string{m_view}; }
+
+   private:
+    std::shared_ptr<const std::string> m_storage;
+    std::string_view m_view;
+};
+
+}  // namespace emailkit
@@ -0,0 +1,219 @@
+#pragma once
+
+#include <emailkit/global.hpp>
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <string>
+#include <string_view>
+
+namespace emailkit {
+
+// Finds where tagged IMAP response ends in a stream of bytes that arrive in chunks.
+//
+// The framer works line by line: it looks only for LF (with memchr) and, at the beginning of each
+// line, for the tag. Whenever a line ends with literal size ({N}\r\n or ~{N}\r\n for literal8),
+// the next N bytes are skipped as a whole without looking into them, so a tag-looking text inside
+// of a literal does not terminate the response and large literals cost nothing except for
+// progress reporting that happens once per chunk. Thus framing cost is proportional to number of
+// lines (protocol tokens) and not to payload size.
+//
+// Chunks are expected to be consecutive and not overlapping which is how asio calls
+// match conditions.
+//
+// With empty tag the framer stops at a tagged line of any command, that is any line which is not
+// untagged ("* ") or continuation request ("+ "). This is how responses of pipelined commands are
+// read: whichever command completes first.
+class imap_response_framer_t {
+   public:
+    explicit imap_response_framer_t(std::string_view tag)
+        : m_tag_prefix(fmt::format("{} ", tag)), m_any_tag(tag.empty()) {}
+
+    // Returns number of bytes of the chunk which complete the response, or nullopt if the response
+    // needs more data.
+    std::optional<size_t> feed(const char* begin, const char* end) {
+        auto r = scan(begin, end, NO_LITERAL_STOP);
+        if (r.status == scan_status_t::response_complete) {
+            return r.consumed;
+        }
+        return std::nullopt;
+    }
+
+    enum class scan_status_t {
+        need_more,          // all bytes consumed, response is not complete yet
+        response_complete,  // response ends after consumed bytes
+        literal_begins,     // literal of at least stop_at_literal_size begins after consumed bytes
+        untagged_response_complete,  // untagged response (with its literals) ends after consumed
+    };
+    struct scan_result_t {
+        size_t consumed = 0;
+        scan_status_t status = scan_status_t::need_more;
+        size_t literal_size = 0;  // for literal_begins
+    };
+    static constexpr size_t NO_LITERAL_STOP = std::numeric_limits<size_t>::max();
+
+    // Same as feed() but additionally stops right before data of literals which are at least
+    // stop_at_literal_size long so that caller can handle them in a special way. Literal is still
+    // considered started, so its bytes must be fed (skipped) as usual when caller is done with
+    // them. With stop_at_untagged_responses it also stops after each complete untagged response so
+    // that caller can take it out while the rest of the response is still being received.
+    scan_result_t scan(const char* begin,
+                       const char* end,
+                       size_t stop_at_literal_size,
+                       bool stop_at_untagged_responses = false) {
+        const char* p = begin;
+        while (p != end) {
+            if (m_literal_bytes_left > 0) {
+                const size_t n = std::min(m_literal_bytes_left, static_cast<size_t>(end - p));
+                p += n;
+                m_literal_bytes_left -= n;
+                report_literal_progress();
+                continue;
+            }
+
+            if (m_matching_tag && m_any_tag) {
+                m_matching_tag = false;
+                m_tagged_line = *p != '*' && *p != '+' && *p != '\r' && *p != '\n';
+                continue;
+            }
+
+            if (m_matching_tag) {
+                while (p != end && m_tag_chars_matched < m_tag_prefix.size()) {
+                    if (*p != m_tag_prefix[m_tag_chars_matched]) {
+                        m_matching_tag = false;
+                        break;
+                    }
+                    push_tail(p, p + 1);
+                    ++p;
+                    ++m_tag_chars_matched;
+                }
+                if (m_tag_chars_matched == m_tag_prefix.size()) {
+                    m_matching_tag = false;
+                    m_tagged_line = true;
+                }
+                continue;
+            }
+
+            const char* lf = static_cast<const char*>(std::memchr(p, '\n', end - p));
+            if (!lf) {
+                push_tail(p, end);
+                p = end;
+                break;
+            }
+
+            push_tail(p, lf);
+            p = lf + 1;
+
+            if (m_tagged_line) {
+                log_debug("finished reading response");
+                reset_line_state();
+                return {static_cast<size_t>(p - begin), scan_status_t::response_complete};
+            }
+
+            if (auto literal_size = literal_size_at_tail()) {
+                m_literal_size = *literal_size;
+                m_literal_bytes_left = *literal_size;
+                m_prev_progress = 0.0;
+                log_debug("reading literal of size {}Kb", m_literal_size / 1024);
+                // The line continues after literal data so it cannot start with the tag.
+                m_tail.clear();
+                m_matching_tag = false;
+                m_tag_chars_matched = 0;
+                if (m_literal_size >= stop_at_literal_size) {
+                    return {static_cast<size_t>(p - begin), scan_status_t::literal_begins,
+                            m_literal_size};
+                }
+            } else {
+                reset_line_state();
+                if (stop_at_untagged_responses) {
+                    return {static_cast<size_t>(p - begin),
+                            scan_status_t::untagged_response_complete};
+                }
+            }
+        }
+
+        return {static_cast<size_t>(p - begin), scan_status_t::need_more};
+    }
+
+    size_t literal_bytes_left() const { return m_literal_bytes_left; }
+
+   private:
+    // Longest line ending we need to remember to recognize literal size: '{' + 20 digits of
+    // size_t + "}\r".
+    static constexpr size_t MAX_TAIL_SIZE = 24;
+
+    void reset_line_state() {
+        m_tail.clear();
+        m_matching_tag = true;
+        m_tag_chars_matched = 0;
+        m_tagged_line = false;
+    }
+
+    void push_tail(const char* begin, const char* end) {
+        const size_t n = end - begin;
+        if (n >= MAX_TAIL_SIZE) {
+            m_tail.assign(end - MAX_TAIL_SIZE, end);
+        } else {
+            m_tail.append(begin, end);
+            if (m_tail.size() > MAX_TAIL_SIZE) {
+                m_tail.erase(0, m_tail.size() - MAX_TAIL_SIZE);
+            }
+        }
+    }
+
+    // Checks if current line (LF excluded) ends with "{<digits>}\r".
+    std::optional<size_t> literal_size_at_tail() const {
+        std::string_view t = m_tail;
+        if (t.size() < 4 || t[t.size() - 1] != '\r' || t[t.size() - 2] != '}') {
+            return std::nullopt;
+        }
+        t.remove_suffix(2);
+        const auto open_pos = t.rfind('{');
+        if (open_pos == std::string_view::npos || open_pos + 1 == t.size()) {
+            return std::nullopt;
+        }
+        // Size which does not fit size_t is not a literal, wrapped around it would desynchronize
+        // framing from the stream.
+        const auto digits = t.substr(open_pos + 1);
+        size_t value = 0;
+        auto [ptr, ec] = std::from_chars(digits.data(), digits.data() + digits.size(), value);
+        if (ec != std::errc{} || ptr != digits.data() + digits.size()) {
+            return std::nullopt;
+        }
+        return value;
+    }
+
+    void report_literal_progress() {
+        const double progress =
+            m_literal_size > 0
+                ? (static_cast<double>(m_literal_size - m_literal_bytes_left) / m_literal_size) *
+                      100.0
+                : 100.0;
+        if ((progress - m_prev_progress) >= 5.0 || m_literal_bytes_left == 0) {
+            log_debug("progress: {}%", std::round(progress));
+            m_prev_progress = progress;
+        }
+    }
+
+    const std::string m_tag_prefix;
+    const bool m_any_tag;
+    std::string m_tail;  // last bytes of current line, up to MAX_TAIL_SIZE
+    bool m_matching_tag = true;
+    size_t m_tag_chars_matched = 0;
+    bool m_tagged_line = false;
+    size_t m_literal_size = 0;
+    size_t m_literal_bytes_left = 0;
+    double m_prev_progress{};  // previously reported progress
+};
+
+// Tag of complete response, which is the first token of its last (tagged) line.
+inline std::string_view imap_response_tag(std::string_view response) {
+    const auto lf_pos =
+        response.size() < 2 ? std::string_view::npos : response.rfind('\n', response.size() - 2);
+    const auto line = lf_pos == std::string_view::npos ? response : response.substr(lf_pos + 1);
+    return line.substr(0, std::min(line.find_first_of(" \r\n"), line.size()));
+}
+
+}  // namespace emailkit
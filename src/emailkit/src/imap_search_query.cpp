@@ -0,0 +1,245 @@
+#include "imap_search_query.hpp"
+
+#include <algorithm>
+#include <array>
+#include <charconv>
+
+namespace emailkit::imap_client {
+
+namespace {
+
+constexpr std::array<std::string_view, 12> MONTHS = {"Jan", "Feb", "Mar", "Apr", "May", "Jun",
+                                                     "Jul", "Aug", "Sep", "Oct", "Nov", "Dec"};
+
+// LITERAL- allows non-synchronizing literals up to this size
+// (https://datatracker.ietf.org/doc/html/rfc7888#section-5).
+constexpr size_t LITERAL_MINUS_MAX_SIZE = 4096;
+
+// atom-char: any CHAR except atom-specials (RFC 3501, section 9).
+bool is_atom(std::string_view s) {
+    constexpr std::string_view ATOM_SPECIALS = "(){%*\"\\]";
+    return !s.empty() && std::ranges::all_of(s, [&](char c) {
+        const auto u = static_cast<unsigned char>(c);
+        return u > 0x20 && u < 0x7f && ATOM_SPECIALS.find(c) == std::string_view::npos;
+    });
+}
+
+// Field name of RFC 5322 which can be sent as atom.
+bool is_header_name(std::string_view s) {
+    return is_atom(s) && s.find(':') == std::string_view::npos;
+}
+
+// seq-number = nz-number / "*"
+bool is_seq_number(std::string_view s) {
+    if (s == "*") {
+        return true;
+    }
+    uint32_t n = 0;
+    auto [end, ec] = std::from_chars(s.data(), s.data() + s.size(), n);
+    return ec == std::errc{} && end == s.data() + s.size() && s.front() != '0';
+}
+
+// sequence-set = (seq-number / seq-range) ["," sequence-set], seq-range = seq-number ":" seq-number
+bool is_sequence_set(std::string_view s) {
+    for (size_t start = 0;;) {
+        const auto comma = s.find(',', start);
+        const auto part = s.substr(start, comma - start);
+        const auto colon = part.find(':');
+        const auto first = part.substr(0, colon);
+        const auto last = colon == std::string_view::npos ? first : part.substr(colon + 1);
+        if (!is_seq_number(first) || !is_seq_number(last)) {
+            return false;
+        }
+        if (comma == std::string_view::npos) {
+            return true;
+        }
+        start = comma + 1;
+    }
+}
+
+// date = date-day "-" date-month "-" date-year, e.g. "1-Feb-1994".
+std::string encode_date(search_query_t::date_t d) {
+    return fmt::format("{}-{}-{}", static_cast<unsigned>(d.day()),
+                       MONTHS[static_cast<unsigned>(d.month()) - 1], static_cast<int>(d.year()));
+}
+
+}  // namespace
+
+search_query_t& search_query_t::all() {
+    return add_key("ALL");
+}
+search_query_t& search_query_t::seen() {
+    return add_key("SEEN");
+}
+search_query_t& search_query_t::unseen() {
+    return add_key("UNSEEN");
+}
+search_query_t& search_query_t::flagged() {
+    return add_key("FLAGGED");
+}
+search_query_t& search_query_t::unflagged() {
+    return add_key("UNFLAGGED");
+}
+search_query_t& search_query_t::answered() {
+    return add_key("ANSWERED");
+}
+search_query_t& search_query_t::unanswered() {
+    return add_key("UNANSWERED");
+}
+search_query_t& search_query_t::deleted() {
+    return add_key("DELETED");
+}
+search_query_t& search_query_t::draft() {
+    return add_key("DRAFT");
+}
+search_query_t& search_query_t::keyword(std::string flag) {
+    if (!is_atom(flag)) {
+        m_invalid = true;
+        return *this;
+    }
+    return add_key(fmt::format("KEYWORD {}", flag));
+}
+
+search_query_t& search_query_t::from(std::string s) {
+    return add_string_key("FROM", s);
+}
+search_query_t& search_query_t::to(std::string s) {
+    return add_string_key("TO", s);
+}
+search_query_t& search_query_t::cc(std::string s) {
+    return add_string_key("CC", s);
+}
+search_query_t& search_query_t::subject(std::string s) {
+    return add_string_key("SUBJECT", s);
+}
+search_query_t& search_query_t::body(std::string s) {
+    return add_string_key("BODY", s);
+}
+search_query_t& search_query_t::text(std::string s) {
+    return add_string_key("TEXT", s);
+}
+search_query_t& search_query_t::header(std::string field_name, std::string s) {
+    if (!is_header_name(field_name)) {
+        m_invalid = true;
+        return *this;
+    }
+    return add_string_key(fmt::format("HEADER {}", field_name), s);
+}
+
+search_query_t& search_query_t::since(date_t d) {
+    return add_date_key("SINCE", d);
+}
+search_query_t& search_query_t::before(date_t d) {
+    return add_date_key("BEFORE", d);
+}
+search_query_t& search_query_t::on(date_t d) {
+    return add_date_key("ON", d);
+}
+search_query_t& search_query_t::sent_since(date_t d) {
+    return add_date_key("SENTSINCE", d);
+}
+search_query_t& search_query_t::sent_before(date_t d) {
+    return add_date_key("SENTBEFORE", d);
+}
+
+search_query_t& search_query_t::larger(uint32_t size) {
+    return add_key(fmt::format("LARGER {}", size));
+}
+search_query_t& search_query_t::smaller(uint32_t size) {
+    return add_key(fmt::format("SMALLER {}", size));
+}
+
+search_query_t& search_query_t::uid(std::string uid_set) {
+    if (!is_sequence_set(uid_set)) {
+        m_invalid = true;
+        return *this;
+    }
+    return add_key(fmt::format("UID {}", uid_set));
+}
+search_query_t& search_query_t::changed_since(uint64_t modseq) {
+    return add_key(fmt::format("MODSEQ {}", modseq));
+}
+
+search_query_t& search_query_t::not_(const search_query_t& q) {
+    merge_flags(q);
+    return add_key(fmt::format("NOT {}", q.as_key()));
+}
+
+search_query_t& search_query_t::or_(const search_query_t& a, const search_query_t& b) {
+    merge_flags(a);
+    merge_flags(b);
+    return add_key(fmt::format("OR {} {}", a.as_key(), b.as_key()));
+}
+
+search_query_t& search_query_t::gmail_raw(std::string s) {
+    m_gmail_extensions = true;
+    return add_string_key("X-GM-RAW", s);
+}
+
+expected<std::string> search_query_t::encode(const imap_capabilities_t& capabilities) const {
+    if (m_invalid) {
+        return unexpected(make_error_code(std::errc::invalid_argument));
+    }
+    if (m_largest_literal > 0 && !capabilities.has(imap_capability_t::literal_plus) &&
+        !(capabilities.has(imap_capability_t::literal_minus) &&
+          m_largest_literal <= LITERAL_MINUS_MAX_SIZE)) {
+        return unexpected(make_error_code(std::errc::operation_not_supported));
+    }
+    const auto criteria =
+        m_keys.empty() ? std::string{"ALL"} : fmt::format("{}", fmt::join(m_keys, " "));
+    return m_utf8 ? fmt::format("CHARSET UTF-8 {}", criteria) : criteria;
+}
+
+search_query_t& search_query_t::add_key(std::string key) {
+    m_keys.emplace_back(std::move(key));
+    return *this;
+}
+
+search_query_t& search_query_t::add_string_key(std::string_view key, std::string_view s) {
+    if (s.find_first_of("\r\n") != std::string_view::npos) {
+        m_invalid = true;
+        return *this;
+    }
+    if (std::ranges::any_of(s, [](char c) { return static_cast<unsigned char>(c) >= 0x80; })) {
+        m_utf8 = true;
+        m_largest_literal = std::max(m_largest_literal, s.size());
+        return add_key(fmt::format("{} {{{}+}}\r\n{}", key, s.size(), s));
+    }
+
+    std::string quoted = "\"";
+    for (char c : s) {
+        if (c == '"' || c == '\\') {
+            quoted += '\\';
+        }
+        quoted += c;
+    }
+    quoted += '"';
+    return add_key(fmt::format("{} {}", key, quoted));
+}
+
+search_query_t& search_query_t::add_date_key(std::string_view key, date_t d) {
+    if (!d.ok()) {
+        m_invalid = true;
+        return *this;
+    }
+    return add_key(fmt::format("{} {}", key, encode_date(d)));
+}
+
+std::string search_query_t::as_key() const {
+    if (m_keys.empty()) {
+        return "ALL";
+    }
+    if (m_keys.size() == 1) {
+        return m_keys.front();
+    }
+    return fmt::format("({})", fmt::join(m_keys, " "));
+}
+
+void search_query_t::merge_flags(const search_query_t& q) {
+    m_utf8 |= q.m_utf8;
+    m_largest_literal = std::max(m_largest_literal, q.m_largest_literal);
+    m_gmail_extensions |= q.m_gmail_extensions;
+    m_invalid |= q.m_invalid;
+}
+
+}  // namespace emailkit::imap_client
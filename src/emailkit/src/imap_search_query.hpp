@@ -0,0 +1,89 @@
+#pragma once
+#include <emailkit/global.hpp>
+#include <emailkit/imap_capabilities.hpp>
+#include <chrono>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace emailkit::imap_client {
+
+// Typed criteria of SEARCH command (https://datatracker.ietf.org/doc/html/rfc3501#section-6.4.4),
+// keys added one after another must all match:
+//
+//     search_query_t{}.unseen().from("alan.kay@example.com").since(2024y / 3 / 1)
+//
+// Strings are sent as quoted strings. Quoted strings are 7-bit, so a string which is not ASCII is
+// sent as literal and the query gets CHARSET UTF-8. Commands are sent in one go, so literals are
+// non-synchronizing ones which need LITERAL+ (or LITERAL- for up to 4096 bytes). Strings with CR
+// or LF, keywords which are not atoms, invalid header names and UID sets make the query invalid.
+class search_query_t {
+   public:
+    using date_t = std::chrono::year_month_day;
+
+    search_query_t& all();
+    search_query_t& seen();
+    search_query_t& unseen();
+    search_query_t& flagged();
+    search_query_t& unflagged();
+    search_query_t& answered();
+    search_query_t& unanswered();
+    search_query_t& deleted();
+    search_query_t& draft();
+    search_query_t& keyword(std::string flag);
+
+    search_query_t& from(std::string s);
+    search_query_t& to(std::string s);
+    search_query_t& cc(std::string s);
+    search_query_t& subject(std::string s);
+    search_query_t& body(std::string s);
+    search_query_t& text(std::string s);
+    search_query_t& header(std::string field_name, std::string s);
+
+    // Internal date of message (when it was received), ignoring time and timezone.
+    search_query_t& since(date_t d);
+    search_query_t& before(date_t d);
+    search_query_t& on(date_t d);
+    // Date: header of message.
+    search_query_t& sent_since(date_t d);
+    search_query_t& sent_before(date_t d);
+
+    search_query_t& larger(uint32_t size);
+    search_query_t& smaller(uint32_t size);
+
+    // UIDs in uid set format, e.g. "1000:*".
+    search_query_t& uid(std::string uid_set);
+    // Messages changed since mod-sequence, needs CONDSTORE.
+    search_query_t& changed_since(uint64_t modseq);
+
+    search_query_t& not_(const search_query_t& q);
+    search_query_t& or_(const search_query_t& a, const search_query_t& b);
+
+    // X-GM-RAW: Gmail search syntax, e.g. "has:attachment in:unread", needs X-GM-EXT-1
+    // (https://developers.google.com/gmail/imap/imap-extensions).
+    search_query_t& gmail_raw(std::string s);
+
+    bool empty() const { return m_keys.empty(); }
+    bool uses_gmail_extensions() const { return m_gmail_extensions; }
+
+    // Criteria part of SEARCH command, "ALL" for empty query. Fails with invalid_argument if the
+    // query is invalid and with operation_not_supported if it has literals which capabilities of
+    // the server do not allow.
+    expected<std::string> encode(const imap_capabilities_t& capabilities = {}) const;
+
+   private:
+    search_query_t& add_key(std::string key);
+    search_query_t& add_string_key(std::string_view key, std::string_view s);
+    search_query_t& add_date_key(std::string_view key, date_t d);
+    // Keys of nested query as one search key.
+    std::string as_key() const;
+    void merge_flags(const search_query_t& q);
+
+    std::vector<std::string> m_keys;
+    bool m_utf8 = false;
+    size_t m_largest_literal = 0;  // 0 if there are no literals
+    bool m_gmail_extensions = false;
+    bool m_invalid = false;
+};
+
+}  // namespace emailkit::imap_client
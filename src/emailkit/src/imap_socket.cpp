@@ -1,15 +1,21 @@
 #include "imap_socket.hpp"
 
+#include <asio/buffer.hpp>
 #include <asio/connect.hpp>
 #include <asio/ip/tcp.hpp>
 #include <asio/read_until.hpp>
 #include <asio/ssl.hpp>
-#include <asio/streambuf.hpp>
+#include <asio/steady_timer.hpp>
 #include <asio/write.hpp>
-#include <fstream>
 #include <regex>
 #include <system_error>
 
+#include "compressing_stream.hpp"
+#include "imap_response_framer.hpp"
+#include "protocol_capture.hpp"
+#include "tcp_connector.hpp"
+#include "timer_wheel.hpp"
+#include "tls_session_cache.hpp"
 #include "utils.hpp"
 
 #define RAISE_CB_ON_ERROR(ec)                     \
@@ -25,144 +31,32 @@ template <class... T>
 struct spell_type;
 
 namespace emailkit {
-using iterator_t = asio::buffers_iterator<asio::const_buffers_1>;
-struct imap_match_condition_t {
-    explicit imap_match_condition_t(std::string tag)
-        : m_tag(tag), m_pattern_prefix{fmt::format("{} ", m_tag)} {}
+using recv_buffer_t = decltype(asio::dynamic_buffer(std::declval<std::string&>()));
+using iterator_t = asio::buffers_iterator<recv_buffer_t::const_buffers_type>;
 
-    enum class state_t { idle, reading_size, waiting_cr, waiting_lf, reading_data, got_tag };
+// Adapts imap_response_framer_t to asio match condition interface. Receive buffer is a
+// std::string so buffers are contiguous and framer can work on raw pointers.
+struct imap_match_condition_t {
+    explicit imap_match_condition_t(std::string tag) : m_framer(tag) {}
 
     std::pair<iterator_t, bool> operator()(iterator_t begin, iterator_t end) {
         if (std::exchange(m_first_byte, false)) {
             log_debug("started reading response");
         }
-
-        // FIXME:
-        // we are looking for a pattern according to grammar. hoping there cannot be sequence like
-        // that (but we need to check to create nstring/string somewhere which looks like this). in
-        // general this is going to be flawed until we have real streaming parsing when we read and
-        // parse on the fly.
-
-        iterator_t it = begin;
-        for (; it != end; ++it) {
-            if (m_state == state_t::reading_data) {
-                const auto progress =
-                    m_literal_size > 0
-                        ? ((static_cast<double>(m_literal_size - m_literal_data_bytes_left) /
-                            m_literal_size) *
-                           100.0)
-                        : 100.0;
-                if ((progress - m_prev_progress) >= 5.0 || static_cast<int>(progress) == 100) {
-                    log_debug("progress: {}%", std::round(progress));
-                    m_prev_progress = progress;
-                }
-            }
-
-            if (m_state == state_t::got_tag) {
-                log_debug("in state got tag, char is: {} ({})", (int)*it,
-                          isprint(*it) ? ((char)*it) : '?');
-                // TODO: should we somehow recover from this?
-                // we can validate this tag better, strictly accordint the grammar!
-                if (m_prev == 0x0d && *it == 0x0a) {
-                    log_debug("finished reading response");
-                    return {it + 1, true};
-                }
-                // m_prev = *it;
-            } else if (m_state == state_t::idle) {
-                // this is main part of the matcher:
-                //  in the stream we try to find either literal size '{'
-                // or \r\nTAG or if it is beginning of the line, "TAG "
-                if (*it == '{') {
-                    m_state = state_t::reading_size;
-                    m_literal_size_s = "";
-                } else if (m_prev == 0x0d && *it == 0x0a) {
-                    m_line_size = 0;
-                } else {
-                    // TODO: it seems like we can make things safer by expecting that TAG is either
-                    // goes at tge beginning ro it is after \r\n but not somewhere in the line.
-                    if (*it == m_pattern_prefix[m_next_expected_prefix_char_idx] &&
-                        m_next_expected_prefix_char_idx == m_line_size) {
-                        log_debug("matched {}", (int)*it);
-                        m_next_expected_prefix_char_idx++;
-                        if (m_next_expected_prefix_char_idx == m_pattern_prefix.size()) {
-                            // TODO: double check that after that we have OK|NO\BAD. this can also
-                            // be done in NFA fashion.
-                            log_debug("matched all characters of prefix");
-                            m_state = state_t::got_tag;
-                            // return {it, true};
-                        }
-                    }
-                    m_line_size++;
-                    // maintain a window of last N characters and compare it with a pattern
-                    // "\r\n{TAG} (OK|NO|BAD).*)" once we found it,
-                }
-            } else if (m_state == state_t::reading_size) {
-                if (*it == '}') {
-                    m_state = state_t::waiting_cr;
-                } else {
-                    if (isdigit(*it)) {
-                        m_literal_size_s += *it;
-                    } else {
-                        // TODO: error!
-                    }
-                }
-            } else if (m_state == state_t::waiting_cr) {
-                if (*it == 0x0d) {
-                    m_state = state_t::waiting_lf;
-                } else {
-                    // error, go to idle.
-                    m_state = state_t::idle;
-                    m_next_expected_prefix_char_idx = 0;
-                }
-            } else if (m_state == state_t::waiting_lf) {
-                if (*it == 0x0a) {
-                    m_state = state_t::reading_data;
-                    m_prev_progress = 0.0;
-                    m_literal_size = std::stoi(m_literal_size_s);
-                    m_literal_data_bytes_left = m_literal_size;
-                    log_debug("reading literal of size {}Kb", m_literal_size / 1024);
-                    log_debug("progress: 0%");
-                    log_debug("reading literal data of size (size={})", m_literal_size);
-                    if (m_literal_data_bytes_left > 0) {
-                    } else {
-                        log_debug("literal size == 0 case, going to idle state");
-                        m_state = state_t::idle;
-                        m_next_expected_prefix_char_idx = 0;
-                    }
-                } else {
-                    // error, go to idle.
-                    m_state = state_t::idle;
-                    m_next_expected_prefix_char_idx = 0;
-                }
-            } else if (m_state == state_t::reading_data) {
-                if (m_literal_data_bytes_left-- == 0) {
-                    log_debug("read last byte of literal, going to idle state");
-                    m_state = state_t::idle;
-                    m_next_expected_prefix_char_idx = 0;
-                }
-            }
-
-            m_prev = *it;
+        if (begin == end) {
+            return {end, false};
         }
 
-        log_debug("added for match -- END");
+        const char* data = &*begin;
+        if (auto consumed = m_framer.feed(data, data + (end - begin))) {
+            return {begin + *consumed, true};
+        }
         return {end, false};
     }
 
-    std::string m_tag;
-    size_t m_literal_data_bytes_left = 0;
-    state_t m_state = state_t::idle;
-    std::string m_literal_size_s;
-    size_t m_literal_size = 0;
-    size_t m_next_expected_prefix_char_idx = 0;
-    const std::string m_pattern_prefix;
-    unsigned char m_prev = 255;
+    imap_response_framer_t m_framer;
     bool m_first_byte = true;
-    bool m_new_line = true;  // is true whenever we are in indle state and iterator it points to the
-                             // first character of the line.
-    size_t m_line_size = 0;
-    double m_prev_progress{};  // previously reported progress
-};                             // namespace emailkit
+};
 }  // namespace emailkit
 
 namespace asio {
@@ -191,115 +85,125 @@ class match_char {
     char c_;
 };
 
-class imap_client_impl_t : public imap_socket_t, std::enable_shared_from_this<imap_client_impl_t> {
+class imap_client_impl_t : public imap_socket_t,
+                           public std::enable_shared_from_this<imap_client_impl_t> {
    public:
     explicit imap_client_impl_t(asio::io_context& ctx)
-        : m_ctx(ctx), m_ssl_ctx(asio::ssl::context::sslv23), m_socket(m_ctx, m_ssl_ctx) {}
+        : m_ctx(ctx),
+          m_ssl_ctx(tls_session_cache_t::instance().client_context()),
+          m_socket(m_ctx, *m_ssl_ctx),
+          m_stream(m_socket),
+          m_connection_id(protocol_capture_t::next_connection_id()),
+          m_health_timer(m_ctx) {
+        m_stream.set_transfer_observer([this](size_t bytes_received, size_t bytes_sent) {
+            const auto now = std::chrono::steady_clock::now();
+            if (bytes_received > 0) {
+                m_health.on_bytes_received(bytes_received, now);
+            }
+            if (bytes_sent > 0) {
+                m_health.on_bytes_sent(bytes_sent, now);
+            }
+            check_link_grade(now);
+        });
+    }
 
     virtual void async_connect(std::string host,
                                std::string port,
+                               call_opts_t opts,
                                async_callback<void> cb) override {
         log_debug("async_connect is working ..");
 
-        // TODO: async?
-        asio::ip::tcp::resolver resolver{m_ctx};
-        asio::ip::tcp::resolver::query query{host, port};
-
-        std::error_code ec;
-        auto endpoints = resolver.resolve(query, ec);
-        if (ec) {
-            log_error("resolve failed: {}", ec.message());
-            cb(ec);
-            return;
-        }
-
-        log_debug("addresses:");
-        for (auto x : endpoints) {
-            log_debug("ip address: {}", x.endpoint().address().to_string());
-        }
-
-        asio::async_connect(m_socket.lowest_layer(), std::move(endpoints),
-                            [cb = std::move(cb), this](std::error_code ec,
-                                                       const asio::ip::tcp::endpoint& e) mutable {
-                                if (ec) {
-                                    log_error("async_connect failed: {}", ec.message());
-                                    cb(ec);
-                                    return;
-                                }
-
-                                log_debug("connected: {}:{} (proto: {}), doing handhshake",
-                                          e.address().to_string(), e.port(), e.protocol().family());
-                                m_socket.async_handshake(
-                                    asio::ssl::stream_base::client,
-                                    [this, cb = std::move(cb)](std::error_code ec) mutable {
-                                        if (ec) {
-                                            log_error("async_handhshake failed: {}", ec.message());
-                                            cb(ec);
-                                            return;
-                                        }
-                                        log_debug("handshake done");
-
-                                        m_connected = true;
-                                        cb({});
-                                    });
-                            });
-    }
+        reset_session();
+        cb = guard_call(opts, std::move(cb));
+        m_connection_stats = {};
+        m_tls_session_key = fmt::format("{}:{}", host, port);
+        m_connect_cancellation = {};
 
-    virtual void async_receive_line(async_callback<imap_response_line_t> cb) override {
-        asio::async_read_until(
-            m_socket, m_recv_buff, "\r\n",
-            [this, cb = std::move(cb)](std::error_code ec, size_t bytes_transferred) mutable {
+        async_happy_eyeballs_connect(
+            m_ctx, host, port, m_socket.next_layer(),
+            [this, host, cb = std::move(cb)](std::error_code ec,
+                                             tcp_connect_result_t connect_result) mutable {
                 if (ec) {
-                    log_error("async_read_until failed: {}", ec);
-                    cb(ec, {});
+                    log_error("async_connect failed: {}", ec.message());
+                    cb(ec);
                     return;
                 }
 
-                log_debug("bytes_transferred: {}, stream size: {}", bytes_transferred,
-                          m_recv_buff.size());
-
-                // TODO: ensure that stripping the line of \r\n is good idea. ABNF parses may not
-                // like it and we may want to do it on upper level or have as parameter!
-
-                const auto& buff_data = m_recv_buff.data();
+                const auto& e = connect_result.endpoint;
+                log_debug("connected: {}:{} (proto: {}), doing handhshake",
+                          e.address().to_string(), e.port(), e.protocol().family());
+
+                m_connection_stats.endpoint = connect_result.endpoint;
+                m_connection_stats.dns_time = connect_result.dns_time;
+                m_connection_stats.tcp_time = connect_result.tcp_time;
+
+                auto& session_cache = tls_session_cache_t::instance();
+                const bool resumption_attempted = session_cache.prepare_handshake(
+                    m_socket.native_handle(), host, m_tls_session_key);
+
+                const auto handshake_started_ts = std::chrono::steady_clock::now();
+                m_socket.async_handshake(
+                    asio::ssl::stream_base::client,
+                    [this, handshake_started_ts, resumption_attempted,
+                     cb = std::move(cb)](std::error_code ec) mutable {
+                        if (ec) {
+                            log_error("async_handhshake failed: {}", ec.message());
+                            if (resumption_attempted) {
+                                tls_session_cache_t::instance().forget(m_tls_session_key);
+                            }
+                            cb(ec);
+                            return;
+                        }
+                        m_connection_stats.tls_time =
+                            std::chrono::duration_cast<std::chrono::microseconds>(
+                                std::chrono::steady_clock::now() - handshake_started_ts);
+                        m_connection_stats.tls_session_resumed =
+                            SSL_session_reused(m_socket.native_handle()) == 1;
+                        log_info(
+                            "connected to {}:{} (dns: {}us, tcp: {}us, tls: {}us, resumed: {})",
+                            m_connection_stats.endpoint.address().to_string(),
+                            m_connection_stats.endpoint.port(),
+                            m_connection_stats.dns_time.count(),
+                            m_connection_stats.tcp_time.count(),
+                            m_connection_stats.tls_time.count(),
+                            m_connection_stats.tls_session_resumed);
+
+                        m_connected = true;
+                        cb({});
+                    });
+            },
+            tcp_connect_opts_t{.cancellation = m_connect_cancellation.token()});
+    }
 
-                if (buff_data.size() < bytes_transferred) {
-                    log_error("buff_data.size={} while bytes_transferred={}", buff_data.size(),
-                              bytes_transferred);
-                    cb(ec, {});
-                    return;
-                }
+    virtual const imap_connection_stats_t& connection_stats() const override {
+        return m_connection_stats;
+    }
 
-                const char* data_ptr = static_cast<const char*>(buff_data.data());
+    virtual connection_health_t connection_health() const override {
+        return m_health.snapshot(std::chrono::steady_clock::now());
+    }
 
-#ifndef NDEBUG
-                if (m_opt_dump_stream_to_file) {
-                    m_protocol_log_fs << "S: ";
-                    m_protocol_log_fs.write(data_ptr, bytes_transferred);
-                    if (!m_protocol_log_fs.good()) {
-                        auto err = errno;
-                        log_warning("write to protocol log failed: {}", strerror(err));
-                    }
-                    m_protocol_log_fs.flush();
-                }
-#endif
+    virtual void on_link_grade_change(fu2::function<void(link_grade_t)> cb) override {
+        m_link_grade_change_cb = std::move(cb);
+    }
 
-                std::string received_data{data_ptr, bytes_transferred};
-                if (received_data.size() < 2 || received_data[received_data.size() - 2] != '\r' ||
-                    received_data[received_data.size() - 1] != '\n') {
-                    log_error("received not a line, no \\r\\n");
-                    cb(make_error_code(std::errc::io_error), {});
+    virtual void async_receive_line(call_opts_t opts,
+                                    async_callback<imap_response_line_t> cb) override {
+        async_receive_raw_line(
+            std::move(opts),
+            [cb = std::move(cb)](std::error_code ec, std::string received_data) mutable {
+                if (ec) {
+                    cb(ec, {});
                     return;
                 }
-
-                m_recv_buff.consume(bytes_transferred);
                 cb({}, imap_response_line_t{std::move(received_data)});
             });
     }
 
-    virtual void async_receive_raw_line(async_callback<std::string> cb) override {
+    virtual void async_receive_raw_line(call_opts_t opts, async_callback<std::string> cb) override {
+        cb = guard_call(opts, std::move(cb));
         asio::async_read_until(
-            m_socket, m_recv_buff, "\r\n",
+            m_stream, asio::dynamic_buffer(m_recv_buff), "\r\n",
             [this, cb = std::move(cb)](std::error_code ec, size_t bytes_transferred) mutable {
                 if (ec) {
                     log_error("async_read_until failed: {}", ec);
@@ -313,33 +217,19 @@ class imap_client_impl_t : public imap_socket_t, std::enable_shared_from_this<im
                 // TODO: ensure that stripping the line of \r\n is good idea. ABNF parses may not
                 // like it and we may want to do it on upper level or have as parameter!
 
-                const auto& buff_data = m_recv_buff.data();
-
-                if (buff_data.size() < bytes_transferred) {
-                    log_error("buff_data.size={} while bytes_transferred={}", buff_data.size(),
+                if (m_recv_buff.size() < bytes_transferred) {
+                    log_error("buff_data.size={} while bytes_transferred={}", m_recv_buff.size(),
                               bytes_transferred);
                     cb(ec, {});
                     return;
                 }
 
-                const char* data_ptr = static_cast<const char*>(buff_data.data());
-
-#ifndef NDEBUG
-                if (m_opt_dump_stream_to_file) {
-                    // TODO: seems like we should not expect that write will happen by entire
-                    // portion.
-                    m_protocol_log_fs << "S: ";
-                    m_protocol_log_fs.write(data_ptr, bytes_transferred);
-                    if (!m_protocol_log_fs.good()) {
-                        auto err = errno;
-                        log_warning("write to protocol log failed: {}", strerror(err));
-                    }
+                capture_received_data(std::string_view{m_recv_buff.data(), bytes_transferred},
+                                      first_token(m_recv_buff));
+                track_received_line(first_token(m_recv_buff));
 
-                    m_protocol_log_fs.flush();
-                }
-#endif
-
-                std::string received_data{data_ptr, bytes_transferred};
+                // Lines are short so they are copied out and the rest of the buffer is kept.
+                std::string received_data = m_recv_buff.substr(0, bytes_transferred);
                 if (received_data.size() < 2 || received_data[received_data.size() - 2] != '\r' ||
                     received_data[received_data.size() - 1] != '\n') {
                     log_error("received not a line, no \\r\\n");
@@ -347,15 +237,28 @@ class imap_client_impl_t : public imap_socket_t, std::enable_shared_from_this<im
                     return;
                 }
 
-                m_recv_buff.consume(bytes_transferred);
+                m_recv_buff.erase(0, bytes_transferred);
                 cb({}, std::move(received_data));
             });
     }
 
-    virtual void async_receive_response(std::string tag, async_callback<std::string> cb) override {
+    virtual void async_receive_response(std::string tag,
+                                        imap_literal_sink_opts_t literal_sink_opts,
+                                        untagged_response_handler_t on_untagged_response,
+                                        call_opts_t opts,
+                                        async_callback<imap_response_buffer_t> cb) override {
         if (!m_connected) {
             log_error("not connected");
-            cb(make_error_code(std::errc::not_connected), "");
+            cb(make_error_code(std::errc::not_connected), {});
+            return;
+        }
+
+        cb = guard_call(opts, std::move(cb));
+
+        if (literal_sink_opts.sink || on_untagged_response) {
+            auto state = std::make_shared<streaming_receive_state_t>(
+                tag, std::move(literal_sink_opts), std::move(on_untagged_response));
+            async_receive_response_streaming(std::move(state), std::move(cb));
             return;
         }
 
@@ -364,9 +267,9 @@ class imap_client_impl_t : public imap_socket_t, std::enable_shared_from_this<im
         auto read_start_ts = std::chrono::steady_clock::now();
 
         asio::async_read_until(
-            m_socket, m_recv_buff, cond,
-            [read_start_ts, this, cb = std::move(cb)](std::error_code ec,
-                                                      size_t bytes_transferred) mutable {
+            m_stream, asio::dynamic_buffer(m_recv_buff), cond,
+            [read_start_ts, this, tag, cb = std::move(cb)](std::error_code ec,
+                                                           size_t bytes_transferred) mutable {
                 if (ec) {
                     log_error("async_read_until failed: {}", ec);
                     cb(ec, {});
@@ -378,61 +281,43 @@ class imap_client_impl_t : public imap_socket_t, std::enable_shared_from_this<im
                 log_debug("bytes_transferred: {}, stream size: {}", bytes_transferred,
                           m_recv_buff.size());
 
-                m_bytes_received_total += bytes_transferred;
-
-                // TODO: ensure that stripping the line of \r\n is good idea. ABNF parses may not
-                // like it and we may want to do it on upper level or have as parameter!
-
-                const auto& buff_data = m_recv_buff.data();
-
-                if (buff_data.size() < bytes_transferred) {
-                    log_error("buff_data.size={} while bytes_transferred={}", buff_data.size(),
+                if (m_recv_buff.size() < bytes_transferred) {
+                    log_error("buff_data.size={} while bytes_transferred={}", m_recv_buff.size(),
                               bytes_transferred);
                     cb(ec, {});
                     return;
                 }
 
-                const char* data_ptr = static_cast<const char*>(buff_data.data());
-
-#ifndef NDEBUG
-                if (m_opt_dump_stream_to_file) {
-                    // TODO: seems like we should not expect that write will happen by entire
-                    // portion.
-                    m_protocol_log_fs << "S: ";
-                    m_protocol_log_fs.write(data_ptr, bytes_transferred);
-                    if (!m_protocol_log_fs.good()) {
-                        auto err = errno;
-                        log_warning("write to protocol log failed: {}", strerror(err));
-                    }
+                const std::string_view response{m_recv_buff.data(), bytes_transferred};
+                capture_received_data(response, imap_response_tag(response));
+                track_received_line(imap_response_tag(response));
 
-                    m_protocol_log_fs.flush();
-                }
-#endif
-
-                std::string received_data{data_ptr, bytes_transferred};
-                if (received_data.size() < 2 || received_data[received_data.size() - 2] != '\r' ||
-                    received_data[received_data.size() - 1] != '\n') {
+                if (bytes_transferred < 2 || m_recv_buff[bytes_transferred - 2] != '\r' ||
+                    m_recv_buff[bytes_transferred - 1] != '\n') {
                     log_error("received not a line, no \\r\\n");
                     cb(make_error_code(std::errc::io_error), {});
                     return;
                 }
 
-                m_recv_buff.consume(bytes_transferred);
-                cb({}, std::move(received_data));
+                cb({}, detach_received_data(bytes_transferred));
             });
     }
 
-    virtual void async_send_command(std::string command, async_callback<void> cb) override {
+    virtual void async_send_command(std::string command,
+                                    call_opts_t opts,
+                                    async_callback<void> cb) override {
         if (!m_connected) {
             log_error("not connected");
             cb(make_error_code(std::errc::not_connected));
             return;
         }
 
+        cb = guard_call(opts, std::move(cb));
+
         log_debug("sending command '{}'", utils::escape_ctrl(command));
 
         asio::async_write(
-            m_socket, asio::buffer(command),
+            m_stream, asio::buffer(command),
             [this, cb = std::move(cb), command](std::error_code ec, size_t bytes_written) mutable {
                 if (ec) {
                     log_error("async_write failed: {}", ec.message());
@@ -440,63 +325,382 @@ class imap_client_impl_t : public imap_socket_t, std::enable_shared_from_this<im
                     return;
                 }
 
-#ifndef NDEBUG
-                if (m_opt_dump_stream_to_file) {
-                    // TODO: seems like we should not expect that write will happen by
-                    // entire portion.
-                    m_protocol_log_fs << "C: " << command;
-                    if (!m_protocol_log_fs.good()) {
-                        auto err = errno;
-                        log_warning("write to protocol log failed: {}", strerror(err));
-                    }
-                    m_protocol_log_fs.flush();
-                }
-#endif
+                capture_protocol_data(capture_direction_t::client_to_server, command,
+                                      first_token(command));
+                m_health.on_command_sent(sent_command_tag(command),
+                                         std::chrono::steady_clock::now());
+                schedule_health_check();
 
                 cb({});
             });
     }
 
-    virtual void set_option(imap_socket_opts::dump_stream_to_file) override {
-        m_opt_dump_stream_to_file = true;
+    virtual std::error_code start_compression() override {
+        if (!m_connected) {
+            return make_error_code(std::errc::not_connected);
+        }
+
+        // Whatever has been read after the response to COMPRESS is compressed already.
+        std::string already_received = std::exchange(m_recv_buff, {});
+        if (auto ec = m_stream.start_compression(already_received)) {
+            log_error("failed starting compression: {}", ec);
+            return ec;
+        }
+        log_info("compression started");
+        return {};
+    }
+
+    virtual void set_option(imap_socket_opts::capture_protocol opt) override {
+        m_capture_enabled.store(opt.enabled, std::memory_order_relaxed);
     }
 
-    bool initialize(bool dump_stream_to_file) {
-        if (dump_stream_to_file) {
-            m_protocol_log_fs =
-                std::ofstream{"imap_socket_dump.bin",
-                              std::ios_base::out | std::ios_base::app | std::ios_base::binary};
-            if (!m_protocol_log_fs) {
-                auto err = errno;
-                log_error("failed opening protocol log file: {}", ::strerror(err));
-                // TODO: allow to override with env variable/library opt and make this optional.
-                return false;
+   private:
+    // Constrains a call by opts: whichever comes first, completion of the call or its deadline or
+    // cancellation, calls the callback. Returns callback to be called on completion.
+    template <class T>
+    async_callback<T> guard_call(const call_opts_t& opts, async_callback<T> cb) {
+        if (opts.unconstrained()) {
+            return cb;
+        }
+
+        struct guard_t {
+            async_callback<T> cb;
+            bool finished = false;
+            timer_wheel_t::timer_id_t timer = 0;
+            cancellation_registration_t cancellation;
+        };
+        auto guard = std::make_shared<guard_t>();
+        guard->cb = std::move(cb);
+
+        auto abort = [self = weak_from_this(),
+                      weak_guard = std::weak_ptr<guard_t>{guard}](std::errc reason) {
+            auto this_ = self.lock();
+            auto guard = weak_guard.lock();
+            if (!this_ || !guard || guard->finished) {
+                return;
+            }
+            guard->finished = true;
+            this_->abort_connection(reason);
+            guard->cancellation.reset();
+            if constexpr (std::is_void_v<T>) {
+                guard->cb(make_error_code(reason));
+            } else {
+                guard->cb(make_error_code(reason), {});
+            }
+        };
+
+        if (opts.deadline) {
+            guard->timer = timer_wheel_t::of(m_ctx).schedule(
+                *opts.deadline, [abort]() mutable { abort(std::errc::timed_out); });
+        }
+        if (opts.cancellation.can_be_cancelled()) {
+            // Token can be cancelled from any thread.
+            guard->cancellation =
+                opts.cancellation.on_cancel([ex = m_ctx.get_executor(), abort]() mutable {
+                    asio::post(ex, [abort]() mutable { abort(std::errc::operation_canceled); });
+                });
+        }
+
+        auto complete = [this, guard](auto... args) {
+            if (std::exchange(guard->finished, true)) {
+                // Operation has been cancelled and caller already got the error.
+                release_aborted_connection();
+                return;
             }
+            timer_wheel_t::of(m_ctx).cancel(guard->timer);
+            guard->cancellation.reset();
+            guard->cb(std::move(args)...);
+        };
+        if constexpr (std::is_void_v<T>) {
+            return [complete](std::error_code ec) mutable { complete(ec); };
+        } else {
+            return [complete](std::error_code ec, T value) mutable {
+                complete(ec, std::move(value));
+            };
+        }
+    }
+
+    // Socket is connected again after its connection has been lost, nothing of previous session
+    // may leak into the new one. SSL object keeps its finished handshake otherwise and the next
+    // one "succeeds" without talking to the server.
+    void reset_session() {
+        m_abort_reason = {};
+        m_connected = false;
+        std::error_code ec;
+        m_socket.lowest_layer().close(ec);
+        SSL_clear(m_socket.native_handle());
+        m_stream.reset();
+        std::string{}.swap(m_recv_buff);
+    }
+
+    // Closing the socket makes all pending operations complete with operation_aborted. Connect
+    // which is still resolving or racing its attempts is cancelled so that no late attempt is
+    // moved into the socket.
+    void abort_connection(std::errc reason) {
+        log_warning("aborting connection: {}", make_error_code(reason).message());
+        m_abort_reason = make_error_code(reason);
+        m_connected = false;
+        m_connect_cancellation.cancel();
+        std::error_code ec;
+        m_socket.lowest_layer().close(ec);
+    }
+
+    // Called when operations of aborted connection complete, which is when buffers they were
+    // using are not referenced anymore.
+    void release_aborted_connection() {
+        if (!m_abort_reason) {
+            return;
+        }
+        // E.g. connect has gone through after the deadline.
+        m_connected = false;
+        std::error_code ec;
+        m_socket.lowest_layer().close(ec);
+        std::string{}.swap(m_recv_buff);
+    }
+
+    struct streaming_receive_state_t {
+        streaming_receive_state_t(std::string_view tag,
+                                  imap_literal_sink_opts_t opts,
+                                  untagged_response_handler_t on_untagged_response)
+            : tag(tag),
+              framer(tag),
+              opts(std::move(opts)),
+              on_untagged_response(std::move(on_untagged_response)) {}
+
+        std::string tag;
+        imap_response_framer_t framer;
+        imap_literal_sink_opts_t opts;
+        untagged_response_handler_t on_untagged_response;
+        size_t scanned = 0;  // bytes of m_recv_buff which have been looked through by framer
+        size_t sink_bytes_left = 0;
+        size_t handed_out = 0;  // bytes of m_recv_buff passed to on_untagged_response
+    };
+
+    // Unlike async_read_until, reads chunk by chunk so that large literals and untagged responses
+    // can be removed from receive buffer right after they have been read.
+    void async_receive_response_streaming(std::shared_ptr<streaming_receive_state_t> state,
+                                          async_callback<imap_response_buffer_t> cb) {
+        auto response_size_or_err = process_received_data_streaming(*state);
+        // Untagged responses are copied out one by one, the buffer is compacted once per chunk.
+        m_recv_buff.erase(0, state->handed_out);
+        state->scanned -= state->handed_out;
+        if (response_size_or_err && *response_size_or_err) {
+            **response_size_or_err -= state->handed_out;
+        }
+        state->handed_out = 0;
+        if (!response_size_or_err) {
+            cb(response_size_or_err.error(), {});
+            return;
+        }
+        if (auto response_size = *response_size_or_err) {
+            track_received_line(
+                imap_response_tag(std::string_view{m_recv_buff}.substr(0, *response_size)));
+            cb({}, detach_received_data(*response_size));
+            return;
         }
-        return true;
+
+        const size_t offset = m_recv_buff.size();
+        m_recv_buff.resize(offset + STREAMING_READ_CHUNK_SIZE);
+        m_stream.async_read_some(
+            asio::buffer(m_recv_buff.data() + offset, STREAMING_READ_CHUNK_SIZE),
+            [this, offset, state = std::move(state), cb = std::move(cb)](
+                std::error_code ec, size_t bytes_transferred) mutable {
+                m_recv_buff.resize(offset + bytes_transferred);
+                if (ec) {
+                    log_error("async_read_some failed: {}", ec);
+                    cb(ec, {});
+                    return;
+                }
+                capture_received_data(std::string_view{m_recv_buff}.substr(offset),
+                                      state->tag);
+                async_receive_response_streaming(std::move(state), std::move(cb));
+            });
+    }
+
+    // Returns size of the response if it has been received completely.
+    expected<std::optional<size_t>> process_received_data_streaming(
+        streaming_receive_state_t& state) {
+        while (state.scanned < m_recv_buff.size()) {
+            if (state.sink_bytes_left > 0) {
+                auto& sink = *state.opts.sink;
+                const size_t n =
+                    std::min(state.sink_bytes_left, m_recv_buff.size() - state.scanned);
+                const char* chunk_begin = m_recv_buff.data() + state.scanned;
+                if (auto ec = sink.on_literal_data({chunk_begin, n})) {
+                    return unexpected(ec);
+                }
+                state.framer.feed(chunk_begin, chunk_begin + n);  // framer just skips them
+                m_recv_buff.erase(state.scanned, n);
+                state.sink_bytes_left -= n;
+                if (state.sink_bytes_left == 0) {
+                    if (auto ec = sink.on_literal_end()) {
+                        return unexpected(ec);
+                    }
+                }
+                continue;
+            }
+
+            auto r = state.framer.scan(
+                m_recv_buff.data() + state.scanned, m_recv_buff.data() + m_recv_buff.size(),
+                state.opts.sink ? state.opts.threshold : imap_response_framer_t::NO_LITERAL_STOP,
+                static_cast<bool>(state.on_untagged_response));
+            state.scanned += r.consumed;
+
+            using scan_status_t = imap_response_framer_t::scan_status_t;
+            if (r.status == scan_status_t::response_complete) {
+                return state.scanned;
+            }
+            if (r.status == scan_status_t::untagged_response_complete) {
+                auto response = imap_response_buffer_t::from_string(m_recv_buff.substr(
+                    state.handed_out, state.scanned - state.handed_out));
+                state.handed_out = state.scanned;
+                if (auto ec = state.on_untagged_response(std::move(response))) {
+                    return unexpected(ec);
+                }
+                continue;
+            }
+            if (r.status == scan_status_t::literal_begins) {
+                auto& sink = *state.opts.sink;
+                // Literal header "{N}\r\n" ends right where we are, it becomes "{0}\r\n".
+                const size_t close_pos = state.scanned - 3;
+                const size_t open_pos = m_recv_buff.rfind('{', close_pos);
+                m_recv_buff.replace(open_pos + 1, close_pos - open_pos - 1, "0");
+                state.scanned = open_pos + 5;
+
+                log_debug("passing literal of size {}Kb to sink", r.literal_size / 1024);
+                if (auto ec = sink.on_literal_begin(r.literal_size)) {
+                    return unexpected(ec);
+                }
+                state.sink_bytes_left = r.literal_size;
+                if (r.literal_size == 0) {
+                    if (auto ec = sink.on_literal_end()) {
+                        return unexpected(ec);
+                    }
+                }
+            }
+        }
+        return std::nullopt;
+    }
+
+    // Hands out first n bytes of the receive buffer as a response without copying them: the
+    // buffer itself is moved into shared storage and only bytes received after the response (if
+    // any, normally there are none) are copied into the new receive buffer.
+    imap_response_buffer_t detach_received_data(size_t n) {
+        std::string rest;
+        if (n < m_recv_buff.size()) {
+            rest.assign(m_recv_buff, n, std::string::npos);
+            m_recv_buff.resize(n);
+        }
+        auto result = imap_response_buffer_t::from_string(std::move(m_recv_buff));
+        m_recv_buff = std::move(rest);
+        return result;
+    }
+
+    void capture_received_data(std::string_view data, std::string_view tag) {
+        capture_protocol_data(capture_direction_t::server_to_client, data, tag);
+    }
+
+    void capture_protocol_data(capture_direction_t direction,
+                               std::string_view data,
+                               std::string_view tag) {
+        if (m_capture_enabled.load(std::memory_order_relaxed)) {
+            protocol_capture_t::instance().capture(direction, m_connection_id, tag, data);
+        }
+    }
+
+    // Token is the first one of received line or tag of received response.
+    void track_received_line(std::string_view token) {
+        const auto now = std::chrono::steady_clock::now();
+        if (token == "+") {
+            m_health.on_continuation_request(now);
+        } else if (token != "*") {
+            m_health.on_tagged_response(token, now);
+        }
+        check_link_grade(now);
+    }
+
+    void check_link_grade(std::chrono::steady_clock::time_point now) {
+        const auto grade = m_health.grade(now);
+        if (grade == m_link_grade) {
+            return;
+        }
+        log_info("link grade changed: {} -> {}", to_string(m_link_grade), to_string(grade));
+        m_link_grade = grade;
+        if (m_link_grade_change_cb) {
+            m_link_grade_change_cb(grade);
+        }
+    }
+
+    // Stall is absence of traffic, so it has to be looked for with a timer.
+    void schedule_health_check() {
+        if (std::exchange(m_health_check_scheduled, true)) {
+            return;
+        }
+        m_health_timer.expires_after(HEALTH_CHECK_INTERVAL);
+        m_health_timer.async_wait([this](std::error_code ec) {
+            if (ec) {
+                return;  // socket is being destroyed
+            }
+            m_health_check_scheduled = false;
+            check_link_grade(std::chrono::steady_clock::now());
+            if (m_health.has_commands_in_flight()) {
+                schedule_health_check();
+            }
+        });
+    }
+
+    // Tag of command or response line (or "*"/"+" for untagged/continuation lines).
+    static std::string_view first_token(std::string_view line) {
+        return line.substr(0, std::min(line.find_first_of(" \r\n"), line.size()));
+    }
+
+    // DONE ending IDLE continues command which is in flight already, it is not a command.
+    static std::string_view sent_command_tag(std::string_view command) {
+        const auto tag = first_token(command);
+        return tag == "DONE" ? std::string_view{} : tag;
     }
 
    private:
+    static constexpr size_t STREAMING_READ_CHUNK_SIZE = 64 * 1024;
+    static constexpr auto HEALTH_CHECK_INTERVAL = 1s;
+
     asio::io_context& m_ctx;
-    asio::ssl::context m_ssl_ctx;
+    std::shared_ptr<asio::ssl::context> m_ssl_ctx;
+    std::string m_tls_session_key;  // "host:port", must outlive SSL object, see tls_session_cache_t
     asio::ssl::stream<asio::ip::tcp::socket> m_socket;
+    compressing_stream_t<asio::ssl::stream<asio::ip::tcp::socket>> m_stream;
     bool m_connected = false;
-    asio::streambuf m_recv_buff;
-    bool m_opt_dump_stream_to_file = false;
-    std::ofstream m_protocol_log_fs;
-    size_t m_bytes_received_total = 0;
+    imap_connection_stats_t m_connection_stats;
+    std::string m_recv_buff;
+    const uint64_t m_connection_id;  // identifies connection in protocol capture
+    std::atomic<bool> m_capture_enabled = false;
+    connection_health_estimator_t m_health;
+    asio::steady_timer m_health_timer;
+    bool m_health_check_scheduled = false;
+    link_grade_t m_link_grade = link_grade_t::green;
+    fu2::function<void(link_grade_t)> m_link_grade_change_cb;
+    std::error_code m_abort_reason;  // why connection has been aborted by deadline/cancellation
+    cancellation_source_t m_connect_cancellation;  // of the connect in progress
 };
 
 }  // namespace
 
 std::shared_ptr<imap_socket_t> make_imap_socket(asio::io_context& ctx) {
-    auto inst = std::make_shared<imap_client_impl_t>(ctx);
-    // FIXME: we have dynamic flag for this so this should be on demand created.
-    if (!inst->initialize(true)) {
-        log_error("imap socket initialization failed");
-        return nullptr;
-    }
-    return inst;
+    return std::make_shared<imap_client_impl_t>(ctx);
+}
+
+std::string_view imap_socket_io_backend() {
+#if defined(ASIO_HAS_IO_URING) && defined(ASIO_DISABLE_EPOLL)
+    return "io_uring";
+#elif defined(ASIO_HAS_EPOLL)
+    return "epoll";
+#elif defined(ASIO_HAS_KQUEUE)
+    return "kqueue";
+#elif defined(ASIO_HAS_IOCP)
+    return "iocp";
+#else
+    return "select";
+#endif
 }
 
 void async_keep_receiving_lines_until(
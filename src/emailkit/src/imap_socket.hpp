@@ -1,6 +1,11 @@
 #pragma once
 #include <emailkit/global.hpp>
 #include <asio/io_context.hpp>
+#include <asio/ip/tcp.hpp>
+#include <emailkit/call_opts.hpp>
+#include <emailkit/connection_health.hpp>
+#include <emailkit/imap_literal_sink.hpp>
+#include <emailkit/imap_response_buffer.hpp>
 #include <emailkit/imap_response_line.hpp>
 #include <emailkit/log.hpp>
 #include <memory>
@@ -8,33 +13,122 @@
 namespace emailkit {
 
 namespace imap_socket_opts {
-struct dump_stream_to_file {};
+// Captures traffic of the connection with protocol_capture_t::instance(), can be switched on and
+// off at any time.
+struct capture_protocol {
+    bool enabled = true;
+};
 }  // namespace imap_socket_opts
 
+// How the last connection has been established.
+struct imap_connection_stats_t {
+    asio::ip::tcp::endpoint endpoint;  // endpoint which won connection race
+    std::chrono::microseconds dns_time{};
+    std::chrono::microseconds tcp_time{};
+    std::chrono::microseconds tls_time{};  // handshake time
+    bool tls_session_resumed = false;        // abbreviated handshake with cached session
+};
+
+// Receives untagged responses of a response while it is being received, see
+// imap_socket_t::async_receive_response.
+using untagged_response_handler_t = fu2::unique_function<std::error_code(imap_response_buffer_t)>;
+
 // https://datatracker.ietf.org/doc/html/rfc3501
 class imap_socket_t {
    public:
     virtual ~imap_socket_t() = default;
 
-    // todo: context with deadline?
-    virtual void async_connect(std::string host, std::string port, async_callback<void> cb) = 0;
-    // virtual void async_receive_line(async_callback<std::string> cb) = 0;
+    // Every asynchronous call takes call_opts_t with optional deadline and cancellation token.
+    // When either fires, the call fails with timed_out/operation_canceled, pending socket
+    // operations are cancelled and connection is closed: response that has been partially read
+    // cannot be skipped in IMAP, so connection is not usable anymore and its buffered data is
+    // released. Overloads without opts are not constrained.
+    virtual void async_connect(std::string host,
+                               std::string port,
+                               call_opts_t opts,
+                               async_callback<void> cb) = 0;
+    void async_connect(std::string host, std::string port, async_callback<void> cb) {
+        async_connect(std::move(host), std::move(port), {}, std::move(cb));
+    }
+
+    // Valid after async_connect succeeded.
+    virtual const imap_connection_stats_t& connection_stats() const = 0;
 
-    virtual void async_receive_line(async_callback<imap_response_line_t> cb) = 0;
+    // Current throughput and latency estimate, see connection_health_estimator_t.
+    virtual connection_health_t connection_health() const = 0;
 
-    virtual void async_receive_raw_line(async_callback<std::string> cb) = 0;
+    // Called whenever link grade changes, e.g. becomes red when server stops responding to pending
+    // command and green again once data flows. Grade is reevaluated on traffic and periodically
+    // while commands are pending so stalls are noticed without any traffic.
+    virtual void on_link_grade_change(fu2::function<void(link_grade_t)> cb) = 0;
+
+    virtual void async_receive_line(call_opts_t opts, async_callback<imap_response_line_t> cb) = 0;
+    void async_receive_line(async_callback<imap_response_line_t> cb) {
+        async_receive_line({}, std::move(cb));
+    }
+
+    virtual void async_receive_raw_line(call_opts_t opts, async_callback<std::string> cb) = 0;
+    void async_receive_raw_line(async_callback<std::string> cb) {
+        async_receive_raw_line({}, std::move(cb));
+    }
 
     // Reads out entire response taking into consideration what was a tag knowing some of details
-    // about imap grammar.
-    virtual void async_receive_response(std::string tag, async_callback<std::string> cb) = 0;
+    // about imap grammar. Received bytes are handed over without copying.
+    //
+    // With empty tag reads up to tagged line of any command, which is the way to receive responses
+    // of pipelined commands: the tag is then the first token of the last line of the response.
+    //
+    // If literal_sink_opts has a sink, literals at least literal_sink_opts.threshold long are
+    // passed to the sink as they arrive instead of being accumulated, so that memory used by socket
+    // stays bounded regardless of message sizes. In the response such literals are replaced with
+    // empty ones.
+    //
+    // If on_untagged_response is set, every untagged response ("* 12 FETCH (...)\r\n" together
+    // with its literals) is passed to it as soon as it has been received and is dropped from the
+    // receive buffer, so that caller can process a large response while the rest of it is still
+    // downloading and socket keeps at most one untagged response of it. cb then gets what remains,
+    // normally only the tagged line. Error returned by on_untagged_response fails the receive.
+    virtual void async_receive_response(std::string tag,
+                                        imap_literal_sink_opts_t literal_sink_opts,
+                                        untagged_response_handler_t on_untagged_response,
+                                        call_opts_t opts,
+                                        async_callback<imap_response_buffer_t> cb) = 0;
+    void async_receive_response(std::string tag,
+                                imap_literal_sink_opts_t literal_sink_opts,
+                                call_opts_t opts,
+                                async_callback<imap_response_buffer_t> cb) {
+        async_receive_response(std::move(tag), std::move(literal_sink_opts), {}, std::move(opts),
+                               std::move(cb));
+    }
+    void async_receive_response(std::string tag, async_callback<imap_response_buffer_t> cb) {
+        async_receive_response(std::move(tag), {}, {}, std::move(cb));
+    }
+    void async_receive_response(std::string tag,
+                                imap_literal_sink_opts_t literal_sink_opts,
+                                async_callback<imap_response_buffer_t> cb) {
+        async_receive_response(std::move(tag), std::move(literal_sink_opts), {}, std::move(cb));
+    }
 
-    virtual void async_send_command(std::string command, async_callback<void> cb) = 0;
+    virtual void async_send_command(std::string command,
+                                    call_opts_t opts,
+                                    async_callback<void> cb) = 0;
+    void async_send_command(std::string command, async_callback<void> cb) {
+        async_send_command(std::move(command), {}, std::move(cb));
+    }
 
-    virtual void set_option(imap_socket_opts::dump_stream_to_file) = 0;
+    // Switches connection to DEFLATE compression in both directions, to be called right after
+    // server accepted COMPRESS DEFLATE command (https://datatracker.ietf.org/doc/html/rfc4978).
+    virtual std::error_code start_compression() = 0;
+
+    virtual void set_option(imap_socket_opts::capture_protocol) = 0;
 };
 
 std::shared_ptr<imap_socket_t> make_imap_socket(asio::io_context& ctx);
 
+// Name of asio I/O backend sockets are compiled with ("io_uring" or "epoll"/"kqueue"/..),
+// see EMAILKIT_USE_IO_URING build option.
+std::string_view imap_socket_io_backend();
+
 void async_keep_receiving_lines_until(
     std::weak_ptr<imap_socket_t> socket_ptr,
     fu2::function<std::error_code(const imap_response_line_t& l)> p,
@@ -0,0 +1,183 @@
+#include "protocol_capture.hpp"
+
+#include <bit>
+#include <cstring>
+
+namespace emailkit {
+
+protocol_capture_t& protocol_capture_t::instance() {
+    static protocol_capture_t inst{protocol_capture_opts_t{}};
+    return inst;
+}
+
+uint64_t protocol_capture_t::next_connection_id() {
+    static std::atomic<uint64_t> last_id{0};
+    return ++last_id;
+}
+
+protocol_capture_t::protocol_capture_t(protocol_capture_opts_t opts)
+    : m_opts(opts),
+      m_mask(std::bit_ceil(std::max<size_t>(opts.ring_capacity, 2)) - 1),
+      m_slots(std::make_unique<slot_t[]>(m_mask + 1)) {
+    for (size_t i = 0; i <= m_mask; ++i) {
+        m_slots[i].sequence.store(i, std::memory_order_relaxed);
+    }
+
+    m_file = std::ofstream{opts.path,
+                           std::ios_base::out | std::ios_base::app | std::ios_base::binary};
+    if (!m_file) {
+        auto err = errno;
+        // Frames are still consumed (and discarded) so that sockets are not affected.
+        log_error("failed opening protocol capture file {}: {}", opts.path, ::strerror(err));
+    }
+
+    m_writer_thread = std::thread{[this] { writer_thread_main(); }};
+}
+
+protocol_capture_t::~protocol_capture_t() {
+    m_stop.store(true, std::memory_order_release);
+    m_wakeup_seq.fetch_add(1, std::memory_order_release);
+    m_wakeup_seq.notify_one();
+    m_writer_thread.join();
+}
+
+bool protocol_capture_t::capture(capture_direction_t direction,
+                                 uint64_t connection_id,
+                                 std::string_view tag,
+                                 std::string_view data) {
+    const size_t original_size = data.size();
+    data = data.substr(0, m_opts.max_frame_bytes);
+    if (m_buffered_bytes.fetch_add(data.size(), std::memory_order_relaxed) + data.size() >
+        m_opts.max_buffered_bytes) {
+        m_buffered_bytes.fetch_sub(data.size(), std::memory_order_relaxed);
+        m_frames_dropped.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+
+    slot_t* slot = nullptr;
+    size_t pos = m_enqueue_pos.load(std::memory_order_relaxed);
+    for (;;) {
+        slot = &m_slots[pos & m_mask];
+        const size_t seq = slot->sequence.load(std::memory_order_acquire);
+        const auto diff = static_cast<std::ptrdiff_t>(seq) - static_cast<std::ptrdiff_t>(pos);
+        if (diff == 0) {
+            if (m_enqueue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                break;
+            }
+        } else if (diff < 0) {
+            m_buffered_bytes.fetch_sub(data.size(), std::memory_order_relaxed);
+            m_frames_dropped.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        } else {
+            pos = m_enqueue_pos.load(std::memory_order_relaxed);
+        }
+    }
+
+    // Strings of the slot keep capacity of small frames between uses, so once the ring has warmed
+    // up capturing commands and status responses does not allocate.
+    auto& frame = slot->frame;
+    frame.timestamp_us = std::chrono::duration_cast<std::chrono::microseconds>(
+                             std::chrono::system_clock::now().time_since_epoch())
+                             .count();
+    frame.connection_id = connection_id;
+    frame.direction = direction;
+    frame.tag.assign(tag);
+    frame.data.assign(data);
+    frame.original_size = original_size;
+    slot->sequence.store(pos + 1, std::memory_order_release);
+
+    // Waking writer up is a syscall, it is done only when writer is going to sleep. Pairs with
+    // the fence in writer_thread_main(): either writer sees the frame or we see it waiting.
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (m_writer_waiting.load(std::memory_order_relaxed) &&
+        m_writer_waiting.exchange(false, std::memory_order_relaxed)) {
+        m_wakeup_seq.fetch_add(1, std::memory_order_release);
+        m_wakeup_seq.notify_one();
+    }
+    return true;
+}
+
+void protocol_capture_t::flush() {
+    const size_t target = m_enqueue_pos.load(std::memory_order_acquire);
+    for (;;) {
+        const size_t flushed = m_frames_flushed.load(std::memory_order_acquire);
+        if (flushed >= target) {
+            return;
+        }
+        m_frames_flushed.wait(flushed, std::memory_order_acquire);
+    }
+}
+
+bool protocol_capture_t::next_frame_ready() const {
+    // Empty or producer has not finished the frame yet otherwise.
+    return m_slots[m_dequeue_pos & m_mask].sequence.load(std::memory_order_acquire) ==
+           m_dequeue_pos + 1;
+}
+
+bool protocol_capture_t::try_write_next_frame() {
+    if (!next_frame_ready()) {
+        return false;
+    }
+    slot_t& slot = m_slots[m_dequeue_pos & m_mask];
+
+    auto& frame = slot.frame;
+    if (m_file.is_open()) {
+        m_file << fmt::format(
+            "# {} {} {} {} {}", frame.timestamp_us, frame.connection_id,
+            frame.direction == capture_direction_t::client_to_server ? "C" : "S",
+            frame.tag.empty() ? "-" : frame.tag, frame.data.size());
+        if (frame.original_size > frame.data.size()) {
+            m_file << ' ' << frame.original_size;
+        }
+        m_file << '\n';
+        m_file.write(frame.data.data(), frame.data.size());
+        m_file << '\n';
+    }
+    m_buffered_bytes.fetch_sub(frame.data.size(), std::memory_order_relaxed);
+    // Otherwise every slot would keep the largest frame it has ever had.
+    for (auto* s : {&frame.tag, &frame.data}) {
+        if (s->capacity() > RETAINED_SLOT_BYTES) {
+            std::string{}.swap(*s);
+        } else {
+            s->clear();
+        }
+    }
+
+    slot.sequence.store(m_dequeue_pos + m_mask + 1, std::memory_order_release);
+    ++m_dequeue_pos;
+    m_frames_written.fetch_add(1, std::memory_order_relaxed);
+    return true;
+}
+
+void protocol_capture_t::writer_thread_main() {
+    for (;;) {
+        const size_t wakeup_seq = m_wakeup_seq.load(std::memory_order_acquire);
+        const bool stopping = m_stop.load(std::memory_order_acquire);
+
+        bool written_any = false;
+        while (try_write_next_frame()) {
+            written_any = true;
+        }
+        if (written_any) {
+            if (m_file.is_open() && !m_file.flush()) {
+                auto err = errno;
+                log_warning("write to protocol capture file failed: {}", ::strerror(err));
+                m_file.clear();
+            }
+            m_frames_flushed.store(m_dequeue_pos, std::memory_order_release);
+            m_frames_flushed.notify_all();
+        }
+
+        if (stopping) {
+            return;
+        }
+        m_writer_waiting.store(true, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (!next_frame_ready()) {
+            m_wakeup_seq.wait(wakeup_seq, std::memory_order_acquire);
+        }
+        m_writer_waiting.store(false, std::memory_order_relaxed);
+    }
+}
+
+}  // namespace emailkit
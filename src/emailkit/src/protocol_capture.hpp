@@ -0,0 +1,100 @@
+#pragma once
+#include <emailkit/global.hpp>
+#include <atomic>
+#include <fstream>
+#include <string_view>
+#include <thread>
+
+namespace emailkit {
+
+enum class capture_direction_t : uint8_t {
+    client_to_server,
+    server_to_client,
+};
+
+struct protocol_capture_opts_t {
+    std::string path = "imap_socket_dump.bin";
+    size_t ring_capacity = 4096;  // frames, rounded up to power of two
+    // Memory ceiling: bytes of frames captured but not written yet. Frames which do not fit are
+    // dropped.
+    size_t max_buffered_bytes = 32 * 1024 * 1024;
+    // Longer frames (e.g. FETCH responses with message bodies) are truncated.
+    size_t max_frame_bytes = 256 * 1024;
+};
+
+// Protocol capture which is cheap enough to be left on in production.
+//
+// Sockets append frames (direction, timestamp, connection id, command tag and bytes as they were
+// sent or received) to a bounded lock-free ring and a background thread drains the ring into a
+// file. Network path never waits for disk: if the writer falls behind and the ring is full, frame
+// is dropped and counted.
+//
+// Frames are written as a header line followed by the data and LF:
+//   # <unix time, us> <connection id> <C|S> <tag> <data size>[ <size before truncation>]
+class protocol_capture_t {
+   public:
+    // Process-wide capture writing to default path. Created (and file opened) on first use.
+    static protocol_capture_t& instance();
+
+    explicit protocol_capture_t(protocol_capture_opts_t opts);
+    ~protocol_capture_t();
+
+    protocol_capture_t(const protocol_capture_t&) = delete;
+    protocol_capture_t& operator=(const protocol_capture_t&) = delete;
+
+    // Unique id for frames of one connection, does not require capture to exist.
+    static uint64_t next_connection_id();
+
+    // Never blocks. Returns false if the frame has been dropped.
+    bool capture(capture_direction_t direction,
+                 uint64_t connection_id,
+                 std::string_view tag,
+                 std::string_view data);
+
+    // Waits until frames captured before the call are written and flushed to the file.
+    void flush();
+
+    bool is_open() const { return m_file.is_open(); }
+    size_t frames_written() const { return m_frames_written.load(std::memory_order_relaxed); }
+    size_t frames_dropped() const { return m_frames_dropped.load(std::memory_order_relaxed); }
+
+   private:
+    struct frame_t {
+        int64_t timestamp_us = 0;
+        uint64_t connection_id = 0;
+        capture_direction_t direction{};
+        std::string tag;
+        std::string data;
+        size_t original_size = 0;  // of data before truncation
+    };
+
+    // Slot of bounded MPMC queue (D. Vyukov), only one consumer is used here.
+    struct slot_t {
+        std::atomic<size_t> sequence{0};
+        frame_t frame;
+    };
+
+    // Slot strings keep capacity up to this between uses, larger buffers are released.
+    static constexpr size_t RETAINED_SLOT_BYTES = 4096;
+
+    bool next_frame_ready() const;
+    bool try_write_next_frame();
+    void writer_thread_main();
+
+    const protocol_capture_opts_t m_opts;
+    const size_t m_mask;
+    std::unique_ptr<slot_t[]> m_slots;
+    alignas(64) std::atomic<size_t> m_enqueue_pos{0};
+    alignas(64) size_t m_dequeue_pos = 0;  // writer thread only
+    std::atomic<size_t> m_wakeup_seq{0};  // bumped to wake writer up
+    std::atomic<bool> m_writer_waiting{false};
+    std::atomic<size_t> m_buffered_bytes{0};
+    std::atomic<size_t> m_frames_written{0};
+    std::atomic<size_t> m_frames_dropped{0};
+    std::atomic<size_t> m_frames_flushed{0};  // dequeue position as of last file flush
+    std::atomic<bool> m_stop{false};
+    std::ofstream m_file;
+    std::thread m_writer_thread;
+};
+
+}  // namespace emailkit
@@ -0,0 +1,219 @@
+#include "tcp_connector.hpp"
+
+#include <asio/connect.hpp>
+#include <asio/dispatch.hpp>
+#include <asio/post.hpp>
+#include <asio/steady_timer.hpp>
+
+namespace emailkit {
+
+namespace {
+
+using steady_clock = std::chrono::steady_clock;
+
+std::chrono::microseconds elapsed_since(steady_clock::time_point ts) {
+    return std::chrono::duration_cast<std::chrono::microseconds>(steady_clock::now() - ts);
+}
+
+struct happy_eyeballs_state_t : std::enable_shared_from_this<happy_eyeballs_state_t> {
+    happy_eyeballs_state_t(asio::io_context& ctx,
+                           asio::ip::tcp::socket& target_socket,
+                           async_callback<tcp_connect_result_t> cb,
+                           tcp_connect_opts_t opts)
+        : ctx(ctx),
+          target_socket(target_socket),
+          resolver(ctx),
+          attempt_timer(ctx),
+          cb(std::move(cb)),
+          opts(opts) {}
+
+    void start(std::vector<asio::ip::tcp::endpoint> resolved_endpoints) {
+        endpoints = interleave_address_families(std::move(resolved_endpoints));
+        result.endpoints_resolved = endpoints.size();
+        if (endpoints.empty()) {
+            finish(make_error_code(std::errc::host_unreachable));
+            return;
+        }
+        connect_started_ts = steady_clock::now();
+        start_next_attempt();
+    }
+
+    void start_next_attempt() {
+        if (done || next_endpoint_idx >= endpoints.size()) {
+            return;
+        }
+
+        const size_t attempt_idx = attempts.size();
+        const auto endpoint = endpoints[next_endpoint_idx++];
+        attempts.emplace_back(std::make_unique<asio::ip::tcp::socket>(ctx));
+        in_flight++;
+        result.attempts_started++;
+
+        log_debug("connecting to {}:{} (attempt {})", endpoint.address().to_string(),
+                  endpoint.port(), attempt_idx);
+
+        attempts.back()->async_connect(
+            endpoint, [this, self = shared_from_this(), attempt_idx, endpoint](std::error_code ec) {
+                on_attempt_finished(attempt_idx, endpoint, ec);
+            });
+
+        if (next_endpoint_idx < endpoints.size()) {
+            attempt_timer.expires_after(opts.connection_attempt_delay);
+            attempt_timer.async_wait([this, self = shared_from_this()](std::error_code ec) {
+                if (ec) {
+                    return;  // cancelled because attempt failed early or race is over
+                }
+                start_next_attempt();
+            });
+        }
+    }
+
+    void on_attempt_finished(size_t attempt_idx,
+                             const asio::ip::tcp::endpoint& endpoint,
+                             std::error_code ec) {
+        in_flight--;
+        if (done) {
+            return;
+        }
+
+        if (ec) {
+            log_warning("connection to {}:{} failed: {}", endpoint.address().to_string(),
+                        endpoint.port(), ec.message());
+            last_error = ec;
+            if (next_endpoint_idx < endpoints.size()) {
+                // No reason to wait for the timer, next endpoint goes right away.
+                attempt_timer.cancel();
+                start_next_attempt();
+            } else if (in_flight == 0) {
+                finish(last_error);
+            }
+            return;
+        }
+
+        result.endpoint = endpoint;
+        result.tcp_time = elapsed_since(connect_started_ts);
+        target_socket = std::move(*attempts[attempt_idx]);
+        finish({});
+    }
+
+    // Called from the thread of ctx only.
+    void cancel() {
+        if (done) {
+            return;
+        }
+        log_debug("connect has been cancelled");
+        stop();
+        asio::post(ctx, [self = shared_from_this()]() {
+            self->cb(make_error_code(std::errc::operation_canceled), {});
+        });
+    }
+
+    void stop() {
+        done = true;
+        cancellation.reset();
+        resolver.cancel();
+        attempt_timer.cancel();
+        for (auto& s : attempts) {
+            std::error_code close_ec;
+            s->close(close_ec);
+        }
+    }
+
+    void finish(std::error_code ec) {
+        stop();
+        if (ec) {
+            cb(ec, {});
+        } else {
+            cb({}, std::move(result));
+        }
+    }
+
+    asio::io_context& ctx;
+    asio::ip::tcp::socket& target_socket;
+    asio::ip::tcp::resolver resolver;
+    asio::steady_timer attempt_timer;
+    async_callback<tcp_connect_result_t> cb;
+    tcp_connect_opts_t opts;
+
+    std::vector<asio::ip::tcp::endpoint> endpoints;
+    size_t next_endpoint_idx = 0;
+    std::vector<std::unique_ptr<asio::ip::tcp::socket>> attempts;
+    size_t in_flight = 0;
+    bool done = false;
+    cancellation_registration_t cancellation;
+    std::error_code last_error;
+    steady_clock::time_point connect_started_ts;
+    tcp_connect_result_t result;
+};
+
+}  // namespace
+
+std::vector<asio::ip::tcp::endpoint> interleave_address_families(
+    std::vector<asio::ip::tcp::endpoint> endpoints) {
+    if (endpoints.empty()) {
+        return endpoints;
+    }
+
+    const bool first_is_v6 = endpoints.front().address().is_v6();
+    std::vector<asio::ip::tcp::endpoint> preferred, other;
+    for (auto& e : endpoints) {
+        (e.address().is_v6() == first_is_v6 ? preferred : other).push_back(e);
+    }
+
+    std::vector<asio::ip::tcp::endpoint> result;
+    result.reserve(endpoints.size());
+    for (size_t i = 0; i < std::max(preferred.size(), other.size()); ++i) {
+        if (i < preferred.size()) {
+            result.push_back(preferred[i]);
+        }
+        if (i < other.size()) {
+            result.push_back(other[i]);
+        }
+    }
+    return result;
+}
+
+void async_happy_eyeballs_connect(asio::io_context& ctx,
+                                  std::string host,
+                                  std::string port,
+                                  asio::ip::tcp::socket& target_socket,
+                                  async_callback<tcp_connect_result_t> cb,
+                                  tcp_connect_opts_t opts) {
+    auto state = std::make_shared<happy_eyeballs_state_t>(ctx, target_socket, std::move(cb), opts);
+    const auto dns_started_ts = steady_clock::now();
+
+    state->resolver.async_resolve(
+        host, port,
+        [state, host, dns_started_ts](std::error_code ec,
+                                      asio::ip::tcp::resolver::results_type results) mutable {
+            if (state->done) {
+                return;  // cancelled
+            }
+            state->result.dns_time = elapsed_since(dns_started_ts);
+            if (ec) {
+                log_error("resolve of {} failed: {}", host, ec.message());
+                state->finish(ec);
+                return;
+            }
+
+            std::vector<asio::ip::tcp::endpoint> endpoints;
+            for (auto& x : results) {
+                log_debug("ip address: {}", x.endpoint().address().to_string());
+                endpoints.push_back(x.endpoint());
+            }
+            log_debug("resolved {} into {} addresses in {}us", host, endpoints.size(),
+                      state->result.dns_time.count());
+            state->start(std::move(endpoints));
+        });
+
+    // Token may be cancelled from any thread, state is touched on the thread of ctx only.
+    state->cancellation = opts.cancellation.on_cancel([&ctx, weak_state = std::weak_ptr{state}]() {
+        asio::dispatch(ctx, [weak_state]() {
+            if (auto state = weak_state.lock()) {
+                state->cancel();
+            }
+        });
+    });
+}
+
+}  // namespace emailkit
@@ -0,0 +1,43 @@
+#pragma once
+#include <emailkit/global.hpp>
+#include <asio/io_context.hpp>
+#include <asio/ip/tcp.hpp>
+#include <emailkit/call_opts.hpp>
+
+namespace emailkit {
+
+struct tcp_connect_opts_t {
+    // Delay before next endpoint is tried while previous attempt is still in progress
+    // (https://datatracker.ietf.org/doc/html/rfc8305#section-5 recommends 250ms).
+    std::chrono::milliseconds connection_attempt_delay = 250ms;
+    // Cancels resolve and every attempt in flight, callback gets std::errc::operation_canceled
+    // and target_socket is not touched afterwards.
+    cancellation_token_t cancellation;
+};
+
+struct tcp_connect_result_t {
+    asio::ip::tcp::endpoint endpoint;  // endpoint which won the race
+    std::chrono::microseconds dns_time{};
+    std::chrono::microseconds tcp_time{};
+    size_t endpoints_resolved = 0;
+    size_t attempts_started = 0;
+};
+
+// Resolves host asynchronously and connects to one of resolved addresses in Happy Eyeballs
+// fashion: addresses are ordered alternating IPv6 and IPv4, attempts are started one after another
+// with connection_attempt_delay in between (or immediately if previous attempt failed) and the
+// first connection established wins while the rest are cancelled. Winning connection is moved
+// into target_socket which must stay alive until callback is called.
+void async_happy_eyeballs_connect(asio::io_context& ctx,
+                                  std::string host,
+                                  std::string port,
+                                  asio::ip::tcp::socket& target_socket,
+                                  async_callback<tcp_connect_result_t> cb,
+                                  tcp_connect_opts_t opts = {});
+
+// Orders endpoints for connection attempts: alternates address families starting with the family
+// of the first endpoint as returned by resolver (RFC8305, section 4).
+std::vector<asio::ip::tcp::endpoint> interleave_address_families(
+    std::vector<asio::ip::tcp::endpoint> endpoints);
+
+}  // namespace emailkit
@@ -0,0 +1,95 @@
+#include "timer_wheel.hpp"
+
+namespace emailkit {
+
+asio::execution_context::id timer_wheel_t::id;
+
+timer_wheel_t::timer_wheel_t(asio::io_context& ctx)
+    : asio::execution_context::service(ctx), m_timer(ctx) {}
+
+timer_wheel_t::timer_id_t timer_wheel_t::schedule(steady_clock::time_point deadline,
+                                                  fu2::unique_function<void()> cb) {
+    if (!m_ticking) {
+        m_current_slot_time = steady_clock::now();
+    }
+
+    const auto ticks_ahead = std::max<int64_t>(
+        1, (deadline - m_current_slot_time + TICK - steady_clock::duration{1}) / TICK);
+    // Deadlines further than one turn of the wheel stay in their slot for several turns.
+    const size_t slot = (m_current_slot + static_cast<size_t>(ticks_ahead)) % SLOTS;
+
+    const auto id = ++m_last_id;
+    auto& entries = m_slots[slot];
+    entries.push_back(entry_t{id, deadline, std::move(cb)});
+    m_index.emplace(id, std::make_pair(slot, std::prev(entries.end())));
+
+    start_ticking();
+    return id;
+}
+
+void timer_wheel_t::cancel(timer_id_t id) {
+    auto it = m_index.find(id);
+    if (it == m_index.end()) {
+        return;
+    }
+    auto [slot, entry_it] = it->second;
+    m_slots[slot].erase(entry_it);
+    m_index.erase(it);
+}
+
+void timer_wheel_t::shutdown() {
+    m_timer.cancel();
+    for (auto& slot : m_slots) {
+        slot.clear();
+    }
+    m_index.clear();
+}
+
+void timer_wheel_t::start_ticking() {
+    if (std::exchange(m_ticking, true)) {
+        return;
+    }
+    m_timer.expires_at(m_current_slot_time + TICK);
+    m_timer.async_wait([this](std::error_code ec) {
+        if (ec) {
+            return;
+        }
+        on_tick();
+    });
+}
+
+void timer_wheel_t::on_tick() {
+    const auto now = steady_clock::now();
+
+    // Loop may have been busy for more than one tick, all slots we are late for are processed.
+    const auto elapsed_ticks = std::max<int64_t>(1, (now - m_current_slot_time) / TICK);
+    const size_t slots_to_process = std::min<size_t>(elapsed_ticks, SLOTS);
+
+    std::vector<fu2::unique_function<void()>> expired;
+    for (size_t i = 0; i < slots_to_process; ++i) {
+        m_current_slot = (m_current_slot + 1) % SLOTS;
+        auto& entries = m_slots[m_current_slot];
+        for (auto it = entries.begin(); it != entries.end();) {
+            if (it->deadline <= now) {
+                expired.emplace_back(std::move(it->cb));
+                m_index.erase(it->id);
+                it = entries.erase(it);
+            } else {
+                ++it;
+            }
+        }
+    }
+    m_current_slot_time += elapsed_ticks * TICK;
+
+    m_ticking = false;
+    if (!m_index.empty()) {
+        start_ticking();
+    }
+
+    // Callbacks may schedule and cancel timers.
+    for (auto& cb : expired) {
+        cb();
+    }
+}
+
+}  // namespace emailkit
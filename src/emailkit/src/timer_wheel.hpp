@@ -0,0 +1,66 @@
+#pragma once
+#include <emailkit/global.hpp>
+#include <array>
+#include <asio/io_context.hpp>
+#include <asio/steady_timer.hpp>
+#include <list>
+#include <unordered_map>
+
+namespace emailkit {
+
+// Hashed timer wheel serving deadlines of all calls made on one io_context. There can be
+// thousands of pending calls (accounts x pipelined commands) and almost none of them ever expire,
+// so instead of arming steady_timer per call, deadlines are put into slots of TICK granularity
+// and one steady_timer ticks only while there is something scheduled. Scheduling and cancelling
+// are O(1).
+//
+// One instance per io_context (asio service), get it with timer_wheel_t::of(ctx). Not thread
+// safe, to be used from the thread running io_context. Callbacks are called on that thread.
+class timer_wheel_t : public asio::execution_context::service {
+   public:
+    using key_type = timer_wheel_t;
+    using timer_id_t = uint64_t;
+    using steady_clock = std::chrono::steady_clock;
+
+    static constexpr auto TICK = 100ms;
+    static constexpr size_t SLOTS = 512;
+
+    static asio::execution_context::id id;
+
+    static timer_wheel_t& of(asio::io_context& ctx) {
+        return asio::use_service<timer_wheel_t>(ctx);
+    }
+
+    explicit timer_wheel_t(asio::io_context& ctx);
+
+    // Callback is called within TICK after deadline passes (at the next tick for past deadlines).
+    timer_id_t schedule(steady_clock::time_point deadline, fu2::unique_function<void()> cb);
+
+    // Does nothing if timer has already fired or cancelled.
+    void cancel(timer_id_t id);
+
+    size_t size() const { return m_index.size(); }
+
+   private:
+    struct entry_t {
+        timer_id_t id;
+        steady_clock::time_point deadline;
+        fu2::unique_function<void()> cb;
+    };
+    using slot_t = std::list<entry_t>;
+
+    void shutdown() override;
+
+    void start_ticking();
+    void on_tick();
+
+    asio::steady_timer m_timer;
+    std::array<slot_t, SLOTS> m_slots;
+    std::unordered_map<timer_id_t, std::pair<size_t, slot_t::iterator>> m_index;
+    size_t m_current_slot = 0;
+    steady_clock::time_point m_current_slot_time;  // when current slot has been processed
+    bool m_ticking = false;
+    timer_id_t m_last_id = 0;
+};
+
+}  // namespace emailkit
@@ -0,0 +1,98 @@
+#include "tls_session_cache.hpp"
+
+#include <asio/ip/address.hpp>
+
+namespace emailkit {
+
+tls_session_cache_t& tls_session_cache_t::instance() {
+    static tls_session_cache_t inst;
+    return inst;
+}
+
+int tls_session_cache_t::key_ex_data_index() {
+    // Holds pointer to string with cache key, owned by whoever owns SSL object.
+    static const int index = SSL_get_ex_new_index(0, nullptr, nullptr, nullptr, nullptr);
+    return index;
+}
+
+std::shared_ptr<asio::ssl::context> tls_session_cache_t::client_context() {
+    std::lock_guard lock{m_mutex};
+    if (!m_client_context) {
+        m_client_context = std::make_shared<asio::ssl::context>(asio::ssl::context::sslv23);
+        SSL_CTX* native_ctx = m_client_context->native_handle();
+        // Internal store is server oriented (keyed by session id), client sessions are kept here.
+        SSL_CTX_set_session_cache_mode(native_ctx,
+                                       SSL_SESS_CACHE_CLIENT | SSL_SESS_CACHE_NO_INTERNAL_STORE);
+        SSL_CTX_sess_set_new_cb(native_ctx, &tls_session_cache_t::on_new_session);
+    }
+    return m_client_context;
+}
+
+bool tls_session_cache_t::prepare_handshake(SSL* ssl,
+                                            const std::string& host,
+                                            const std::string& key) {
+    // SNI is needed not only for picking certificate but also for server to accept resumption.
+    // Literal IP addresses are not allowed in SNI (RFC6066, section 3).
+    std::error_code ec;
+    asio::ip::make_address(host, ec);
+    if (ec && !SSL_set_tlsext_host_name(ssl, host.c_str())) {
+        log_warning("failed to set SNI for {}", host);
+    }
+
+    SSL_set_ex_data(ssl, key_ex_data_index(), const_cast<std::string*>(&key));
+
+    std::shared_ptr<SSL_SESSION> session;
+    {
+        std::lock_guard lock{m_mutex};
+        auto it = m_sessions.find(key);
+        if (it == m_sessions.end()) {
+            return false;
+        }
+        session = it->second;
+    }
+
+    if (!SSL_SESSION_is_resumable(session.get())) {
+        forget(key);
+        return false;
+    }
+
+    if (!SSL_set_session(ssl, session.get())) {
+        log_warning("failed to set cached TLS session for {}", key);
+        return false;
+    }
+    log_debug("attached cached TLS session for {}", key);
+    return true;
+}
+
+void tls_session_cache_t::forget(const std::string& key) {
+    std::lock_guard lock{m_mutex};
+    m_sessions.erase(key);
+}
+
+size_t tls_session_cache_t::size() const {
+    std::lock_guard lock{m_mutex};
+    return m_sessions.size();
+}
+
+int tls_session_cache_t::on_new_session(SSL* ssl, SSL_SESSION* session) {
+    auto* key = static_cast<const std::string*>(SSL_get_ex_data(ssl, key_ex_data_index()));
+    if (!key) {
+        return 0;  // not our connection, OpenSSL keeps ownership.
+    }
+
+    // Connections are not shut down with close_notify so OpenSSL marks their sessions as not
+    // resumable when SSL object goes away. Copy is not affected by that.
+    SSL_SESSION* session_copy = SSL_SESSION_dup(session);
+    if (!session_copy) {
+        log_warning("failed to copy TLS session for {}", *key);
+        return 0;
+    }
+
+    log_debug("got new TLS session for {}", *key);
+    auto& cache = instance();
+    std::lock_guard lock{cache.m_mutex};
+    cache.m_sessions[*key] = std::shared_ptr<SSL_SESSION>(session_copy, &SSL_SESSION_free);
+    return 0;  // reference to original session stays with OpenSSL
+}
+
+}  // namespace emailkit
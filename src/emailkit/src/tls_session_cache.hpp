@@ -0,0 +1,42 @@
+#pragma once
+#include <emailkit/global.hpp>
+#include <asio/ssl/context.hpp>
+#include <mutex>
+
+namespace emailkit {
+
+// Process-wide client side cache of TLS sessions keyed by "host:port".
+//
+// All imap sockets share one SSL context which is configured to hand every new session to the
+// cache, including TLS 1.3 session tickets that server sends after handshake is done. Before
+// handshake the socket asks cache to attach a session previously received from the same host so
+// that reconnect (e.g. from autoconnect timer or after network flap) is an abbreviated handshake.
+// If server declines resumption, full handshake happens as usual.
+class tls_session_cache_t {
+   public:
+    static tls_session_cache_t& instance();
+
+    // SSL context for client connections which feeds this cache.
+    std::shared_ptr<asio::ssl::context> client_context();
+
+    // Prepares SSL object for handshake with host: sets SNI and cached session if there is one.
+    // Returns true if session for resumption has been attached.
+    bool prepare_handshake(SSL* ssl, const std::string& host, const std::string& key);
+
+    // Drops session, e.g. after handshake using it has failed.
+    void forget(const std::string& key);
+
+    size_t size() const;
+
+   private:
+    tls_session_cache_t() = default;
+
+    static int on_new_session(SSL* ssl, SSL_SESSION* session);
+    static int key_ex_data_index();
+
+    mutable std::mutex m_mutex;
+    std::shared_ptr<asio::ssl::context> m_client_context;
+    std::map<std::string, std::shared_ptr<SSL_SESSION>> m_sessions;
+};
+
+}  // namespace emailkit
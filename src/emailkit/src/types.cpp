@@ -76,6 +76,23 @@ std::string to_json(const MailboxEmail& mail) {
         writer.Null();
     }
 
+    writer.Key("gmail_message_id");
+    if (mail.gmail_message_id.has_value()) {
+        writer.Uint64(*mail.gmail_message_id);
+    } else {
+        writer.Null();
+    }
+
+    writer.Key("gmail_thread_id");
+    if (mail.gmail_thread_id.has_value()) {
+        writer.Uint64(*mail.gmail_thread_id);
+    } else {
+        writer.Null();
+    }
+
+    writer.Key("gmail_labels");
+    encode_string_vec(writer, mail.gmail_labels);
+
     writer.Key("raw_headers");
     writer.StartObject();
     for (auto& [h, v] : mail.raw_headers) {
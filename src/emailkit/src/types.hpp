@@ -30,6 +30,10 @@ struct Attachment {
     std::string subtype;
     std::string name;
     uint32_t octets;
+    // Section of the part in BODYSTRUCTURE (e.g. "2"), to load it with
+    // imap_client_t::async_fetch_message_part when it is opened.
+    std::string part_id;
+    std::string encoding;  // Content-Transfer-Encoding of the part, e.g. "BASE64"
 };
 
 struct MailboxEmail {
@@ -58,6 +62,14 @@ struct MailboxEmail {
     optional<MessageID> in_reply_to;
     optional<std::vector<MessageID>> references;
 
+    // Gmail ids (X-GM-MSGID, X-GM-THRID), present only for servers with X-GM-EXT-1. Messages of
+    // the same conversation have the same thread id, so References are not needed for threading.
+    optional<uint64_t> gmail_message_id;
+    optional<uint64_t> gmail_thread_id;
+    // Gmail labels (X-GM-LABELS) which are folders the message is shown in, e.g. "\\Inbox",
+    // "Work/Projects". Message is in one place on the server (All Mail) regardless of them.
+    vector<string> gmail_labels;
+
     map<string, string> raw_headers;
 
     vector<Attachment> attachments;
@@ -0,0 +1,43 @@
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include <emailkit/call_opts.hpp>
+
+#include <thread>
+
+using namespace emailkit;
+
+TEST(call_opts_test, cancellation_calls_registered_callbacks_once) {
+    cancellation_source_t source;
+    auto token = source.token();
+    EXPECT_TRUE(token.can_be_cancelled());
+    EXPECT_FALSE(token.is_cancelled());
+
+    int called = 0;
+    int unregistered_called = 0;
+    auto registration = token.on_cancel([&] { ++called; });
+    {
+        auto short_lived = token.on_cancel([&] { ++unregistered_called; });
+    }
+
+    std::thread{[&] { source.cancel(); }}.join();
+    source.cancel();
+
+    EXPECT_TRUE(token.is_cancelled());
+    EXPECT_EQ(called, 1);
+    EXPECT_EQ(unregistered_called, 0);
+
+    // Registering on cancelled token calls right away.
+    bool late_called = false;
+    auto late = token.on_cancel([&] { late_called = true; });
+    EXPECT_TRUE(late_called);
+}
+
+TEST(call_opts_test, default_opts_are_unconstrained) {
+    EXPECT_TRUE(call_opts_t{}.unconstrained());
+    EXPECT_FALSE(cancellation_token_t{}.can_be_cancelled());
+    EXPECT_FALSE(call_opts_t::timeout(1s).unconstrained());
+
+    cancellation_source_t source;
+    EXPECT_FALSE(call_opts_t{.cancellation = source.token()}.unconstrained());
+}
@@ -0,0 +1,95 @@
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include <emailkit/connection_health.hpp>
+
+using namespace emailkit;
+
+namespace {
+using steady_clock = std::chrono::steady_clock;
+const auto T0 = steady_clock::time_point{} + 1h;
+}  // namespace
+
+TEST(connection_health_test, measures_rtt_and_bandwidth) {
+    connection_health_estimator_t e;
+    e.on_command_sent("A1", T0);
+    e.on_bytes_sent(30, T0);
+    e.on_bytes_received(100, T0 + 40ms);  // first byte of response, opens bandwidth window
+    for (int i = 1; i <= 10; ++i) {
+        e.on_bytes_received(100 * 1024, T0 + 40ms + i * 100ms);
+    }
+    e.on_tagged_response("A1", T0 + 1040ms);
+
+    auto h = e.snapshot(T0 + 1040ms);
+    EXPECT_EQ(h.rtt, 40ms);
+    EXPECT_EQ(h.last_rtt, 40ms);
+    EXPECT_NEAR(h.bandwidth, 1000 * 1024, 1024);  // 100Kb every 100ms
+    EXPECT_EQ(h.bytes_sent_total, 30);
+    EXPECT_EQ(h.bytes_received_total, 100 + 10 * 100 * 1024);
+    EXPECT_EQ(h.commands_in_flight, 0);
+    EXPECT_EQ(h.grade, link_grade_t::green);
+}
+
+TEST(connection_health_test, pending_command_without_traffic_is_a_stall) {
+    connection_health_estimator_t e;
+    e.on_command_sent("A1", T0);
+    e.on_bytes_received(100, T0 + 50ms);
+
+    EXPECT_EQ(e.grade(T0 + 1s), link_grade_t::green);
+    EXPECT_EQ(e.grade(T0 + 5s), link_grade_t::yellow);
+    auto h = e.snapshot(T0 + 20s);
+    EXPECT_EQ(h.grade, link_grade_t::red);
+    EXPECT_EQ(h.pending_silence, 20s - 50ms);
+
+    // Traffic comes back (e.g. left the lift).
+    e.on_bytes_received(100, T0 + 20s);
+    EXPECT_EQ(e.grade(T0 + 20s), link_grade_t::green);
+    e.on_tagged_response("A1", T0 + 20s);
+    EXPECT_EQ(e.grade(T0 + 60s), link_grade_t::green);
+}
+
+TEST(connection_health_test, idle_and_continuation_are_not_stalls) {
+    connection_health_estimator_t e;
+    EXPECT_EQ(e.grade(T0 + 1h), link_grade_t::green);
+
+    e.on_command_sent("A1", T0);
+    e.on_bytes_received(20, T0 + 30ms);
+    e.on_continuation_request(T0 + 30ms);
+    EXPECT_EQ(e.grade(T0 + 10min), link_grade_t::green);
+
+    // Our answer to continuation request has no tag of its own.
+    e.on_command_sent("", T0 + 10min);
+    EXPECT_EQ(e.snapshot(T0 + 10min).commands_in_flight, 1);
+    EXPECT_EQ(e.grade(T0 + 10min + 15s), link_grade_t::red);
+}
+
+TEST(connection_health_test, rtt_is_sampled_only_for_commands_sent_alone) {
+    connection_health_estimator_t e;
+    e.on_command_sent("A1", T0);
+    e.on_command_sent("A2", T0 + 10ms);
+    e.on_bytes_received(100, T0 + 100ms);
+    e.on_tagged_response("A1", T0 + 100ms);
+    e.on_bytes_received(100, T0 + 900ms);
+    e.on_tagged_response("A2", T0 + 900ms);
+    EXPECT_EQ(e.snapshot(T0 + 900ms).rtt, 100ms);
+
+    // Completion of later command completes earlier ones too.
+    e.on_command_sent("A3", T0 + 1s);
+    e.on_command_sent("A4", T0 + 1s);
+    e.on_tagged_response("A4", T0 + 2s);
+    EXPECT_EQ(e.snapshot(T0 + 2s).commands_in_flight, 0);
+}
+
+TEST(connection_health_test, high_rtt_degrades_grade) {
+    connection_health_estimator_t e;
+    e.on_command_sent("A1", T0);
+    e.on_bytes_received(100, T0 + 2s);
+    e.on_tagged_response("A1", T0 + 2s);
+    EXPECT_EQ(e.grade(T0 + 2s), link_grade_t::yellow);
+
+    // Stall is not folded into RTT.
+    e.on_command_sent("A2", T0 + 3s);
+    e.on_bytes_received(100, T0 + 60s);
+    e.on_tagged_response("A2", T0 + 60s);
+    EXPECT_EQ(e.snapshot(T0 + 60s).rtt, 2s);
+}
@@ -0,0 +1,112 @@
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include <emailkit/compressing_stream.hpp>
+#include <emailkit/deflate_codec.hpp>
+
+#include <asio.hpp>
+
+using namespace emailkit;
+
+namespace {
+std::string make_headers_like_text() {
+    std::string text;
+    for (int i = 0; i < 200; ++i) {
+        text += fmt::format(
+            "* {} FETCH (UID {} RFC822.HEADER {{62}}\r\nDelivered-To: someone@gmail.com\r\n"
+            "Subject: hello\r\n\r\n)\r\n",
+            i + 1, i + 100);
+    }
+    return text;
+}
+}  // namespace
+
+TEST(deflate_codec_test, round_trip) {
+    deflate_codec_t sender, receiver;
+    ASSERT_FALSE(sender.init_error());
+    ASSERT_FALSE(receiver.init_error());
+
+    const std::string text = make_headers_like_text();
+    std::string compressed;
+    ASSERT_FALSE(sender.deflate(text, compressed));
+    EXPECT_LT(compressed.size(), text.size() / 4);
+
+    // Feed receiver in small pieces as they would come from the network.
+    std::string inflated;
+    for (size_t offset = 0; offset < compressed.size(); offset += 7) {
+        ASSERT_FALSE(receiver.inflate(std::string_view{compressed}.substr(offset, 7), inflated));
+    }
+    EXPECT_EQ(inflated, text);
+    EXPECT_EQ(receiver.inflated_bytes_in(), compressed.size());
+    EXPECT_EQ(receiver.inflated_bytes_out(), text.size());
+}
+
+TEST(deflate_codec_test, each_chunk_is_flushed) {
+    deflate_codec_t sender, receiver;
+    for (std::string_view chunk : {"A1 COMPRESS DEFLATE\r\n", "A2 NOOP\r\n"}) {
+        std::string compressed, inflated;
+        ASSERT_FALSE(sender.deflate(chunk, compressed));
+        ASSERT_FALSE(receiver.inflate(compressed, inflated));
+        EXPECT_EQ(inflated, chunk);
+    }
+}
+
+TEST(deflate_codec_test, garbage_is_error) {
+    deflate_codec_t receiver;
+    std::string inflated;
+    EXPECT_TRUE(receiver.inflate("\xff\xff\xff\xff garbage", inflated));
+}
+
+TEST(compressing_stream_test, reads_and_writes_through_compression) {
+    asio::io_context ctx;
+    asio::ip::tcp::acceptor acceptor{
+        ctx, asio::ip::tcp::endpoint{asio::ip::make_address("127.0.0.1"), 0}};
+    asio::ip::tcp::socket server_socket{ctx};
+    asio::ip::tcp::socket client_socket{ctx};
+    acceptor.async_accept(server_socket, [](std::error_code) {});
+    client_socket.connect(acceptor.local_endpoint());
+    ctx.run();
+    ctx.restart();
+
+    compressing_stream_t<asio::ip::tcp::socket> client_stream{client_socket};
+    deflate_codec_t server_codec;
+
+    // Server response to COMPRESS arrives uncompressed, with compressed data right after it.
+    std::string server_output = "A1 OK DEFLATE active\r\n";
+    const size_t compressed_part_offset = server_output.size();
+    ASSERT_FALSE(server_codec.deflate("* 1 EXISTS\r\nA2 OK done\r\n", server_output));
+    asio::write(server_socket, asio::buffer(server_output));
+
+    std::string recv_buff;
+    size_t line_size = 0;
+    asio::async_read_until(client_stream, asio::dynamic_buffer(recv_buff), "\r\n",
+                           [&](std::error_code ec, size_t n) {
+                               ASSERT_FALSE(ec);
+                               line_size = n;
+                           });
+    ctx.run();
+    ctx.restart();
+    ASSERT_EQ(line_size, compressed_part_offset);
+
+    ASSERT_FALSE(client_stream.start_compression(std::string_view{recv_buff}.substr(line_size)));
+    recv_buff.clear();
+
+    asio::async_read_until(client_stream, asio::dynamic_buffer(recv_buff), "A2 OK done\r\n",
+                           [&](std::error_code ec, size_t) { ASSERT_FALSE(ec); });
+    ctx.run();
+    ctx.restart();
+    EXPECT_EQ(recv_buff, "* 1 EXISTS\r\nA2 OK done\r\n");
+
+    const std::string command = "A3 NOOP\r\n";
+    asio::async_write(client_stream, asio::buffer(command), [&](std::error_code ec, size_t n) {
+        ASSERT_FALSE(ec);
+        EXPECT_EQ(n, command.size());
+    });
+    ctx.run();
+
+    std::string compressed(1024, '\0');
+    compressed.resize(server_socket.read_some(asio::buffer(compressed)));
+    std::string inflated;
+    ASSERT_FALSE(server_codec.inflate(compressed, inflated));
+    EXPECT_EQ(inflated, command);
+}
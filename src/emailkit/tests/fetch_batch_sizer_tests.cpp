@@ -0,0 +1,99 @@
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include <emailkit/fetch_batch_sizer.hpp>
+
+using namespace emailkit;
+
+namespace {
+fetch_stats_t work_of(int messages, size_t bytes_per_message, std::chrono::microseconds parse) {
+    return {.responses = 1,
+            .messages = static_cast<size_t>(messages),
+            .response_bytes = messages * bytes_per_message,
+            .parse_time = parse};
+}
+}  // namespace
+
+TEST(fetch_batch_sizer_test, grows_for_small_messages_and_shrinks_for_big_ones) {
+    fetch_batch_sizer_t sizer{{.initial_batch = 50,
+                               .max_batch = 1000,
+                               .target_response_bytes = 512 * 1024,
+                               .target_parse_time = 1s}};
+
+    // Newsletter-like mailbox: 1Kb per message, growth is limited to twice per batch.
+    int n = sizer.begin_batch();
+    EXPECT_EQ(n, 50);
+    sizer.on_batch_completed(n, n, work_of(n, 1024, 5ms), 100ms, {});
+    EXPECT_EQ(sizer.batch_size(), 100);
+    for (int i = 0; i < 10; ++i) {
+        n = sizer.begin_batch();
+        sizer.on_batch_completed(n, n, work_of(n, 1024, 5ms), 100ms, {});
+    }
+    EXPECT_EQ(sizer.batch_size(), 512);
+
+    // Big headers: shrinks at once.
+    for (int i = 0; i < 10; ++i) {
+        n = sizer.begin_batch();
+        sizer.on_batch_completed(n, n, work_of(n, 64 * 1024, 5ms), 100ms, {});
+    }
+    EXPECT_EQ(sizer.batch_size(), 8);
+
+    auto m = sizer.metrics();
+    EXPECT_EQ(m.smallest_batch, 8);
+    EXPECT_EQ(m.largest_batch, 512);
+    EXPECT_EQ(m.batches, 21);
+    EXPECT_NEAR(m.bytes_per_message, 64 * 1024, 4 * 1024);  // EWMA converges
+    EXPECT_EQ(m.bytes_in_flight, 0);
+}
+
+TEST(fetch_batch_sizer_test, limited_by_parse_time_latency_and_memory) {
+    fetch_batch_sizer_t sizer{{.initial_batch = 100,
+                               .target_response_bytes = 1024 * 1024,
+                               .target_parse_time = 100ms,
+                               .target_latency = 2s,
+                               .max_bytes_in_flight = 100 * 1024}};
+
+    // 2ms of parsing per message, 50 messages fit into parse time target.
+    int n = sizer.begin_batch();
+    sizer.on_batch_completed(n, n, work_of(n, 1024, n * 2ms), 100ms, {});
+    EXPECT_EQ(sizer.batch_size(), 50);
+
+    // Batch took twice as long as wanted.
+    n = sizer.begin_batch();
+    sizer.on_batch_completed(n, n, work_of(n, 1024, n * 1ms), 4s, {});
+    EXPECT_EQ(sizer.batch_size(), 25);
+
+    // Two batches of 1Kb messages in flight take the whole ceiling of 100Kb.
+    sizer.on_batch_completed(n, 0, work_of(0, 0, 0ms), 100ms, {});
+    ASSERT_EQ(sizer.batch_size(), 50);
+    EXPECT_EQ(sizer.begin_batch(), 50);
+    EXPECT_EQ(sizer.begin_batch(), 50);
+    EXPECT_EQ(sizer.begin_batch(), 5);  // min_batch
+}
+
+TEST(fetch_batch_sizer_test, slow_link_lifts_target_to_bandwidth_delay_product) {
+    fetch_batch_sizer_t sizer{{.initial_batch = 500,
+                               .target_response_bytes = 64 * 1024,
+                               .target_parse_time = 10s}};
+    int n = sizer.begin_batch();
+    // 1Mb/s with 500ms RTT, 512Kb are in flight before the first byte comes back.
+    sizer.on_batch_completed(n, n, work_of(n, 1024, 1ms), 1s,
+                             connection_health_t{.bandwidth = 1024 * 1024, .rtt = 500ms});
+    EXPECT_EQ(sizer.batch_size(), 512);
+}
+
+TEST(fetch_batch_sizer_test, counts_delivered_messages) {
+    fetch_batch_sizer_t sizer{{.initial_batch = 50}};
+
+    // Last batch of a mailbox gets fewer messages than asked for, stats of the connection include
+    // another batch pipelined with it.
+    int n = sizer.begin_batch();
+    sizer.on_batch_completed(n, 20, work_of(70, 1024, 1ms), 100ms, {});
+    n = sizer.begin_batch();
+    sizer.on_batch_completed(n, n, work_of(n, 1024, 1ms), 100ms, {});
+    n = sizer.begin_batch();
+    sizer.on_batch_failed(n);
+
+    EXPECT_EQ(sizer.metrics().batches, 3);
+    EXPECT_EQ(sizer.metrics().messages, 20 + 100);
+}
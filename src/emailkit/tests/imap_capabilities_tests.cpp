@@ -0,0 +1,47 @@
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include <emailkit/imap_capabilities.hpp>
+
+using namespace emailkit::imap_client;
+using namespace testing;
+
+TEST(imap_capabilities_test, parses_capability_response) {
+    auto caps = imap_capabilities_t::from_response_line(
+        "* CAPABILITY IMAP4rev1 UNSELECT IDLE X-GM-EXT-1 COMPRESS=DEFLATE ENABLE CONDSTORE "
+        "ESEARCH LITERAL- SPECIAL-USE AUTH=XOAUTH2\r\n");
+    ASSERT_TRUE(caps);
+    EXPECT_TRUE(caps->known());
+    EXPECT_TRUE(caps->has(imap_capability_t::idle));
+    EXPECT_TRUE(caps->has(imap_capability_t::gmail_ext));
+    EXPECT_TRUE(caps->has(imap_capability_t::compress_deflate));
+    EXPECT_TRUE(caps->has(imap_capability_t::condstore));
+    EXPECT_TRUE(caps->has(imap_capability_t::esearch));
+    EXPECT_TRUE(caps->has(imap_capability_t::literal_minus));
+    EXPECT_FALSE(caps->has(imap_capability_t::literal_plus));
+    EXPECT_FALSE(caps->has(imap_capability_t::qresync));
+    EXPECT_FALSE(caps->has(imap_capability_t::binary));
+    EXPECT_TRUE(caps->has("auth=xoauth2"));
+    EXPECT_FALSE(caps->has("AUTH=PLAIN"));
+    EXPECT_EQ(caps->names().front(), "IMAP4REV1");
+}
+
+TEST(imap_capabilities_test, parses_capability_response_code) {
+    auto greeting = imap_capabilities_t::from_response_line(
+        "* OK [CAPABILITY IMAP4rev1 LITERAL+ idle STARTTLS] Dovecot ready.\r\n");
+    ASSERT_TRUE(greeting);
+    EXPECT_TRUE(greeting->has(imap_capability_t::literal_plus));
+    EXPECT_TRUE(greeting->has(imap_capability_t::idle));
+    EXPECT_THAT(greeting->names(), ElementsAre("IMAP4REV1", "LITERAL+", "IDLE", "STARTTLS"));
+
+    auto tagged = imap_capabilities_t::from_response_line(
+        "A1 OK [CAPABILITY IMAP4rev1 QRESYNC BINARY] Logged in\r\n");
+    ASSERT_TRUE(tagged);
+    EXPECT_TRUE(tagged->has(imap_capability_t::qresync));
+    EXPECT_TRUE(tagged->has(imap_capability_t::binary));
+
+    EXPECT_FALSE(imap_capabilities_t::from_response_line("* OK Gimap ready\r\n"));
+    EXPECT_FALSE(imap_capabilities_t::from_response_line("A1 OK [READ-WRITE] done\r\n"));
+    EXPECT_FALSE(imap_capabilities_t::from_response_line("* OK [CAPABILITY IMAP4rev1\r\n"));
+    EXPECT_FALSE(imap_capabilities_t{}.known());
+}
@@ -0,0 +1,43 @@
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include <emailkit/imap_client_coro.hpp>
+
+#include <asio/co_spawn.hpp>
+#include <asio/detached.hpp>
+#include <asio/io_context.hpp>
+
+using namespace emailkit::imap_client;
+
+TEST(imap_client_coro_test, awaits_callbacks_called_in_place_and_later) {
+    asio::io_context ctx;
+
+    bool test_ran = false;
+    asio::co_spawn(
+        ctx,
+        [&]() -> asio::awaitable<void> {
+            // Called before initiation returns, e.g. validation error.
+            auto [ec, value] = co_await coro::async_await<int>([](async_callback<int> cb) {
+                cb(make_error_code(std::errc::invalid_argument), 0);
+            });
+            EXPECT_EQ(ec, std::errc::invalid_argument);
+
+            std::tie(ec, value) = co_await coro::async_await<int>([&](async_callback<int> cb) {
+                asio::post(ctx, [cb = std::move(cb)]() mutable { cb({}, 42); });
+            });
+            EXPECT_FALSE(ec);
+            EXPECT_EQ(value, 42);
+
+            auto [void_ec] = co_await coro::async_await<void>([&](async_callback<void> cb) {
+                asio::post(ctx, [cb = std::move(cb)]() mutable {
+                    cb(make_error_code(std::errc::timed_out));
+                });
+            });
+            EXPECT_EQ(void_ec, std::errc::timed_out);
+            test_ran = true;
+        },
+        asio::detached);
+
+    ctx.run_for(std::chrono::seconds(1));
+    EXPECT_TRUE(test_ran);
+}
@@ -344,6 +344,61 @@ TEST(imap_client_test, gmail_imap_xoauth_success_test) {
     EXPECT_TRUE(test_ran);
 }
 
+TEST(imap_client_test, capabilities_queried_after_authentication) {
+    asio::io_context ctx;
+
+    fake_imap_server srv{ctx, "localhost", "9934"};
+    ASSERT_FALSE(srv.start());
+
+    bool test_ran = false;
+
+    // Greeting comes with the first response, capabilities announced there are the ones before
+    // authentication.
+    srv.reply_once(
+        [&](std::error_code ec, std::tuple<std::string, async_callback<std::string>> line_and_cb) {
+            auto& [line, cb] = line_and_cb;
+            auto maybe_cmd = parse_imap_command(line);
+            ASSERT_TRUE(maybe_cmd);
+            EXPECT_EQ(maybe_cmd->tokens[1], "AUTHENTICATE");
+            cb({}, fmt::format("* OK [CAPABILITY IMAP4rev1 AUTH=XOAUTH2] ready\r\n"
+                               "{} OK Success\r\n",
+                               maybe_cmd->tokens[0]));
+        });
+    srv.reply_once(
+        [&](std::error_code ec, std::tuple<std::string, async_callback<std::string>> line_and_cb) {
+            auto& [line, cb] = line_and_cb;
+            auto maybe_cmd = parse_imap_command(line);
+            ASSERT_TRUE(maybe_cmd);
+            EXPECT_EQ(maybe_cmd->tokens[1], "CAPABILITY");
+            cb({}, fmt::format("* CAPABILITY IMAP4rev1 IDLE X-GM-EXT-1\r\n"
+                               "{} OK Thats all she wrote!\r\n",
+                               maybe_cmd->tokens[0]));
+        });
+
+    auto client = make_imap_client(ctx);
+    client->async_connect("localhost", "9934", [&](std::error_code ec) {
+        ASSERT_FALSE(ec);
+        EXPECT_FALSE(client->capabilities().known());
+
+        client->async_authenticate(
+            {.user_email = "alan.kay@example.com", .oauth_token = "[alan_kay_oauth_token]"},
+            [&](std::error_code ec, auto details) {
+                ASSERT_FALSE(ec);
+                const auto& caps = client->capabilities();
+                EXPECT_TRUE(caps.has(imap_client::imap_capability_t::idle));
+                EXPECT_TRUE(caps.has(imap_client::imap_capability_t::gmail_ext));
+                EXPECT_FALSE(caps.has("AUTH=XOAUTH2"));
+                EXPECT_FALSE(caps.has(imap_client::imap_capability_t::compress_deflate));
+                ctx.stop();
+                test_ran = true;
+            });
+    });
+
+    ctx.run_for(std::chrono::seconds(1));
+
+    EXPECT_TRUE(test_ran);
+}
+
 TEST(imap_client_test, gmail_imap_xoauth_failure_400_test) {
     // Test recorded from experiments with gmail imap server. In this particular example gmail imap
     // complains about lack of scope.
@@ -1010,7 +1065,7 @@ TEST(imap_client_test, select_command_basic_test) {
                 "* 0 RECENT\r\n"
                 "* OK [UNSEEN 3] Unseen count.\r\n"
                 "* OK [UIDNEXT 10] Predicted next UID.\r\n"
-                "* OK [HIGHESTMODSEQ 1909]\r\n" // Note, this ignored by parser (TODO: implement)
+                "* OK [HIGHESTMODSEQ 1909]\r\n"
                 "{} OK [READ-WRITE] INBOX selected. (Success)\r\n", cmd.tokens[0]);
             // clang-format on
 
@@ -1036,6 +1091,7 @@ TEST(imap_client_test, select_command_basic_test) {
                 EXPECT_EQ(r.recents, 0);
                 EXPECT_EQ(r.opt_unseen, 3);
                 EXPECT_EQ(r.uid_next, 10);
+                EXPECT_EQ(r.highest_modseq, 1909);
                 EXPECT_EQ(r.read_write_mode,
                           emailkit::imap_client::types::read_write_mode_t::read_write);
 
@@ -1082,7 +1138,7 @@ TEST(imap_client_test, select_command_invalid_response_basic_test) {
                 "* 0 RECENT\r\n"
                 "* OK [UNSEEN 3] Unseen count.\r\n"
                 "* OK [UIDNEXT 10] Predicted next UID.\r\n"
-                "* OK [HIGHESTMODSEQ 1909]\r\n" // Note, this ignored by parser (TODO: implement)
+                "* OK [HIGHESTMODSEQ 1909]\r\n"
                 "{} OK [READ-WRITE] INBOX selected. (Success)\r\n", cmd.tokens[0]);
             // clang-format on
 
@@ -1148,7 +1204,7 @@ TEST(imap_client_test, fetch_command_result_of_mailbox_data_test) {
                 "* 0 RECENT\r\n"
                 "* OK [UNSEEN 3] Unseen count.\r\n"
                 "* OK [UIDNEXT 10] Predicted next UID.\r\n"
-                "* OK [HIGHESTMODSEQ 1909]\r\n" // Note, this ignored by parser (TODO: implement)
+                "* OK [HIGHESTMODSEQ 1909]\r\n"
                 "{} OK [READ-WRITE] INBOX selected. (Success)\r\n", cmd.tokens[0]);
             // clang-format on
 
@@ -1253,6 +1309,123 @@ TEST(imap_client_test, fetch_command_with_literal_size____AND_CRETE_NORMAL_NAME)
     EXPECT_TRUE(test_ran);
 }
 
+TEST(imap_client_test, fetch_command_with_literal_sink) {
+    asio::io_context ctx;
+
+    bool test_ran = false;
+
+    fake_imap_server srv{ctx, "localhost", "9934"};
+    ASSERT_FALSE(srv.start());
+
+    const std::string big_literal = "0123\r\nA0 8901\r\n0123456";
+    srv.reply_once(
+        [&](std::error_code ec, std::tuple<std::string, async_callback<std::string>> line_and_cb) {
+            auto& [line, cb] = line_and_cb;
+
+            auto maybe_cmd = parse_imap_command(line);
+            ASSERT_TRUE(maybe_cmd);
+            auto& cmd = *maybe_cmd;
+            ASSERT_GT(cmd.tokens.size(), 0);
+
+            cb({}, fmt::format("* 1 FETCH (UID 7 RFC822.SIZE 22 RFC822 {{22}}\r\n{})\r\n"
+                               "* 2 FETCH (UID 8 RFC822 {{3}}\r\nabc)\r\n{} OK Success\r\n",
+                               big_literal, cmd.tokens[0]));
+        });
+
+    std::vector<std::string> sink_literals;
+    auto sink = std::make_shared<emailkit::callback_literal_sink_t>(
+        emailkit::callback_literal_sink_t::callbacks_t{
+            .on_begin =
+                [&](size_t size) {
+                    sink_literals.emplace_back().reserve(size);
+                    return std::error_code{};
+                },
+            .on_data =
+                [&](std::string_view chunk) {
+                    sink_literals.back() += chunk;
+                    return std::error_code{};
+                }});
+
+    auto client = make_test_imap_client(ctx);
+    client->async_connect("localhost", "9934", [&](std::error_code ec) {
+        ASSERT_FALSE(ec);
+
+        namespace imap_commands = emailkit::imap_client::imap_commands;
+
+        client->async_execute_command(
+            imap_commands::fetch_t{
+                .sequence_set = imap_commands::fetch_sequence_spec{.from = 1, .to = 2},
+                .items = {imap_commands::all_t{}},
+                .literal_sink = {.sink = sink, .threshold = 10}},
+            [&](std::error_code ec, emailkit::imap_client::types::fetch_response_t r) {
+                EXPECT_FALSE(ec);
+                // Only literal above threshold goes to the sink, the small one stays in response.
+                EXPECT_THAT(sink_literals, ElementsAre(big_literal));
+                EXPECT_EQ(r.message_data_items.size(), 2);
+                test_ran = true;
+                ctx.stop();
+            });
+    });
+
+    ctx.run_for(std::chrono::seconds(1));
+    EXPECT_TRUE(test_ran);
+}
+
+TEST(imap_client_test, fetch_command_delivers_messages_as_they_arrive) {
+    asio::io_context ctx;
+
+    bool test_ran = false;
+
+    fake_imap_server srv{ctx, "localhost", "9934"};
+    ASSERT_FALSE(srv.start());
+
+    srv.reply_once(
+        [&](std::error_code ec, std::tuple<std::string, async_callback<std::string>> line_and_cb) {
+            auto& [line, cb] = line_and_cb;
+
+            auto maybe_cmd = parse_imap_command(line);
+            ASSERT_TRUE(maybe_cmd);
+            auto& cmd = *maybe_cmd;
+            ASSERT_GT(cmd.tokens.size(), 0);
+
+            cb({}, fmt::format("* 1 FETCH (UID 7 RFC822 {{9}}\r\nA0 OK x\r\n)\r\n"
+                               "* 2 FETCH (UID oops)\r\n"
+                               "* 3 FETCH (UID 9)\r\n{} OK Success\r\n",
+                               cmd.tokens[0]));
+        });
+
+    std::vector<uint32_t> delivered;
+
+    auto client = make_test_imap_client(ctx);
+    client->async_connect("localhost", "9934", [&](std::error_code ec) {
+        ASSERT_FALSE(ec);
+
+        namespace imap_commands = emailkit::imap_client::imap_commands;
+
+        client->async_execute_command(
+            imap_commands::fetch_t{
+                .sequence_set = imap_commands::fetch_sequence_spec{.from = 1, .to = 3},
+                .items = {imap_commands::all_t{}},
+                .on_message_data =
+                    [&](emailkit::imap_parser::MessageData message_data) {
+                        delivered.push_back(message_data.message_number);
+                    }},
+            [&](std::error_code ec, emailkit::imap_client::types::fetch_response_t r) {
+                // Bad message does not stop the others and is reported at the end.
+                EXPECT_TRUE(ec);
+                EXPECT_THAT(delivered, ElementsAre(1, 3));
+                EXPECT_TRUE(r.message_data_items.empty());
+                EXPECT_EQ(r.failed_raw_imap_opt, "* 2 FETCH (UID oops)\r\n");
+                EXPECT_EQ(client->fetch_stats().messages, 2);
+                test_ran = true;
+                ctx.stop();
+            });
+    });
+
+    ctx.run_for(std::chrono::seconds(1));
+    EXPECT_TRUE(test_ran);
+}
+
 TEST(imap_client_test, fetch_command_bad_requeset_from_server) {
     // Just in case some servers don't like our requests or all servers don't like some of our
     // requests, we want to have some well defined behavior.
@@ -1328,6 +1501,15 @@ TEST(imap_parser_test, encode_fetch_command_test) {
 
         EXPECT_EQ(text, "fetch 1:200 (body envelope)");
     }
+    {
+        using imap_commands::search_return_t;
+        EXPECT_EQ(imap_commands::encode_cmd(imap_commands::uid_search_t{.criteria = "UNSEEN"}),
+                  "uid search UNSEEN");
+        EXPECT_EQ(imap_commands::encode_cmd(imap_commands::uid_search_t{
+                      .criteria = "UNSEEN",
+                      .return_options = {search_return_t::count, search_return_t::all}}),
+                  "uid search return (COUNT ALL) UNSEEN");
+    }
     {
         namespace fi = imap_commands::fetch_items;
         auto text_or_err = imap_commands::encode_cmd(imap_commands::fetch_t{
@@ -1354,6 +1536,29 @@ TEST(imap_parser_test, encode_fetch_command_test) {
                   "fetch 1:200 (body bodystructure envelope flags internaldate rfc822 "
                   "rfc822.header rfc822.size rfc822.text uid)");
     }
+    {
+        namespace fi = imap_commands::fetch_items;
+        auto text_or_err = imap_commands::encode_cmd(imap_commands::fetch_t{
+            .sequence_set = imap_commands::raw_fetch_sequence_spec{"5"},
+            .by_uid = true,
+            .items = imap_commands::fetch_items_vec_t{
+                fi::body_part_t{.section_spec = "HEADER"},
+                fi::body_peek_t{.section_spec = "1.2", .partial = fi::body_partial_t{0, 1024}},
+                fi::body_peek_t{}}});
+
+        ASSERT_TRUE(text_or_err);
+        EXPECT_EQ(*text_or_err, "uid fetch 5 (body[HEADER] body.peek[1.2]<0.1024> body.peek[])");
+    }
+    {
+        // Section spec cannot close the section or inject another command.
+        namespace fi = imap_commands::fetch_items;
+        for (std::string section_spec : {"1]", "1\r\nA1 LOGOUT"}) {
+            auto text_or_err = imap_commands::encode_cmd(imap_commands::fetch_t{
+                .sequence_set = imap_commands::raw_fetch_sequence_spec{"5"},
+                .items = imap_commands::fetch_items_vec_t{fi::body_peek_t{section_spec}}});
+            EXPECT_FALSE(text_or_err);
+        }
+    }
 }
 
 TEST(imap_client_test, gmail_autoreply_test) {
@@ -1406,3 +1611,797 @@ TEST(imap_client_test, gmail_autoreply_test) {
     ctx.run_for(std::chrono::seconds(3));
     EXPECT_TRUE(test_ran);
 }
+
+TEST(imap_client_test, command_deadline_expires_on_stalled_server) {
+    asio::io_context ctx;
+
+    bool test_ran = false;
+
+    fake_imap_server srv{ctx, "localhost", "9934"};
+    ASSERT_FALSE(srv.start());
+
+    // Server accepts command and never replies.
+    async_callback<std::string> stalled_reply;
+    srv.reply_once(
+        [&](std::error_code ec, std::tuple<std::string, async_callback<std::string>> line_and_cb) {
+            auto& [line, cb] = line_and_cb;
+            stalled_reply = std::move(cb);
+        });
+
+    auto client = make_imap_client(ctx);
+    client->async_connect("localhost", "9934", [&](std::error_code ec) {
+        ASSERT_FALSE(ec);
+
+        const auto started_at = std::chrono::steady_clock::now();
+        client->async_execute_command(
+            imap_client::imap_commands::list_t{.reference_name = "", .mailbox_name = "*"},
+            emailkit::call_opts_t::timeout(300ms),
+            [&, started_at](std::error_code ec, emailkit::imap_client::types::list_response_t r) {
+                EXPECT_EQ(ec, std::errc::timed_out);
+                EXPECT_GE(std::chrono::steady_clock::now() - started_at, 300ms);
+                test_ran = true;
+                ctx.stop();
+            });
+    });
+
+    ctx.run_for(std::chrono::seconds(2));
+    EXPECT_TRUE(test_ran);
+}
+
+TEST(imap_client_test, command_cancelled_while_waiting_for_response) {
+    asio::io_context ctx;
+
+    bool test_ran = false;
+
+    fake_imap_server srv{ctx, "localhost", "9934"};
+    ASSERT_FALSE(srv.start());
+
+    emailkit::cancellation_source_t cancellation;
+    async_callback<std::string> stalled_reply;
+    srv.reply_once(
+        [&](std::error_code ec, std::tuple<std::string, async_callback<std::string>> line_and_cb) {
+            auto& [line, cb] = line_and_cb;
+            stalled_reply = std::move(cb);
+            cancellation.cancel();
+        });
+
+    auto client = make_imap_client(ctx);
+    client->async_connect("localhost", "9934", [&](std::error_code ec) {
+        ASSERT_FALSE(ec);
+
+        client->async_execute_command(
+            imap_client::imap_commands::list_t{.reference_name = "", .mailbox_name = "*"},
+            emailkit::call_opts_t{.cancellation = cancellation.token()},
+            [&](std::error_code ec, emailkit::imap_client::types::list_response_t r) {
+                EXPECT_EQ(ec, std::errc::operation_canceled);
+                test_ran = true;
+                ctx.stop();
+            });
+    });
+
+    ctx.run_for(std::chrono::seconds(1));
+    EXPECT_TRUE(test_ran);
+}
+
+TEST(imap_client_test, pipelined_commands_dispatched_by_tag) {
+    asio::io_context ctx;
+
+    int commands_finished = 0;
+
+    fake_imap_server srv{ctx, "localhost", "9934"};
+    ASSERT_FALSE(srv.start());
+
+    // First command is not answered until the second one arrives, then both are answered at once
+    // and in reverse order.
+    std::string first_tag;
+    srv.reply_once(
+        [&](std::error_code ec, std::tuple<std::string, async_callback<std::string>> line_and_cb) {
+            auto& [line, cb] = line_and_cb;
+            auto maybe_cmd = parse_imap_command(line);
+            ASSERT_TRUE(maybe_cmd);
+            first_tag = maybe_cmd->tokens[0];
+            cb({}, "");
+        });
+    srv.reply_once(
+        [&](std::error_code ec, std::tuple<std::string, async_callback<std::string>> line_and_cb) {
+            auto& [line, cb] = line_and_cb;
+            auto maybe_cmd = parse_imap_command(line);
+            ASSERT_TRUE(maybe_cmd);
+            const auto& second_tag = maybe_cmd->tokens[0];
+            EXPECT_NE(first_tag, second_tag);
+            cb({}, fmt::format("* LIST (\\HasNoChildren) \"/\" \"Second\"\r\n"
+                               "{} OK Success\r\n"
+                               "* LIST (\\HasNoChildren) \"/\" \"First\"\r\n"
+                               "{} OK Success\r\n",
+                               second_tag, first_tag));
+        });
+
+    auto client = make_imap_client(ctx);
+    client->set_max_commands_in_flight(2);
+    client->async_connect("localhost", "9934", [&](std::error_code ec) {
+        ASSERT_FALSE(ec);
+
+        for (std::string name : {"First", "Second"}) {
+            client->async_execute_command(
+                imap_client::imap_commands::list_t{.reference_name = "", .mailbox_name = name},
+                [&, name](std::error_code ec, emailkit::imap_client::types::list_response_t r) {
+                    ASSERT_FALSE(ec);
+                    ASSERT_EQ(r.inbox_list.size(), 1);
+                    EXPECT_EQ(r.inbox_list[0].inbox_path, std::vector<std::string>{name});
+                    if (++commands_finished == 2) {
+                        ctx.stop();
+                    }
+                });
+        }
+    });
+
+    ctx.run_for(std::chrono::seconds(1));
+    EXPECT_EQ(commands_finished, 2);
+}
+
+TEST(imap_client_test, sync_mailbox_fetches_changes_since_known_state) {
+    asio::io_context ctx;
+
+    bool test_ran = false;
+
+    fake_imap_server srv{ctx, "localhost", "9934"};
+    ASSERT_FALSE(srv.start());
+
+    auto expect_command = [&](std::string expected_command, std::string untagged_response) {
+        srv.reply_once([&, expected_command, untagged_response](
+                           std::error_code ec,
+                           std::tuple<std::string, async_callback<std::string>> line_and_cb) {
+            auto& [line, cb] = line_and_cb;
+            auto maybe_cmd = parse_imap_command(line);
+            ASSERT_TRUE(maybe_cmd);
+            const auto& tag = maybe_cmd->tokens[0];
+            EXPECT_EQ(line.substr(0, line.find_first_of("\r\n")),
+                      fmt::format("{} {}", tag, expected_command));
+            cb({}, fmt::format("{}{} OK Success\r\n", untagged_response, tag));
+        });
+    };
+    expect_command("ENABLE CONDSTORE QRESYNC", "* ENABLED CONDSTORE QRESYNC\r\n");
+    expect_command("select \"INBOX\"",
+                   "* 6 EXISTS\r\n"
+                   "* OK [UIDVALIDITY 7] UIDs valid.\r\n"
+                   "* OK [UIDNEXT 12] Predicted next UID.\r\n"
+                   "* OK [HIGHESTMODSEQ 110]\r\n");
+    expect_command("uid fetch 1:9 (UID FLAGS) (CHANGEDSINCE 100 VANISHED)",
+                   "* VANISHED (EARLIER) 3:4\r\n"
+                   "* 2 FETCH (UID 5 FLAGS (\\Seen \\Flagged) MODSEQ (105))\r\n");
+    // Last message matches "10:*" even though its UID is below 10, so nothing new is fetched.
+    expect_command("uid search UID 10:*", "* SEARCH 9\r\n");
+
+    auto client = make_imap_client(ctx);
+    client->async_connect("localhost", "9934", [&](std::error_code ec) {
+        ASSERT_FALSE(ec);
+
+        client->async_sync_mailbox(
+            "INBOX",
+            imap_client::imap_client_t::MailboxSyncState{
+                .uid_validity = 7, .uid_next = 10, .highest_modseq = 100},
+            [&](std::error_code ec, imap_client::imap_client_t::MailboxSyncResult r) {
+                ASSERT_FALSE(ec);
+
+                EXPECT_FALSE(r.uid_validity_changed);
+                EXPECT_EQ(r.state.uid_validity, 7);
+                EXPECT_EQ(r.state.uid_next, 12);
+                EXPECT_EQ(r.state.highest_modseq, 110);
+                EXPECT_THAT(r.vanished, ElementsAre(imap_client::types::uid_range_t{3, 4}));
+                ASSERT_EQ(r.flags_changes.size(), 1);
+                EXPECT_EQ(r.flags_changes[0].uid, 5);
+                EXPECT_THAT(r.flags_changes[0].flags, ElementsAre("\\Seen", "\\Flagged"));
+                EXPECT_EQ(r.flags_changes[0].modseq, 105);
+                EXPECT_TRUE(r.new_emails.empty());
+
+                test_ran = true;
+                ctx.stop();
+            });
+    });
+
+    ctx.run_for(std::chrono::seconds(1));
+    EXPECT_TRUE(test_ran);
+}
+
+TEST(imap_client_test, sync_mailbox_enables_qresync_again_after_reconnect) {
+    asio::io_context ctx;
+
+    bool test_ran = false;
+
+    fake_imap_server srv{ctx, "localhost", "9934"};
+    ASSERT_FALSE(srv.start());
+
+    auto expect_command = [&](std::string expected_command, std::string untagged_response) {
+        srv.reply_once([&, expected_command, untagged_response](
+                           std::error_code ec,
+                           std::tuple<std::string, async_callback<std::string>> line_and_cb) {
+            auto& [line, cb] = line_and_cb;
+            auto maybe_cmd = parse_imap_command(line);
+            ASSERT_TRUE(maybe_cmd);
+            const auto& tag = maybe_cmd->tokens[0];
+            EXPECT_EQ(line.substr(0, line.find_first_of("\r\n")),
+                      fmt::format("{} {}", tag, expected_command));
+            cb({}, fmt::format("{}{} OK Success\r\n", untagged_response, tag));
+        });
+    };
+    // Mailbox has not changed, so a session is ENABLE and SELECT only.
+    for (int i = 0; i < 2; ++i) {
+        expect_command("ENABLE CONDSTORE QRESYNC", "* ENABLED CONDSTORE QRESYNC\r\n");
+        expect_command("select \"INBOX\"",
+                       "* 6 EXISTS\r\n"
+                       "* OK [UIDVALIDITY 7] UIDs valid.\r\n"
+                       "* OK [UIDNEXT 10] Predicted next UID.\r\n"
+                       "* OK [HIGHESTMODSEQ 100]\r\n");
+    }
+
+    const imap_client::imap_client_t::MailboxSyncState known{
+        .uid_validity = 7, .uid_next = 10, .highest_modseq = 100};
+    auto client = make_imap_client(ctx);
+    client->async_connect("localhost", "9934", [&](std::error_code ec) {
+        ASSERT_FALSE(ec);
+        client->async_sync_mailbox(
+            "INBOX", known,
+            [&](std::error_code ec, imap_client::imap_client_t::MailboxSyncResult r) {
+                ASSERT_FALSE(ec);
+                // Connection is lost, e.g. network changed, and the same client connects again.
+                client->async_connect("localhost", "9934", [&](std::error_code ec) {
+                    ASSERT_FALSE(ec);
+                    client->async_sync_mailbox(
+                        "INBOX", known,
+                        [&](std::error_code ec,
+                            imap_client::imap_client_t::MailboxSyncResult r) {
+                            ASSERT_FALSE(ec);
+                            EXPECT_EQ(r.state.uid_next, 10);
+                            test_ran = true;
+                            ctx.stop();
+                        });
+                });
+            });
+    });
+
+    ctx.run_for(std::chrono::seconds(1));
+    EXPECT_TRUE(test_ran);
+}
+
+TEST(imap_client_test, malformed_sync_responses_fail_commands) {
+    asio::io_context ctx;
+
+    bool test_ran = false;
+
+    fake_imap_server srv{ctx, "localhost", "9934"};
+    ASSERT_FALSE(srv.start());
+
+    auto reply_with = [&](std::string untagged_response) {
+        srv.reply_once([&, untagged_response](
+                           std::error_code ec,
+                           std::tuple<std::string, async_callback<std::string>> line_and_cb) {
+            auto& [line, cb] = line_and_cb;
+            auto maybe_cmd = parse_imap_command(line);
+            ASSERT_TRUE(maybe_cmd);
+            cb({}, fmt::format("{}{} OK Success\r\n", untagged_response, maybe_cmd->tokens[0]));
+        });
+    };
+    reply_with("* SEARCH 2 x\r\n");
+    reply_with("* 1 FETCH (UID 4 MODSEQ () FLAGS (\\Seen))\r\n");
+    reply_with("* 1 FETCH (UID 4 X-GM-MSGID x X-GM-THRID 10)\r\n");
+
+    auto client = make_imap_client(ctx);
+    client->async_connect("localhost", "9934", [&](std::error_code ec) {
+        ASSERT_FALSE(ec);
+
+        client->async_execute_command(
+            imap_client::imap_commands::uid_search_t{.criteria = "ALL"},
+            [&](std::error_code ec, imap_client::types::search_response_t) {
+                EXPECT_TRUE(ec);
+                client->async_execute_command(
+                    imap_client::imap_commands::uid_fetch_flags_changes_t{.uid_set = "1:*",
+                                                                          .changed_since = 1},
+                    [&](std::error_code ec, imap_client::types::flags_changes_response_t) {
+                        EXPECT_TRUE(ec);
+                        client->async_execute_command(
+                            imap_client::imap_commands::uid_fetch_gmail_ids_t{.uid_set = "4"},
+                            [&](std::error_code ec, imap_client::types::gmail_ids_response_t) {
+                                EXPECT_TRUE(ec);
+                                test_ran = true;
+                                ctx.stop();
+                            });
+                    });
+            });
+    });
+
+    ctx.run_for(std::chrono::seconds(1));
+    EXPECT_TRUE(test_ran);
+}
+
+TEST(imap_client_test, fetch_message_part_loads_only_requested_range) {
+    asio::io_context ctx;
+
+    bool test_ran = false;
+
+    fake_imap_server srv{ctx, "localhost", "9934"};
+    ASSERT_FALSE(srv.start());
+
+    srv.reply_once(
+        [&](std::error_code ec, std::tuple<std::string, async_callback<std::string>> line_and_cb) {
+            auto& [line, cb] = line_and_cb;
+            auto maybe_cmd = parse_imap_command(line);
+            ASSERT_TRUE(maybe_cmd);
+            const auto& tag = maybe_cmd->tokens[0];
+            EXPECT_EQ(line.substr(0, line.find_first_of("\r\n")),
+                      fmt::format("{} uid fetch 42 (body.peek[2]<4.6>)", tag));
+            cb({}, fmt::format("* 3 FETCH (UID 42 BODY[2]<4> {{6}}\r\nVBERi0)\r\n"
+                               "{} OK Success\r\n",
+                               tag));
+        });
+
+    auto client = make_imap_client(ctx);
+    client->async_connect("localhost", "9934", [&](std::error_code ec) {
+        ASSERT_FALSE(ec);
+
+        client->async_fetch_message_part(
+            42, "2", imap_client::imap_commands::fetch_items::body_partial_t{4, 6},
+            [&](std::error_code ec, imap_client::types::body_section_t part) {
+                ASSERT_FALSE(ec);
+                EXPECT_EQ(part.section, "2");
+                EXPECT_EQ(part.origin, 4);
+                EXPECT_EQ(part.data, "VBERi0");
+
+                test_ran = true;
+                ctx.stop();
+            });
+    });
+
+    ctx.run_for(std::chrono::seconds(1));
+    EXPECT_TRUE(test_ran);
+}
+
+TEST(imap_client_test, fetch_message_part_binary_comes_decoded_by_server) {
+    asio::io_context ctx;
+
+    bool test_ran = false;
+
+    fake_imap_server srv{ctx, "localhost", "9934"};
+    ASSERT_FALSE(srv.start());
+
+    srv.reply_once(
+        [&](std::error_code ec, std::tuple<std::string, async_callback<std::string>> line_and_cb) {
+            auto& [line, cb] = line_and_cb;
+            auto maybe_cmd = parse_imap_command(line);
+            ASSERT_TRUE(maybe_cmd);
+            cb({}, fmt::format("* CAPABILITY IMAP4rev1 BINARY\r\n{} OK Success\r\n",
+                               maybe_cmd->tokens[0]));
+        });
+    srv.reply_once(
+        [&](std::error_code ec, std::tuple<std::string, async_callback<std::string>> line_and_cb) {
+            auto& [line, cb] = line_and_cb;
+            auto maybe_cmd = parse_imap_command(line);
+            ASSERT_TRUE(maybe_cmd);
+            const auto& tag = maybe_cmd->tokens[0];
+            EXPECT_EQ(line.substr(0, line.find_first_of("\r\n")),
+                      fmt::format("{} uid fetch 42 (binary.peek[2]<4.6> binary.size[2])", tag));
+            // Literal8 with NUL, PDF part is sent by server decoded from base64.
+            cb({}, "* 3 FETCH (UID 42 BINARY[2]<4> ~{6}\r\n" + std::string("-1.4\n\0)", 6) +
+                       fmt::format(" BINARY.SIZE[2] 3072)\r\n{} OK Success\r\n", tag));
+        });
+
+    auto client = make_imap_client(ctx);
+    client->async_connect("localhost", "9934", [&](std::error_code ec) {
+        ASSERT_FALSE(ec);
+        client->async_authenticate(
+            {.user_email = "alan.kay@example.com", .oauth_token = "[alan_kay_oauth_token]"},
+            [&](std::error_code ec, auto details) {
+                ASSERT_FALSE(ec);
+                client->async_fetch_message_part_binary(
+                    42, "2", imap_client::imap_commands::fetch_items::body_partial_t{4, 6},
+                    [&](std::error_code ec, imap_client::types::binary_section_t part) {
+                        ASSERT_FALSE(ec);
+                        EXPECT_EQ(part.section, "2");
+                        EXPECT_EQ(part.origin, 4);
+                        EXPECT_EQ(part.data, std::string("-1.4\n\0)", 6));
+                        EXPECT_EQ(part.size, 3072);
+
+                        test_ran = true;
+                        ctx.stop();
+                    });
+            });
+    });
+
+    ctx.run_for(std::chrono::seconds(1));
+    EXPECT_TRUE(test_ran);
+}
+
+TEST(imap_client_test, fetch_message_part_binary_fails_on_invalid_part_or_response) {
+    asio::io_context ctx;
+
+    bool test_ran = false;
+
+    fake_imap_server srv{ctx, "localhost", "9934"};
+    ASSERT_FALSE(srv.start());
+
+    srv.reply_once(
+        [&](std::error_code ec, std::tuple<std::string, async_callback<std::string>> line_and_cb) {
+            auto& [line, cb] = line_and_cb;
+            auto maybe_cmd = parse_imap_command(line);
+            ASSERT_TRUE(maybe_cmd);
+            cb({}, fmt::format("* CAPABILITY IMAP4rev1 BINARY\r\n{} OK Success\r\n",
+                               maybe_cmd->tokens[0]));
+        });
+    // Invalid part id is not sent, so the only FETCH is the one with valid part id.
+    srv.reply_once(
+        [&](std::error_code ec, std::tuple<std::string, async_callback<std::string>> line_and_cb) {
+            auto& [line, cb] = line_and_cb;
+            auto maybe_cmd = parse_imap_command(line);
+            ASSERT_TRUE(maybe_cmd);
+            const auto& tag = maybe_cmd->tokens[0];
+            EXPECT_EQ(line.substr(0, line.find_first_of("\r\n")),
+                      fmt::format("{} uid fetch 42 (binary.peek[2])", tag));
+            cb({}, fmt::format("* 3 FETCH (UID 42 BINARY[2] x)\r\n{} OK Success\r\n", tag));
+        });
+
+    auto client = make_imap_client(ctx);
+    client->async_connect("localhost", "9934", [&](std::error_code ec) {
+        ASSERT_FALSE(ec);
+        client->async_authenticate(
+            {.user_email = "alan.kay@example.com", .oauth_token = "[alan_kay_oauth_token]"},
+            [&](std::error_code ec, auto details) {
+                ASSERT_FALSE(ec);
+                client->async_fetch_message_part_binary(
+                    42, "2]<0.1> body[", std::nullopt,
+                    [&](std::error_code ec, imap_client::types::binary_section_t) {
+                        EXPECT_EQ(ec, make_error_code(std::errc::invalid_argument));
+                        client->async_fetch_message_part_binary(
+                            42, "2", std::nullopt,
+                            [&](std::error_code ec, imap_client::types::binary_section_t) {
+                                EXPECT_TRUE(ec);
+                                test_ran = true;
+                                ctx.stop();
+                            });
+                    });
+            });
+    });
+
+    ctx.run_for(std::chrono::seconds(1));
+    EXPECT_TRUE(test_ran);
+}
+
+TEST(imap_client_test, search_uses_esearch_when_advertised) {
+    asio::io_context ctx;
+
+    bool test_ran = false;
+
+    fake_imap_server srv{ctx, "localhost", "9934"};
+    ASSERT_FALSE(srv.start());
+
+    srv.reply_once(
+        [&](std::error_code ec, std::tuple<std::string, async_callback<std::string>> line_and_cb) {
+            auto& [line, cb] = line_and_cb;
+            auto maybe_cmd = parse_imap_command(line);
+            ASSERT_TRUE(maybe_cmd);
+            cb({}, fmt::format("* CAPABILITY IMAP4rev1 ESEARCH\r\n{} OK Success\r\n",
+                               maybe_cmd->tokens[0]));
+        });
+    srv.reply_once(
+        [&](std::error_code ec, std::tuple<std::string, async_callback<std::string>> line_and_cb) {
+            auto& [line, cb] = line_and_cb;
+            auto maybe_cmd = parse_imap_command(line);
+            ASSERT_TRUE(maybe_cmd);
+            const auto& tag = maybe_cmd->tokens[0];
+            EXPECT_EQ(line.substr(0, line.find_first_of("\r\n")),
+                      fmt::format("{} uid search return (MIN MAX COUNT ALL) UNSEEN FROM "
+                                  "\"alan.kay@example.com\"",
+                                  tag));
+            cb({}, fmt::format("* ESEARCH (TAG \"{0}\") UID MIN 7 MAX 3800 COUNT 4 "
+                               "ALL 7,3798:3800\r\n{0} OK SEARCH completed\r\n",
+                               tag));
+        });
+
+    auto client = make_imap_client(ctx);
+    client->async_connect("localhost", "9934", [&](std::error_code ec) {
+        ASSERT_FALSE(ec);
+        client->async_authenticate(
+            {.user_email = "alan.kay@example.com", .oauth_token = "[alan_kay_oauth_token]"},
+            [&](std::error_code ec, auto details) {
+                ASSERT_FALSE(ec);
+                client->async_search(
+                    imap_client::search_query_t{}.unseen().from("alan.kay@example.com"),
+                    [&](std::error_code ec, imap_client::types::search_response_t r) {
+                        ASSERT_FALSE(ec);
+                        EXPECT_EQ(r.count, 4);
+                        EXPECT_EQ(r.min, 7);
+                        EXPECT_EQ(r.max, 3800);
+                        EXPECT_EQ(r.all, "7,3798:3800");
+                        EXPECT_TRUE(r.ids.empty());
+
+                        // No X-GM-EXT-1.
+                        client->async_search(
+                            imap_client::search_query_t{}.gmail_raw("has:attachment"),
+                            [&](std::error_code ec, imap_client::types::search_response_t) {
+                                EXPECT_EQ(ec, std::errc::operation_not_supported);
+                                test_ran = true;
+                                ctx.stop();
+                            });
+                    });
+            });
+    });
+
+    ctx.run_for(std::chrono::seconds(1));
+    EXPECT_TRUE(test_ran);
+}
+
+TEST(imap_client_test, idle_streams_updates_until_next_command) {
+    asio::io_context ctx;
+
+    std::vector<std::string> events;
+    bool idle_finished = false;
+    bool list_finished = false;
+
+    fake_imap_server srv{ctx, "localhost", "9934"};
+    ASSERT_FALSE(srv.start());
+
+    std::string idle_tag;
+    srv.reply_once(
+        [&](std::error_code ec, std::tuple<std::string, async_callback<std::string>> line_and_cb) {
+            auto& [line, cb] = line_and_cb;
+            auto maybe_cmd = parse_imap_command(line);
+            ASSERT_TRUE(maybe_cmd);
+            ASSERT_GT(maybe_cmd->tokens.size(), 1);
+            EXPECT_EQ(maybe_cmd->tokens[1], "IDLE");
+            idle_tag = maybe_cmd->tokens[0];
+            cb({},
+               "+ idling\r\n"
+               "* 22 EXPUNGE\r\n"
+               "* OK Still here\r\n"
+               "* 23 EXISTS\r\n");
+        });
+    // Command submitted by subscriber ends IDLE.
+    srv.reply_once(
+        [&](std::error_code ec, std::tuple<std::string, async_callback<std::string>> line_and_cb) {
+            auto& [line, cb] = line_and_cb;
+            EXPECT_EQ(line, "DONE\r\n");
+            cb({}, fmt::format("{} OK IDLE terminated (Success)\r\n", idle_tag));
+        });
+    srv.reply_once(
+        [&](std::error_code ec, std::tuple<std::string, async_callback<std::string>> line_and_cb) {
+            auto& [line, cb] = line_and_cb;
+            auto maybe_cmd = parse_imap_command(line);
+            ASSERT_TRUE(maybe_cmd);
+            cb({}, fmt::format("* LIST (\\HasNoChildren) \"/\" \"INBOX\"\r\n"
+                               "{} OK Success\r\n",
+                               maybe_cmd->tokens[0]));
+        });
+
+    auto client = make_imap_client(ctx);
+    client->async_connect("localhost", "9934", [&](std::error_code ec) {
+        ASSERT_FALSE(ec);
+
+        client->async_idle(
+            [&](const imap_client::types::idle_event_t& e) {
+                events.push_back(e.line);
+                if (e.kind != imap_client::types::idle_event_kind_t::exists) {
+                    return;
+                }
+                EXPECT_EQ(e.number, 23);
+                client->async_execute_command(
+                    imap_client::imap_commands::list_t{.reference_name = "", .mailbox_name = "*"},
+                    [&](std::error_code ec, imap_client::types::list_response_t r) {
+                        ASSERT_FALSE(ec);
+                        EXPECT_TRUE(idle_finished);
+                        EXPECT_EQ(r.inbox_list.size(), 1);
+                        list_finished = true;
+                        ctx.stop();
+                    });
+            },
+            [&](std::error_code ec) {
+                EXPECT_FALSE(ec);
+                idle_finished = true;
+            });
+    });
+
+    ctx.run_for(std::chrono::seconds(1));
+    EXPECT_THAT(events, ElementsAre("* 22 EXPUNGE", "* 23 EXISTS"));
+    EXPECT_TRUE(idle_finished);
+    EXPECT_TRUE(list_finished);
+}
+
+TEST(imap_client_test, list_mailboxes_with_status_in_one_command) {
+    asio::io_context ctx;
+
+    bool test_ran = false;
+
+    fake_imap_server srv{ctx, "localhost", "9934"};
+    ASSERT_FALSE(srv.start());
+
+    srv.reply_once(
+        [&](std::error_code ec, std::tuple<std::string, async_callback<std::string>> line_and_cb) {
+            auto& [line, cb] = line_and_cb;
+            auto maybe_cmd = parse_imap_command(line);
+            ASSERT_TRUE(maybe_cmd);
+            cb({}, fmt::format("* CAPABILITY IMAP4rev1 LIST-STATUS CONDSTORE\r\n{} OK Success\r\n",
+                               maybe_cmd->tokens[0]));
+        });
+    srv.reply_once(
+        [&](std::error_code ec, std::tuple<std::string, async_callback<std::string>> line_and_cb) {
+            auto& [line, cb] = line_and_cb;
+            auto maybe_cmd = parse_imap_command(line);
+            ASSERT_TRUE(maybe_cmd);
+            const auto& tag = maybe_cmd->tokens[0];
+            EXPECT_EQ(line.substr(0, line.find_first_of("\r\n")),
+                      fmt::format("{} list \"\" \"*\" return (status (MESSAGES UNSEEN UIDNEXT "
+                                  "UIDVALIDITY HIGHESTMODSEQ))",
+                                  tag));
+            // clang-format off
+            std::string response =
+                R"(* LIST (\HasNoChildren) "/" "INBOX")""\r\n"
+                R"(* STATUS "INBOX" (MESSAGES 17 UNSEEN 2 UIDNEXT 4392 UIDVALIDITY 1 )"
+                R"(HIGHESTMODSEQ 90060))""\r\n"
+                R"(* LIST (\HasChildren \Noselect) "/" "[Gmail]")""\r\n"
+                R"(* LIST (\HasNoChildren \Sent) "/" "[Gmail]/Sent")""\r\n"
+                R"(* STATUS "[Gmail]/Sent" (MESSAGES 3 UNSEEN 0 UIDNEXT 9 UIDVALIDITY 5 )"
+                R"(HIGHESTMODSEQ 12))""\r\n";
+            // clang-format on
+            cb({}, response + fmt::format("{} OK Success\r\n", tag));
+        });
+
+    auto client = make_imap_client(ctx);
+    client->async_connect("localhost", "9934", [&](std::error_code ec) {
+        ASSERT_FALSE(ec);
+        client->async_authenticate(
+            {.user_email = "alan.kay@example.com", .oauth_token = "[alan_kay_oauth_token]"},
+            [&](std::error_code ec, auto details) {
+                ASSERT_FALSE(ec);
+                client->async_list_mailboxes_with_status(
+                    [&](std::error_code ec, imap_client_t::ListMailboxesResult r) {
+                        ASSERT_FALSE(ec);
+                        const auto& list = r.raw_response.inbox_list;
+                        ASSERT_EQ(list.size(), 3);
+                        ASSERT_TRUE(list[0].status);
+                        EXPECT_EQ(list[0].status->mailbox, "INBOX");
+                        EXPECT_EQ(list[0].status->messages, 17);
+                        EXPECT_EQ(list[0].status->unseen, 2);
+                        EXPECT_EQ(list[0].status->uid_next, 4392);
+                        EXPECT_EQ(list[0].status->uid_validity, 1);
+                        EXPECT_EQ(list[0].status->highest_modseq, 90060);
+                        EXPECT_FALSE(list[1].status);  // \Noselect
+                        ASSERT_TRUE(list[2].status);
+                        EXPECT_EQ(list[2].status->messages, 3);
+                        EXPECT_EQ(list[2].status->uid_next, 9);
+                        test_ran = true;
+                        ctx.stop();
+                    });
+            });
+    });
+
+    ctx.run_for(std::chrono::seconds(1));
+    EXPECT_TRUE(test_ran);
+}
+
+TEST(imap_client_test, list_mailboxes_with_status_falls_back_to_pipelined_status) {
+    asio::io_context ctx;
+
+    bool test_ran = false;
+
+    fake_imap_server srv{ctx, "localhost", "9934"};
+    ASSERT_FALSE(srv.start());
+
+    srv.reply_once(
+        [&](std::error_code ec, std::tuple<std::string, async_callback<std::string>> line_and_cb) {
+            auto& [line, cb] = line_and_cb;
+            auto maybe_cmd = parse_imap_command(line);
+            ASSERT_TRUE(maybe_cmd);
+            cb({}, fmt::format("* CAPABILITY IMAP4rev1\r\n{} OK Success\r\n",
+                               maybe_cmd->tokens[0]));
+        });
+    srv.reply_once(
+        [&](std::error_code ec, std::tuple<std::string, async_callback<std::string>> line_and_cb) {
+            auto& [line, cb] = line_and_cb;
+            auto maybe_cmd = parse_imap_command(line);
+            ASSERT_TRUE(maybe_cmd);
+            const auto& tag = maybe_cmd->tokens[0];
+            EXPECT_EQ(line.substr(0, line.find_first_of("\r\n")),
+                      fmt::format("{} list \"\" \"*\"", tag));
+            // clang-format off
+            std::string response =
+                R"(* LIST (\HasNoChildren) "/" "INBOX")""\r\n"
+                R"(* LIST (\HasChildren \Noselect) "/" "[Gmail]")""\r\n"
+                R"(* LIST (\HasNoChildren \Sent) "/" "[Gmail]/Sent")""\r\n"
+                R"(* LIST (\HasNoChildren \Trash) "/" "[Gmail]/Trash")""\r\n";
+            // clang-format on
+            cb({}, response + fmt::format("{} OK Success\r\n", tag));
+        });
+    // STATUS commands are not answered until the last one arrives, so all of them must have been
+    // sent without waiting for responses. STATUS of Sent fails as if it has been deleted.
+    std::vector<std::string> status_commands;
+    std::vector<std::string> status_tags;
+    for (int i = 0; i < 3; ++i) {
+        srv.reply_once([&, i](std::error_code ec,
+                              std::tuple<std::string, async_callback<std::string>> line_and_cb) {
+            auto& [line, cb] = line_and_cb;
+            auto maybe_cmd = parse_imap_command(line);
+            ASSERT_TRUE(maybe_cmd);
+            status_tags.push_back(maybe_cmd->tokens[0]);
+            status_commands.push_back(line.substr(status_tags.back().size() + 1,
+                                                  line.find_first_of("\r\n") -
+                                                      status_tags.back().size() - 1));
+            if (i < 2) {
+                cb({}, "");
+                return;
+            }
+            cb({}, fmt::format("* STATUS \"INBOX\" (MESSAGES 17 UNSEEN 2 UIDNEXT 4392 "
+                               "UIDVALIDITY 1)\r\n"
+                               "{} OK Success\r\n"
+                               "{} NO Mailbox doesn't exist\r\n"
+                               "* STATUS \"[Gmail]/Trash\" (MESSAGES 3 UNSEEN 0 UIDNEXT 9 "
+                               "UIDVALIDITY 5)\r\n"
+                               "{} OK Success\r\n",
+                               status_tags[0], status_tags[1], status_tags[2]));
+        });
+    }
+
+    auto client = make_imap_client(ctx);
+    client->async_connect("localhost", "9934", [&](std::error_code ec) {
+        ASSERT_FALSE(ec);
+        client->async_authenticate(
+            {.user_email = "alan.kay@example.com", .oauth_token = "[alan_kay_oauth_token]"},
+            [&](std::error_code ec, auto details) {
+                ASSERT_FALSE(ec);
+                client->async_list_mailboxes_with_status(
+                    [&](std::error_code ec, imap_client_t::ListMailboxesResult r) {
+                        ASSERT_FALSE(ec);
+                        const auto& list = r.raw_response.inbox_list;
+                        ASSERT_EQ(list.size(), 4);
+                        ASSERT_TRUE(list[0].status);
+                        EXPECT_EQ(list[0].status->messages, 17);
+                        EXPECT_EQ(list[0].status->uid_next, 4392);
+                        EXPECT_FALSE(list[1].status);  // \Noselect
+                        EXPECT_FALSE(list[2].status);  // STATUS failed
+                        ASSERT_TRUE(list[3].status);
+                        EXPECT_EQ(list[3].status->messages, 3);
+                        EXPECT_EQ(list[3].status->uid_validity, 5);
+                        test_ran = true;
+                        ctx.stop();
+                    });
+            });
+    });
+
+    ctx.run_for(std::chrono::seconds(1));
+    EXPECT_TRUE(test_ran);
+    EXPECT_THAT(status_commands,
+                ElementsAre("status \"INBOX\" (MESSAGES UNSEEN UIDNEXT UIDVALIDITY)",
+                            "status \"[Gmail]/Sent\" (MESSAGES UNSEEN UIDNEXT UIDVALIDITY)",
+                            "status \"[Gmail]/Trash\" (MESSAGES UNSEEN UIDNEXT UIDVALIDITY)"));
+}
+
+TEST(imap_client_test, malformed_status_response_fails_command) {
+    asio::io_context ctx;
+
+    bool test_ran = false;
+
+    fake_imap_server srv{ctx, "localhost", "9934"};
+    ASSERT_FALSE(srv.start());
+
+    srv.reply_once(
+        [&](std::error_code ec, std::tuple<std::string, async_callback<std::string>> line_and_cb) {
+            auto& [line, cb] = line_and_cb;
+            auto maybe_cmd = parse_imap_command(line);
+            ASSERT_TRUE(maybe_cmd);
+            cb({}, fmt::format("* STATUS INBOX (MESSAGES x)\r\n{} OK Success\r\n",
+                               maybe_cmd->tokens[0]));
+        });
+
+    auto client = make_imap_client(ctx);
+    client->async_connect("localhost", "9934", [&](std::error_code ec) {
+        ASSERT_FALSE(ec);
+        client->async_execute_command(
+            imap_client::imap_commands::status_t{
+                .mailbox_name = "INBOX",
+                .items = {imap_client::imap_commands::status_item_t::messages}},
+            [&](std::error_code ec, imap_client::types::mailbox_status_t) {
+                EXPECT_TRUE(ec);
+                test_ran = true;
+                ctx.stop();
+            });
+    });
+
+    ctx.run_for(std::chrono::seconds(1));
+    EXPECT_TRUE(test_ran);
+}
@@ -0,0 +1,121 @@
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include <emailkit/imap_connection_pool.hpp>
+
+#include <asio.hpp>
+
+using namespace emailkit;
+using namespace emailkit::imap_client;
+
+TEST(imap_connection_pool_test, opens_up_to_limit_and_reuses_released_connections) {
+    asio::io_context ctx;
+
+    int setups = 0;
+    auto pool = make_imap_connection_pool(
+        ctx, imap_connection_pool_opts_t{.max_connections = 2},
+        [&](imap_client_t& client, call_opts_t opts, async_callback<void> cb) {
+            ++setups;
+            asio::post(ctx, [cb = std::move(cb)]() mutable { cb({}); });
+        });
+
+    std::vector<imap_connection_lease_t> leases;
+    for (int i = 0; i < 3; ++i) {
+        pool->async_acquire([&](std::error_code ec, imap_connection_lease_t lease) {
+            ASSERT_FALSE(ec);
+            ASSERT_TRUE(lease);
+            leases.emplace_back(std::move(lease));
+        });
+    }
+    ctx.run_for(100ms);
+    ctx.restart();
+
+    EXPECT_EQ(setups, 2);
+    EXPECT_EQ(pool->size(), 2);
+    ASSERT_EQ(leases.size(), 2);
+
+    // Third request is served by connection which is released first.
+    auto first = std::move(leases.front());
+    leases.erase(leases.begin());
+    const auto* first_client = &*first;
+    first.release();
+    ASSERT_EQ(leases.size(), 2);
+    EXPECT_EQ(&*leases[1], first_client);
+    EXPECT_EQ(setups, 2);
+
+    // Discarded connection is replaced by a new one on demand.
+    auto discarded = std::move(leases.back());
+    leases.pop_back();
+    discarded.discard();
+    discarded.release();
+    EXPECT_EQ(pool->size(), 1);
+    pool->async_acquire([&](std::error_code ec, imap_connection_lease_t lease) {
+        ASSERT_FALSE(ec);
+        leases.emplace_back(std::move(lease));
+    });
+    ctx.run_for(100ms);
+    EXPECT_EQ(setups, 3);
+    EXPECT_EQ(leases.size(), 2);
+}
+
+TEST(imap_connection_pool_test, refused_connection_lowers_limit) {
+    asio::io_context ctx;
+
+    int setups = 0;
+    auto pool = make_imap_connection_pool(
+        ctx, imap_connection_pool_opts_t{.max_connections = 4},
+        [&](imap_client_t& client, call_opts_t opts, async_callback<void> cb) {
+            // Server allows one connection only.
+            std::error_code ec =
+                ++setups > 1 ? make_error_code(std::errc::connection_refused) : std::error_code{};
+            asio::post(ctx, [cb = std::move(cb), ec]() mutable { cb(ec); });
+        });
+
+    std::vector<imap_connection_lease_t> leases;
+    int served = 0;
+    for (int i = 0; i < 2; ++i) {
+        pool->async_acquire([&](std::error_code ec, imap_connection_lease_t lease) {
+            ASSERT_FALSE(ec);
+            ++served;
+            leases.emplace_back(std::move(lease));
+        });
+    }
+    ctx.run_for(100ms);
+    ctx.restart();
+
+    EXPECT_EQ(served, 1);
+    EXPECT_EQ(pool->max_size(), 1);
+
+    auto released = std::move(leases.front());
+    leases.clear();
+    released.release();
+    ctx.run_for(100ms);
+    EXPECT_EQ(served, 2);
+    EXPECT_EQ(setups, 2);
+}
+
+TEST(imap_connection_pool_test, waiting_request_expires) {
+    asio::io_context ctx;
+
+    auto pool = make_imap_connection_pool(
+        ctx, imap_connection_pool_opts_t{.max_connections = 1},
+        [&](imap_client_t& client, call_opts_t opts, async_callback<void> cb) { cb({}); });
+
+    imap_connection_lease_t held;
+    pool->async_acquire([&](std::error_code ec, imap_connection_lease_t lease) {
+        ASSERT_FALSE(ec);
+        held = std::move(lease);
+    });
+
+    bool expired = false;
+    pool->async_acquire(call_opts_t::timeout(200ms),
+                        [&](std::error_code ec, imap_connection_lease_t lease) {
+                            EXPECT_EQ(ec, std::errc::timed_out);
+                            EXPECT_FALSE(lease);
+                            expired = true;
+                            ctx.stop();
+                        });
+    ctx.run_for(1s);
+    EXPECT_TRUE(expired);
+    EXPECT_TRUE(held);
+}
@@ -0,0 +1,34 @@
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include <emailkit/imap_literal_sink.hpp>
+
+#include <sstream>
+
+TEST(imap_literal_sink_test, file_sink_writes_literal_per_file) {
+    const auto dir = std::filesystem::temp_directory_path() / "emailkit_literal_sink_test";
+    std::filesystem::remove_all(dir);
+    std::filesystem::create_directories(dir);
+
+    emailkit::file_literal_sink_t sink{dir};
+    ASSERT_FALSE(sink.on_literal_begin(6));
+    ASSERT_FALSE(sink.on_literal_data("abc"));
+    ASSERT_FALSE(sink.on_literal_data("def"));
+    ASSERT_FALSE(sink.on_literal_end());
+    ASSERT_FALSE(sink.on_literal_begin(0));
+    ASSERT_FALSE(sink.on_literal_end());
+
+    ASSERT_EQ(sink.files().size(), 2);
+    std::ifstream f{sink.files()[0], std::ios::binary};
+    std::stringstream ss;
+    ss << f.rdbuf();
+    EXPECT_EQ(ss.str(), "abcdef");
+    EXPECT_EQ(std::filesystem::file_size(sink.files()[1]), 0);
+
+    std::filesystem::remove_all(dir);
+}
+
+TEST(imap_literal_sink_test, file_sink_fails_on_missing_dir) {
+    emailkit::file_literal_sink_t sink{"/nonexistent/emailkit/dir"};
+    EXPECT_TRUE(sink.on_literal_begin(10));
+}
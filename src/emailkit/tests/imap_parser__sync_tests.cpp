@@ -0,0 +1,188 @@
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include <emailkit/imap_parser__sync.hpp>
+
+using namespace emailkit::imap_parser::sync;
+using namespace testing;
+
+TEST(imap_parser_sync_test, changed_since_fetch_with_vanished) {
+    const std::string response =
+        "* VANISHED (EARLIER) 300:302,405\r\n"
+        "* 1 FETCH (UID 4 MODSEQ (65402) FLAGS (\\Seen))\r\n"
+        "* 2 FETCH (UID 6 FLAGS (\\Deleted $Phishing) MODSEQ (75403))\r\n"
+        "* 4 FETCH (UID 8 FLAGS () MODSEQ (29738))\r\n"
+        "A3 OK Conditional UID FETCH completed\r\n";
+
+    auto r_or_err = parse_sync_response(response);
+    ASSERT_TRUE(r_or_err);
+    auto& r = *r_or_err;
+
+    EXPECT_THAT(r.vanished, ElementsAre(uid_range_t{300, 302}, uid_range_t{405, 405}));
+    ASSERT_EQ(r.flags_changes.size(), 3);
+    EXPECT_EQ(r.flags_changes[0].uid, 4);
+    EXPECT_EQ(r.flags_changes[0].modseq, 65402);
+    EXPECT_THAT(r.flags_changes[0].flags, ElementsAre("\\Seen"));
+    EXPECT_EQ(r.flags_changes[1].uid, 6);
+    EXPECT_EQ(r.flags_changes[1].modseq, 75403);
+    EXPECT_THAT(r.flags_changes[1].flags, ElementsAre("\\Deleted", "$Phishing"));
+    EXPECT_EQ(r.flags_changes[2].uid, 8);
+    EXPECT_THAT(r.flags_changes[2].flags, IsEmpty());
+}
+
+TEST(imap_parser_sync_test, search_with_modseq) {
+    auto r_or_err = parse_sync_response("* SEARCH 2 5 6 (MODSEQ 917162500)\r\nA1 OK\r\n");
+    ASSERT_TRUE(r_or_err);
+    EXPECT_THAT(r_or_err->search_results, ElementsAre(2, 5, 6));
+    EXPECT_EQ(r_or_err->search_modseq, 917162500);
+
+    r_or_err = parse_sync_response("* SEARCH\r\nA1 OK\r\n");
+    ASSERT_TRUE(r_or_err);
+    EXPECT_THAT(r_or_err->search_results, IsEmpty());
+    EXPECT_EQ(r_or_err->search_modseq, std::nullopt);
+}
+
+TEST(imap_parser_sync_test, esearch_return_data) {
+    auto r_or_err = parse_sync_response(
+        "* ESEARCH (TAG \"A282\") UID MIN 2 MAX 20 COUNT 4 ALL 2,10:11,20\r\nA282 OK\r\n");
+    ASSERT_TRUE(r_or_err);
+    ASSERT_TRUE(r_or_err->esearch);
+    const auto& e = *r_or_err->esearch;
+    EXPECT_TRUE(e.uid);
+    EXPECT_EQ(e.min, 2);
+    EXPECT_EQ(e.max, 20);
+    EXPECT_EQ(e.count, 4);
+    EXPECT_EQ(e.all, "2,10:11,20");
+    EXPECT_THAT(r_or_err->search_results, IsEmpty());
+
+    // Nothing found, only COUNT is returned.
+    r_or_err = parse_sync_response("* ESEARCH (TAG \"A283\") UID COUNT 0\r\nA283 OK\r\n");
+    ASSERT_TRUE(r_or_err);
+    ASSERT_TRUE(r_or_err->esearch);
+    EXPECT_EQ(r_or_err->esearch->count, 0);
+    EXPECT_EQ(r_or_err->esearch->min, std::nullopt);
+    EXPECT_EQ(r_or_err->esearch->all, "");
+
+    EXPECT_FALSE(parse_sync_response("* ESEARCH UID COUNT x\r\nA1 OK\r\n"));
+}
+
+TEST(imap_parser_sync_test, gmail_ids_fetch) {
+    auto r_or_err = parse_sync_response(
+        "* 1 FETCH (UID 4 X-GM-MSGID 1278455344230334865 X-GM-THRID 1266894439832287888)\r\n"
+        "* 2 FETCH (X-GM-THRID 1266894439832287888 UID 9 X-GM-MSGID 1278455344230334866)\r\n"
+        "A1 OK Success\r\n");
+    ASSERT_TRUE(r_or_err);
+    EXPECT_THAT(r_or_err->flags_changes, IsEmpty());
+    ASSERT_EQ(r_or_err->gmail_ids.size(), 2);
+    EXPECT_EQ(r_or_err->gmail_ids[0].uid, 4);
+    EXPECT_EQ(r_or_err->gmail_ids[0].msgid, 1278455344230334865);
+    EXPECT_EQ(r_or_err->gmail_ids[0].thrid, 1266894439832287888);
+    EXPECT_EQ(r_or_err->gmail_ids[1].uid, 9);
+    EXPECT_EQ(r_or_err->gmail_ids[1].thrid, 1266894439832287888);
+
+    EXPECT_FALSE(parse_sync_response("* 1 FETCH (UID 4 X-GM-THRID 12)\r\nA1 OK\r\n"));
+}
+
+TEST(imap_parser_sync_test, gmail_labels_fetch) {
+    auto r_or_err = parse_sync_response(
+        "* 1 FETCH (UID 4 X-GM-MSGID 11 X-GM-THRID 10 X-GM-LABELS (\\Inbox \"My (Label)\" "
+        "Work/Projects \"Say \\\"hi\\\"\"))\r\n"
+        "* 2 FETCH (UID 5 X-GM-MSGID 12 X-GM-THRID 10 X-GM-LABELS ())\r\n"
+        "A1 OK Success\r\n");
+    ASSERT_TRUE(r_or_err);
+    ASSERT_EQ(r_or_err->gmail_ids.size(), 2);
+    EXPECT_THAT(r_or_err->gmail_ids[0].labels,
+                ElementsAre("\\Inbox", "My (Label)", "Work/Projects", "Say \"hi\""));
+    EXPECT_THAT(r_or_err->gmail_ids[1].labels, IsEmpty());
+
+    EXPECT_FALSE(parse_sync_response(
+        "* 1 FETCH (UID 4 X-GM-MSGID 11 X-GM-THRID 10 X-GM-LABELS (\"Open))\r\nA1 OK\r\n"));
+}
+
+TEST(imap_parser_sync_test, gmail_labels_fetch_with_literals) {
+    auto r_or_err = parse_sync_response(
+        "* 1 FETCH (UID 4 X-GM-MSGID 11 X-GM-THRID 10 X-GM-LABELS (\\Inbox {10}\r\n"
+        "Work \"(1)\" {4}\r\nA)\r\n))\r\n"
+        "* 2 FETCH (UID 5 X-GM-MSGID 12 X-GM-THRID 10 X-GM-LABELS ({3}\r\n\"x\"))\r\n"
+        "A1 OK Success\r\n");
+    ASSERT_TRUE(r_or_err);
+    ASSERT_EQ(r_or_err->gmail_ids.size(), 2);
+    EXPECT_EQ(r_or_err->gmail_ids[0].msgid, 11);
+    EXPECT_THAT(r_or_err->gmail_ids[0].labels, ElementsAre("\\Inbox", "Work \"(1)\"", "A)\r\n"));
+    EXPECT_EQ(r_or_err->gmail_ids[1].uid, 5);
+    EXPECT_THAT(r_or_err->gmail_ids[1].labels, ElementsAre("\"x\""));
+
+    // Literal is shorter than it claims to be.
+    EXPECT_FALSE(parse_sync_response(
+        "* 1 FETCH (UID 4 X-GM-MSGID 11 X-GM-THRID 10 X-GM-LABELS ({40}\r\nA))\r\nA1 OK\r\n"));
+}
+
+TEST(imap_parser_sync_test, status_response) {
+    auto status_or_err = parse_status_response_line(
+        "* STATUS \"[Gmail]/All Mail\" (MESSAGES 231 UNSEEN 3 UIDNEXT 44292 UIDVALIDITY 1 "
+        "HIGHESTMODSEQ 90060115205545359 SIZE 1048576)\r\n");
+    ASSERT_TRUE(status_or_err);
+    EXPECT_EQ(*status_or_err, (mailbox_status_t{.mailbox = "[Gmail]/All Mail",
+                                                .messages = 231,
+                                                .unseen = 3,
+                                                .uid_next = 44292,
+                                                .uid_validity = 1,
+                                                .highest_modseq = 90060115205545359}));
+
+    status_or_err = parse_status_response_line("* STATUS INBOX (RECENT 1)");
+    ASSERT_TRUE(status_or_err);
+    EXPECT_EQ(status_or_err->mailbox, "INBOX");
+    EXPECT_EQ(status_or_err->recent, 1);
+    EXPECT_FALSE(status_or_err->messages);
+
+    EXPECT_FALSE(parse_status_response_line("* LIST () \"/\" INBOX\r\n"));
+    EXPECT_FALSE(parse_status_response_line("* STATUS INBOX (MESSAGES x)\r\n"));
+    EXPECT_FALSE(parse_status_response_line("* STATUS \"INBOX (MESSAGES 1)\r\n"));
+}
+
+TEST(imap_parser_sync_test, binary_fetch) {
+    // Data with NUL and CRLF in literal8, size of decoded part, unsolicited flags update.
+    const char response[] =
+        "* 3 FETCH (FLAGS (\\Seen))\r\n"
+        "* 12 FETCH (UID 345 BINARY[2]<0> ~{7}\r\n\x89PNG\0\r\n BINARY.SIZE[2] 10240)\r\n"
+        "* 13 FETCH (BINARY[1.1] \"text\" UID 346 BINARY[] NIL)\r\n"
+        "A1 OK FETCH completed\r\n";
+    auto sections_or_err =
+        parse_binary_fetch_response(std::string_view{response, sizeof(response) - 1});
+    ASSERT_TRUE(sections_or_err);
+    auto& sections = *sections_or_err;
+    ASSERT_EQ(sections.size(), 3);
+    EXPECT_EQ(sections[0].uid, 345);
+    EXPECT_EQ(sections[0].section, "2");
+    EXPECT_EQ(sections[0].origin, 0);
+    EXPECT_EQ(sections[0].data, std::string("\x89PNG\0\r\n", 7));
+    EXPECT_EQ(sections[0].size, 10240);
+    EXPECT_EQ(sections[1].uid, 346);
+    EXPECT_EQ(sections[1].section, "1.1");
+    EXPECT_EQ(sections[1].data, "text");
+    EXPECT_FALSE(sections[1].origin);
+    EXPECT_FALSE(sections[1].size);
+    EXPECT_EQ(sections[2].section, "");
+    EXPECT_EQ(sections[2].data, "");
+
+    EXPECT_FALSE(parse_binary_fetch_response("* 1 FETCH (UID 1 BINARY[1] ~{10}\r\nshort)\r\n"));
+    EXPECT_FALSE(parse_binary_fetch_response("* 1 FETCH (BINARY[1] {1}\r\nx)\r\nA1 OK\r\n"));
+}
+
+TEST(imap_parser_sync_test, malformed_responses) {
+    EXPECT_FALSE(parse_sync_response("* 1 FETCH (UID x FLAGS ())\r\nA1 OK\r\n"));
+    EXPECT_FALSE(parse_sync_response("* 1 FETCH (FLAGS (\\Seen)\r\nA1 OK\r\n"));
+    EXPECT_FALSE(parse_sync_response("* SEARCH 1 (MODSEQ)\r\nA1 OK\r\n"));
+    EXPECT_FALSE(parse_sync_response("* 1 FETCH (UID 1 RFC822 {10}\r\n"));
+}
+
+TEST(imap_parser_sync_test, uid_sets) {
+    EXPECT_THAT(*parse_uid_set("1:3,7,12:10"), ElementsAre(1, 2, 3, 7, 10, 11, 12));
+    EXPECT_FALSE(parse_uid_set("1:*"));
+    EXPECT_FALSE(parse_uid_set("1:4294967295"));
+    EXPECT_THAT(*parse_uid_ranges("1:4294967295,7"),
+                ElementsAre(uid_range_t{1, 4294967295}, uid_range_t{7, 7}));
+    EXPECT_EQ(encode_uid_set({1, 2, 3, 7, 10, 11}), "1:3,7,10:11");
+    EXPECT_EQ(encode_uid_set({5}), "5");
+    EXPECT_EQ(encode_uid_set({}), "");
+}
@@ -20,7 +20,7 @@ TEST(imap_parser_test, basic_test) {
         "* 0 RECENT\r\n"
         "* OK [UNSEEN 3] Unseen count.\r\n"
         "* OK [UIDNEXT 10] Predicted next UID.\r\n"
-        "* OK [HIGHESTMODSEQ 1909]\r\n"  // Note, this ignored by parser (TODO: implement)
+        "* OK [HIGHESTMODSEQ 1909]\r\n"
         "A3 OK [READ-ONLY] INBOX selected. (Success)\r\n";
     "A3 OK [READ-WRITE] INBOX selected. (Success)\r\n";  // Note, this is not seen by parser
                                                          // (TODO: separate test)
@@ -61,8 +61,28 @@ TEST(imap_parser_test, basic_test) {
     // ASSERT_TRUE(std::holds_alternative<imap_parser::uidnext_resp_text_code_t>(records[8]));
     // EXPECT_THAT(std::get<imap_parser::uidnext_resp_text_code_t>(records[8]).value, 10);
 
-    ASSERT_TRUE(std::holds_alternative<imap_parser::read_only_resp_text_code_t>(records[8]));
-    // ASSERT_TRUE(std::holds_alternative<imap_parser::read_write_resp_text_code_t>(records[9]));
+    ASSERT_TRUE(
+        std::holds_alternative<imap_parser::highest_modseq_resp_text_code_t>(records[8]));
+    EXPECT_EQ(std::get<imap_parser::highest_modseq_resp_text_code_t>(records[8]).value, 1909);
+
+    ASSERT_TRUE(std::holds_alternative<imap_parser::read_only_resp_text_code_t>(records[9]));
+    // ASSERT_TRUE(std::holds_alternative<imap_parser::read_write_resp_text_code_t>(records[10]));
+}
+
+TEST(imap_parser_test, highest_modseq_beyond_uint32_and_nomodseq) {
+    auto records_or_err = imap_parser::parse_mailbox_data_records(
+        "* OK [HIGHESTMODSEQ 90060115205545359]\r\n"
+        "* OK [NOMODSEQ] Sorry, this mailbox format doesn't support modsequences\r\n"
+        "A3 OK [READ-WRITE] INBOX selected. (Success)\r\n");
+    ASSERT_TRUE(records_or_err);
+    auto& records = *records_or_err;
+    ASSERT_GE(records.size(), 2);
+
+    ASSERT_TRUE(
+        std::holds_alternative<imap_parser::highest_modseq_resp_text_code_t>(records[0]));
+    EXPECT_EQ(std::get<imap_parser::highest_modseq_resp_text_code_t>(records[0]).value,
+              90060115205545359ull);
+    EXPECT_TRUE(std::holds_alternative<imap_parser::no_modseq_resp_text_code_t>(records[1]));
 }
 
 TEST(imap_parser_test, bad_syntax_in_flags__1) {
@@ -238,6 +258,35 @@ TEST(imap_parser_test, parse_message_data_records_fetch_rfc822) {
     ASSERT_TRUE(message_data_or_err);
 }
 
+TEST(imap_parser_test, parse_message_data_records_fetch_body_section_partial) {
+    // clang-format off
+    const std::string fetch_body_section_result =
+        "* 1 FETCH (UID 5 BODY[2]<0> {4}\r\ntest)\r\n"
+        "* 2 FETCH (BODY[1.MIME] \"Content-Type: text/plain\")\r\n"
+        "A4 OK Success\r\n";
+
+    // clang-format on
+    auto message_data_or_err = imap_parser::parse_message_data_records(fetch_body_section_result);
+    ASSERT_TRUE(message_data_or_err);
+    ASSERT_EQ(message_data_or_err->size(), 2);
+
+    auto& first_attrs = (*message_data_or_err)[0].static_attributes;
+    ASSERT_EQ(first_attrs.size(), 2);
+    auto* partial_section = std::get_if<imap_parser::MsgAttrBodySection>(&first_attrs[1]);
+    ASSERT_TRUE(partial_section);
+    EXPECT_EQ(partial_section->section, "2");
+    EXPECT_EQ(partial_section->origin, 0);
+    EXPECT_EQ(partial_section->data, "test");
+
+    auto& second_attrs = (*message_data_or_err)[1].static_attributes;
+    ASSERT_EQ(second_attrs.size(), 1);
+    auto* mime_section = std::get_if<imap_parser::MsgAttrBodySection>(&second_attrs[0]);
+    ASSERT_TRUE(mime_section);
+    EXPECT_EQ(mime_section->section, "1.MIME");
+    EXPECT_FALSE(mime_section->origin);
+    EXPECT_EQ(mime_section->data, "Content-Type: text/plain");
+}
+
 TEST(imap_parser_test, parse_message_data_records_fetch_rfc822__correct_size) {
     // clang-format off
     const std::string fetch_rfc822_result =
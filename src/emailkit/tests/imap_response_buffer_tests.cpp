@@ -0,0 +1,30 @@
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include <emailkit/imap_response_buffer.hpp>
+
+TEST(imap_response_buffer_test, from_string_does_not_copy) {
+    std::string s = "* 1 FETCH (RFC822 {5}\r\nhello)\r\nA0 OK Success\r\n";
+    const char* original_data = s.data();
+    auto buff = emailkit::imap_response_buffer_t::from_string(std::move(s));
+    EXPECT_EQ(buff.data(), original_data);
+    EXPECT_EQ(buff.view(), "* 1 FETCH (RFC822 {5}\r\nhello)\r\nA0 OK Success\r\n");
+}
+
+TEST(imap_response_buffer_test, subbuffer_shares_storage) {
+    emailkit::imap_response_buffer_t sub;
+    {
+        auto buff = emailkit::imap_response_buffer_t::from_string("* 1 EXISTS\r\nA0 OK\r\n");
+        sub = buff.subbuffer(12);
+        EXPECT_EQ(sub.data(), buff.data() + 12);
+    }
+    // storage is still alive after parent handle has gone.
+    EXPECT_EQ(sub.view(), "A0 OK\r\n");
+    EXPECT_EQ(sub.size(), 7);
+}
+
+TEST(imap_response_buffer_test, empty_buffer) {
+    emailkit::imap_response_buffer_t buff;
+    EXPECT_TRUE(buff.empty());
+    EXPECT_EQ(buff.to_string(), "");
+}
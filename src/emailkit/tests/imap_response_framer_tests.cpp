@@ -0,0 +1,136 @@
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include <emailkit/imap_response_framer.hpp>
+
+namespace {
+std::optional<size_t> feed_all(emailkit::imap_response_framer_t& framer, std::string_view s) {
+    return framer.feed(s.data(), s.data() + s.size());
+}
+}  // namespace
+
+TEST(imap_response_framer_test, simple_response) {
+    emailkit::imap_response_framer_t framer{"A0"};
+    std::string_view response = "* 1 EXISTS\r\nA0 OK Success\r\n";
+    EXPECT_EQ(feed_all(framer, response), response.size());
+}
+
+TEST(imap_response_framer_test, stops_right_after_tagged_line) {
+    emailkit::imap_response_framer_t framer{"A0"};
+    std::string_view response = "* 1 EXISTS\r\nA0 OK Success\r\n* 2 EXISTS\r\n";
+    EXPECT_EQ(feed_all(framer, response), 27);
+}
+
+TEST(imap_response_framer_test, tag_inside_of_literal_is_ignored) {
+    emailkit::imap_response_framer_t framer{"A0"};
+    std::string_view response =
+        "* 1 FETCH (RFC822 {18}\r\nhello\r\nA0 OK fake)\r\nA0 OK Success\r\n";
+    EXPECT_EQ(feed_all(framer, response), response.size());
+}
+
+TEST(imap_response_framer_test, literal8_is_skipped) {
+    emailkit::imap_response_framer_t framer{"A0"};
+    std::string_view response =
+        "* 1 FETCH (BINARY[] ~{12}\r\n\r\nA0 OK x\r\n)\r\nA0 OK Success\r\n";
+    EXPECT_EQ(feed_all(framer, response), response.size());
+}
+
+TEST(imap_response_framer_test, zero_size_literal) {
+    emailkit::imap_response_framer_t framer{"A0"};
+    std::string_view response = "* 1 FETCH (RFC822 {0}\r\n)\r\nA0 OK Success\r\n";
+    EXPECT_EQ(feed_all(framer, response), response.size());
+}
+
+TEST(imap_response_framer_test, overflowing_literal_size_is_not_a_literal) {
+    emailkit::imap_response_framer_t framer{"A0"};
+    // 2^64 + 1 would wrap around to literal of 1 byte which swallows "A" of the tagged line.
+    std::string_view response = "* 1 FETCH (RFC822 {18446744073709551617}\r\nA0 OK Success\r\n";
+    EXPECT_EQ(feed_all(framer, response), response.size());
+}
+
+TEST(imap_response_framer_test, tag_not_at_line_start_is_ignored) {
+    emailkit::imap_response_framer_t framer{"A0"};
+    EXPECT_EQ(feed_all(framer, "* OK A0 OK Success\r\n"), std::nullopt);
+    EXPECT_EQ(feed_all(framer, "AA0 OK\r\n"), std::nullopt);
+    EXPECT_EQ(feed_all(framer, "A0 OK\r\n"), 7);
+}
+
+TEST(imap_response_framer_test, byte_by_byte_feeding) {
+    emailkit::imap_response_framer_t framer{"A10"};
+    std::string_view response =
+        "* 1 FETCH (RFC822 {20}\r\n\r\nA10 OK fake\r\nxxxxx)\r\n* 2 EXISTS\r\nA10 OK Success\r\n";
+    for (size_t i = 0; i + 1 < response.size(); ++i) {
+        ASSERT_EQ(framer.feed(response.data() + i, response.data() + i + 1), std::nullopt)
+            << "at offset " << i;
+    }
+    EXPECT_EQ(framer.feed(response.data() + response.size() - 1, response.data() + response.size()),
+              1);
+}
+
+TEST(imap_response_framer_test, literal_size_split_between_chunks) {
+    emailkit::imap_response_framer_t framer{"A0"};
+    EXPECT_EQ(feed_all(framer, "* 1 FETCH (RFC822 {1"), std::nullopt);
+    EXPECT_EQ(feed_all(framer, "0}\r"), std::nullopt);
+    EXPECT_EQ(feed_all(framer, "\nA0 OK ab\r\n"), std::nullopt);
+    EXPECT_EQ(framer.literal_bytes_left(), 0);
+    EXPECT_EQ(feed_all(framer, ")\r\nA0 OK\r\n"), 10);
+}
+
+TEST(imap_response_framer_test, scan_stops_before_large_literal_data) {
+    using scan_status_t = emailkit::imap_response_framer_t::scan_status_t;
+    emailkit::imap_response_framer_t framer{"A0"};
+    std::string_view response =
+        "* 1 FETCH (BODY[] {3}\r\nabc RFC822 {12}\r\n0123456789\r\n)\r\nA0 OK\r\n";
+    const char* p = response.data();
+    const char* end = response.data() + response.size();
+
+    auto r = framer.scan(p, end, 10);
+    EXPECT_EQ(r.status, scan_status_t::literal_begins);
+    EXPECT_EQ(r.literal_size, 12);
+    EXPECT_EQ(response.substr(r.consumed, 12), "0123456789\r\n");
+    p += r.consumed;
+
+    r = framer.scan(p, end, 10);
+    EXPECT_EQ(r.status, scan_status_t::response_complete);
+    EXPECT_EQ(p + r.consumed, end);
+}
+
+TEST(imap_response_framer_test, scan_stops_after_each_untagged_response) {
+    using scan_status_t = emailkit::imap_response_framer_t::scan_status_t;
+    emailkit::imap_response_framer_t framer{""};
+    std::string_view response =
+        "* 1 FETCH (UID 7 RFC822 {9}\r\nA0 OK x\r\n)\r\n* 2 FETCH (UID 8)\r\nA3 OK Success\r\n";
+    const char* p = response.data();
+    const char* end = response.data() + response.size();
+
+    auto r = framer.scan(p, end, framer.NO_LITERAL_STOP, true);
+    EXPECT_EQ(r.status, scan_status_t::untagged_response_complete);
+    EXPECT_EQ(response.substr(0, r.consumed), "* 1 FETCH (UID 7 RFC822 {9}\r\nA0 OK x\r\n)\r\n");
+    p += r.consumed;
+
+    r = framer.scan(p, end, framer.NO_LITERAL_STOP, true);
+    EXPECT_EQ(r.status, scan_status_t::untagged_response_complete);
+    EXPECT_EQ(std::string_view(p, r.consumed), "* 2 FETCH (UID 8)\r\n");
+    p += r.consumed;
+
+    r = framer.scan(p, end, framer.NO_LITERAL_STOP, true);
+    EXPECT_EQ(r.status, scan_status_t::response_complete);
+    EXPECT_EQ(p + r.consumed, end);
+}
+
+TEST(imap_response_framer_test, empty_tag_stops_at_any_tagged_line) {
+    emailkit::imap_response_framer_t framer{""};
+    std::string_view response =
+        "* 1 FETCH (RFC822 {9}\r\nA0 OK x\r\n)\r\n+ go ahead\r\nA7 OK Success\r\nA8 OK\r\n";
+    EXPECT_EQ(feed_all(framer, response), response.size() - 7);
+
+    // Next response is framed by the same framer.
+    EXPECT_EQ(feed_all(framer, response.substr(response.size() - 7)), 7);
+}
+
+TEST(imap_response_framer_test, response_tag) {
+    EXPECT_EQ(emailkit::imap_response_tag("* 1 EXISTS\r\nA12 OK Success\r\n"), "A12");
+    EXPECT_EQ(emailkit::imap_response_tag("A1 NO\r\n"), "A1");
+    EXPECT_EQ(emailkit::imap_response_tag("* 1 FETCH (RFC822 {7}\r\nA0 OK\r\n)\r\nA2 OK\r\n"),
+              "A2");
+}
@@ -0,0 +1,74 @@
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include <emailkit/imap_search_query.hpp>
+
+using namespace emailkit::imap_client;
+using namespace std::chrono;
+
+TEST(imap_search_query_test, encodes_criteria) {
+    EXPECT_EQ(search_query_t{}.encode(), "ALL");
+
+    EXPECT_EQ(search_query_t{}
+                  .unseen()
+                  .from("alan.kay@example.com")
+                  .since(2024y / March / 1)
+                  .before(2024y / December / 31)
+                  .encode(),
+              "UNSEEN FROM \"alan.kay@example.com\" SINCE 1-Mar-2024 BEFORE 31-Dec-2024");
+
+    EXPECT_EQ(search_query_t{}
+                  .or_(search_query_t{}.from("a@x.org"), search_query_t{}.from("b@x.org").flagged())
+                  .not_(search_query_t{}.deleted())
+                  .encode(),
+              "OR FROM \"a@x.org\" (FROM \"b@x.org\" FLAGGED) NOT DELETED");
+
+    EXPECT_EQ(search_query_t{}.subject("say \"hi\" \\o/").larger(1024).encode(),
+              "SUBJECT \"say \\\"hi\\\" \\\\o/\" LARGER 1024");
+}
+
+TEST(imap_search_query_test, charset_gmail_and_invalid_strings) {
+    const imap_capabilities_t literal_plus{{"IMAP4rev1", "LITERAL+"}};
+    const imap_capabilities_t literal_minus{{"IMAP4rev1", "LITERAL-"}};
+
+    // 8-bit strings go as non-synchronizing literals.
+    EXPECT_EQ(search_query_t{}.subject("Привіт").encode(literal_plus),
+              "CHARSET UTF-8 SUBJECT {12+}\r\nПривіт");
+    EXPECT_EQ(search_query_t{}.not_(search_query_t{}.from("Ґ")).seen().encode(literal_minus),
+              "CHARSET UTF-8 NOT FROM {2+}\r\nҐ SEEN");
+    EXPECT_EQ(search_query_t{}.subject("Привіт").encode().error(),
+              std::errc::operation_not_supported);
+    const auto long_text = std::string(4096, 'x') + "Привіт";
+    EXPECT_EQ(search_query_t{}.body(long_text).encode(literal_minus).error(),
+              std::errc::operation_not_supported);
+    EXPECT_TRUE(search_query_t{}.body(long_text).encode(literal_plus));
+
+    auto gmail = search_query_t{}.gmail_raw("has:attachment in:unread");
+    EXPECT_TRUE(gmail.uses_gmail_extensions());
+    EXPECT_EQ(gmail.encode(), "X-GM-RAW \"has:attachment in:unread\"");
+    EXPECT_FALSE(search_query_t{}.seen().uses_gmail_extensions());
+
+    EXPECT_EQ(search_query_t{}.subject("a\r\nb").encode().error(), std::errc::invalid_argument);
+    EXPECT_EQ(search_query_t{}.since(2024y / February / 30).encode().error(),
+              std::errc::invalid_argument);
+}
+
+TEST(imap_search_query_test, tokens_which_cannot_be_sent_make_query_invalid) {
+    EXPECT_EQ(search_query_t{}.keyword("$Forwarded").encode(), "KEYWORD $Forwarded");
+    EXPECT_EQ(search_query_t{}.header("List-Id", "dev").encode(), "HEADER List-Id \"dev\"");
+    EXPECT_EQ(search_query_t{}.uid("1,5:7,1000:*").encode(), "UID 1,5:7,1000:*");
+
+    for (auto flag : {"", "a b", "a\r\nA2 DELETE INBOX", "a)", "(a", "a\"", "a{5}", "a]", "\\x"}) {
+        EXPECT_EQ(search_query_t{}.keyword(flag).encode().error(), std::errc::invalid_argument)
+            << flag;
+    }
+    for (auto name : {"", "List Id", "X:Y", "X\r\nA2 LOGOUT", "X)"}) {
+        EXPECT_EQ(search_query_t{}.header(name, "x").encode().error(), std::errc::invalid_argument)
+            << name;
+    }
+    for (auto uid_set : {"", "0", "1:", ",1", "1,", "1,,2", "1:2:3", "x", "1 ALL", "4294967296",
+                         "1)\r\nA2 LOGOUT"}) {
+        EXPECT_EQ(search_query_t{}.uid(uid_set).encode().error(), std::errc::invalid_argument)
+            << uid_set;
+    }
+}
@@ -0,0 +1,108 @@
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include <emailkit/protocol_capture.hpp>
+
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <thread>
+
+using namespace emailkit;
+
+namespace {
+std::string read_file(const std::filesystem::path& path) {
+    std::ifstream f{path, std::ios_base::binary};
+    std::stringstream ss;
+    ss << f.rdbuf();
+    return ss.str();
+}
+}  // namespace
+
+TEST(protocol_capture_test, writes_frames_with_headers) {
+    const auto path = std::filesystem::temp_directory_path() / "emailkit_protocol_capture_test.bin";
+    std::filesystem::remove(path);
+
+    protocol_capture_t capture{protocol_capture_opts_t{.path = path.string()}};
+    ASSERT_TRUE(capture.is_open());
+    const auto conn_id = protocol_capture_t::next_connection_id();
+    EXPECT_TRUE(capture.capture(capture_direction_t::client_to_server, conn_id, "A1",
+                                "A1 select INBOX\r\n"));
+    EXPECT_TRUE(capture.capture(capture_direction_t::server_to_client, conn_id, "A1",
+                                "A1 OK Success\r\n"));
+    capture.flush();
+
+    const std::string contents = read_file(path);
+    EXPECT_THAT(contents, testing::MatchesRegex(fmt::format(
+                              "# [0-9]+ {0} C A1 17\nA1 select INBOX\r\n\n"
+                              "# [0-9]+ {0} S A1 15\nA1 OK Success\r\n\n",
+                              conn_id)));
+    EXPECT_EQ(capture.frames_written(), 2);
+    EXPECT_EQ(capture.frames_dropped(), 0);
+    std::filesystem::remove(path);
+}
+
+TEST(protocol_capture_test, long_frames_are_truncated_and_memory_is_bounded) {
+    const auto path = std::filesystem::temp_directory_path() / "emailkit_protocol_capture_max.bin";
+    std::filesystem::remove(path);
+
+    protocol_capture_t capture{protocol_capture_opts_t{
+        .path = path.string(), .max_buffered_bytes = 6, .max_frame_bytes = 4}};
+    const auto conn_id = protocol_capture_t::next_connection_id();
+    EXPECT_TRUE(capture.capture(capture_direction_t::server_to_client, conn_id, "",
+                                "* 1 FETCH (RFC822 {5}\r\nhello)\r\n"));
+    capture.flush();
+    EXPECT_TRUE(capture.capture(capture_direction_t::server_to_client, conn_id, "", "* 2"));
+    capture.flush();
+
+    const std::string contents = read_file(path);
+    EXPECT_THAT(contents,
+                testing::MatchesRegex(fmt::format(
+                    "# [0-9]+ {0} S - 4 31\n\\* 1 \n# [0-9]+ {0} S - 3\n\\* 2\n", conn_id)));
+    std::filesystem::remove(path);
+
+    // Frames which would take more than max_buffered_bytes are dropped.
+    protocol_capture_t small_capture{
+        protocol_capture_opts_t{.path = path.string(), .max_buffered_bytes = 2}};
+    EXPECT_FALSE(small_capture.capture(capture_direction_t::client_to_server, conn_id, "A1",
+                                       "A1 NOOP\r\n"));
+    EXPECT_EQ(small_capture.frames_dropped(), 1);
+    std::filesystem::remove(path);
+}
+
+TEST(protocol_capture_test, concurrent_producers_lose_nothing_that_was_accepted) {
+    const auto path = std::filesystem::temp_directory_path() / "emailkit_protocol_capture_mt.bin";
+    std::filesystem::remove(path);
+
+    protocol_capture_t capture{protocol_capture_opts_t{.path = path.string(), .ring_capacity = 8}};
+    constexpr int THREADS = 4;
+    constexpr int FRAMES_PER_THREAD = 2000;
+    std::atomic<size_t> accepted{0};
+    std::vector<std::thread> producers;
+    for (int t = 0; t < THREADS; ++t) {
+        producers.emplace_back([&capture, &accepted] {
+            const auto conn_id = protocol_capture_t::next_connection_id();
+            for (int i = 0; i < FRAMES_PER_THREAD; ++i) {
+                if (capture.capture(capture_direction_t::server_to_client, conn_id, "*",
+                                    "* 1 EXISTS\r\n")) {
+                    ++accepted;
+                }
+            }
+        });
+    }
+    for (auto& t : producers) {
+        t.join();
+    }
+    capture.flush();
+
+    EXPECT_EQ(capture.frames_written(), accepted.load());
+    EXPECT_EQ(capture.frames_written() + capture.frames_dropped(), THREADS * FRAMES_PER_THREAD);
+
+    const std::string contents = read_file(path);
+    size_t headers = 0;
+    for (size_t pos = 0; (pos = contents.find("# ", pos)) != std::string::npos; ++pos) {
+        ++headers;
+    }
+    EXPECT_EQ(headers, accepted.load());
+    std::filesystem::remove(path);
+}
@@ -0,0 +1,102 @@
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include <emailkit/tcp_connector.hpp>
+
+#include <asio.hpp>
+
+using namespace emailkit;
+
+namespace {
+asio::ip::tcp::endpoint ep(const char* addr) {
+    return asio::ip::tcp::endpoint{asio::ip::make_address(addr), 993};
+}
+}  // namespace
+
+TEST(tcp_connector_test, interleave_address_families) {
+    auto ordered = interleave_address_families(
+        {ep("::1"), ep("::2"), ep("::3"), ep("10.0.0.1"), ep("10.0.0.2")});
+    EXPECT_THAT(ordered,
+                ::testing::ElementsAre(ep("::1"), ep("10.0.0.1"), ep("::2"), ep("10.0.0.2"),
+                                       ep("::3")));
+}
+
+TEST(tcp_connector_test, interleave_address_families_ipv4_first) {
+    auto ordered = interleave_address_families({ep("10.0.0.1"), ep("10.0.0.2"), ep("::1")});
+    EXPECT_THAT(ordered, ::testing::ElementsAre(ep("10.0.0.1"), ep("::1"), ep("10.0.0.2")));
+}
+
+TEST(tcp_connector_test, connects_to_loopback) {
+    asio::io_context ctx;
+
+    asio::ip::tcp::acceptor acceptor{
+        ctx, asio::ip::tcp::endpoint{asio::ip::make_address("127.0.0.1"), 0}};
+    asio::ip::tcp::socket accepted{ctx};
+    acceptor.async_accept(accepted, [](std::error_code) {});
+
+    asio::ip::tcp::socket socket{ctx};
+    bool called = false;
+    async_happy_eyeballs_connect(
+        ctx, "127.0.0.1", std::to_string(acceptor.local_endpoint().port()), socket,
+        [&](std::error_code ec, tcp_connect_result_t result) {
+            called = true;
+            ASSERT_FALSE(ec);
+            EXPECT_EQ(result.endpoint, acceptor.local_endpoint());
+            EXPECT_EQ(result.endpoints_resolved, 1);
+            EXPECT_EQ(result.attempts_started, 1);
+        });
+    ctx.run();
+
+    EXPECT_TRUE(called);
+    EXPECT_TRUE(socket.is_open());
+    EXPECT_EQ(socket.remote_endpoint(), acceptor.local_endpoint());
+}
+
+TEST(tcp_connector_test, fails_when_nobody_listens) {
+    asio::io_context ctx;
+
+    // Take free port and release it so that connection is refused.
+    asio::ip::tcp::acceptor acceptor{
+        ctx, asio::ip::tcp::endpoint{asio::ip::make_address("127.0.0.1"), 0}};
+    const auto port = acceptor.local_endpoint().port();
+    acceptor.close();
+
+    asio::ip::tcp::socket socket{ctx};
+    std::error_code result_ec;
+    async_happy_eyeballs_connect(ctx, "127.0.0.1", std::to_string(port), socket,
+                                 [&](std::error_code ec, tcp_connect_result_t) { result_ec = ec; });
+    ctx.run();
+
+    EXPECT_TRUE(result_ec);
+    EXPECT_FALSE(socket.is_open());
+}
+
+TEST(tcp_connector_test, cancelled_connect_leaves_socket_untouched) {
+    asio::io_context ctx;
+
+    asio::ip::tcp::acceptor acceptor{
+        ctx, asio::ip::tcp::endpoint{asio::ip::make_address("127.0.0.1"), 0}};
+    asio::ip::tcp::socket accepted{ctx};
+    acceptor.async_accept(accepted, [](std::error_code) {});
+
+    asio::ip::tcp::socket socket{ctx};
+    cancellation_source_t cancellation;
+    std::error_code result_ec;
+    size_t calls = 0;
+    asio::post(ctx, [&]() {
+        async_happy_eyeballs_connect(
+            ctx, "127.0.0.1", std::to_string(acceptor.local_endpoint().port()), socket,
+            [&](std::error_code ec, tcp_connect_result_t) {
+                calls++;
+                result_ec = ec;
+                acceptor.close();
+            },
+            tcp_connect_opts_t{.cancellation = cancellation.token()});
+        cancellation.cancel();
+    });
+    ctx.run();
+
+    EXPECT_EQ(calls, 1);
+    EXPECT_EQ(result_ec, std::errc::operation_canceled);
+    EXPECT_FALSE(socket.is_open());
+}
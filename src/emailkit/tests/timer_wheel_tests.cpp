@@ -0,0 +1,69 @@
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include <emailkit/timer_wheel.hpp>
+
+#include <asio.hpp>
+
+using namespace emailkit;
+
+TEST(timer_wheel_test, fires_after_deadline_in_order) {
+    asio::io_context ctx;
+    auto& wheel = timer_wheel_t::of(ctx);
+    EXPECT_EQ(&wheel, &timer_wheel_t::of(ctx));
+
+    const auto start = std::chrono::steady_clock::now();
+    std::vector<int> fired;
+    std::vector<std::chrono::steady_clock::duration> fired_after;
+    for (int i : {3, 1, 2}) {
+        wheel.schedule(start + i * 150ms, [&, i] {
+            fired.push_back(i);
+            fired_after.push_back(std::chrono::steady_clock::now() - start);
+        });
+    }
+    EXPECT_EQ(wheel.size(), 3);
+
+    ctx.run_for(1s);
+
+    EXPECT_THAT(fired, testing::ElementsAre(1, 2, 3));
+    ASSERT_EQ(fired_after.size(), 3);
+    for (size_t i = 0; i < fired_after.size(); ++i) {
+        EXPECT_GE(fired_after[i], (i + 1) * 150ms);
+        EXPECT_LT(fired_after[i], (i + 1) * 150ms + 2 * timer_wheel_t::TICK);
+    }
+    EXPECT_EQ(wheel.size(), 0);
+}
+
+TEST(timer_wheel_test, cancelled_timer_does_not_fire) {
+    asio::io_context ctx;
+    auto& wheel = timer_wheel_t::of(ctx);
+
+    bool fired = false;
+    bool other_fired = false;
+    auto id = wheel.schedule(std::chrono::steady_clock::now() + 100ms, [&] { fired = true; });
+    wheel.schedule(std::chrono::steady_clock::now() + 200ms, [&] { other_fired = true; });
+    wheel.cancel(id);
+    wheel.cancel(id);  // no-op
+
+    ctx.run_for(500ms);
+    EXPECT_FALSE(fired);
+    EXPECT_TRUE(other_fired);
+}
+
+TEST(timer_wheel_test, deadline_beyond_one_turn_and_in_the_past) {
+    asio::io_context ctx;
+    auto& wheel = timer_wheel_t::of(ctx);
+
+    const auto now = std::chrono::steady_clock::now();
+    bool far_fired = false;
+    bool past_fired = false;
+    // Lands in the slot right after the current one, but one full turn later.
+    wheel.schedule(now + timer_wheel_t::TICK * (timer_wheel_t::SLOTS + 1),
+                   [&] { far_fired = true; });
+    wheel.schedule(now - 1s, [&] { past_fired = true; });
+
+    ctx.run_for(3 * timer_wheel_t::TICK);
+    EXPECT_TRUE(past_fired);
+    EXPECT_FALSE(far_fired);
+    EXPECT_EQ(wheel.size(), 1);
+}
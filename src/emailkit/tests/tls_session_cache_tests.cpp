@@ -0,0 +1,105 @@
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include <emailkit/tls_session_cache.hpp>
+
+#include <asio.hpp>
+#include <asio/ssl.hpp>
+
+using namespace emailkit;
+
+namespace {
+
+// Accepts TLS connections and greets every client with a line so that client also gets session
+// tickets which TLS 1.3 servers send after handshake.
+class greeting_tls_server {
+   public:
+    explicit greeting_tls_server(asio::io_context& ctx)
+        : m_ssl_ctx(asio::ssl::context::sslv23),
+          m_acceptor(ctx, asio::ip::tcp::endpoint{asio::ip::make_address("127.0.0.1"), 0}) {
+        m_ssl_ctx.use_certificate_chain_file("newcert.pem");
+        m_ssl_ctx.use_private_key_file("privkey.pem", asio::ssl::context::pem);
+        do_accept();
+    }
+
+    std::string port() const { return std::to_string(m_acceptor.local_endpoint().port()); }
+
+   private:
+    void do_accept() {
+        m_acceptor.async_accept([this](std::error_code ec, asio::ip::tcp::socket socket) {
+            if (ec) {
+                return;
+            }
+            auto stream = std::make_shared<asio::ssl::stream<asio::ip::tcp::socket>>(
+                std::move(socket), m_ssl_ctx);
+            stream->async_handshake(asio::ssl::stream_base::server, [stream](std::error_code ec) {
+                if (ec) {
+                    return;
+                }
+                asio::async_write(*stream, asio::buffer("* OK ready\r\n", 12),
+                                  [stream](std::error_code, size_t) {});
+            });
+            do_accept();
+        });
+    }
+
+    asio::ssl::context m_ssl_ctx;
+    asio::ip::tcp::acceptor m_acceptor;
+};
+
+// Connects, reads greeting and returns whether session has been resumed.
+bool connect_once(asio::io_context& ctx, const std::string& port) {
+    auto& cache = tls_session_cache_t::instance();
+    auto ssl_ctx = cache.client_context();
+    asio::ssl::stream<asio::ip::tcp::socket> stream{ctx, *ssl_ctx};
+    const std::string key = "localhost:" + port;
+
+    stream.next_layer().connect(
+        asio::ip::tcp::endpoint{asio::ip::make_address("127.0.0.1"),
+                                static_cast<unsigned short>(std::stoi(port))});
+    cache.prepare_handshake(stream.native_handle(), "localhost", key);
+
+    bool resumed = false;
+    bool done = false;
+    std::string greeting;
+    stream.async_handshake(asio::ssl::stream_base::client, [&](std::error_code ec) {
+        EXPECT_FALSE(ec) << ec.message();
+        if (ec) {
+            done = true;
+            ctx.stop();
+            return;
+        }
+        resumed = SSL_session_reused(stream.native_handle()) == 1;
+        asio::async_read_until(stream, asio::dynamic_buffer(greeting), "\r\n",
+                               [&](std::error_code ec, size_t) {
+                                   EXPECT_FALSE(ec) << ec.message();
+                                   done = true;
+                                   ctx.stop();
+                               });
+    });
+    // Server keeps accepting, so io_context never runs out of work.
+    ctx.restart();
+    ctx.run_for(std::chrono::seconds(5));
+    EXPECT_TRUE(done);
+    return resumed;
+}
+
+}  // namespace
+
+TEST(tls_session_cache_test, second_connection_resumes_session) {
+    asio::io_context ctx;
+    greeting_tls_server server{ctx};
+
+    EXPECT_FALSE(connect_once(ctx, server.port()));
+    EXPECT_GE(tls_session_cache_t::instance().size(), 1);
+    EXPECT_TRUE(connect_once(ctx, server.port()));
+}
+
+TEST(tls_session_cache_test, forget_drops_session) {
+    asio::io_context ctx;
+    greeting_tls_server server{ctx};
+
+    connect_once(ctx, server.port());
+    tls_session_cache_t::instance().forget("localhost:" + server.port());
+    EXPECT_FALSE(connect_once(ctx, server.port()));
+}
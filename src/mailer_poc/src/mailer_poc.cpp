@@ -2,9 +2,13 @@
 #include <emailkit/emailkit.hpp>
 #include <emailkit/google_auth.hpp>
 #include <emailkit/imap_client.hpp>
+#include <emailkit/imap_client_coro.hpp>
+#include <emailkit/imap_connection_pool.hpp>
 #include <emailkit/utils.hpp>
 
+#include <asio/co_spawn.hpp>
 #include <asio/steady_timer.hpp>
+#include <deque>
 #include <fstream>
 #include <mutex>
 #include <ostream>
@@ -21,6 +25,7 @@
 namespace mailer {
 using namespace emailkit;
 using emailkit::imap_client::types::list_response_entry_t;
+using emailkit::imap_client::types::mailbox_status_t;
 using emailkit::types::EmailAddress;
 using emailkit::types::MessageID;
 
@@ -103,7 +108,8 @@ class MailerPOC_impl : public MailerPOC,
                        public EnableUseThis<MailerPOC_impl>,
                        public MailerUIStateParent {
    public:
-    explicit MailerPOC_impl() : m_callbacks(nullptr), m_autoconnect_timer(m_ctx) {}
+    explicit MailerPOC_impl()
+        : m_callbacks(nullptr), m_autoconnect_timer(m_ctx), m_inbox_poll_timer(m_ctx) {}
     ~MailerPOC_impl() { emailkit::finalize(); }
 
    public:  // MailerUIStateParent
@@ -398,232 +404,456 @@ class MailerPOC_impl : public MailerPOC,
         std::string timestamp;
     };
 
+    // Mailboxes are downloaded in parallel, each by one connection of the pool. Huge mailboxes are
+    // split into ranges of messages so that they are downloaded by several connections too.
     void async_download_all_emails(async_callback<void> cb) {
         using namespace emailkit;
         using namespace emailkit::imap_client;
 
-        m_imap_client->async_list_mailboxes(
-            use_this(std::move(cb), [](auto& this_, std::error_code ec,
-                                       imap_client_t::ListMailboxesResult result, auto cb) mutable {
-                ASYNC_RETURN_ON_ERROR(ec, cb, "async list mailboxes failed");
-                log_info("executed list_mailboxes:\n{}",
-                         fmt::join(result.raw_response.inbox_list, "\n"));
-
-                this_.async_download_all_mailboxes(result.raw_response.inbox_list, std::move(cb));
+        m_connection_pool->async_acquire(use_this(
+            std::move(cb), [](auto& this_, std::error_code ec, imap_connection_lease_t lease,
+                              auto cb) mutable {
+                ASYNC_RETURN_ON_ERROR(ec, cb, "no connection for listing mailboxes");
+                auto& client = *lease;
+                client.async_list_mailboxes_with_status(this_.use_this(
+                    std::move(cb),
+                    [lease = std::move(lease)](auto& this_, std::error_code ec,
+                                               imap_client_t::ListMailboxesResult result,
+                                               auto cb) mutable {
+                        if (ec) {
+                            lease.discard();
+                        }
+                        ASYNC_RETURN_ON_ERROR(ec, cb, "async list mailboxes failed");
+                        const bool gmail = lease->capabilities().has(
+                            emailkit::imap_client::imap_capability_t::gmail_ext);
+                        lease.release();
+                        log_info("executed list_mailboxes:\n{}",
+                                 fmt::join(result.raw_response.inbox_list, "\n"));
+
+                        this_.async_download_all_mailboxes(result.raw_response.inbox_list, gmail,
+                                                           std::move(cb));
+                    }));
             }));
     }
 
+    // Part of a mailbox downloaded by one connection.
+    struct mailbox_download_task_t {
+        std::string mailbox_raw;
+        std::vector<std::string> folder_path;
+        int from = 1;
+        std::optional<int> to;  // not known until mailbox is selected
+    };
+
+    struct mailboxes_download_state_t {
+        std::deque<mailbox_download_task_t> tasks;
+        size_t workers_left = 0;
+        std::error_code first_error;
+        // Remembered once all mailboxes are downloaded.
+        std::map<std::string, mailbox_status_t> statuses;
+        async_callback<void> cb;
+    };
+
     void async_download_all_mailboxes(std::vector<list_response_entry_t> list_entries,
+                                      bool gmail,
                                       async_callback<void> cb) {
-        std::reverse(list_entries.begin(), list_entries.end());
-        async_download_all_mailboxes_it(std::move(list_entries), std::move(cb));
-    }
+        // TODO: this should be done at imap client level involving corresponding RFC.
+        // The raw command should not interpret this fields. But non-raw command should be aware
+        // of RFC and can parse this into enum flags.
+        auto is_noselect_box = [](auto& x) {
+            return std::find(x.flags.begin(), x.flags.end(), "\\Noselect") != x.flags.end();
+        };
+        // Special-use mailbox with all messages (https://datatracker.ietf.org/doc/html/rfc6154).
+        auto is_all_box = [](auto& x) {
+            return std::find(x.flags.begin(), x.flags.end(), "\\All") != x.flags.end();
+        };
+
+        // On Gmail label folders are views of All Mail, so the same message would be downloaded
+        // once per label. All Mail alone is downloaded instead, folders come from X-GM-LABELS.
+        if (auto all_box = std::find_if(list_entries.begin(), list_entries.end(), is_all_box);
+            gmail && all_box != list_entries.end()) {
+            log_info("Gmail account, downloading only '{}' with labels", all_box->mailbox_raw);
+            list_entries = {*all_box};
+        }
 
-    void async_download_all_mailboxes_it(std::vector<list_response_entry_t> list_entries,
-                                         async_callback<void> cb) {
-        if (list_entries.empty()) {
-            // done
+        auto state = std::make_shared<mailboxes_download_state_t>();
+        for (auto& e : list_entries) {
+            if (is_noselect_box(e)) {
+                log_info("skipping noselect folder '{}'", e.mailbox_raw);
+                continue;
+            }
+            if (e.inbox_path == vector<string>({"INBOX"})) {
+                continue;  // synchronized by async_watch_inbox
+            }
+            if (e.status) {
+                // Same message count, UIDNEXT, UIDVALIDITY (and HIGHESTMODSEQ) as when downloaded
+                // last time, nothing to select and fetch.
+                auto it = m_downloaded_mailbox_statuses.find(e.mailbox_raw);
+                if (it != m_downloaded_mailbox_statuses.end() && it->second == *e.status) {
+                    log_info("skipping unchanged folder '{}'", e.mailbox_raw);
+                    continue;
+                }
+                state->statuses[e.mailbox_raw] = *e.status;
+            }
+            state->tasks.emplace_back(mailbox_download_task_t{.mailbox_raw = e.mailbox_raw,
+                                                              .folder_path = e.inbox_path});
+        }
+        if (state->tasks.empty()) {
             cb({});
             return;
         }
 
-        auto e = std::move(list_entries.back());
-        list_entries.pop_back();
+        state->workers_left = std::min(state->tasks.size(), SYNC_CONNECTIONS);
+        state->cb = std::move(cb);
+        log_info("downloading {} mailboxes over {} connections", state->tasks.size(),
+                 state->workers_left);
+        for (size_t i = state->workers_left; i > 0; --i) {
+            async_download_next_task(state);
+        }
+    }
 
-        std::string mailbox_path =
-            fmt::format("{}", fmt::join(e.inbox_path, e.hierarchy_delimiter));
+    // Worker takes tasks one by one until there are none left. Failed task does not stop others.
+    void async_download_next_task(std::shared_ptr<mailboxes_download_state_t> state) {
+        if (state->tasks.empty()) {
+            if (--state->workers_left == 0) {
+                if (!state->first_error) {
+                    for (auto& [mailbox, status] : state->statuses) {
+                        m_downloaded_mailbox_statuses[mailbox] = std::move(status);
+                    }
+                }
+                state->cb(state->first_error);
+            }
+            return;
+        }
+        auto task = std::move(state->tasks.front());
+        state->tasks.pop_front();
+
+        async_download_mailbox_task(
+            std::move(task), state,
+            [this_weak = weak_from_this(), state](std::error_code ec) {
+                if (ec && !state->first_error) {
+                    state->first_error = ec;
+                }
+                if (auto this_ = this_weak.lock()) {
+                    this_->async_download_next_task(state);
+                }
+            });
+    }
 
-        log_info("selecting mailbox '{}'", mailbox_path);
+    void async_download_mailbox_task(mailbox_download_task_t task,
+                                     std::shared_ptr<mailboxes_download_state_t> state,
+                                     async_callback<void> cb) {
+        using namespace emailkit::imap_client;
 
-        // TODO: this should be done at imap client level involving corresponding RFC.
-        // The raw command should not interpret this fields. But non-raw command should be aware
-        // of RFC and can parse this into enum flags.
-        auto is_noselect_box = [](auto& x) {
-            return std::find(x.flags.begin(), x.flags.end(), "\\Noselect") != x.flags.end();
-        };
+        m_connection_pool->async_acquire(use_this(
+            std::move(cb), [task = std::move(task), state](
+                               auto& this_, std::error_code ec, imap_connection_lease_t lease,
+                               auto cb) mutable {
+                ASYNC_RETURN_ON_ERROR(ec, cb, "no connection for downloading mailbox");
+
+                // The IMAP protocol is inherently stateful. One should select a mailbox and do
+                // fetches on it.
+                log_info("selecting mailbox: {}", task.mailbox_raw);
+                auto& client = *lease;
+                client.async_select_mailbox(
+                    task.mailbox_raw,
+                    this_.use_this(
+                        std::move(cb),
+                        [task = std::move(task), state, lease = std::move(lease)](
+                            auto& this_, std::error_code ec,
+                            imap_client_t::SelectMailboxResult result, auto cb) mutable {
+                            if (ec) {
+                                lease.discard();
+                            }
+                            ASYNC_RETURN_ON_ERROR(ec, cb, "async select mailbox failed");
+                            const int exists = static_cast<int>(result.raw_response.exists);
+                            log_info("selected {} folder (exists: {}, recents: {})",
+                                     task.mailbox_raw, exists, result.raw_response.recents);
+
+                            if (!task.to) {
+                                // Rest of the mailbox goes to connections which are idle, ahead
+                                // of other mailboxes.
+                                task.to = std::min(exists, task.from + MAILBOX_RANGE_SIZE - 1);
+                                std::vector<mailbox_download_task_t> ranges;
+                                for (int from = *task.to + 1; from <= exists;
+                                     from += MAILBOX_RANGE_SIZE) {
+                                    ranges.emplace_back(mailbox_download_task_t{
+                                        .mailbox_raw = task.mailbox_raw,
+                                        .folder_path = task.folder_path,
+                                        .from = from,
+                                        .to = std::min(exists, from + MAILBOX_RANGE_SIZE - 1)});
+                                }
+                                state->tasks.insert(state->tasks.begin(), ranges.begin(),
+                                                    ranges.end());
+                            }
+
+                            auto& client = *lease;
+                            this_.async_download_emails_for_mailbox(
+                                client, task.from, *task.to, std::move(task.folder_path),
+                                [lease = std::move(lease),
+                                 cb = std::move(cb)](std::error_code ec) mutable {
+                                    if (ec) {
+                                        lease.discard();
+                                    }
+                                    cb(ec);
+                                });
+                        }));
+            }));
+    }
 
-        if (is_noselect_box(e) || e.inbox_path != vector<string>({"INBOX"})) {
-            log_info("skipping noselect folder '{}'", mailbox_path);
-            async_download_all_mailboxes_it(std::move(list_entries), std::move(cb));
+    // Isolates messages which fail to download in from..to, which is known to fail as a whole:
+    // the range is split in halves which are fetched at once (pipelined), failing halves are split
+    // further. One bad message costs O(log n) round trips instead of a fetch per message. Failed
+    // messages are quarantined (see quarantine_email) and replaced by placeholders.
+    void async_download_emails_bisecting(
+        emailkit::imap_client::imap_client_t& client,
+        int from,
+        int to,
+        async_callback<std::vector<emailkit::types::MailboxEmail>> cb) {
+        if (from == to) {
+            client.async_list_items(
+                from, from,
+                use_this(std::move(cb),
+                         [from](auto& this_, std::error_code ec,
+                                std::variant<string, vector<emailkit::types::MailboxEmail>>
+                                    items_or_text,
+                                auto cb) mutable {
+                             if (!ec) {
+                                 // Succeeded alone, e.g. failure was transient.
+                                 cb({}, std::move(std::get<vector<emailkit::types::MailboxEmail>>(
+                                            items_or_text)));
+                                 return;
+                             }
+                             if (!has_failed_response(items_or_text)) {
+                                 cb(ec, {});  // connection problem, not a message one
+                                 return;
+                             }
+                             log_error("failed downloading email {}: {}", from, ec);
+                             cb({}, {this_.quarantine_email(from,
+                                                            std::get<string>(items_or_text))});
+                         }));
             return;
         }
 
-        // The IMAP protocol is inherently stateful. One should select a mailbox and do fetches
-        // on it. So download all the emails we need to select each folder and list one by one.
-        log_info("selecting mailbox: {}", e.mailbox_raw);
-        m_imap_client->async_select_mailbox(
-            e.mailbox_raw,
-            use_this(std::move(cb), [mailbox_path_parts = e.inbox_path, mailbox_path,
-                                     list_entries = std::move(list_entries)](
-                                        auto& this_, std::error_code ec,
-                                        imap_client::imap_client_t::SelectMailboxResult result,
-                                        auto cb) mutable {
-                ASYNC_RETURN_ON_ERROR(ec, cb, "async select mailbox failed");
-                log_info("selected {} folder (exists: {}, recents: {})", mailbox_path,
-                         result.raw_response.exists, result.raw_response.recents);
-
-                log_info("downloading emails on selected folder");
-
-                // this_.m_imap_client->async_execute_command(
-                //     emailkit::imap_client::imap_commands::fetch_t{
-                //         .sequence_set =
-                //             emailkit::imap_client::imap_commands::raw_fetch_sequence_spec{
-                //                 fmt::format("{}:{}", 55, 55)},
-                //         .items =
-                //             emailkit::imap_client::imap_commands::fetch_items_vec_t{
-                //                 emailkit::imap_client::imap_commands::fetch_items::uid_t{},
-                //                 // emailkit::imap_client::imap_commands::fetch_items::
-                //                 //     body_structure_t{},
-                //                 emailkit::imap_client::imap_commands::fetch_items::
-                //                     rfc822_header_t{}}},
-                //     this_.use_this(std::move(cb),
-                //                    [](auto& this_, std::error_code ec, auto response, auto cb) {
-                //                        if (!ec) {
-                //                            log_warning("something strange!");
-                //                        }
-                //                        cb({});
-                //                    }));
-                this_.async_download_emails_for_mailbox(
-                    result.raw_response.exists, std::move(mailbox_path_parts),
-                    this_.use_this(std::move(cb), [list_entries = std::move(list_entries)](
-                                                      auto& this_, std::error_code ec, auto cb) {
-                        ASYNC_RETURN_ON_ERROR(ec, cb,
-                                              "async downlaod emails for mailbox failed: {}");
-                        this_.async_download_all_mailboxes_it(std::move(list_entries),
-                                                              std::move(cb));
-                    }));
-            }));
+        struct halves_state_t {
+            std::vector<emailkit::types::MailboxEmail> left;
+            std::vector<emailkit::types::MailboxEmail> right;
+            int halves_left = 2;
+            std::error_code first_error;
+            async_callback<std::vector<emailkit::types::MailboxEmail>> cb;
+        };
+        auto state = std::make_shared<halves_state_t>(halves_state_t{.cb = std::move(cb)});
+        auto on_half_done = [state](std::error_code ec, bool left,
+                                    std::vector<emailkit::types::MailboxEmail> emails) {
+            if (ec && !state->first_error) {
+                state->first_error = ec;
+            }
+            (left ? state->left : state->right) = std::move(emails);
+            if (--state->halves_left > 0) {
+                return;
+            }
+            if (state->first_error) {
+                state->cb(state->first_error, {});
+                return;
+            }
+            auto& result = state->left;
+            result.insert(result.end(), std::make_move_iterator(state->right.begin()),
+                          std::make_move_iterator(state->right.end()));
+            state->cb({}, std::move(result));
+        };
+
+        const int mid = from + (to - from) / 2;
+        async_download_range_or_bisect(
+            client, from, mid,
+            [on_half_done](std::error_code ec, std::vector<emailkit::types::MailboxEmail> emails) {
+                on_half_done(ec, true, std::move(emails));
+            });
+        async_download_range_or_bisect(
+            client, mid + 1, to,
+            [on_half_done](std::error_code ec, std::vector<emailkit::types::MailboxEmail> emails) {
+                on_half_done(ec, false, std::move(emails));
+            });
     }
 
-    void async_download_emails_for_mailbox_sequential_it(
+    void async_download_range_or_bisect(
+        emailkit::imap_client::imap_client_t& client,
         int from,
         int to,
-        std::vector<emailkit::types::MailboxEmail> acc_vec,
         async_callback<std::vector<emailkit::types::MailboxEmail>> cb) {
-        if (from > to) {
-            log_debug("from > to");
-            cb({}, std::move(acc_vec));
+        if (from == to) {
+            async_download_emails_bisecting(client, from, to, std::move(cb));
             return;
         }
-        m_imap_client->async_list_items(
-            from, from,
+        client.async_list_items(
+            from, to,
             use_this(std::move(cb),
-                     [from, to, acc_vec = std::move(acc_vec)](
-                         auto& this_, std::error_code ec,
-                         std::variant<string, vector<emailkit::types::MailboxEmail>> items_or_text,
-                         auto cb) mutable {
+                     [&client, from, to](auto& this_, std::error_code ec,
+                                         std::variant<string, vector<emailkit::types::MailboxEmail>>
+                                             items_or_text,
+                                         auto cb) mutable {
+                         if (ec && !has_failed_response(items_or_text)) {
+                             cb(ec, {});
+                             return;
+                         }
                          if (ec) {
-                             log_error("failed downloading email with uid {}: {}", from, ec);
-                             emailkit::types::MailboxEmail email;
-                             email.message_uid = from;
-                             email.is_valid = false;
-                             email.subject = fmt::format("<FAILED TO DOWNLOAD EMAIL #{}", from);
-                             acc_vec.emplace_back(std::move(email));
-
-                             if (std::holds_alternative<string>(items_or_text)) {
-                                 auto failed_raw_imap = std::get<string>(items_or_text);
-                                 std::string file_name = fmt::format(
-                                     "failed-{}-{}", from, std::hash<string>{}(failed_raw_imap));
-                                 log_warning("writing failed email body into {}", file_name);
-                                 std::ofstream f(file_name,
-                                                 std::ios_base::out | std::ios_base::binary);
-                                 if (f.good()) {
-                                     f << failed_raw_imap;
-                                     f.close();
-                                 } else {
-                                     log_error("failed writing file with bad IMAP into disk");
-                                 }
-                             }
-                         } else {
-                             assert(std::holds_alternative<vector<emailkit::types::MailboxEmail>>(
-                                 items_or_text));
-                             for (auto& x :
-                                  std::get<vector<emailkit::types::MailboxEmail>>(items_or_text)) {
-                                 acc_vec.emplace_back(std::move(x));
-                             }
+                             log_warning("range {}:{} failed, bisecting: {}", from, to, ec);
+                             this_.async_download_emails_bisecting(client, from, to,
+                                                                   std::move(cb));
+                             return;
                          }
-                         this_.async_download_emails_for_mailbox_sequential_it(
-                             from + 1, to, std::move(acc_vec), std::move(cb));
+                         cb({}, std::move(std::get<vector<emailkit::types::MailboxEmail>>(
+                                    items_or_text)));
                      }));
     }
 
-    void async_download_emails_for_mailbox_sequential(
-        int from,
-        int to,
-        async_callback<std::vector<emailkit::types::MailboxEmail>> cb) {
-        async_download_emails_for_mailbox_sequential_it(from, to, {}, std::move(cb));
+    // Response has been received but could not be processed, as opposed to e.g. connection loss.
+    static bool has_failed_response(
+        const std::variant<string, vector<emailkit::types::MailboxEmail>>& items_or_text) {
+        auto* raw = std::get_if<string>(&items_or_text);
+        return raw && !raw->empty();
     }
 
-    // TODO: what if new email is received on the server while we are downloading folder?
-    void async_download_emails_for_mailbox_it(int from,
-                                              int N,
-                                              std::vector<std::string> folder_path,
-                                              async_callback<void> cb) {
-        if (from > N) {
-            log_info("finished at from={}, N={}", from, N);
-            cb({});
-            return;
+    // Placeholder for email which cannot be downloaded, raw response is dumped into a file for
+    // investigation.
+    emailkit::types::MailboxEmail quarantine_email(int n, const std::string& failed_raw_imap) {
+        emailkit::types::MailboxEmail email;
+        email.message_uid = n;
+        email.is_valid = false;
+        email.subject = fmt::format("<FAILED TO DOWNLOAD EMAIL #{}", n);
+
+        if (!failed_raw_imap.empty()) {
+            std::string file_name =
+                fmt::format("failed-{}-{}", n, std::hash<string>{}(failed_raw_imap));
+            log_warning("writing failed email body into {}", file_name);
+            std::ofstream f(file_name, std::ios_base::out | std::ios_base::binary);
+            if (f.good()) {
+                f << failed_raw_imap;
+                f.close();
+            } else {
+                log_error("failed writing file with bad IMAP into disk");
+            }
         }
-        const int BATCH_SIZE = 50;
-        int to = from + std::min(N - from, BATCH_SIZE);
+        return email;
+    }
 
-        log_info("downloading next batch, from: {}, to: {}", from, to);
+    // Batches of one mailbox range, taken in order by the chains downloading it.
+    struct batches_download_state_t {
+        int next = 1;  // first message of the next batch
+        int last = 0;
+        std::vector<std::string> folder_path;
+        int chains_left = 0;
+        std::error_code first_error;
+        async_callback<void> cb;
+    };
 
-        m_imap_client->async_list_items(
-            from, to,
-            use_this(std::move(cb), [from, to, N, folder_path = std::move(folder_path)](
-                                        auto& this_, std::error_code ec,
-                                        std::variant<string,
-                                                     std::vector<emailkit::types::MailboxEmail>>
-                                            items_or_text,
-                                        auto cb) mutable {
-                if (ec) {
-                    log_error(
-                        "async list items failed on batch {}:{}, falling back to "
-                        "sequential fetch: {}",
-                        from, to, ec);
-                    // Fallback to sequential download which will create dummy emails for ones that
-                    // we failed to download.
-                    this_.async_download_emails_for_mailbox_sequential(
-                        from, to,
-                        this_.use_this(
-                            std::move(cb), [from, to, folder_path = std::move(folder_path)](
-                                               auto& this_, std::error_code ec,
-                                               std::vector<emailkit::types::MailboxEmail> emails,
-                                               auto cb) mutable {
-                                if (ec) {
-                                    log_error(
-                                        "sequential download (fallback) failed to download a batch "
-                                        "{}{}: {} ",
-                                        from, to, ec);
-                                    cb(ec);
-                                    return;
-                                }
-                                // TODO: note, this is async processing.
-                                this_.process_email_folder(folder_path, std::move(emails));
-                                cb({});
-                            }));
-                    return;
+    // TODO: what if new email is received on the server while we are downloading folder?
+    //
+    // Chain takes batches of the range one by one until there are none left. Runs on m_ctx, the
+    // lease of the client is held by the caller until all chains are done.
+    asio::awaitable<std::error_code> download_emails_chain(
+        emailkit::imap_client::imap_client_t& client,
+        std::shared_ptr<batches_download_state_t> state) {
+        namespace coro = emailkit::imap_client::coro;
+        using emailkit::types::MailboxEmail;
+
+        auto this_weak = weak_from_this();
+        while (state->next <= state->last) {
+            const int batch_size = m_fetch_batch_sizer.begin_batch();
+            const int from = state->next;
+            const int to = std::min(state->last, from + batch_size - 1);
+            state->next = to + 1;
+
+            log_info("downloading next batch, from: {}, to: {}", from, to);
+
+            const auto stats_before = client.fetch_stats();
+            const auto started_at = std::chrono::steady_clock::now();
+            auto [ec, items_or_text] = co_await coro::list_items(client, from, to);
+            if (this_weak.expired()) {
+                co_return make_error_code(std::errc::owner_dead);
+            }
+
+            if (ec) {
+                m_fetch_batch_sizer.on_batch_failed(batch_size);
+                if (!has_failed_response(items_or_text)) {
+                    log_error("async list items failed on batch {}:{}: {}", from, to, ec);
+                    co_return ec;
+                }
+                log_error("async list items failed on batch {}:{}, bisecting: {}", from, to, ec);
+                // Good messages of the batch are downloaded, placeholders are created for the ones
+                // that we failed to download.
+                auto [bisect_ec, emails] = co_await coro::async_await<std::vector<MailboxEmail>>(
+                    [&](async_callback<std::vector<MailboxEmail>> cb) {
+                        async_download_emails_bisecting(client, from, to, std::move(cb));
+                    });
+                if (this_weak.expired()) {
+                    co_return make_error_code(std::errc::owner_dead);
                 }
+                if (bisect_ec) {
+                    log_error("bisecting failed to download a batch {}:{}: {}", from, to,
+                              bisect_ec);
+                    co_return bisect_ec;
+                }
+                process_email_folder(state->folder_path, std::move(emails));
+                continue;
+            }
 
-                // TODO: this should probably be named async_ since this is done in UI
-                // thread.
-                this_.process_email_folder(
-                    folder_path,
-                    std::move(std::get<std::vector<emailkit::types::MailboxEmail>>(items_or_text)));
-                this_.async_download_emails_for_mailbox_it(to + 1, N, std::move(folder_path),
-                                                           std::move(cb));
-            }));
+            auto& emails = std::get<std::vector<MailboxEmail>>(items_or_text);
+            m_fetch_batch_sizer.on_batch_completed(
+                batch_size, emails.size(), client.fetch_stats() - stats_before,
+                std::chrono::duration_cast<std::chrono::microseconds>(
+                    std::chrono::steady_clock::now() - started_at),
+                client.connection_health());
+            publish_fetch_batch_metrics();
+
+            // TODO: this should probably be named async_ since this is done in UI thread.
+            process_email_folder(state->folder_path, std::move(emails));
+        }
+        log_info("finished at {}", state->last);
+        co_return std::error_code{};
     }
 
-    // Downlaods all emails from currenty selected inbox.
-    void async_download_emails_for_mailbox(int mailbox_size,
+    void async_download_emails_for_mailbox(emailkit::imap_client::imap_client_t& client,
+                                           int first,
+                                           int last,
                                            std::vector<std::string> folder_path,
                                            async_callback<void> cb) {
         // TODO: in real world program this should not be unbound list but some fixed bucket
 
-        async_download_emails_for_mailbox_it(1, mailbox_size, std::move(folder_path),
-                                             std::move(cb));
+        // Batches are downloaded by several chains at once so that their FETCH commands are
+        // pipelined by imap client. Each chain takes the next batch when its previous one is
+        // done, batch sizes are chosen by m_fetch_batch_sizer.
+        const int chains = static_cast<int>(emailkit::imap_client::DEFAULT_MAX_COMMANDS_IN_FLIGHT);
+        auto state = std::make_shared<batches_download_state_t>(
+            batches_download_state_t{.next = first,
+                                     .last = last,
+                                     .folder_path = std::move(folder_path),
+                                     .chains_left = chains,
+                                     .cb = std::move(cb)});
+
+        for (int i = 0; i < chains; ++i) {
+            asio::co_spawn(m_ctx, download_emails_chain(client, state),
+                           [state](std::exception_ptr e, std::error_code ec) {
+                               if (e) {
+                                   std::rethrow_exception(e);
+                               }
+                               if (ec && !state->first_error) {
+                                   state->first_error = ec;
+                               }
+                               if (--state->chains_left == 0) {
+                                   state->cb(state->first_error);
+                               }
+                           });
+        }
+    }
+
+    void publish_fetch_batch_metrics() {
+        const auto m = m_fetch_batch_sizer.metrics();
+        log_debug("fetch batch: next {} (range {}..{}), {:.0f} bytes and {}us of parsing per "
+                  "message, latency {}ms, {} bytes in flight",
+                  m.batch_size, m.smallest_batch, m.largest_batch, m.bytes_per_message,
+                  m.parse_time_per_message.count(), m.last_latency.count() / 1000,
+                  m.bytes_in_flight);
+        std::lock_guard lock{m_fetch_batch_metrics_mutex};
+        m_fetch_batch_metrics = m;
     }
 
     void process_email_folder(vector<string> folder_path,
@@ -711,6 +941,8 @@ class MailerPOC_impl : public MailerPOC,
     }
 
     void async_accept_creds(IMAPConnectionCreds creds, async_callback<void> cb) override {
+        m_creds = creds;
+
         // If previous call was test connection then current state must be connected and we don't
         // need to reconnect again. If not connected yet, then initiate connection. This seems to be
         // more complicated then needed but it is reasonable.
@@ -720,6 +952,7 @@ class MailerPOC_impl : public MailerPOC,
             change_state(ApplicationState::imap_established);
             // QUESTION: how the app should internally react  to this?
             // WE should somehow initiate business logic: downloading data and do stuff.
+            start_synchronization();
         } else {
             m_ui_state.set_own_address(creds.email_address);
             change_state(ApplicationState::ready_to_connect);
@@ -731,14 +964,21 @@ class MailerPOC_impl : public MailerPOC,
         cb({});
     }
 
+    // Runs only until connection is established, new mail is then pushed by server (see
+    // async_watch_inbox) and the loop is restarted when connection is lost.
     void autoconnect_iteration() {
         m_autoconnect_timer.expires_from_now(30s);
         m_autoconnect_timer.async_wait([this_weak = weak_from_this()](std::error_code ec) {
+            if (ec == asio::error::operation_aborted) {
+                return;  // rearmed
+            }
             if (auto this_ = this_weak.lock()) {
                 switch (this_->m_state) {
                     case ApplicationState::ready_to_connect:
                         this_->trigger_autoconnect();
                         break;
+                    case ApplicationState::imap_established:
+                        return;
                     default:
                         log_debug("autconnect not applicable in state: {}",
                                   fmt::streamed(this_->m_state));
@@ -749,6 +989,96 @@ class MailerPOC_impl : public MailerPOC,
         });
     }
 
+    // INBOX is watched over the main connection, other mailboxes are downloaded over connections
+    // of the pool. Pool and its downloads outlive the main connection, after reconnect only
+    // watching INBOX is started again.
+    void start_synchronization() {
+        if (!m_connection_pool) {
+            m_connection_pool = emailkit::imap_client::make_imap_connection_pool(
+                m_ctx, {.max_connections = SYNC_CONNECTIONS},
+                [this_weak = weak_from_this()](emailkit::imap_client::imap_client_t& client,
+                                               emailkit::call_opts_t opts,
+                                               async_callback<void> cb) {
+                    auto this_ = this_weak.lock();
+                    if (!this_) {
+                        cb(make_error_code(std::errc::owner_dead));
+                        return;
+                    }
+                    this_->async_setup_connection(client, this_->m_creds, std::move(opts),
+                                                  std::move(cb));
+                });
+            run_background_activities();
+        }
+
+        async_watch_inbox();
+    }
+
+    // Downloads new emails of INBOX and waits for more with IDLE. When server reports new
+    // messages, IDLE is stopped and synchronization fetches only messages above last known UID.
+    // Servers without IDLE are polled every INBOX_POLL_INTERVAL instead.
+    void async_watch_inbox() {
+        m_imap_client->async_sync_mailbox(
+            "INBOX", m_inbox_sync_state,
+            [this_weak = weak_from_this()](
+                std::error_code ec,
+                emailkit::imap_client::imap_client_t::MailboxSyncResult result) {
+                auto this_ = this_weak.lock();
+                if (!this_) {
+                    return;
+                }
+                if (ec) {
+                    this_->on_watching_inbox_failed(ec);
+                    return;
+                }
+
+                log_info("INBOX synchronized, {} new emails", result.new_emails.size());
+                if (!result.new_emails.empty()) {
+                    this_->process_email_folder({"INBOX"}, std::move(result.new_emails));
+                }
+                this_->m_inbox_sync_state = result.state;
+
+                const auto& capabilities = this_->m_imap_client->capabilities();
+                if (capabilities.known() &&
+                    !capabilities.has(emailkit::imap_client::imap_capability_t::idle)) {
+                    this_->m_inbox_poll_timer.expires_from_now(INBOX_POLL_INTERVAL);
+                    this_->m_inbox_poll_timer.async_wait([this_weak](std::error_code ec) {
+                        if (ec == asio::error::operation_aborted) {
+                            return;
+                        }
+                        if (auto this_ = this_weak.lock()) {
+                            this_->async_watch_inbox();
+                        }
+                    });
+                    return;
+                }
+
+                this_->m_imap_client->async_idle(
+                    [this_weak](const emailkit::imap_client::types::idle_event_t& e) {
+                        auto this_ = this_weak.lock();
+                        if (this_ &&
+                            e.kind == emailkit::imap_client::types::idle_event_kind_t::exists) {
+                            log_info("new email in INBOX");
+                            this_->m_imap_client->stop_idle();
+                        }
+                    },
+                    [this_weak](std::error_code ec) {
+                        if (auto this_ = this_weak.lock()) {
+                            if (ec) {
+                                this_->on_watching_inbox_failed(ec);
+                                return;
+                            }
+                            this_->async_watch_inbox();
+                        }
+                    });
+            });
+    }
+
+    void on_watching_inbox_failed(std::error_code ec) {
+        log_error("watching INBOX failed, reconnecting: {}", ec);
+        change_state(ApplicationState::ready_to_connect);
+        autoconnect_iteration();
+    }
+
     // Attempts to connect with specified creds. Creds have all necessarry information inside
     // effectively encapsulating credentials and server address.
     void async_test_creds(IMAPConnectionCreds creds, async_callback<void> cb) override {
@@ -765,36 +1095,103 @@ class MailerPOC_impl : public MailerPOC,
             }));
     }
 
+    // Done over a connection of the pool so that watching INBOX is not interrupted.
+    void async_search_mailbox(
+        std::string mailbox,
+        emailkit::imap_client::search_query_t query,
+        async_callback<emailkit::imap_client::types::search_response_t> cb) override {
+        using namespace emailkit::imap_client;
+
+        if (!m_connection_pool) {
+            cb(make_error_code(std::errc::not_connected), {});
+            return;
+        }
+        m_connection_pool->async_acquire(use_this(
+            std::move(cb), [mailbox = std::move(mailbox), query = std::move(query)](
+                               auto& this_, std::error_code ec, imap_connection_lease_t lease,
+                               auto cb) mutable {
+                ASYNC_RETURN_ON_ERROR(ec, cb, "no connection for searching mailbox");
+                auto& client = *lease;
+                client.async_select_mailbox(
+                    mailbox, [lease = std::move(lease), query = std::move(query),
+                              cb = std::move(cb)](std::error_code ec,
+                                                  imap_client_t::SelectMailboxResult) mutable {
+                        if (ec) {
+                            lease.discard();
+                        }
+                        ASYNC_RETURN_ON_ERROR(ec, cb, "async select mailbox failed");
+                        auto& client = *lease;
+                        client.async_search(
+                            std::move(query),
+                            [lease = std::move(lease), cb = std::move(cb)](
+                                std::error_code ec, types::search_response_t response) mutable {
+                                if (ec) {
+                                    lease.discard();
+                                }
+                                ASYNC_RETURN_ON_ERROR(ec, cb, "searching mailbox failed");
+                                log_info("found {} emails", response.count.value_or(0));
+                                cb({}, std::move(response));
+                            });
+                    });
+            }));
+    }
+
     ApplicationState get_state() override { return m_state; }
 
+    emailkit::fetch_batch_metrics_t fetch_batch_metrics() override {
+        std::lock_guard lock{m_fetch_batch_metrics_mutex};
+        return m_fetch_batch_metrics;
+    }
+
     void trigger_autoconnect() {
         log_info("triggering autoconnect..");
         assert(m_state != ApplicationState::imap_established &&
                m_state != ApplicationState::imap_authenticating);
 
-        auto cb = [](std::error_code ec) {
-            log_debug("Failed connecting to IMAP server: {}", ec);
-            // Don't do any actions, autoconnect timer loop will take care of making more attempts.
+        auto cb = [this_weak = weak_from_this()](std::error_code ec) {
+            if (ec) {
+                log_debug("Failed connecting to IMAP server: {}", ec);
+                // Don't do any actions, autoconnect timer loop will take care of making more
+                // attempts.
+                return;
+            }
+            if (auto this_ = this_weak.lock()) {
+                this_->change_state(ApplicationState::imap_established);
+                this_->start_synchronization();
+            }
         };
 
         async_connect_and_authenticate(m_creds, std::move(cb));
     }
 
     void async_connect_and_authenticate(IMAPConnectionCreds creds, async_callback<void> cb) {
+        // One deadline for the whole sequence so that hung server does not block autoconnect.
+        async_setup_connection(*m_imap_client, std::move(creds),
+                               emailkit::call_opts_t::timeout(30s), std::move(cb));
+    }
+
+    // Connects, authenticates and enables compression, for the main connection as well as for
+    // connections of the pool.
+    void async_setup_connection(emailkit::imap_client::imap_client_t& client,
+                                IMAPConnectionCreds creds,
+                                emailkit::call_opts_t opts,
+                                async_callback<void> cb) {
         log_info("connecting to IMAP server: {}", fmt::streamed(creds));
-        m_imap_client->async_connect(
-            creds.host, std::to_string(creds.port),
-            use_this(std::move(cb), [creds](auto& this_, std::error_code ec, auto cb) mutable {
+        client.async_connect(
+            creds.host, std::to_string(creds.port), opts,
+            use_this(std::move(cb), [&client, creds, opts](auto& this_, std::error_code ec,
+                                                           auto cb) mutable {
                 if (ec) {
                     log_error("failed connecting Gmail IMAP: {}", ec);
+                    cb(ec);
                     return;
                 }
 
                 // now we need to authenticate on imap server
-                this_.m_imap_client->async_authenticate(
-                    {.user_email = creds.email_address, .oauth_token = creds.access_token},
+                client.async_authenticate(
+                    {.user_email = creds.email_address, .oauth_token = creds.access_token}, opts,
                     this_.use_this(std::move(cb),
-                                   [](auto& this_, std::error_code ec,
+                                   [&client, opts](auto& this_, std::error_code ec,
                                       emailkit::imap_client::auth_error_details_t err_details,
                                       auto cb) mutable {
                                        if (ec) {
@@ -808,11 +1205,39 @@ class MailerPOC_impl : public MailerPOC,
                                        // which would indicate information about all current
                                        // connections.
 
-                                       cb({});
+                                       this_.async_try_enable_compression(client, opts,
+                                                                          std::move(cb));
                                    }));
             }));
     }
 
+    // Compression is an optimization, connection works without it as well.
+    void async_try_enable_compression(emailkit::imap_client::imap_client_t& client,
+                                      emailkit::call_opts_t opts,
+                                      async_callback<void> cb) {
+        const auto& capabilities = client.capabilities();
+        if (capabilities.known() &&
+            !capabilities.has(emailkit::imap_client::imap_capability_t::compress_deflate)) {
+            log_info("server does not support compression, continuing without it");
+            cb({});
+            return;
+        }
+        client.async_execute_command(
+            emailkit::imap_client::imap_commands::compress_deflate_t{}, std::move(opts),
+            [cb = std::move(cb)](std::error_code ec) mutable {
+                if (ec == std::errc::operation_not_supported) {
+                    log_warning("server declined compression, continuing without it");
+                } else if (ec) {
+                    log_error("failed enabling compression: {}", ec);
+                    cb(ec);
+                    return;
+                } else {
+                    log_info("IMAP connection is compressed");
+                }
+                cb({});
+            });
+    }
+
     void change_state(ApplicationState state) {
         if (state != m_state) {
             log_info("----------------------------------");
@@ -824,13 +1249,32 @@ class MailerPOC_impl : public MailerPOC,
     }
 
    private:
+    // Ceiling for emails of the account being downloaded at once, over all connections.
+    static constexpr size_t FETCH_MEMORY_CEILING = 32 * 1024 * 1024;
+    // Connections used for downloading mailboxes, in addition to the main one. Fewer are used if
+    // server does not allow that many.
+    static constexpr size_t SYNC_CONNECTIONS = 4;
+    // Mailboxes bigger than that are downloaded by several connections.
+    static constexpr int MAILBOX_RANGE_SIZE = 2000;
+    // INBOX is polled that often if server does not support IDLE.
+    static constexpr auto INBOX_POLL_INTERVAL = 2min;
+
     std::unique_ptr<std::thread> m_thread;
     asio::io_context m_ctx;
 
     MailerPOCCallbacks* m_callbacks;
     std::shared_ptr<emailkit::google_auth_t> m_google_auth;
     std::shared_ptr<emailkit::imap_client::imap_client_t> m_imap_client;
+    std::shared_ptr<emailkit::imap_client::imap_connection_pool_t> m_connection_pool;
     asio::steady_timer m_autoconnect_timer;
+    asio::steady_timer m_inbox_poll_timer;
+    emailkit::imap_client::imap_client_t::MailboxSyncState m_inbox_sync_state;
+    // Status of every mailbox as of its last successful download.
+    std::map<std::string, mailbox_status_t> m_downloaded_mailbox_statuses;
+    emailkit::fetch_batch_sizer_t m_fetch_batch_sizer{
+        {.max_bytes_in_flight = FETCH_MEMORY_CEILING}};
+    emailkit::fetch_batch_metrics_t m_fetch_batch_metrics;
+    std::mutex m_fetch_batch_metrics_mutex;
 
     MailerUIState m_ui_state{""};
     std::mutex m_ui_state_mutex;
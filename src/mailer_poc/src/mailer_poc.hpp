@@ -152,7 +152,19 @@ class MailerPOC {
     // effectively encapsulating credentials and server address.
     virtual void async_test_creds(IMAPConnectionCreds creds, async_callback<void> cb) = 0;
 
+    // Searches mailbox on server without downloading its emails, e.g. for a filtered view or
+    // number of unread emails from someone. Mailbox is raw name as listed by server. Fails with
+    // not_connected until IMAP connection is established.
+    virtual void async_search_mailbox(
+        std::string mailbox,
+        emailkit::imap_client::search_query_t query,
+        async_callback<emailkit::imap_client::types::search_response_t> cb) = 0;
+
     virtual ApplicationState get_state() = 0;
+
+    // Batch sizes chosen for downloading emails and what they are based on, updated after every
+    // batch. Can be called from any thread.
+    virtual emailkit::fetch_batch_metrics_t fetch_batch_metrics() = 0;
 };
 
 std::shared_ptr<MailerPOC> make_mailer_poc();
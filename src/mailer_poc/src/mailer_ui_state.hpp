@@ -6,6 +6,7 @@
 #include <emailkit/utils.hpp>
 
 #include <set>
+#include <unordered_map>
 
 namespace mailer {
 using namespace emailkit;
@@ -172,11 +173,20 @@ class MailerUIState {
 
         optional<types::MessageID> thread_id_opt;
         TreeNode* thread_id_node = nullptr;
-        for (auto& mid : references) {
-            if (auto it = m_thread_id_to_tree_index.find(mid);
-                it != m_thread_id_to_tree_index.end()) {
-                thread_id_opt = mid;
-                thread_id_node = it->second;
+        if (email.gmail_thread_id.has_value()) {
+            // Gmail tells the conversation directly, no need to match References.
+            if (auto it = m_gmail_thread_index.find(*email.gmail_thread_id);
+                it != m_gmail_thread_index.end()) {
+                thread_id_opt = it->second.thread_id;
+                thread_id_node = it->second.node;
+            }
+        } else {
+            for (auto& mid : references) {
+                if (auto it = m_thread_id_to_tree_index.find(mid);
+                    it != m_thread_id_to_tree_index.end()) {
+                    thread_id_opt = mid;
+                    thread_id_node = it->second;
+                }
             }
         }
 
@@ -286,6 +296,9 @@ class MailerUIState {
 
             m_thread_id_to_tree_index.erase(*thread_id_opt);
             m_thread_id_to_tree_index.emplace(*thread_id_opt, group_folder_node);
+            if (email.gmail_thread_id.has_value()) {
+                m_gmail_thread_index[*email.gmail_thread_id].node = group_folder_node;
+            }
 
             if (new_location) {
                 // m_message_to_tree_index.erase(*thread_id_opt);
@@ -302,6 +315,10 @@ class MailerUIState {
                                         .attachments_count = email.attachments.size()});
             m_thread_id_to_tree_index[email.message_id.value()] = group_folder_node;
             //            m_message_to_tree_index[email.message_id.value()] = group_folder_node;
+            if (email.gmail_thread_id.has_value()) {
+                m_gmail_thread_index[*email.gmail_thread_id] = GmailThread{
+                    .thread_id = email.message_id.value(), .node = group_folder_node};
+            }
         }
     }
 
@@ -504,6 +521,12 @@ class MailerUIState {
     map<MessageID, types::MailboxEmail> m_message_id_to_email_index;
     //    map<MessageID, TreeNode*> m_message_to_tree_index;
     map<MessageID, TreeNode*> m_thread_id_to_tree_index;
+    // X-GM-THRID -> thread, for emails from Gmail which are threaded by Gmail's thread id.
+    struct GmailThread {
+        MessageID thread_id;
+        TreeNode* node = nullptr;
+    };
+    std::unordered_map<uint64_t, GmailThread> m_gmail_thread_index;
     map<set<types::EmailAddress>, TreeNode*> m_contact_group_to_node_index;
     MailerUIStateParent* m_parent;
 };
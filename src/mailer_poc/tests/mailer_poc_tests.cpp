@@ -249,6 +249,31 @@ TEST(mailer_poc_tests, conversation_with_self_basic_test) {
         render_tree(ui));
 }
 
+TEST(mailer_poc_tests, gmail_thread_id_threading) {
+    mailer::MailerUIState ui{"sli.ukraine@gmail.com"};
+
+    auto make_gmail_email = [](auto subject, auto message_id, uint64_t thread_id,
+                               vector<MessageID> references = {}) {
+        auto email = make_email({"combdn@gmail.com"}, {"sli.ukraine@gmail.com"}, subject,
+                                message_id, references);
+        email.gmail_thread_id = thread_id;
+        return email;
+    };
+
+    ui.process_email(make_gmail_email("Hi", "e1", 1001));
+    // Gmail thread id wins: no References but the same thread, and References pointing to other
+    // thread are not followed.
+    ui.process_email(make_gmail_email("Re: Hi", "e2", 1001));
+    ui.process_email(make_gmail_email("Other", "e3", 1002, {"e1"}));
+    ASSERT_EQ(
+        R"([$root]
+    [combdn@gmail.com]
+        Hi (emails: 2)
+        Other (emails: 1)
+)",
+        render_tree(ui, true));
+}
+
 TEST(mailer_poc_tests, conversation_with_self_real_world_issue) {
     mailer::MailerUIState ui{"liubomyr.semkiv.test@gmail.com"};
     ui.process_email(
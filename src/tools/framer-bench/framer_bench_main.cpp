@@ -0,0 +1,241 @@
+// Compares imap_response_framer_t with byte-by-byte matcher that imap_socket used before it.
+//
+// Usage: framer-bench [<response-dump> <tag>]...
+//
+// Each dump is expected to contain exactly one response, ending with the tagged line, e.g. what
+// protocol log has for a single FETCH. Responses are replicated to a few megabytes so that timings
+// are meaningful. Without arguments, Gmail FETCH dump from emailkit tests is used together with
+// synthetic response carrying a large attachment.
+#include <emailkit/imap_response_framer.hpp>
+
+#include <fmt/format.h>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <sstream>
+
+namespace {
+
+// Copy of imap_match_condition_t as it was before imap_response_framer_t, with asio iterators
+// replaced by plain pointers.
+struct legacy_matcher_t {
+    explicit legacy_matcher_t(std::string tag) : m_pattern_prefix{fmt::format("{} ", tag)} {}
+
+    enum class state_t { idle, reading_size, waiting_cr, waiting_lf, reading_data, got_tag };
+
+    std::pair<const char*, bool> operator()(const char* begin, const char* end) {
+        const char* it = begin;
+        for (; it != end; ++it) {
+            if (m_state == state_t::reading_data) {
+                const auto progress =
+                    m_literal_size > 0
+                        ? ((static_cast<double>(m_literal_size - m_literal_data_bytes_left) /
+                            m_literal_size) *
+                           100.0)
+                        : 100.0;
+                if ((progress - m_prev_progress) >= 5.0 || static_cast<int>(progress) == 100) {
+                    log_debug("progress: {}%", std::round(progress));
+                    m_prev_progress = progress;
+                }
+            }
+
+            if (m_state == state_t::got_tag) {
+                if (m_prev == 0x0d && *it == 0x0a) {
+                    return {it + 1, true};
+                }
+            } else if (m_state == state_t::idle) {
+                if (*it == '{') {
+                    m_state = state_t::reading_size;
+                    m_literal_size_s = "";
+                } else if (m_prev == 0x0d && *it == 0x0a) {
+                    m_line_size = 0;
+                } else {
+                    if (*it == m_pattern_prefix[m_next_expected_prefix_char_idx] &&
+                        m_next_expected_prefix_char_idx == m_line_size) {
+                        m_next_expected_prefix_char_idx++;
+                        if (m_next_expected_prefix_char_idx == m_pattern_prefix.size()) {
+                            m_state = state_t::got_tag;
+                        }
+                    }
+                    m_line_size++;
+                }
+            } else if (m_state == state_t::reading_size) {
+                if (*it == '}') {
+                    m_state = state_t::waiting_cr;
+                } else if (isdigit(*it)) {
+                    m_literal_size_s += *it;
+                }
+            } else if (m_state == state_t::waiting_cr) {
+                if (*it == 0x0d) {
+                    m_state = state_t::waiting_lf;
+                } else {
+                    m_state = state_t::idle;
+                    m_next_expected_prefix_char_idx = 0;
+                }
+            } else if (m_state == state_t::waiting_lf) {
+                if (*it == 0x0a) {
+                    m_state = state_t::reading_data;
+                    m_prev_progress = 0.0;
+                    m_literal_size = std::stoi(m_literal_size_s);
+                    m_literal_data_bytes_left = m_literal_size;
+                    if (m_literal_data_bytes_left == 0) {
+                        m_state = state_t::idle;
+                        m_next_expected_prefix_char_idx = 0;
+                    }
+                } else {
+                    m_state = state_t::idle;
+                    m_next_expected_prefix_char_idx = 0;
+                }
+            } else if (m_state == state_t::reading_data) {
+                if (m_literal_data_bytes_left-- == 0) {
+                    m_state = state_t::idle;
+                    m_next_expected_prefix_char_idx = 0;
+                }
+            }
+
+            m_prev = *it;
+        }
+        return {end, false};
+    }
+
+    size_t m_literal_data_bytes_left = 0;
+    state_t m_state = state_t::idle;
+    std::string m_literal_size_s;
+    size_t m_literal_size = 0;
+    size_t m_next_expected_prefix_char_idx = 0;
+    const std::string m_pattern_prefix;
+    unsigned char m_prev = 255;
+    size_t m_line_size = 0;
+    double m_prev_progress{};
+};
+
+// Size of chunks as they typically come from TLS stream.
+constexpr size_t CHUNK_SIZE = 16 * 1024;
+constexpr size_t TARGET_RESPONSE_SIZE = 32 * 1024 * 1024;
+
+struct bench_case_t {
+    std::string name;
+    std::string tag;
+    std::string response;
+};
+
+// Repeats untagged part of the response until it is at least TARGET_RESPONSE_SIZE long.
+std::string replicate_response(std::string_view response, std::string_view tag) {
+    const auto tagged_line_pos = response.rfind(fmt::format("\r\n{} ", tag));
+    if (tagged_line_pos == std::string_view::npos) {
+        return std::string{response};
+    }
+    const auto untagged_part = response.substr(0, tagged_line_pos + 2);
+    const auto tagged_line = response.substr(tagged_line_pos + 2);
+
+    std::string result;
+    result.reserve(TARGET_RESPONSE_SIZE + response.size());
+    while (result.size() < TARGET_RESPONSE_SIZE) {
+        result += untagged_part;
+    }
+    result += tagged_line;
+    return result;
+}
+
+std::string make_attachment_response() {
+    std::string body;
+    body.reserve(TARGET_RESPONSE_SIZE);
+    while (body.size() < TARGET_RESPONSE_SIZE) {
+        body += "QUJDREVGR0hJSktMTU5PUFFSU1RVVldYWVphYmNkZWZnaGlqa2xtbm9wcXJzdHV2d3h5ejAxMjM0\r\n";
+    }
+    return fmt::format("* 1 FETCH (UID 1 RFC822 {{{}}}\r\n{})\r\nA1 OK Success\r\n", body.size(),
+                       body);
+}
+
+template <class F>
+double measure_mb_per_sec(const std::string& response, F&& feed_chunk) {
+    constexpr int ITERATIONS = 5;
+    const auto started_ts = std::chrono::steady_clock::now();
+    for (int i = 0; i < ITERATIONS; ++i) {
+        if (!feed_chunk(response)) {
+            fmt::print(stderr, "response end has not been found\n");
+            return 0.0;
+        }
+    }
+    const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - started_ts;
+    return (static_cast<double>(response.size()) * ITERATIONS / (1024.0 * 1024.0)) /
+           elapsed.count();
+}
+
+void run_case(const bench_case_t& c) {
+    const double legacy_mbps = measure_mb_per_sec(c.response, [&](const std::string& r) {
+        legacy_matcher_t matcher{c.tag};
+        for (size_t offset = 0; offset < r.size(); offset += CHUNK_SIZE) {
+            const char* begin = r.data() + offset;
+            const char* end = r.data() + std::min(r.size(), offset + CHUNK_SIZE);
+            if (matcher(begin, end).second) {
+                return true;
+            }
+        }
+        return false;
+    });
+
+    const double framer_mbps = measure_mb_per_sec(c.response, [&](const std::string& r) {
+        emailkit::imap_response_framer_t framer{c.tag};
+        for (size_t offset = 0; offset < r.size(); offset += CHUNK_SIZE) {
+            const char* begin = r.data() + offset;
+            const char* end = r.data() + std::min(r.size(), offset + CHUNK_SIZE);
+            if (framer.feed(begin, end)) {
+                return true;
+            }
+        }
+        return false;
+    });
+
+    fmt::print("{:<40} {:>8.1f}MB {:>10.1f}MB/s {:>10.1f}MB/s {:>7.1f}x\n", c.name,
+               c.response.size() / (1024.0 * 1024.0), legacy_mbps, framer_mbps,
+               legacy_mbps > 0 ? framer_mbps / legacy_mbps : 0.0);
+}
+
+std::optional<std::string> read_file(const std::string& path) {
+    std::ifstream file{path, std::ios::binary};
+    if (!file) {
+        return std::nullopt;
+    }
+    std::stringstream ss;
+    ss << file.rdbuf();
+    return ss.str();
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+    g_current_level = log_level_t::error;
+
+    std::vector<bench_case_t> cases;
+    if (argc > 1) {
+        if ((argc - 1) % 2 != 0) {
+            fmt::print(stderr, "usage: {} [<response-dump> <tag>]...\n", argv[0]);
+            return 1;
+        }
+        for (int i = 1; i + 1 < argc; i += 2) {
+            auto contents = read_file(argv[i]);
+            if (!contents) {
+                fmt::print(stderr, "failed to read {}\n", argv[i]);
+                return 1;
+            }
+            cases.push_back(
+                bench_case_t{argv[i], argv[i + 1], replicate_response(*contents, argv[i + 1])});
+        }
+    } else {
+        if (auto contents = read_file("gmail_autoreply_test.dat")) {
+            cases.push_back(bench_case_t{"gmail FETCH RFC822.HEADER", "A8",
+                                         replicate_response(*contents, "A8")});
+        } else {
+            fmt::print(stderr, "gmail_autoreply_test.dat not found, skipping\n");
+        }
+        cases.push_back(
+            bench_case_t{"single large RFC822 literal", "A1", make_attachment_response()});
+    }
+
+    fmt::print("{:<40} {:>10} {:>12} {:>12} {:>8}\n", "case", "size", "legacy", "framer",
+               "speedup");
+    for (auto& c : cases) {
+        run_case(c);
+    }
+}
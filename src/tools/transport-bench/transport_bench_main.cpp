@@ -0,0 +1,178 @@
+// Measures cost of receiving large IMAP responses on many connections at once with whatever asio
+// backend emailkit is compiled with (epoll by default, io_uring with EMAILKIT_USE_IO_URING).
+//
+// Usage: transport-bench [accounts] [megabytes-per-account]
+//
+// Server side runs on its own thread and sends every account one FETCH response with a big
+// literal. Client side runs on main thread and reads responses the same way imap_socket does:
+// read_some into a receive buffer and let imap_response_framer_t find the end of the response.
+// Only client thread CPU is reported. Read operations per MB is an approximation of syscalls per
+// MB for epoll (one recv per read); for exact numbers run under `strace -c -f`.
+#include <emailkit/imap_response_framer.hpp>
+#include <emailkit/imap_socket.hpp>
+
+#include <asio.hpp>
+#include <fmt/format.h>
+#include <sys/resource.h>
+#include <thread>
+
+namespace {
+
+constexpr size_t READ_CHUNK_SIZE = 64 * 1024;
+
+struct thread_usage_t {
+    std::chrono::microseconds user{};
+    std::chrono::microseconds sys{};
+    long voluntary_ctx_switches = 0;
+
+    static thread_usage_t now() {
+        rusage ru{};
+        getrusage(RUSAGE_THREAD, &ru);
+        auto to_us = [](timeval tv) {
+            return std::chrono::seconds{tv.tv_sec} + std::chrono::microseconds{tv.tv_usec};
+        };
+        return {to_us(ru.ru_utime), to_us(ru.ru_stime), ru.ru_nvcsw};
+    }
+};
+
+std::string make_response(size_t literal_size) {
+    std::string literal(literal_size, 'x');
+    for (size_t i = 76; i < literal.size(); i += 78) {
+        literal[i - 1] = '\r';
+        literal[i] = '\n';
+    }
+    return fmt::format("* 1 FETCH (UID 1 RFC822 {{{}}}\r\n{})\r\nA1 OK Success\r\n", literal_size,
+                       literal);
+}
+
+class sending_server_t {
+   public:
+    sending_server_t(size_t accounts, std::string response)
+        : m_acceptor(m_ctx, asio::ip::tcp::endpoint{asio::ip::make_address("127.0.0.1"), 0}),
+          m_response(std::move(response)),
+          m_accounts_left(accounts) {}
+
+    asio::ip::tcp::endpoint endpoint() const { return m_acceptor.local_endpoint(); }
+
+    void run() {
+        do_accept();
+        m_thread = std::thread([this] { m_ctx.run(); });
+    }
+
+    void join() { m_thread.join(); }
+
+   private:
+    void do_accept() {
+        m_acceptor.async_accept([this](std::error_code ec, asio::ip::tcp::socket socket) {
+            if (ec) {
+                fmt::print(stderr, "accept failed: {}\n", ec.message());
+                return;
+            }
+            auto s = std::make_shared<asio::ip::tcp::socket>(std::move(socket));
+            asio::async_write(*s, asio::buffer(m_response), [s](std::error_code ec, size_t) {
+                if (ec) {
+                    fmt::print(stderr, "write failed: {}\n", ec.message());
+                }
+            });
+            if (--m_accounts_left > 0) {
+                do_accept();
+            }
+        });
+    }
+
+    asio::io_context m_ctx;
+    asio::ip::tcp::acceptor m_acceptor;
+    const std::string m_response;
+    size_t m_accounts_left;
+    std::thread m_thread;
+};
+
+struct account_t {
+    explicit account_t(asio::io_context& ctx) : socket(ctx), framer("A1") {}
+
+    asio::ip::tcp::socket socket;
+    emailkit::imap_response_framer_t framer;
+    std::string recv_buff;
+    size_t bytes_received = 0;
+    size_t read_ops = 0;
+    bool done = false;
+};
+
+void async_read_response(account_t& a) {
+    const size_t offset = a.recv_buff.size();
+    a.recv_buff.resize(offset + READ_CHUNK_SIZE);
+    a.socket.async_read_some(
+        asio::buffer(a.recv_buff.data() + offset, READ_CHUNK_SIZE),
+        [&a, offset](std::error_code ec, size_t n) {
+            a.read_ops++;
+            a.recv_buff.resize(offset + n);
+            if (ec) {
+                fmt::print(stderr, "read failed: {}\n", ec.message());
+                return;
+            }
+            a.bytes_received += n;
+            if (a.framer.feed(a.recv_buff.data() + offset, a.recv_buff.data() + offset + n)) {
+                a.done = true;
+                return;
+            }
+            // Like in imap_socket, literal bytes are not needed once framer skipped them, but
+            // receive buffer keeps whole response. Here it is dropped to keep memory flat.
+            a.recv_buff.clear();
+            async_read_response(a);
+        });
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+    g_current_level = log_level_t::error;
+
+    const size_t accounts = argc > 1 ? std::stoul(argv[1]) : 100;
+    const size_t megabytes_per_account = argc > 2 ? std::stoul(argv[2]) : 8;
+
+    const std::string response = make_response(megabytes_per_account * 1024 * 1024);
+    sending_server_t server{accounts, response};
+    server.run();
+
+    asio::io_context ctx;
+    std::vector<std::unique_ptr<account_t>> clients;
+    for (size_t i = 0; i < accounts; ++i) {
+        clients.emplace_back(std::make_unique<account_t>(ctx));
+        clients.back()->socket.connect(server.endpoint());
+    }
+
+    const auto usage_before = thread_usage_t::now();
+    const auto started_ts = std::chrono::steady_clock::now();
+
+    for (auto& c : clients) {
+        async_read_response(*c);
+    }
+    ctx.run();
+
+    const std::chrono::duration<double> wall = std::chrono::steady_clock::now() - started_ts;
+    const auto usage_after = thread_usage_t::now();
+    server.join();
+
+    size_t bytes_total = 0, read_ops_total = 0, done_total = 0;
+    for (auto& c : clients) {
+        bytes_total += c->bytes_received;
+        read_ops_total += c->read_ops;
+        done_total += c->done ? 1 : 0;
+    }
+
+    const double mb_total = bytes_total / (1024.0 * 1024.0);
+    const auto user = usage_after.user - usage_before.user;
+    const auto sys = usage_after.sys - usage_before.sys;
+
+    fmt::print("backend:                {}\n", emailkit::imap_socket_io_backend());
+    fmt::print("accounts:               {} ({} completed)\n", accounts, done_total);
+    fmt::print("received:               {:.1f}MB in {:.3f}s ({:.1f}MB/s)\n", mb_total, wall.count(),
+               mb_total / wall.count());
+    fmt::print("client cpu:             user {}ms, sys {}ms\n", user.count() / 1000,
+               sys.count() / 1000);
+    fmt::print("client cpu per account: {:.2f}ms\n", (user + sys).count() / 1000.0 / accounts);
+    fmt::print("read ops per MB:        {:.1f}\n", read_ops_total / mb_total);
+    fmt::print("voluntary ctx switches: {}\n",
+               usage_after.voluntary_ctx_switches - usage_before.voluntary_ctx_switches);
+    return done_total == accounts ? 0 : 1;
+}